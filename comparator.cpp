@@ -368,6 +368,37 @@ void Comparator::init(ColumnSpec lct, unsigned int loff,
 			size = min(lct.size, rct.size);
 			break;
 
+		// First argument is a varchar.
+		//
+		case CT_VARCHAR:
+			if (rct.type != CT_VARCHAR)
+				throw UnknownComparisonException();
+
+			switch(op) {
+				case Equal:
+					fn = VarcharVarcharEqual;
+					break;
+				case NotEqual:
+					fn = VarcharVarcharNotEqual;
+					break;
+				case Less:
+					fn = VarcharVarcharLess;
+					break;
+				case LessEqual:
+					fn = VarcharVarcharLessEqual;
+					break;
+				case Greater:
+					fn = VarcharVarcharGreater;
+					break;
+				case GreaterEqual:
+					fn = VarcharVarcharGreaterEqual;
+					break;
+				default:
+					fn = MakesNoSense;
+					break;
+			}
+			break;
+
 		// First argument is a date.
 		//
 		// Byte-wise this is the same as CtLong, but we treat it separately to
@@ -88,6 +88,7 @@ int main(int argc, char** argv)
 #endif
 
 	cout << "Max Memory Allocated (bytes): " << TotalBytesAllocated << endl;
+	dbgPrintHugePages();
 
 #ifdef STATS_ALLOCATE
 	dbgPrintAllocations(q);
@@ -107,4 +107,6 @@ class SingleThreadedOnly : public QueryExecutionError { };
 
 class CreateSegmentFailure { };
 
+class SpillFailure { };
+
 #endif
@@ -36,6 +36,7 @@ using std::string;
 
 #include "hash.h"
 #include "exceptions.h"
+#include "util/buffer.h"
 
 #include "util/static_assert.h"
 
@@ -56,6 +57,29 @@ unsigned int getlogarithm(unsigned int k)
 }
 
 
+void HashFunction::hashBatch(char* first, unsigned int count, 
+		unsigned int stride, size_t size, unsigned int* out)
+{
+	for (unsigned int i=0; i<count; ++i)
+	{
+		out[i] = hash(first + i * stride, size);
+	}
+}
+
+const unsigned int TupleHasher::BatchSize;
+
+void TupleHasher::hashBatch(TupleBuffer* page, unsigned int first, 
+		unsigned int count, unsigned int* out)
+{
+	dbgassert(count <= BatchSize);
+	if (count == 0)
+		return;
+
+	char* start = static_cast<char*>(page->getTupleOffset(first));
+	dbgassert(page->getTupleOffset(first + count - 1) != NULL);
+	fn->hashBatch(start + offset, count, page->getTupleSize(), size, out);
+}
+
 HashFunction::HashFunction(unsigned int buckets) 
 {
 	if (buckets == 0)
@@ -71,8 +95,9 @@ HashFunction::HashFunction(unsigned int buckets)
  *
  * Takes a configuration node with the following structure:
  *
- * <fn-name> = "bytes" | "modulo" | "range" | "exactrange"| "parammodulo" 
- * 		| "knuth" | "tpchorderkey" | "willis" | "alwayszero"
+ * <fn-name> = "bytes" | "crc32" | "modulo" | "range" | "exactrange"
+ * 		| "parammodulo" | "knuth" | "multiplyshift" | "tpchorderkey" 
+ * 		| "willis" | "alwayszero"
  *
  * <field-spec> = field = <number>; | fieldrange = ( <number>, <number> );
  *
@@ -134,12 +159,33 @@ TupleHasher TupleHasher::create(Schema& schema, const libconfig::Setting& node)
 	}
 
 
+	// A "varchar" is hashed on its bytes, not on its inline header, so it
+	// can only be hashed alone.
+	//
+	bool hasvarchar = false;
+	for (int i=fieldmin; i<=fieldmax; ++i)
+	{
+		hasvarchar |= (schema.getColumnType(i) == CT_VARCHAR);
+	}
+	if (hasvarchar && fieldmin != fieldmax)
+	{
+		throw IllegalSchemaDeclarationException();
+	}
+
 	// Construct object, and check preconditions.
 	//
-	if (hashfnname == "bytes")
+	if (hasvarchar && (hashfnname == "bytes" || hashfnname == "crc32"))
+	{
+		hashfn = new VarcharHasher(buckets);
+	}
+	else if (hashfnname == "bytes")
 	{
 		hashfn = new ByteHasher(buckets);
 	}
+	else if (hashfnname == "crc32")
+	{
+		hashfn = new CrcByteHasher(buckets);
+	}
 	else if (hashfnname == "tpchq1magic")
 	{
 		hashfn = new TpchQ1MagicByteHasher();
@@ -201,6 +247,10 @@ TupleHasher TupleHasher::create(Schema& schema, const libconfig::Setting& node)
 			node.lookupValue("offset", offset);
 			hashfn = new KnuthValueHasher(offset, buckets, skipbits);
 		} 
+		else if (hashfnname == "multiplyshift")
+		{
+			hashfn = new MultiplyShiftValueHasher(buckets);
+		}
 		else if (hashfnname == "tpchorderkey")
 		{
 			hashfn = new TpchMagicValueHasher(buckets);
@@ -233,6 +283,32 @@ TupleHasher TupleHasher::create(Schema& schema, const libconfig::Setting& node)
 	return TupleHasher(offset, size, hashfn);
 }
 
+/**
+ * Creates a TupleHasher with a SplitterValueHasher on numeric column \a
+ * field. The splitters are not part of any configuration: they are set at
+ * runtime by the PartitionOp that owns the hasher, through
+ * SplitterValueHasher::setsplitters().
+ */
+TupleHasher TupleHasher::createSplitters(Schema& schema, unsigned int field,
+		unsigned int buckets)
+{
+	switch(schema.getColumnType(field)) {
+		case CT_INTEGER:
+		case CT_LONG:
+		case CT_DATE:
+			break;
+
+		default:
+			throw IllegalSchemaDeclarationException();
+	}
+
+	unsigned long long lloffset 
+		= reinterpret_cast<unsigned long long>(schema.calcOffset(0, field));
+
+	return TupleHasher(static_cast<unsigned short>(lloffset), 
+			schema.get(field).size, new SplitterValueHasher(buckets));
+}
+
 
 vector<HashFunction*> ParameterizedModuloValueHasher::generate(unsigned int passes)
 {
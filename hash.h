@@ -36,11 +36,18 @@
 #define __MYHASHFUNCTION__
 
 #include <vector>
+#include <utility>
+#include <algorithm>
 #include "libconfig.h++"
 
 #include "schema.h"
+#include "util/hashkernels.h"
+
+class TupleBuffer;
 
 using std::vector;
+using std::pair;
+using std::make_pair;
 
 unsigned int getlogarithm(unsigned int k);
 
@@ -61,6 +68,16 @@ class HashFunction
 
 		virtual unsigned int hash(void* start, size_t size) = 0;
 
+		/**
+		 * Hashes \a count keys of \a size bytes into \a out. The first key
+		 * starts at \a first, and each key is \a stride bytes after the
+		 * previous one. The default implementation calls hash() once per
+		 * key; subclasses override it with a loop that the compiler can
+		 * inline, or with a SIMD kernel.
+		 */
+		virtual void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out);
+
 		virtual ~HashFunction() { }
 		
 	protected:
@@ -82,10 +99,25 @@ class HashFunction
 		CtLong _k;	/**< \f$ \_k=log_2(buckets) \f$ */
 };
 
+/**
+ * Calls \a T::hash on each key of a batch. The call is bound at compile time,
+ * so it is inlined in the loop instead of going through the vtable.
+ */
+template <class T>
+inline void hashEach(T* fn, char* first, unsigned int count, 
+		unsigned int stride, size_t size, unsigned int* out)
+{
+	for (unsigned int i=0; i<count; ++i)
+	{
+		out[i] = fn->T::hash(static_cast<void*>(first + i * stride), size);
+	}
+}
+
 class TupleHasher
 {
 	public:
 		friend class PrettyPrinterVisitor;
+		friend class PartitionOp;
 
 		TupleHasher() 
 			: offset(0), size(0), fn(0)
@@ -99,6 +131,17 @@ class TupleHasher
 			return fn->hash(static_cast<char*>(tuple) + offset, size);
 		}
 
+		/**
+		 * Hashes tuples \a first to \a first + \a count - 1 of \a page into
+		 * \a out, with a single call to the hash function. Callers hash
+		 * pages in batches of at most \a BatchSize tuples, so that \a out
+		 * can live on the stack.
+		 */
+		void hashBatch(TupleBuffer* page, unsigned int first, 
+				unsigned int count, unsigned int* out);
+
+		static const unsigned int BatchSize = 1024;
+
 		inline void destroy()
 		{
 			if (fn != 0)
@@ -113,11 +156,19 @@ class TupleHasher
 			return fn->buckets();
 		}
 
+		inline HashFunction* function()
+		{
+			return fn;
+		}
+
 	private:
 		TupleHasher(unsigned short of, unsigned short sz, HashFunction* f) 
 			: offset(of), size(sz), fn(f)
 		{ }
 
+		static TupleHasher createSplitters(
+				Schema& schema, unsigned int field, unsigned int buckets);
+
 		unsigned short offset;
 		unsigned short size;
 		HashFunction* fn;
@@ -138,6 +189,12 @@ class TpchQ1MagicByteHasher : public HashFunction
 			unsigned int v = * reinterpret_cast<unsigned int*>(start);
 			return (((v>>4) | (v>>16)) & 0x1u) | ((v>>1) & 0x2u);
 		}
+
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
 };
 
 /**
@@ -188,10 +245,79 @@ class ByteHasher : public HashFunction
 			return static_cast<unsigned int>(hash);
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
 	private:
 		static const CtLong FNV_64_OFFSET;
 };
 
+/**
+ * Hashes bytes with CRC32-C, eight bytes at a time. Much faster than
+ * ByteHasher for wide keys, such as "char" columns or composite keys, when
+ * the CPU has a CRC32 instruction. The same caveats as ByteHasher apply.
+ */
+class CrcByteHasher : public HashFunction
+{
+	public:
+		CrcByteHasher(unsigned int buckets)
+			: HashFunction(buckets)
+		{ }
+
+		inline unsigned int hash(void* start, size_t size)
+		{
+			return crc32key(start, size) & mask();
+		}
+
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashcrc32(first, count, stride, size, mask(), out);
+		}
+
+	private:
+		inline unsigned int mask()
+		{
+			return static_cast<unsigned int>((1ull << _k) - 1);
+		}
+};
+
+/**
+ * Hashes the bytes of a "varchar" with CRC32-C. The key is the inline
+ * CtVarchar, so the string is read from the heap instead of hashing its
+ * address. TupleHasher picks this function for "bytes" and "crc32" hashing
+ * on a single "varchar" column.
+ */
+class VarcharHasher : public HashFunction
+{
+	public:
+		VarcharHasher(unsigned int buckets)
+			: HashFunction(buckets)
+		{ }
+
+		inline unsigned int hash(void* start, size_t size)
+		{
+			const CtVarchar* val = static_cast<CtVarchar*>(start);
+			dbgassert(size == sizeof(CtVarchar));
+			return crc32key(val->str(), val->length) & mask();
+		}
+
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
+	private:
+		inline unsigned int mask()
+		{
+			return static_cast<unsigned int>((1ull << _k) - 1);
+		}
+};
+
 class ValueHasher : public HashFunction
 {
 	public:
@@ -256,6 +382,12 @@ class RangeValueHasher : public ValueHasher
 			return RangeValueHasher::hash(numericalize(start, size));
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
 	protected:
 		CtLong _min, _max;
 };
@@ -283,6 +415,12 @@ class ModuloValueHasher : public ValueHasher
 			return ModuloValueHasher::hash(numericalize(start, size));
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
 		/**
 		 * Returns the domain size of the hash function. 
 		 * If ret is the return value, this function hashes from zero to ret-1.
@@ -321,6 +459,12 @@ class ParameterizedModuloValueHasher : public ModuloValueHasher
 			return ParameterizedModuloValueHasher::hash(numericalize(start, size));
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
 		/**
 		 * Returns the domain size of the hash function. 
 		 * If ret is the return value, this function hashes from zero to ret-1.
@@ -366,6 +510,12 @@ class KnuthValueHasher : public ParameterizedModuloValueHasher
 		{
 			return KnuthValueHasher::hash(numericalize(start, size));
 		}
+
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
 };
 
 /** 
@@ -387,6 +537,12 @@ class TpchMagicValueHasher : public ModuloValueHasher
 			return TpchMagicValueHasher::hash(numericalize(start, size));
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
 		inline unsigned int hash(long long value) {
 			return ( ( (value >> 2) & ~7L ) | (value & 7) ) & _k;
 		}
@@ -404,6 +560,12 @@ class WillisValueHasher : public ModuloValueHasher
 			return WillisValueHasher::hash(numericalize(start, size));
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
         inline unsigned int hash (CtLong value)
 		{
             CtLong l = value;
@@ -419,6 +581,38 @@ class WillisValueHasher : public ModuloValueHasher
         }
 };
 
+/**
+ * Multiply-shift hash: multiplies the value with a 64-bit odd constant and
+ * keeps the top log2(buckets) bits of the product. Unlike "knuth", the
+ * bucket depends on all bits of the value. The batch kernel hashes four
+ * values per AVX2 register.
+ */
+class MultiplyShiftValueHasher : public ValueHasher
+{
+	public:
+		MultiplyShiftValueHasher(unsigned int buckets)
+			: ValueHasher(buckets)
+		{ }
+
+		inline unsigned int hash(CtLong value)
+		{
+			return multiplyshift(value, _k);
+		}
+
+		inline unsigned int hash(void* start, size_t size)
+		{
+			return MultiplyShiftValueHasher::hash(numericalize(start, size));
+		}
+
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			if (size != sizeof(CtInt) && size != sizeof(CtLong))
+				throw IllegalConversionException();
+			hashmultiplyshift(first, count, stride, size, _k, out);
+		}
+};
+
 /**
  * Pseudo function when no hashing is desired (eg. aggregation with no GROUP BY
  * clause). Hashes to zero and contains one bucket.
@@ -435,6 +629,13 @@ class AlwaysZeroHasher : public HashFunction
 			return 0; 
 		}
 
+		virtual void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = 0;
+		}
+
 		virtual ~AlwaysZeroHasher() { }
 };
 
@@ -462,6 +663,12 @@ class ExactRangeValueHasher : public RangeValueHasher
 			return ExactRangeValueHasher::hash(numericalize(start, size));
 		}
 
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
 		inline CtLong minimumforbucket(unsigned int bucket)
 		{
 			if (bucket == _k)
@@ -478,4 +685,139 @@ class ExactRangeValueHasher : public RangeValueHasher
 		CtLong _bucketrange;
 };
 
+/**
+ * Function that range partitions on splitters which are chosen at runtime,
+ * for example from a sample of the input. Bucket \a i holds the values in
+ * [splitter(i-1), splitter(i)), the first bucket holds all values less than
+ * splitter(0) and the last bucket holds all values from the last splitter
+ * onwards. Everything hashes to bucket zero until splitters have been set.
+ *
+ * A heavy hitter that holds more tuples than one bucket should can be
+ * spread over a run of adjacent buckets with setspreadkeys(). 
+ * hash(void*, size_t) then picks one of these buckets based on the address
+ * of the tuple. The same tuple hashes to the same bucket as long as it is not
+ * moved, so the caller must hash tuples in place. hash(CtLong) ignores
+ * spreading and returns the bucket the splitters give.
+ */
+class SplitterValueHasher : public ValueHasher
+{
+	public:
+		SplitterValueHasher(unsigned int buckets)
+			: ValueHasher(buckets)
+		{ 
+			_k = buckets;
+		}
+
+		/**
+		 * Sets the splitters, which must be sorted and be one less than the
+		 * number of buckets.
+		 */
+		inline void setsplitters(const vector<CtLong>& newsplitters)
+		{
+			dbgassert(newsplitters.size() + 1 == buckets());
+			_splitters = newsplitters;
+		}
+
+		inline const vector<CtLong>& splitters()
+		{
+			return _splitters;
+		}
+
+		/**
+		 * A key whose tuples are spread over buckets \a first onwards.
+		 * Element i of \a cumulative is the fraction of the tuples that go
+		 * to buckets \a first up to and including \a first + i, so the last
+		 * element is 1.
+		 */
+		struct SpreadKey
+		{
+			CtLong key;
+			unsigned int first;
+			vector<double> cumulative;
+
+			bool operator<(const SpreadKey& rhs) const
+			{
+				return key < rhs.key;
+			}
+		};
+
+		/**
+		 * Sets the keys whose tuples are spread over more than one bucket.
+		 * Keys must be sorted and their buckets must not break the order
+		 * of the splitters.
+		 */
+		inline void setspreadkeys(const vector<SpreadKey>& keys)
+		{
+			_spreadkeys = keys;
+		}
+
+		inline const vector<SpreadKey>& spreadkeys()
+		{
+			return _spreadkeys;
+		}
+
+		/**
+		 * Returns the first and last bucket that tuples with \a value are
+		 * sent to.
+		 */
+		inline pair<unsigned int, unsigned int> bucketspan(CtLong value)
+		{
+			const SpreadKey* s = findspreadkey(value);
+			if (s == NULL)
+				return make_pair(hash(value), hash(value));
+			return make_pair(s->first, s->first + s->cumulative.size() - 1);
+		}
+
+		inline unsigned int hash(CtLong value) 
+		{
+			return std::upper_bound(_splitters.begin(), _splitters.end(), value)
+				- _splitters.begin();
+		}
+
+		inline unsigned int hash(void* start, size_t size)
+		{
+			CtLong value = numericalize(start, size);
+			const SpreadKey* s = findspreadkey(value);
+			if (s == NULL)
+				return SplitterValueHasher::hash(value);
+
+			// Multiplicative hash of the tuple address, to spread 
+			// consecutive tuples evenly.
+			//
+			unsigned long long h = 
+				((unsigned long) start) * 0x9E3779B97F4A7C15uLL;
+			double u = (h >> 40) / (double) (1uLL << 24);
+			return s->first + (std::upper_bound(s->cumulative.begin(), 
+					s->cumulative.end() - 1, u) - s->cumulative.begin());
+		}
+
+		void hashBatch(char* first, unsigned int count, 
+				unsigned int stride, size_t size, unsigned int* out)
+		{
+			hashEach(this, first, count, stride, size, out);
+		}
+
+		inline unsigned int buckets()
+		{
+			return _k;
+		}
+
+	protected:
+		inline const SpreadKey* findspreadkey(CtLong value)
+		{
+			if (_spreadkeys.empty())
+				return NULL;
+			SpreadKey probe;
+			probe.key = value;
+			vector<SpreadKey>::const_iterator it = std::lower_bound(
+					_spreadkeys.begin(), _spreadkeys.end(), probe);
+			if (it == _spreadkeys.end() || it->key != value)
+				return NULL;
+			return &(*it);
+		}
+
+		vector<CtLong> _splitters;
+		vector<SpreadKey> _spreadkeys;
+};
+
 #endif
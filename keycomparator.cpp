@@ -0,0 +1,101 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cassert>
+
+#include "keycomparator.h"
+#include "exceptions.h"
+
+void KeyComparator::init(Schema& schema, const vector<unsigned short>& fields,
+		const vector<bool>& ascending)
+{
+	assert(fields.size() == ascending.size());
+
+	keys.clear();
+
+	for (unsigned int i=0; i<fields.size(); ++i)
+	{
+		ColumnSpec cs = schema.get(fields[i]);
+
+		Key k;
+		k.loffset = reinterpret_cast<unsigned long>(schema.calcOffset(0, fields[i]));
+		k.roffset = k.loffset;
+		k.size = cs.size;
+		k.type = cs.type;
+		k.ascending = ascending[i];
+		add(k);
+	}
+}
+
+void KeyComparator::init(Schema& lschema, const vector<unsigned short>& lfields,
+		Schema& rschema, const vector<unsigned short>& rfields)
+{
+	if (lfields.size() != rfields.size())
+		throw InvalidParameter();
+
+	keys.clear();
+
+	for (unsigned int i=0; i<lfields.size(); ++i)
+	{
+		ColumnSpec lcs = lschema.get(lfields[i]);
+		ColumnSpec rcs = rschema.get(rfields[i]);
+		if (lcs.type != rcs.type || lcs.size != rcs.size)
+			throw InvalidParameter();
+
+		Key k;
+		k.loffset = reinterpret_cast<unsigned long>(lschema.calcOffset(0, lfields[i]));
+		k.roffset = reinterpret_cast<unsigned long>(rschema.calcOffset(0, rfields[i]));
+		k.size = lcs.size;
+		k.type = lcs.type;
+		k.ascending = true;
+		add(k);
+	}
+}
+
+void KeyComparator::add(const Key& k)
+{
+	switch (k.type)
+	{
+		case CT_INTEGER:
+		case CT_LONG:
+		case CT_DATE:
+		case CT_DECIMAL:
+		case CT_CHAR:
+		case CT_VARCHAR:
+			break;
+		default:
+			throw UnknownComparisonException();
+	}
+
+	keys.push_back(k);
+}
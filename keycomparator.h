@@ -0,0 +1,170 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MY_KEYCOMPARATOR__
+#define __MY_KEYCOMPARATOR__
+
+#include <vector>
+#include <cstring>
+
+#include "schema.h"
+
+using std::vector;
+
+/**
+ * Compares tuples on a composite key, in a per-column ascending or
+ * descending order. The tuples may be of the same schema, or of two schemas
+ * whose key columns match. Column types and offsets are resolved once at 
+ * \a init, so comparisons do not go through the schema or function
+ * pointers.
+ */
+class KeyComparator {
+	public:
+		KeyComparator() { }
+
+		/**
+		 * Initializes comparator object.
+		 * @param schema Schema of tuples to compare.
+		 * @param fields Key columns, in order of significance.
+		 * @param ascending True for columns sorted in ascending order. Must
+		 * have the same size as \a fields.
+		 * @throws UnknownComparisonException Column type cannot be ordered.
+		 */
+		void init(Schema& schema, const vector<unsigned short>& fields,
+				const vector<bool>& ascending);
+
+		/**
+		 * Initializes comparator object for tuples of \a lschema on the 
+		 * left and tuples of \a rschema on the right, in ascending order.
+		 * @param lfields Key columns of \a lschema, in order of significance.
+		 * @param rfields Key columns of \a rschema, in the same order.
+		 * @throws InvalidParameter Key columns differ in number, type or size.
+		 * @throws UnknownComparisonException Column type cannot be ordered.
+		 */
+		void init(Schema& lschema, const vector<unsigned short>& lfields,
+				Schema& rschema, const vector<unsigned short>& rfields);
+
+		/**
+		 * Returns a negative number if \a ltup precedes \a rtup, zero if
+		 * keys are equal, and a positive number if \a ltup follows \a rtup.
+		 */
+		inline int compare(void* ltup, void* rtup) const
+		{
+			const unsigned int numkeys = keys.size();
+			for (unsigned int i=0; i<numkeys; ++i)
+			{
+				const Key& k = keys[i];
+				const char* l = (const char*)ltup + k.loffset;
+				const char* r = (const char*)rtup + k.roffset;
+				int res;
+
+				switch (k.type)
+				{
+					case CT_INTEGER:
+						res = cmp(*(const CtInt*)l, *(const CtInt*)r);
+						break;
+					case CT_LONG:
+					case CT_DATE:
+						res = cmp(*(const CtLong*)l, *(const CtLong*)r);
+						break;
+					case CT_DECIMAL:
+						res = cmp(*(const CtDecimal*)l, *(const CtDecimal*)r);
+						break;
+					case CT_CHAR:
+						res = strncmp(l, r, k.size);
+						break;
+					case CT_VARCHAR:
+						res = CtVarchar::compare(
+								*(const CtVarchar*)l, *(const CtVarchar*)r);
+						break;
+					default:
+						res = 0;
+						break;
+				}
+
+				if (res != 0)
+					return k.ascending ? res : -res;
+			}
+			return 0;
+		}
+
+		/**
+		 * Returns true if \a ltup strictly precedes \a rtup.
+		 */
+		inline bool less(void* ltup, void* rtup) const
+		{
+			return compare(ltup, rtup) < 0;
+		}
+
+		/**
+		 * Returns true if \a ltup and \a rtup have the same key.
+		 */
+		inline bool equal(void* ltup, void* rtup) const
+		{
+			return compare(ltup, rtup) == 0;
+		}
+
+		/**
+		 * Returns number of key columns.
+		 */
+		inline unsigned int size() const
+		{
+			return keys.size();
+		}
+
+	private:
+		template <typename T>
+		static inline int cmp(const T& l, const T& r)
+		{
+			return (l < r) ? -1 : ((r < l) ? 1 : 0);
+		}
+
+		struct Key
+		{
+			unsigned int loffset;
+			unsigned int roffset;
+			unsigned int size;
+			ColumnType type;
+			bool ascending;
+		};
+
+		/**
+		 * Appends key \a k.
+		 * @throws UnknownComparisonException Column type cannot be ordered.
+		 */
+		void add(const Key& k);
+
+		vector<Key> keys;
+};
+
+#endif
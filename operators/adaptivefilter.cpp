@@ -0,0 +1,291 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "operators.h"
+#include "operators_priv.h"
+
+#include "../rdtsc.h"
+#include "../util/numaallocate.h"
+
+#include <sstream>
+using std::make_pair;
+using std::ostringstream;
+
+static Operator::Page* NullPage = 0;
+
+AdaptiveFilter::FilterState::FilterState(unsigned int predicates)
+	: evaluated(predicates, 0), passed(predicates, 0), cycles(predicates, 0),
+	  sincesample(0), sincereorder(0)
+{
+	for (unsigned int i=0; i<predicates; ++i)
+	{
+		order.push_back(i);
+	}
+}
+
+void AdaptiveFilter::init(libconfig::Config& root, libconfig::Setting& cfg)
+{
+	MapWrapper::init(root, cfg);	//< calls AdaptiveFilter::mapinit below
+
+	string combine = "and";
+	cfg.lookupValue("combine", combine);
+	if (combine != "and" && combine != "or")
+		throw InvalidParameter();
+	disjunction = (combine == "or");
+
+	// Create a comparator for each predicate, as Filter does.
+	//
+	libconfig::Setting& prednode = cfg["predicates"];
+	if (prednode.getLength() == 0)
+		throw InvalidParameter();
+
+	predicates.resize(prednode.getLength());
+	for (unsigned int i=0; i<predicates.size(); ++i)
+	{
+		Predicate& p = predicates[i];
+
+		p.fieldno = (int) prednode[i]["field"];
+		if (p.fieldno >= schema.columns())
+			throw IllegalSchemaDeclarationException();
+
+		ColumnSpec cs = schema.get(p.fieldno);
+		string tmpstr = prednode[i]["op"];
+		p.opstr = tmpstr;
+		Comparator::Comparison compop = Comparator::parseString(p.opstr);
+		checkDictionaryComparison(schema, p.fieldno, compop);
+		p.comparator = Schema::createComparator(schema, p.fieldno, cs, compop);
+
+		const char* inputval = prednode[i]["value"];
+		Schema dummyschema;
+		dummyschema.add(cs);
+		dbgassert(dummyschema.getTupleSize() <= sizeof(p.value));
+		dummyschema.parseTuple(p.value, &inputval, &valueheap);
+	}
+
+	ostringstream oss;
+	oss << "AdaptiveFilter: ";
+	for (unsigned int i=0; i<predicates.size(); ++i)
+	{
+		Schema dummyschema;
+		dummyschema.add(schema.get(predicates[i].fieldno));
+		if (i != 0)
+			oss << (disjunction ? " or " : " and ");
+		oss << "$" << predicates[i].fieldno + 1 << " " << predicates[i].opstr
+			<< " " << dummyschema.prettyprint(predicates[i].value, ',');
+	}
+	description = oss.str();
+
+	for (int i=0; i<MAX_THREADS; ++i)
+	{
+		filterstate.push_back(NULL);
+	}
+}
+
+void AdaptiveFilter::mapinit(Schema& schema)
+{
+	schema = nextOp->getOutSchema();
+}
+
+void AdaptiveFilter::threadInit(unsigned short threadid)
+{
+	MapWrapper::threadInit(threadid);
+
+	void* space = numaallocate_local("AFst", sizeof(FilterState), this);
+	filterstate[threadid] = new (space) FilterState(predicates.size());
+}
+
+void AdaptiveFilter::threadClose(unsigned short threadid)
+{
+	if (filterstate[threadid]) {
+		filterstate[threadid]->~FilterState();
+		numadeallocate(filterstate[threadid]);
+	}
+	filterstate[threadid] = NULL;
+
+	MapWrapper::threadClose(threadid);
+}
+
+bool AdaptiveFilter::evaluate(FilterState* state, void* tuple)
+{
+	// A conjunction is decided by the first predicate that fails, and a
+	// disjunction by the first predicate that passes.
+	//
+	for (unsigned int i=0; i<state->order.size(); ++i)
+	{
+		Predicate& p = predicates[state->order[i]];
+		if (p.comparator.eval(tuple, &p.value) == disjunction)
+			return disjunction;
+	}
+	return !disjunction;
+}
+
+bool AdaptiveFilter::evaluateAndSample(FilterState* state, void* tuple)
+{
+	bool ret = !disjunction;
+
+	for (unsigned int i=0; i<predicates.size(); ++i)
+	{
+		Predicate& p = predicates[i];
+		unsigned long long start = curtick();
+		bool pass = p.comparator.eval(tuple, &p.value);
+		state->cycles[i] += curtick() - start;
+		state->evaluated[i] += 1;
+		state->passed[i] += pass ? 1 : 0;
+
+		if (pass == disjunction)
+			ret = disjunction;
+	}
+
+	return ret;
+}
+
+/**
+ * Predicate a runs before predicate b if c_a/(1-p_a) < c_b/(1-p_b) for a
+ * conjunction, or if c_a/p_a < c_b/p_b for a disjunction. Both sides are
+ * multiplied by the sample counts, so predicates that never decide the
+ * outcome run last.
+ */
+void AdaptiveFilter::reorder(FilterState* state)
+{
+	vector<unsigned int>& order = state->order;
+	vector<double> decided(predicates.size());
+
+	for (unsigned int i=0; i<predicates.size(); ++i)
+	{
+		decided[i] = disjunction 
+			? state->passed[i] 
+			: state->evaluated[i] - state->passed[i];
+	}
+
+	for (unsigned int i=1; i<order.size(); ++i)
+	{
+		unsigned int a = order[i];
+		unsigned int j = i;
+		while (j > 0)
+		{
+			unsigned int b = order[j-1];
+			if (state->cycles[a] * decided[b] >= state->cycles[b] * decided[a])
+				break;
+			order[j] = b;
+			--j;
+		}
+		order[j] = a;
+	}
+
+	for (unsigned int i=0; i<predicates.size(); ++i)
+	{
+		state->evaluated[i] /= 2;
+		state->passed[i] /= 2;
+		state->cycles[i] /= 2;
+	}
+
+	state->sincereorder = 0;
+}
+
+// Copy-paste from MapWrapper, filtering with the state of the thread.
+//
+Operator::GetNextResultT AdaptiveFilter::getNext(unsigned short threadid)
+{
+	Page* in;
+	Operator::ResultCode rc;
+	unsigned int tupoffset;
+
+	Page* out = output[threadid];
+	FilterState* fs = filterstate[threadid];
+	out->clear();
+
+	// Recover state information and start.
+	// 
+	in = state[threadid].input;
+	rc = state[threadid].prevresult;
+	tupoffset = state[threadid].prevoffset;
+
+	while (rc != Error) 
+	{
+		void* tuple;
+
+		dbgassert(rc != Error);
+		dbgassert(in != NULL);
+
+		while ( (tuple = in->getTupleOffset(tupoffset++)) ) 
+		{
+			bool pass;
+
+			if (++fs->sincesample == SampleInterval)
+			{
+				fs->sincesample = 0;
+				pass = evaluateAndSample(fs, tuple);
+			}
+			else
+			{
+				pass = evaluate(fs, tuple);
+			}
+
+			if (++fs->sincereorder == ReorderInterval)
+				reorder(fs);
+
+			if (pass)
+			{
+				void* dest = out->allocateTuple();
+				dbgassert(out->isValidTupleAddress(dest));
+				schema.copyTuple(dest, tuple);
+			}
+
+			// If output buffer full, record state and return.
+			// 
+			if (!out->canStoreTuple()) 
+			{
+				state[threadid] = State(in, rc, tupoffset);
+				return make_pair(Ready, out);
+			}
+		}
+
+		// If input source depleted, remove state information and return.
+		//
+		if (rc == Finished) 
+		{
+			state[threadid] = State(&EmptyPage, Finished, 0);
+			return make_pair(Finished, out);
+		}
+
+		// Read more input.
+		//
+		Operator::GetNextResultT result = nextOp->getNext(threadid);
+		rc = result.first;
+		in = result.second;
+		tupoffset = 0;
+	}
+
+	state[threadid] = State(NullPage, Error, 0);
+	return make_pair(Error, NullPage);	// Reached on Error
+}
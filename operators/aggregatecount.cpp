@@ -50,3 +50,19 @@ void AggregateCount::fold(void* partialresult, void* tuple)
 {
 	(*(CtLong*)partialresult)++;
 }
+
+bool AggregateCount::foldidentity(void* output)
+{
+	*(CtLong*)output = 0;
+	return true;
+}
+
+void AggregateCount::foldpage(void* partialresult, Page* page)
+{
+	(*(CtLong*)partialresult) += page->getNumTuples();
+}
+
+void AggregateCount::foldmerge(void* partialresult, void* otherpartial)
+{
+	(*(CtLong*)partialresult) += *(CtLong*)otherpartial;
+}
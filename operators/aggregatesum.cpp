@@ -34,6 +34,49 @@
 
 #include "operators.h"
 
+/**
+ * Sums \a count values of type \a T that are \a stride bytes apart, starting
+ * at \a first. Four independent accumulators break the dependency chain of
+ * the additions. If values are packed, the compiler vectorizes the loop.
+ */
+template <typename T>
+static T sumstrided(const char* first, unsigned int stride, unsigned long long count)
+{
+	T s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	unsigned long long i = 0;
+
+	if (stride == sizeof(T))
+	{
+		const T* val = reinterpret_cast<const T*>(first);
+		for (; i + 4 <= count; i += 4)
+		{
+			s0 += val[i];
+			s1 += val[i+1];
+			s2 += val[i+2];
+			s3 += val[i+3];
+		}
+		for (; i < count; ++i)
+		{
+			s0 += val[i];
+		}
+		return (s0 + s1) + (s2 + s3);
+	}
+
+	const char* p = first;
+	for (; i + 4 <= count; i += 4, p += 4*stride)
+	{
+		s0 += *reinterpret_cast<const T*>(p);
+		s1 += *reinterpret_cast<const T*>(p + stride);
+		s2 += *reinterpret_cast<const T*>(p + 2*stride);
+		s3 += *reinterpret_cast<const T*>(p + 3*stride);
+	}
+	for (; i < count; ++i, p += stride)
+	{
+		s0 += *reinterpret_cast<const T*>(p);
+	}
+	return (s0 + s1) + (s2 + s3);
+}
+
 Schema& AggregateSum::foldinit(libconfig::Config& root, libconfig::Setting& cfg)
 {
 	sumfieldno = cfg["sumfield"];
@@ -105,3 +148,65 @@ void AggregateSum::fold(void* partialresult, void* tuple)
 			break;
 	};
 }
+
+bool AggregateSum::foldidentity(void* output)
+{
+	switch (aggregateschema.getColumnType(0))
+	{
+		case CT_INTEGER:
+			*(CtInt*)output = 0;
+			break;
+		case CT_LONG:
+			*(CtLong*)output = 0;
+			break;
+		case CT_DECIMAL:
+			*(CtDecimal*)output = 0;
+			break;
+		default:
+			return false;
+	};
+	return true;
+}
+
+void AggregateSum::foldpage(void* partialresult, Page* page)
+{
+	const unsigned long long count = page->getNumTuples();
+	const char* first = 
+		(const char*) inschema.calcOffset(page->getTupleOffset(0), sumfieldno);
+	const unsigned int stride = inschema.getTupleSize();
+
+	switch (aggregateschema.getColumnType(0))
+	{
+		case CT_INTEGER:
+			*(CtInt*)partialresult += sumstrided<CtInt>(first, stride, count);
+			break;
+		case CT_LONG:
+			*(CtLong*)partialresult += sumstrided<CtLong>(first, stride, count);
+			break;
+		case CT_DECIMAL:
+			*(CtDecimal*)partialresult += sumstrided<CtDecimal>(first, stride, count);
+			break;
+		default:
+			throw NotYetImplemented();
+			break;
+	};
+}
+
+void AggregateSum::foldmerge(void* partialresult, void* otherpartial)
+{
+	switch (aggregateschema.getColumnType(0))
+	{
+		case CT_INTEGER:
+			*(CtInt*)partialresult += *(CtInt*)otherpartial;
+			break;
+		case CT_LONG:
+			*(CtLong*)partialresult += *(CtLong*)otherpartial;
+			break;
+		case CT_DECIMAL:
+			*(CtDecimal*)partialresult += *(CtDecimal*)otherpartial;
+			break;
+		default:
+			throw NotYetImplemented();
+			break;
+	};
+}
@@ -0,0 +1,625 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "operators.h"
+#include "operators_priv.h"
+
+#include "../util/numaallocate.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <sstream>
+using std::make_pair;
+using std::istringstream;
+
+static Operator::Page* NullPage = 0;
+
+static void skipspaces(const string& expr, size_t& pos)
+{
+	while (pos < expr.size() && isspace(expr[pos]))
+		++pos;
+}
+
+static void expect(const string& expr, size_t& pos, char c)
+{
+	skipspaces(expr, pos);
+	if (pos >= expr.size() || expr[pos] != c)
+		throw InvalidParameter();
+	++pos;
+}
+
+static unsigned int parsecolumn(const string& expr, size_t& pos)
+{
+	expect(expr, pos, '$');
+	if (pos >= expr.size() || !isdigit(expr[pos]))
+		throw InvalidParameter();
+
+	unsigned int column = 0;
+	while (pos < expr.size() && isdigit(expr[pos]))
+		column = column * 10 + (expr[pos++] - '0');
+	return column;
+}
+
+static bool isnumeric(ColumnType type)
+{
+	return type == CT_INTEGER || type == CT_LONG || type == CT_DECIMAL;
+}
+
+void ComputeOp::init(libconfig::Config& root, libconfig::Setting& cfg)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+
+	libconfig::Setting& node = cfg["expressions"];
+	dbgassert(node.isList() || node.isArray());
+	if (node.getLength() == 0)
+		throw InvalidParameter();
+
+	for (int idx = 0; idx < node.getLength(); ++idx)
+	{
+		string s = node[idx];
+		size_t pos = 0;
+		unsigned int r = parseExpression(s, pos);
+		skipspaces(s, pos);
+		if (pos != s.size())
+			throw InvalidParameter();
+
+		// A column on its own is copied, so it may be of any type. A column
+		// that was widened by long() is not, and is evaluated instead.
+		//
+		if (nodes[r].kind == ColumnNode 
+				&& nodes[r].type == srcschema.getColumnType(nodes[r].column))
+			nodes[r].copy = true;
+		else if (!isnumeric(nodes[r].type))
+			throw InvalidParameter();
+
+		expressions.push_back(s);
+		roots.push_back(r);
+	}
+
+	// Columns in arithmetic have been type-checked by addArith() and
+	// convert(), only copied columns can be of other types.
+	//
+	for (unsigned int i=0; i<nodes.size(); ++i)
+	{
+		if (nodes[i].kind == ColumnNode && !nodes[i].copy)
+			dbgassert(isnumeric(srcschema.getColumnType(nodes[i].column)));
+	}
+
+	isa = exprKernelDetectIsa();
+
+	for (int i=0; i<MAX_THREADS; ++i)
+	{
+		values.push_back(NULL);
+	}
+
+	MapWrapper::init(root, cfg);	//< calls ComputeOp::mapinit below
+}
+
+void ComputeOp::mapinit(Schema& schema)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+
+	for (unsigned int i=0; i<roots.size(); ++i)
+	{
+		Node& n = nodes[roots[i]];
+		if (n.copy)
+			schema.add(srcschema.get(n.column));
+		else
+			schema.add(n.type);
+	}
+
+	string desc = "Compute: ";
+	for (unsigned int i=0; i<expressions.size(); ++i)
+	{
+		if (i != 0)
+			desc += ", ";
+		desc += expressions[i];
+	}
+	description = desc;
+}
+
+unsigned int ComputeOp::parseExpression(const string& expr, size_t& pos)
+{
+	unsigned int ret = parseTerm(expr, pos);
+
+	while (true)
+	{
+		skipspaces(expr, pos);
+		if (pos >= expr.size() || (expr[pos] != '+' && expr[pos] != '-'))
+			return ret;
+
+		ExprArithOp op = (expr[pos++] == '+') ? ExprAdd : ExprSub;
+		unsigned int right = parseTerm(expr, pos);
+		ret = addArith(op, ret, right);
+	}
+}
+
+unsigned int ComputeOp::parseTerm(const string& expr, size_t& pos)
+{
+	unsigned int ret = parseFactor(expr, pos);
+
+	while (true)
+	{
+		skipspaces(expr, pos);
+		if (pos >= expr.size() || (expr[pos] != '*' && expr[pos] != '/'))
+			return ret;
+
+		ExprArithOp op = (expr[pos++] == '*') ? ExprMul : ExprDiv;
+		unsigned int right = parseFactor(expr, pos);
+		ret = addArith(op, ret, right);
+	}
+}
+
+unsigned int ComputeOp::parseFactor(const string& expr, size_t& pos)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+
+	skipspaces(expr, pos);
+	if (pos >= expr.size())
+		throw InvalidParameter();
+
+	char c = expr[pos];
+
+	if (c == '-')
+	{
+		++pos;
+		unsigned int operand = parseFactor(expr, pos);
+		return addArith(ExprSub, addConstant(0), operand);
+	}
+
+	if (c == '(')
+	{
+		++pos;
+		unsigned int ret = parseExpression(expr, pos);
+		expect(expr, pos, ')');
+		return ret;
+	}
+
+	if (c == '$')
+	{
+		Node n = Node();
+		n.kind = ColumnNode;
+		n.column = parsecolumn(expr, pos);
+		if (n.column >= srcschema.columns())
+			throw IllegalSchemaDeclarationException();
+		n.type = srcschema.getColumnType(n.column);
+		return addNode(n);
+	}
+
+	if (isdigit(c) || c == '.')
+	{
+		size_t end = pos;
+		while (end < expr.size() && (isdigit(expr[end]) || expr[end] == '.'))
+			++end;
+
+		string literal = expr.substr(pos, end - pos);
+		istringstream ss(literal);
+		pos = end;
+
+		Node n = Node();
+		n.kind = ConstantNode;
+		if (literal.find('.') == string::npos)
+		{
+			n.type = CT_LONG;
+			ss >> n.longval;
+		}
+		else
+		{
+			n.type = CT_DECIMAL;
+			ss >> n.doubleval;
+		}
+		if (!ss || !ss.eof())
+			throw InvalidParameter();
+		return addNode(n);
+	}
+
+	if (isalpha(c))
+	{
+		size_t end = pos;
+		while (end < expr.size() && isalpha(expr[end]))
+			++end;
+
+		string function = expr.substr(pos, end - pos);
+		pos = end;
+		expect(expr, pos, '(');
+
+		if (function == "year" || function == "month" || function == "day")
+		{
+			Node n = Node();
+			n.kind = DatePartNode;
+			n.type = CT_INTEGER;
+			n.part = (function == "year") ? Year 
+				: (function == "month") ? Month : Day;
+			n.column = parsecolumn(expr, pos);
+			if (n.column >= srcschema.columns()
+					|| srcschema.getColumnType(n.column) != CT_DATE)
+				throw IllegalSchemaDeclarationException();
+			expect(expr, pos, ')');
+			return addNode(n);
+		}
+
+		ColumnType type;
+		if (function == "int")
+			type = CT_INTEGER;
+		else if (function == "long")
+			type = CT_LONG;
+		else if (function == "decimal")
+			type = CT_DECIMAL;
+		else
+			throw InvalidParameter();
+
+		unsigned int operand = parseExpression(expr, pos);
+		expect(expr, pos, ')');
+		return convert(operand, type);
+	}
+
+	throw InvalidParameter();
+}
+
+unsigned int ComputeOp::addNode(const Node& node)
+{
+	nodes.push_back(node);
+	return nodes.size() - 1;
+}
+
+unsigned int ComputeOp::addConstant(long long val)
+{
+	Node n = Node();
+	n.kind = ConstantNode;
+	n.type = CT_LONG;
+	n.longval = val;
+	return addNode(n);
+}
+
+template <typename T>
+static T arith(ExprArithOp op, T a, T b)
+{
+	switch (op)
+	{
+		case ExprAdd:
+			return a + b;
+		case ExprSub:
+			return a - b;
+		case ExprMul:
+			return a * b;
+		default:
+			return (b == 0) ? 0 : a / b;
+	}
+}
+
+unsigned int ComputeOp::addArith(ExprArithOp op, unsigned int left, unsigned int right)
+{
+	if (!isnumeric(nodes[left].type) || !isnumeric(nodes[right].type))
+		throw InvalidParameter();
+
+	ColumnType type = 
+		(nodes[left].type == CT_DECIMAL || nodes[right].type == CT_DECIMAL)
+		? CT_DECIMAL : CT_LONG;
+	left = convert(left, type);
+	right = convert(right, type);
+
+	// Fold operations on constants, so that "-1" is a constant too.
+	//
+	if (nodes[left].kind == ConstantNode && nodes[right].kind == ConstantNode)
+	{
+		Node& l = nodes[left];
+		Node& r = nodes[right];
+		if (type == CT_DECIMAL)
+			l.doubleval = arith(op, l.doubleval, r.doubleval);
+		else
+			l.longval = arith(op, l.longval, r.longval);
+		if (right == nodes.size() - 1)
+			nodes.pop_back();
+		return left;
+	}
+
+	Node n = Node();
+	n.kind = ArithNode;
+	n.type = type;
+	n.op = op;
+	n.left = left;
+	n.right = right;
+	return addNode(n);
+}
+
+unsigned int ComputeOp::convert(unsigned int idx, ColumnType type)
+{
+	Node& from = nodes[idx];
+
+	if (!isnumeric(from.type))
+		throw InvalidParameter();
+
+	if (from.type == type)
+		return idx;
+
+	if (from.kind == ConstantNode)
+	{
+		if (type == CT_DECIMAL && from.type != CT_DECIMAL)
+			from.doubleval = from.longval;
+		else if (type != CT_DECIMAL && from.type == CT_DECIMAL)
+			from.longval = static_cast<long long>(from.doubleval);
+		if (type == CT_INTEGER)
+			from.longval = static_cast<CtInt>(from.longval);
+		from.type = type;
+		return idx;
+	}
+
+	// Integers read from the input are held as longs already. The result of
+	// a conversion to int is not relabeled, as it must still be truncated.
+	//
+	if (from.type == CT_INTEGER && type == CT_LONG
+			&& (from.kind == ColumnNode || from.kind == DatePartNode))
+	{
+		from.type = CT_LONG;
+		return idx;
+	}
+
+	Node n = Node();
+	n.kind = ConvertNode;
+	n.type = type;
+	n.left = idx;
+	return addNode(n);
+}
+
+void ComputeOp::threadInit(unsigned short threadid)
+{
+	MapWrapper::threadInit(threadid);
+
+	void* space = numaallocate_local("CmpV", 
+			nodes.size() * BatchSize * sizeof(long long), this);
+	values[threadid] = reinterpret_cast<char*>(space);
+
+	// Constants never change, so they are expanded once.
+	//
+	for (unsigned int i=0; i<nodes.size(); ++i)
+	{
+		if (nodes[i].kind != ConstantNode)
+			continue;
+
+		for (unsigned int j=0; j<BatchSize; ++j)
+		{
+			if (nodes[i].type == CT_DECIMAL)
+				doubleValues(threadid, i)[j] = nodes[i].doubleval;
+			else
+				longValues(threadid, i)[j] = nodes[i].longval;
+		}
+	}
+}
+
+void ComputeOp::threadClose(unsigned short threadid)
+{
+	if (values[threadid]) {
+		numadeallocate(values[threadid]);
+	}
+	values[threadid] = NULL;
+
+	MapWrapper::threadClose(threadid);
+}
+
+void ComputeOp::computeBatch(unsigned short threadid, const char* first, 
+		unsigned int count, Page* out)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+	const unsigned int instride = srcschema.getTupleSize();
+	const unsigned int outstride = schema.getTupleSize();
+
+	// Evaluate the nodes one at a time, operands first.
+	//
+	for (unsigned int i=0; i<nodes.size(); ++i)
+	{
+		Node& n = nodes[i];
+		long long* lout = longValues(threadid, i);
+		double* dout = doubleValues(threadid, i);
+
+		switch (n.kind)
+		{
+			case ColumnNode:
+			{
+				if (n.copy)
+					break;
+
+				const char* src = reinterpret_cast<const char*>(
+						srcschema.calcOffset(const_cast<char*>(first), n.column));
+				ColumnType type = srcschema.getColumnType(n.column);
+
+				if (type == CT_INTEGER)
+					for (unsigned int j=0; j<count; ++j)
+						lout[j] = *reinterpret_cast<const CtInt*>(src + j * instride);
+				else if (type == CT_LONG)
+					for (unsigned int j=0; j<count; ++j)
+						lout[j] = *reinterpret_cast<const CtLong*>(src + j * instride);
+				else
+					for (unsigned int j=0; j<count; ++j)
+						dout[j] = *reinterpret_cast<const CtDecimal*>(src + j * instride);
+				break;
+			}
+
+			case DatePartNode:
+			{
+				const char* src = reinterpret_cast<const char*>(
+						srcschema.calcOffset(const_cast<char*>(first), n.column));
+
+				for (unsigned int j=0; j<count; ++j)
+				{
+					const CtDate* date = 
+						reinterpret_cast<const CtDate*>(src + j * instride);
+					lout[j] = (n.part == Year) ? date->year()
+						: (n.part == Month) ? date->month() : date->day();
+				}
+				break;
+			}
+
+			case ConstantNode:
+				break;
+
+			case ArithNode:
+				if (n.type == CT_DECIMAL)
+					exprarith(n.op, doubleValues(threadid, n.left), 
+							doubleValues(threadid, n.right), dout, count, isa);
+				else
+					exprarith(n.op, longValues(threadid, n.left), 
+							longValues(threadid, n.right), lout, count, isa);
+				break;
+
+			case ConvertNode:
+			{
+				ColumnType from = nodes[n.left].type;
+
+				if (n.type == CT_DECIMAL)
+					exprconvert(longValues(threadid, n.left), dout, count, isa);
+				else if (from == CT_DECIMAL)
+					exprconvert(doubleValues(threadid, n.left), lout, count, isa);
+				else
+					memcpy(lout, longValues(threadid, n.left), count * sizeof(long long));
+
+				if (n.type == CT_INTEGER)
+					for (unsigned int j=0; j<count; ++j)
+						lout[j] = static_cast<CtInt>(lout[j]);
+				break;
+			}
+		}
+	}
+
+	// Allocate the output tuples, and write them one column at a time.
+	//
+	char* dest = reinterpret_cast<char*>(out->allocateTuple());
+	dbgassert(out->isValidTupleAddress(dest));
+	for (unsigned int j=1; j<count; ++j)
+	{
+		void* tmp = out->allocateTuple();
+		dbgassert(tmp == dest + j * outstride);
+		(void) tmp;
+	}
+
+	for (unsigned int c=0; c<roots.size(); ++c)
+	{
+		Node& n = nodes[roots[c]];
+		char* to = reinterpret_cast<char*>(schema.calcOffset(dest, c));
+
+		if (n.copy)
+		{
+			const char* from = reinterpret_cast<const char*>(
+					srcschema.calcOffset(const_cast<char*>(first), n.column));
+			const unsigned int size = schema.get(c).size;
+			for (unsigned int j=0; j<count; ++j)
+				memcpy(to + j * outstride, from + j * instride, size);
+			continue;
+		}
+
+		const long long* lval = longValues(threadid, roots[c]);
+		const double* dval = doubleValues(threadid, roots[c]);
+
+		switch (n.type)
+		{
+			case CT_INTEGER:
+				for (unsigned int j=0; j<count; ++j)
+					*reinterpret_cast<CtInt*>(to + j * outstride) = lval[j];
+				break;
+			case CT_LONG:
+				for (unsigned int j=0; j<count; ++j)
+					*reinterpret_cast<CtLong*>(to + j * outstride) = lval[j];
+				break;
+			default:
+				for (unsigned int j=0; j<count; ++j)
+					*reinterpret_cast<CtDecimal*>(to + j * outstride) = dval[j];
+				break;
+		}
+	}
+}
+
+// Copy-paste from MapWrapper, computing a batch of tuples at a time.
+//
+Operator::GetNextResultT ComputeOp::getNext(unsigned short threadid)
+{
+	Page* in;
+	Operator::ResultCode rc;
+	unsigned int tupoffset;
+
+	Page* out = output[threadid];
+	out->clear();
+
+	const unsigned int outcapacity = out->capacity() / schema.getTupleSize();
+
+	// Recover state information and start.
+	// 
+	in = state[threadid].input;
+	rc = state[threadid].prevresult;
+	tupoffset = state[threadid].prevoffset;
+
+	while (rc != Error) 
+	{
+		dbgassert(rc != Error);
+		dbgassert(in != NULL);
+
+		unsigned int intuples = in->getNumTuples();
+
+		while (tupoffset < intuples)
+		{
+			unsigned int count = intuples - tupoffset;
+			count = std::min(count, outcapacity - (unsigned int) out->getNumTuples());
+			count = std::min(count, BatchSize);
+
+			const char* first = 
+				reinterpret_cast<const char*>(in->getTupleOffset(tupoffset));
+			computeBatch(threadid, first, count, out);
+			tupoffset += count;
+
+			// If output buffer full, record state and return.
+			// 
+			if (!out->canStoreTuple()) 
+			{
+				state[threadid] = State(in, rc, tupoffset);
+				return make_pair(Ready, out);
+			}
+		}
+
+		// If input source depleted, remove state information and return.
+		//
+		if (rc == Finished) 
+		{
+			state[threadid] = State(&EmptyPage, Finished, 0);
+			return make_pair(Finished, out);
+		}
+
+		// Read more input.
+		//
+		Operator::GetNextResultT result = nextOp->getNext(threadid);
+		rc = result.first;
+		in = result.second;
+		tupoffset = 0;
+	}
+
+	state[threadid] = State(NullPage, Error, 0);
+	return make_pair(Error, NullPage);	// Reached on Error
+}
@@ -49,6 +49,7 @@ void Filter::init(libconfig::Config& root, libconfig::Setting& cfg)
 	string tmpstr = cfg["op"];
 	opstr = tmpstr;
 	Comparator::Comparison compop = Comparator::parseString(opstr);
+	checkDictionaryComparison(schema, fieldno, compop);
 	comparator = Schema::createComparator(schema, fieldno, cs, compop);
 	
 	// Create dummy schema and parse input to create comparator.
@@ -59,7 +60,7 @@ void Filter::init(libconfig::Config& root, libconfig::Setting& cfg)
 	dbgassert(sizeof(value) == FILTERMAXWIDTH);
 	dbgassert(dummyschema.getTupleSize() <= sizeof(value));
 	dbgassert(dummyschema.columns() == 1);
-	dummyschema.parseTuple(value, &inputval);
+	dummyschema.parseTuple(value, &inputval, &valueheap);
 }
 
 void Filter::mapinit(Schema& schema)
@@ -112,6 +112,14 @@ void GenericAggregate::init(libconfig::Config& root, libconfig::Setting& cfg)
 	}
 	comparator.init(schema, nextOp->getOutSchema(), tempvec, aggfields);
 
+	// If not grouping, check if subclass can reduce entire pages at once.
+	//
+	if (aggfields.empty())
+	{
+		vector<char> identity(schema.getTupleSize());
+		pagefold = foldidentity(&identity[0]);
+	}
+
 	assert(aggregationmode == Unset);
 
 	if (cfg.exists("presorted"))
@@ -146,12 +154,15 @@ void GenericAggregate::init(libconfig::Config& root, libconfig::Setting& cfg)
 #endif
 
 			hashtable.push_back( HashTable() );
-			hashtable[0].init(
-				hashfn.buckets(),        // number of hash buckets
-				schema.getTupleSize()*4, // space for each bucket
-				schema.getTupleSize(),	 // size of each tuple
-				allocpolicy,			 // stripe across all
-				this);
+			if (!pagefold)
+			{
+				hashtable[0].init(
+					hashfn.buckets(),        // number of hash buckets
+					schema.getTupleSize()*4, // space for each bucket
+					schema.getTupleSize(),	 // size of each tuple
+					allocpolicy,			 // stripe across all
+					this);
+			}
 
 			barrier.init(threads);
 		}
@@ -176,6 +187,16 @@ void GenericAggregate::threadInit(unsigned short threadid)
 {
 	void* space = numaallocate_local("GnAg", sizeof(Page), this);
 	output[threadid] = new(space) Page(buffsize, schema.getTupleSize(), this);
+
+	if (pagefold)
+	{
+		state[threadid] = State(HashTable::Iterator());
+		state[threadid].partial = 
+			numaallocate_local("GnAP", schema.getTupleSize(), this);
+		foldidentity(state[threadid].partial);
+		return;
+	}
+
 	switch(aggregationmode)
 	{
 		case ThreadLocal:
@@ -211,6 +232,20 @@ void GenericAggregate::threadClose(unsigned short threadid)
 	}
 	output[threadid] = NULL;
 
+	if (pagefold)
+	{
+		// In global mode, thread 0 reads all partial results before arriving
+		// here, so the accumulator can only be freed after the barrier.
+		//
+		if (aggregationmode == Global)
+		{
+			barrier.Arrive();
+		}
+		numadeallocate(state[threadid].partial);
+		state[threadid].partial = NULL;
+		return;
+	}
+
 	switch(aggregationmode)
 	{
 		case ThreadLocal:
@@ -230,22 +265,21 @@ void GenericAggregate::threadClose(unsigned short threadid)
 
 void GenericAggregate::destroy()
 {
-	if (aggregationmode == Global)
+	if (aggregationmode == Global && !pagefold)
 		hashtable[0].destroy();
 	hashfn.destroy();
 	hashtable.clear();
 	aggregationmode = Unset;
+	pagefold = false;
 }
 
-void GenericAggregate::remember(void* tuple, HashTable::Iterator& it, unsigned short htid)
+void GenericAggregate::remember(void* tuple, unsigned int h, 
+		HashTable::Iterator& it, unsigned short htid)
 {
 	void* candidate;
 	int totalaggfields = aggfields.size();
 	Schema& inschema = nextOp->getOutSchema();
 
-	// Identify key and hash it to find the hashtable bucket.
-	//
-	unsigned int h = hashfn.hash(tuple);
 	if (aggregationmode == Global)
 	{
 		hashtable[htid].lockbucket(h);
@@ -293,7 +327,6 @@ Operator::ResultCode GenericAggregate::scanStart(unsigned short threadid,
 	{
 		htid = threadid;
 	}
-	HashTable::Iterator htit = hashtable[htid].createIterator();
 	ResultCode rescode;
 	
 	rescode = nextOp->scanStart(threadid, indexdatapage, indexdataschema);
@@ -301,15 +334,32 @@ Operator::ResultCode GenericAggregate::scanStart(unsigned short threadid,
 		return rescode;
 	}
 
+	if (pagefold)
+	{
+		return scanStartPageFold(threadid);
+	}
+
+	HashTable::Iterator htit = hashtable[htid].createIterator();
+
 	do {
 		result = nextOp->getNext(threadid);
 
 		in = result.second;
 
-		Page::Iterator it = in->createIterator();
-		void* tuple;
-		while ( (tuple = it.next()) ) {
-			remember(tuple, htit, htid);
+		// Hash the keys of a batch of tuples to find their hashtable
+		// buckets, then aggregate each tuple.
+		//
+		unsigned int h[TupleHasher::BatchSize];
+		const unsigned int tuples = in->getNumTuples();
+		for (unsigned int first=0; first<tuples; first+=TupleHasher::BatchSize)
+		{
+			const unsigned int count = 
+				std::min(TupleHasher::BatchSize, tuples - first);
+			hashfn.hashBatch(in, first, count, h);
+			for (unsigned int i=0; i<count; ++i)
+			{
+				remember(in->getTupleOffset(first + i), h[i], htit, htid);
+			}
 		}
 	} while(result.first == Operator::Ready);
 
@@ -416,10 +466,76 @@ Operator::ResultCode GenericAggregate::scanStart(unsigned short threadid,
 	return ((result.first != Operator::Error) ? rescode : Operator::Error);
 }
 
+Operator::ResultCode GenericAggregate::scanStartPageFold(unsigned short threadid)
+{
+	Operator::GetNextResultT result; 
+	ResultCode rescode;
+	void* partial = state[threadid].partial;
+	unsigned long long foldedtuples = 0;
+
+	do {
+		result = nextOp->getNext(threadid);
+
+		// Skip empty pages, as the tuple size of the shared EmptyPage is zero.
+		//
+		Page* in = result.second;
+		if (in->getUsedSpace() == 0)
+			continue;
+
+		foldpage(partial, in);
+		foldedtuples += in->getNumTuples();
+	} while(result.first == Operator::Ready);
+
+	state[threadid].foldedtuples = foldedtuples;
+
+	rescode = nextOp->scanStop(threadid);
+
+	// Merge all partial results into the accumulator of thread 0, which
+	// will produce the output.
+	//
+	if (aggregationmode == Global)
+	{
+		barrier.Arrive();
+
+		if (threadid == 0)
+		{
+			for (unsigned int i=1; i<threads; ++i)
+			{
+				foldmerge(partial, state[i].partial);
+				state[0].foldedtuples += state[i].foldedtuples;
+				state[i].foldedtuples = 0;
+			}
+		}
+	}
+
+	// If scan failed, return Error. Otherwise return what scanClose returned.
+	//
+	return ((result.first != Operator::Error) ? rescode : Operator::Error);
+}
+
 Operator::GetNextResultT GenericAggregate::getNext(unsigned short threadid)
 {
 	void* tuple;
 
+	// Output is at most one tuple if aggregating without grouping. 
+	// No output is produced if there was no input, as in the hash-based case.
+	//
+	if (pagefold)
+	{
+		Page* out = output[threadid];
+		out->clear();
+
+		if (state[threadid].foldedtuples != 0)
+		{
+			void* dest = out->allocateTuple();
+			dbgassert(out->isValidTupleAddress(dest));
+			schema.copyTuple(dest, state[threadid].partial);
+			state[threadid].foldedtuples = 0;
+		}
+
+		return make_pair(Finished, out);
+	}
+
 	// Restore iterator from saved state.
 	//
 	HashTable::Iterator& it = state[threadid].iterator;
@@ -44,7 +44,17 @@ void IndexHashJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 {
 	HashJoinOp::init(root, node);
 
-	// Find and store index data page schema.
+	// The index probe builds directly into the hash table below, so neither
+	// the dense key table, spilling nor replication is supported. Only inner
+	// joins are supported. The build tuples come from the index and do not
+	// outlive the build.
+	//
+	if (usedensekeys || usespill || replicate 
+			|| jointype != InnerJoin || projectsRowPointer())
+		throw InvalidParameter();
+
+	// Find and store index data page schema. The index is looked up on the
+	// first key column only.
 	//
 	idxdataschema.add(buildOp->getOutSchema().getColumnType(joinattr1));
 
@@ -64,7 +74,7 @@ void IndexHashJoinOp::threadInit(unsigned short threadid)
 	const unsigned short groupno = threadgroups.at(threadid);
 	const unsigned long long idxdatasize = 
 		2 * hashtable[groupno].getNumberOfBuckets() 
-		* buildpagesize/sbuild.getTupleSize() * sbuild.getColumnWidth(joinattr1);
+		* buildpagesize/sbuild.getTupleSize() * idxdataschema.getTupleSize();
 	
 	void* space = numaallocate_local("iHJd", sizeof(Page), this);
 	idxdatapage[threadid] = new (space) Page(idxdatasize, 
@@ -92,6 +102,7 @@ Operator::ResultCode IndexHashJoinOp::scanStart(unsigned short threadid,
 	}
 
 	Schema& buildschema = buildOp->getOutSchema();
+	void* packedkey = hashjoinstate[threadid]->packedkey;
 	while (result.first == Operator::Ready) 
 	{
 		result = buildOp->getNext(threadid);
@@ -106,28 +117,24 @@ Operator::ResultCode IndexHashJoinOp::scanStart(unsigned short threadid,
 		Page::Iterator it = page->createIterator();
 		while( (tup = it.next()) ) 
 		{
-			// Find destination bucket.
-			hashbucket = buildhasher.hash(tup);
-			void* joinkey = buildschema.calcOffset(tup, joinattr1);
+			// Find destination bucket. Composite keys are packed before 
+			// hashing.
+			if (keycolumns > 1) {
+				packKey(buildschema, tup, joinattrs1, packedkey);
+				hashbucket = buildhasher.hash(packedkey);
+			} else {
+				hashbucket = buildhasher.hash(tup);
+			}
 
 			// Copy key to idxdata page.
+			void* joinkey = buildschema.calcOffset(tup, joinattr1);
 			void* idxdatatup = idxdatapage[threadid]->allocateTuple();
 			assert(idxdatatup != NULL);
 			idxdataschema.writeData(idxdatatup, 0, joinkey);
 
 			// Project on build, copy result to target.
 			void* target = hashtable[groupno].atomicAllocate(hashbucket, this);
-			sbuild.writeData(target, 0, joinkey);
-			for (unsigned int j=0, buildattrtarget=0; j<projection.size(); ++j) 
-			{
-				if (projection[j].first != BuildSide)
-					continue; 
-
-				unsigned int attr = projection[j].second;
-				sbuild.writeData(target, buildattrtarget+1,	// dest, col in output
-						buildschema.calcOffset(tup, attr));	// src 
-				buildattrtarget++;
-			}
+			projectBuildTuple(tup, target);
 		}
 	}
 
@@ -165,8 +172,7 @@ Operator::ResultCode IndexHashJoinOp::scanStart(unsigned short threadid,
 	hashjoinstate[threadid]->location = tup2;
 
 	if (tup2 != NULL) {
-		unsigned int bucket = probehasher.hash(tup2);
-		hashtable[groupno].placeIterator(hashjoinstate[threadid]->htiter, bucket);
+		placeProbeIterator(threadid, tup2);
 	} else {
 		// Probe is empty?!
 		rescode = Finished;
@@ -44,9 +44,12 @@
 #include "../rdtsc.h"
 
 #include "../util/numaallocate.h"
+#include "../util/numaasserts.h"
+#include "../util/atomics.h"
 
 #include <sstream>
 #include <iostream>
+#include <limits>
 using std::istringstream;
 using std::make_pair;
 using std::cerr;
@@ -157,6 +160,14 @@ std::vector<JoinOp::JoinPrjT> createProjectionVector(const libconfig::Setting& l
 		istringstream ss(remainder);
 		ss >> attribute;
 
+		// Is it a pointer to the build tuple?
+		//
+		if (remainder == "rowid" && s.substr(0, l) == "B")
+		{
+			ret.push_back(make_pair(JoinOp::BuildSide, JoinOp::RowPointer));
+			continue;
+		}
+
 		// Does a number follow '$'?
 		//
 		if (!ss)
@@ -181,6 +192,30 @@ std::vector<JoinOp::JoinPrjT> createProjectionVector(const libconfig::Setting& l
 	return ret;
 }
 
+/**
+ * Reads a join attribute, or the list of attributes of a composite key.
+ */
+vector<unsigned int> readJoinAttributes(libconfig::Setting& node)
+{
+	vector<unsigned int> ret;
+
+	if (!node.isAggregate())
+	{
+		ret.push_back((int) node);
+		return ret;
+	}
+
+	for (int i=0; i<node.getLength(); ++i)
+	{
+		ret.push_back((int) node[i]);
+	}
+
+	if (ret.empty())
+		throw InvalidParameter();
+
+	return ret;
+}
+
 void JoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 {
 	Operator::init(root, node);
@@ -192,8 +227,25 @@ void JoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 
 	// Remember select and join attributes.
 	projection = createProjectionVector(node["projection"]);
-	joinattr1 = node["buildjattr"];
-	joinattr2 = node["probejattr"];
+	joinattrs1 = readJoinAttributes(node["buildjattr"]);
+	joinattrs2 = readJoinAttributes(node["probejattr"]);
+	if (joinattrs1.size() != joinattrs2.size())
+		throw InvalidParameter();
+	joinattr1 = joinattrs1[0];
+	joinattr2 = joinattrs2[0];
+
+	// Codes of different dictionaries, or a code and a plain integer, are
+	// unrelated even when they are equal.
+	//
+	for (unsigned int i=0; i<joinattrs1.size(); ++i)
+	{
+		Schema& sb = buildOp->getOutSchema();
+		Schema& sp = probeOp->getOutSchema();
+		if (joinattrs1[i] >= sb.columns() || joinattrs2[i] >= sp.columns())
+			throw IllegalSchemaDeclarationException();
+		if (sb.getDictionary(joinattrs1[i]) != sp.getDictionary(joinattrs2[i]))
+			throw InvalidParameter();
+	}
 
 	// Create partition groups, and initialize barriers.
 	//
@@ -246,6 +298,11 @@ void JoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 		switch (projection[i].first)
 		{
 			case BuildSide:
+				if (attr == RowPointer)
+				{
+					schema.add(CT_POINTER);
+					break;
+				}
 				dbgassert(attr < buildOp->getOutSchema().columns());
 				schema.add(buildOp->getOutSchema().get(attr));
 				break;
@@ -259,8 +316,20 @@ void JoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 	}
 }
 
+bool JoinOp::projectsRowPointer()
+{
+	for (unsigned int i=0; i<projection.size(); ++i)
+	{
+		if (projection[i].first == BuildSide && projection[i].second == RowPointer)
+			return true;
+	}
+	return false;
+}
+
 HashJoinOp::HashJoinState::HashJoinState() 
-	: location(NULL), pgiter(EmptyPage.createIterator()), probedepleted(false) 
+	: location(NULL), pgiter(EmptyPage.createIterator()), probedepleted(false),
+	  packedkey(NULL), replicanode(0), replicarank(0), scanningbuild(false),
+	  scanbucket(0), scanend(0)
 { 
 }
 
@@ -274,28 +343,110 @@ void HashJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 {
 	JoinOp::init(root, node);
 
-	// Compute and store build schemas.
-	sbuild.add(buildOp->getOutSchema().get(joinattr1));
+	// Semi and anti joins only output the tuples of one side.
+	//
+	string jointypestr = "inner";
+	node.lookupValue("jointype", jointypestr);
+	if (jointypestr == "inner")
+		jointype = InnerJoin;
+	else if (jointypestr == "leftsemi")
+		jointype = LeftSemiJoin;
+	else if (jointypestr == "leftanti")
+		jointype = LeftAntiJoin;
+	else if (jointypestr == "rightsemi")
+		jointype = RightSemiJoin;
+	else if (jointypestr == "rightanti")
+		jointype = RightAntiJoin;
+	else
+		throw InvalidParameter();
+
+	for (unsigned int i=0; i<projection.size(); ++i)
+	{
+		JoinSrcT outputside = isRightJoin() ? BuildSide : ProbeSide;
+		if (jointype != InnerJoin && projection[i].first != outputside)
+			throw InvalidParameter();
+	}
+
+	// A row pointer must stay valid until the query ends. Scans keep their
+	// table in memory until threadClose; other operators reuse their pages.
+	//
+	if (projectsRowPointer() && dynamic_cast<ScanOp*>(buildOp) == NULL)
+		throw InvalidParameter();
+
+	// Compute and store build schemas. Key columns come first.
+	keycolumns = joinattrs1.size();
+	for (unsigned int i=0; i<keycolumns; ++i)
+	{
+		sbuild.add(buildOp->getOutSchema().get(joinattrs1[i]));
+	}
 	for (unsigned int i=0; i<projection.size(); ++i) 
 	{
 		if (projection[i].first != BuildSide)
 			continue; 
 
+		if (projection[i].second == RowPointer)
+		{
+			sbuild.add(CT_POINTER);
+			continue;
+		}
+
 		ColumnSpec ct = buildOp->getOutSchema().get(projection[i].second);
 		sbuild.add(ct);
 	}
 
+	// Right joins mark each build tuple that has been matched.
+	//
+	if (isRightJoin())
+	{
+		sbuild.add(CT_CHAR, 1);
+		markoffset = reinterpret_cast<unsigned long long>(
+				sbuild.calcOffset(0, sbuild.columns() - 1));
+	}
+
 	// Initialize hash functions.
 	//
 	dbgassert(!node["hash"].exists("field"));
 
-	node["hash"].add("field", libconfig::Setting::TypeInt) = (int) joinattr1;
-	buildhasher = TupleHasher::create(buildOp->getOutSchema(), node["hash"]);
-	node["hash"].remove("field");
+	if (keycolumns == 1)
+	{
+		node["hash"].add("field", libconfig::Setting::TypeInt) = (int) joinattr1;
+		buildhasher = TupleHasher::create(buildOp->getOutSchema(), node["hash"]);
+		node["hash"].remove("field");
+
+		node["hash"].add("field", libconfig::Setting::TypeInt) = (int) joinattr2;
+		probehasher = TupleHasher::create(probeOp->getOutSchema(), node["hash"]);
+		node["hash"].remove("field");
+	}
+	else
+	{
+		// Composite keys are compared byte by byte once packed, so the key
+		// columns must be identical on both sides.
+		//
+		for (unsigned int i=0; i<keycolumns; ++i)
+		{
+			ColumnSpec b = buildOp->getOutSchema().get(joinattrs1[i]);
+			ColumnSpec p = probeOp->getOutSchema().get(joinattrs2[i]);
+			if (b.type != p.type || b.size != p.size)
+				throw InvalidParameter();
+		}
+
+		if (node.exists("densekeys") || node.exists("spill"))
+			throw InvalidParameter();
+
+		keysize = reinterpret_cast<unsigned long long>(
+				sbuild.calcOffset(0, keycolumns - 1)) 
+			+ sbuild.getColumnWidth(keycolumns - 1);
 
-	node["hash"].add("field", libconfig::Setting::TypeInt) = (int) joinattr2;
-	probehasher = TupleHasher::create(probeOp->getOutSchema(), node["hash"]);
-	node["hash"].remove("field");
+		// Both sides hash the packed key.
+		//
+		libconfig::Setting& range = 
+			node["hash"].add("fieldrange", libconfig::Setting::TypeList);
+		range.add(libconfig::Setting::TypeInt) = 0;
+		range.add(libconfig::Setting::TypeInt) = (int) keycolumns - 1;
+		buildhasher = TupleHasher::create(sbuild, node["hash"]);
+		probehasher = TupleHasher::create(sbuild, node["hash"]);
+		node["hash"].remove("fieldrange");
+	}
 
 	dbgassert(buildhasher.buckets() == probehasher.buckets());
 
@@ -320,6 +471,91 @@ void HashJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 		hashtable.push_back(HashTable());
 	}
 
+	// If build keys are declared dense, create a dense key table per group
+	// as well. The hash table is still created, as it is the fallback.
+	//
+	if (node.exists("densekeys"))
+	{
+		buildkeytype = buildOp->getOutSchema().getColumnType(joinattr1);
+		probekeytype = probeOp->getOutSchema().getColumnType(joinattr2);
+
+		if ((buildkeytype != CT_INTEGER && buildkeytype != CT_LONG)
+				|| (probekeytype != CT_INTEGER && probekeytype != CT_LONG))
+		{
+			throw InvalidParameter();
+		}
+
+		// Integer settings are longs, wide enough for any CT_LONG key.
+		//
+		usedensekeys = true;
+		long minval = node["densekeys"][0];
+		long maxval = node["densekeys"][1];
+		densemin = minval;
+		densemax = maxval;
+
+		if (densemin > densemax)
+			throw InvalidParameter();
+
+		if (buildkeytype == CT_INTEGER 
+				&& (densemin < std::numeric_limits<CtInt>::min()
+					|| densemax > std::numeric_limits<CtInt>::max()))
+			throw InvalidParameter();
+
+		// A range too wide to allocate is served by the hash table. The
+		// span is computed unsigned, as max - min may not fit in a long.
+		//
+		long maxslots = DefaultDenseKeyMaxSlots;
+		node.lookupValue("densekeysmaxslots", maxslots);
+		if (maxslots <= 0)
+			throw InvalidParameter();
+
+		unsigned long long span = static_cast<unsigned long long>(densemax) 
+			- static_cast<unsigned long long>(densemin);
+		if (span >= static_cast<unsigned long long>(maxslots))
+			usedensekeys = false;
+
+		for (unsigned int i=0; usedensekeys && i<groupleader.size(); ++i)
+		{
+			densetable.push_back(DenseKeyTable());
+		}
+	}
+
+	// Is the build side allowed to spill to disk? 
+	//
+	if (node.exists("spill"))
+	{
+		libconfig::Setting& spillnode = node["spill"];
+
+		if (node.exists("densekeys"))
+			throw InvalidParameter();
+
+		usespill = true;
+		int budgetinM = spillnode["memoryinM"];
+		spillbudget = budgetinM * 1024uLL * 1024uLL;
+
+		spilldirectory = "/tmp";
+		spillnode.lookupValue("directory", spilldirectory);
+
+		spillparts = 16;
+		spillnode.lookupValue("partitions", spillparts);
+		if (spillparts < 2 || spillparts > MAX_SPILL_PARTS
+				|| (spillparts & (spillparts - 1)) != 0)
+			throw InvalidParameter();
+		log2spillparts = getlogarithm(spillparts);
+
+		for (unsigned int i=0; i<groupleader.size(); ++i)
+		{
+			spillgroupstate.push_back(NULL);
+		}
+	}
+
+	if (usedensekeys || usespill)
+	{
+		node["hash"].add("field", libconfig::Setting::TypeInt) = 0;
+		densefallbackhasher = TupleHasher::create(sbuild, node["hash"]);
+		node["hash"].remove("field");
+	}
+
 	// Create and populate NUMA allocation policy object. This could be done
 	// per-group, but for now we use a blanket allocation policy.
 	//
@@ -355,6 +591,30 @@ void HashJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 			<< "NUMA disabled at compile." << endl;
 #endif
 	}
+	else if (policystr == "replicated")
+	{
+		// The hash table is probed in place while spilled partitions are
+		// joined, so there is nothing stable to replicate.
+		//
+		if (usespill)
+			throw InvalidParameter();
+
+		replicate = true;
+#ifdef ENABLE_NUMA
+		numanodes = numa_max_node() + 1;
+#endif
+		for (unsigned int i=0; i<groupleader.size(); ++i)
+		{
+			replicas.push_back(vector<HashTable>(numanodes));
+			replicathreads.push_back(vector<unsigned int>(numanodes, 0));
+		}
+	}
+
+	// The marks of right joins are only scanned in the hash table of the
+	// group.
+	//
+	if (isRightJoin() && (node.exists("densekeys") || usespill || replicate))
+		throw InvalidParameter();
 
 	// Create state and output tables.
 	//
@@ -362,6 +622,31 @@ void HashJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 	{
 		output.push_back(NULL);
 		hashjoinstate.push_back(NULL);
+		spillthreadstate.push_back(NULL);
+	}
+}
+
+HashJoinOp::SpillGroupState::SpillGroupState()
+	: residentbytes(0)
+{
+	for (unsigned int i=0; i<MAX_SPILL_PARTS; ++i)
+	{
+		partbytes[i] = 0;
+		spilled[i] = false;
+	}
+	pthread_mutex_init(&evictlock, NULL);
+}
+
+HashJoinOp::SpillThreadState::SpillThreadState()
+	: joiningspilled(false), currentprobefile(0), tableinitialized(false),
+	  tableshift(0), buildstaging(NULL), probestaging(NULL), scratch(NULL),
+	  buildtuplesspilled(0), probetuplesspilled(0), partitionsjoined(0),
+	  repartitions(0)
+{
+	for (unsigned int i=0; i<MAX_SPILL_PARTS; ++i)
+	{
+		buildfile[i] = NULL;
+		probefile[i] = NULL;
 	}
 }
 
@@ -370,11 +655,63 @@ void HashJoinOp::threadInit(unsigned short threadid)
 	void* space2 = numaallocate_local("HJst", sizeof(HashJoinState), this);
 	hashjoinstate[threadid] = new (space2) HashJoinState();
 
+	if (keycolumns > 1)
+	{
+		hashjoinstate[threadid]->packedkey = 
+			numaallocate_local("HJkp", keysize, this);
+	}
+
 	const unsigned short groupno = threadgroups.at(threadid);
 	if (groupleader.at(groupno) == threadid)
 	{
 		hashtable[groupno].init(buildhasher.buckets(), buildpagesize, 
 				sbuild.getTupleSize(), allocpolicy, this);
+
+		if (usedensekeys)
+		{
+			densetable[groupno].init(densemin, densemax, 
+					sbuild.getTupleSize(), allocpolicy, this);
+		}
+
+		if (usespill)
+		{
+			void* space = numaallocate_local("HJsg", sizeof(SpillGroupState), this);
+			spillgroupstate[groupno] = new (space) SpillGroupState();
+		}
+	}
+
+	if (usespill)
+	{
+		void* space = numaallocate_local("HJss", sizeof(SpillThreadState), this);
+		SpillThreadState* ss = new (space) SpillThreadState();
+		spillthreadstate[threadid] = ss;
+
+		space = numaallocate_local("HJsb", sizeof(Page), this);
+		ss->buildstaging = new (space) 
+			Page(buffsize, sbuild.getTupleSize(), this, "HJsb");
+		space = numaallocate_local("HJsp", sizeof(Page), this);
+		ss->probestaging = new (space) 
+			Page(buffsize, probeOp->getOutSchema().getTupleSize(), this, "HJsp");
+		ss->scratch = numaallocate_local("HJsc", sbuild.getTupleSize(), this);
+	}
+
+	// The first thread of the group to arrive from each NUMA node allocates
+	// the replica on that node.
+	//
+	if (replicate)
+	{
+		HashJoinState* state = hashjoinstate[threadid];
+		state->replicanode = localnumanode();
+		assert(state->replicanode < static_cast<int>(numanodes));
+		state->replicarank = 
+			atomic_increment(&replicathreads[groupno][state->replicanode]);
+
+		if (state->replicarank == 0)
+		{
+			replicas[groupno][state->replicanode].init(buildhasher.buckets(), 
+				buildpagesize, sbuild.getTupleSize(), 
+				vector<char>(1, static_cast<char>(state->replicanode)), this);
+		}
 	}
 
 	// Wait for hashtable init before clearing bucket space and creating
@@ -382,6 +719,16 @@ void HashJoinOp::threadInit(unsigned short threadid)
 	//
 	barriers[groupno].Arrive();
 	hashtable[groupno].bucketclear(threadposingrp.at(threadid), groupsize.at(groupno));
+	if (replicate)
+	{
+		HashJoinState* state = hashjoinstate[threadid];
+		replicas[groupno][state->replicanode].bucketclear(state->replicarank,
+				replicathreads[groupno][state->replicanode]);
+	}
+	if (usedensekeys)
+	{
+		densetable[groupno].clear(threadposingrp.at(threadid), groupsize.at(groupno));
+	}
 
 	barriers[groupno].Arrive();
 	hashjoinstate[threadid]->htiter = hashtable[groupno].createIterator();
@@ -414,7 +761,7 @@ Operator::ResultCode HashJoinOp::scanStart(unsigned short threadid,
 
 	while (result.first == Operator::Ready) {
 		result = buildOp->getNext(threadid);
-		buildFromPage(result.second, groupno);
+		buildFromPage(result.second, threadid);
 	}
 
 	if (result.first == Operator::Error) {
@@ -433,6 +780,26 @@ Operator::ResultCode HashJoinOp::scanStart(unsigned short threadid,
 	//
 	barriers[groupno].Arrive();
 
+	// If some build key did not fit in the dense key table, the group falls
+	// back to the hash table. Every thread moves its share of the dense
+	// table over, and waits for the others before probing.
+	//
+	bool probedense = usedensekeys && !densetable[groupno].hasFailed();
+	if (usedensekeys && !probedense)
+	{
+		migrateDenseKeysToHashTable(threadid, groupno);
+		barriers[groupno].Arrive();
+	}
+
+	// Threads on each NUMA node copy the complete hash table into the
+	// replica of their node, and wait for each other before probing it.
+	//
+	if (replicate && !probedense)
+	{
+		copyToReplica(threadid, groupno);
+		barriers[groupno].Arrive();
+	}
+
 	TRACE('3');
 
 	// Hash table is complete now, every thread can proceed.
@@ -451,10 +818,11 @@ Operator::ResultCode HashJoinOp::scanStart(unsigned short threadid,
 	hashjoinstate[threadid]->location = tup2;
 
 	if (tup2 != NULL) {
-		unsigned int bucket = probehasher.hash(tup2);
-		hashtable[groupno].placeIterator(hashjoinstate[threadid]->htiter, bucket);
-	} else {
-		// Probe is empty?!
+		if (!probedense) {
+			placeProbeIterator(threadid, tup2);
+		}
+	} else if (!isRightJoin()) {
+		// Probe is empty?! Right joins still output from the build side.
 		rescode = Finished;
 	}
 
@@ -478,9 +846,9 @@ void HashJoinOp::constructOutputTuple(void* tupbuild, void* tupprobe, void* outp
 	Schema& probeschema = probeOp->getOutSchema();
 
 	// Copy each column to destination. buildFromPage scans projection
-	// sequentially, so we repeat buildattr starts from 1, because the join
-	// key is attr 0.
-	for (unsigned int j=0, buildattr=1; j<projection.size(); ++j) 
+	// sequentially, so we repeat buildattr starts from keycolumns, because
+	// the join key is attr 0 (or attrs 0 to keycolumns-1, if composite).
+	for (unsigned int j=0, buildattr=keycolumns; j<projection.size(); ++j) 
 	{
 		if (projection[j].first == BuildSide)
 		{
@@ -500,6 +868,43 @@ void HashJoinOp::constructOutputTuple(void* tupbuild, void* tupprobe, void* outp
 	}
 }
 
+namespace {
+
+void deleteSpillFiles(vector<SpillFile*>& files)
+{
+	for (unsigned int i=0; i<files.size(); ++i)
+	{
+		files[i]->close();
+		delete files[i];
+	}
+	files.clear();
+}
+
+unsigned long long sizeOfSpillFiles(vector<SpillFile*>& files)
+{
+	unsigned long long ret = 0;
+	for (unsigned int i=0; i<files.size(); ++i)
+	{
+		ret += files[i]->size();
+	}
+	return ret;
+}
+
+};
+
+namespace {
+
+/**
+ * Reads an "int" or "long" join key as a CtLong.
+ */
+inline CtLong readIntegerKey(void* key, ColumnType ct)
+{
+	dbg2assert(ct == CT_INTEGER || ct == CT_LONG);
+	return (ct == CT_INTEGER) ? *(CtInt*)key : *(CtLong*)key;
+}
+
+};
+
 Operator::GetNextResultT HashJoinOp::getNext(unsigned short threadid)
 {
 	void* tup1;
@@ -507,9 +912,25 @@ Operator::GetNextResultT HashJoinOp::getNext(unsigned short threadid)
 
 	TRACE('G');
 
+	const unsigned short groupno = threadgroups[threadid];
+	if (usedensekeys && !densetable[groupno].hasFailed())
+	{
+		return getNextDenseKeys(threadid);
+	}
+
+	if (jointype == LeftSemiJoin || jointype == LeftAntiJoin)
+	{
+		return getNextLeftSemiAnti(threadid);
+	}
+
+	if (isRightJoin())
+	{
+		return getNextRightSemiAnti(threadid);
+	}
+
 	Page* out = output[threadid];
 	HashJoinState* state = hashjoinstate[threadid];
-	HashTable& ht = hashtable[threadgroups[threadid]];
+	HashTable& ht = probeTable(threadid);
 
 	out->clear();
 	tup2 = state->location;
@@ -520,7 +941,7 @@ Operator::GetNextResultT HashJoinOp::getNext(unsigned short threadid)
 		while ( (tup1 = state->htiter.next()) ) {
 			void* target;
 
-			if (keycomparator.eval(tup1, tup2)) {
+			if (keysDiffer(tup1, tup2, state->packedkey)) {
 				continue;
 			}
 
@@ -546,8 +967,7 @@ Operator::GetNextResultT HashJoinOp::getNext(unsigned short threadid)
 		state->location = tup2;
 		if (tup2 != NULL) {
 			// hash tup2 to place htiter.
-			unsigned int bucket = probehasher.hash(tup2);
-			ht.placeIterator(state->htiter, bucket);
+			placeProbeIterator(threadid, tup2);
 		} else {
 			state->htiter = ht.createIterator();
 			TRACE('F');
@@ -556,113 +976,876 @@ Operator::GetNextResultT HashJoinOp::getNext(unsigned short threadid)
 
 	}
 
-	TRACE('E');
-	// How the hell did we get here?
-	return make_pair(Operator::Error, &EmptyPage);
+	TRACE('E');
+	// How the hell did we get here?
+	return make_pair(Operator::Error, &EmptyPage);
+}
+
+/**
+ * Probes the dense key table. Build keys are unique, so every probe tuple
+ * produces at most one output tuple and there is no iterator to remember
+ * across calls; \a state->location is the next probe tuple to process.
+ */
+Operator::GetNextResultT HashJoinOp::getNextDenseKeys(unsigned short threadid)
+{
+	void* tup1;
+	void* tup2;
+
+	Page* out = output[threadid];
+	HashJoinState* state = hashjoinstate[threadid];
+	DenseKeyTable& dt = densetable[threadgroups[threadid]];
+	Schema& probeschema = probeOp->getOutSchema();
+
+	out->clear();
+	tup2 = state->location;
+
+	while (tup2 != NULL)
+	{
+		CtLong key = readIntegerKey(probeschema.calcOffset(tup2, joinattr2), probekeytype);
+
+		// Left anti joins output the probe tuples that are not found.
+		tup1 = dt.lookup(key);
+		if ((tup1 != NULL) == (jointype != LeftAntiJoin))
+		{
+			void* target = out->allocateTuple();
+			dbg2assert(target!=NULL);
+
+			constructOutputTuple(tup1, tup2, target);
+		}
+
+		tup2 = readNextTupleFromProbe(threadid);
+		state->location = tup2;
+
+		// If buffer full, return with Ready. 
+		if (!out->canStoreTuple()) {
+			TRACE('R');
+			return make_pair(Ready, out);
+		}
+	}
+
+	TRACE('F');
+	return make_pair(Operator::Finished, out);
+}
+
+/**
+ * Every probe tuple produces at most one output tuple, so, as with dense
+ * keys, \a state->location is the next probe tuple to process and \a htiter
+ * is always placed on its bucket.
+ */
+Operator::GetNextResultT HashJoinOp::getNextLeftSemiAnti(unsigned short threadid)
+{
+	void* tup1;
+	void* tup2;
+
+	Page* out = output[threadid];
+	HashJoinState* state = hashjoinstate[threadid];
+
+	out->clear();
+	tup2 = state->location;
+
+	while (tup2 != NULL)
+	{
+		bool found = false;
+		while ( (tup1 = state->htiter.next()) ) {
+			if (!keysDiffer(tup1, tup2, state->packedkey)) {
+				found = true;
+				break;
+			}
+		}
+
+		if (found == (jointype == LeftSemiJoin))
+		{
+			void* target = out->allocateTuple();
+			dbg2assert(target!=NULL);
+
+			constructOutputTuple(NULL, tup2, target);
+		}
+
+		tup2 = readNextTupleFromProbe(threadid);
+		state->location = tup2;
+		if (tup2 != NULL) {
+			placeProbeIterator(threadid, tup2);
+		}
+
+		// If buffer full, return with Ready. 
+		if (!out->canStoreTuple()) {
+			TRACE('R');
+			return make_pair(Ready, out);
+		}
+	}
+
+	state->htiter = probeTable(threadid).createIterator();
+	TRACE('F');
+	return make_pair(Operator::Finished, out);
+}
+
+/**
+ * Marks are only ever set, so concurrent probes of the same build tuple
+ * write the same value and need no synchronization. The barrier orders all
+ * marks of the group before the scan of the hash table.
+ */
+Operator::GetNextResultT HashJoinOp::getNextRightSemiAnti(unsigned short threadid)
+{
+	void* tup1;
+	void* tup2;
+
+	const unsigned short groupno = threadgroups[threadid];
+	Page* out = output[threadid];
+	HashJoinState* state = hashjoinstate[threadid];
+	HashTable& ht = hashtable[groupno];
+
+	out->clear();
+
+	if (!state->scanningbuild)
+	{
+		tup2 = state->location;
+		while (tup2 != NULL)
+		{
+			while ( (tup1 = state->htiter.next()) ) {
+				if (keysDiffer(tup1, tup2, state->packedkey)) {
+					continue;
+				}
+				*(reinterpret_cast<char*>(tup1) + markoffset) = 1;
+			}
+
+			tup2 = readNextTupleFromProbe(threadid);
+			state->location = tup2;
+			if (tup2 != NULL) {
+				placeProbeIterator(threadid, tup2);
+			}
+		}
+
+		barriers[groupno].Arrive();
+
+		unsigned long long thread = threadposingrp.at(threadid);
+		unsigned long long total = groupsize.at(groupno);
+		unsigned long long buckets = ht.getNumberOfBuckets();
+
+		state->scanningbuild = true;
+		state->scanbucket = ((thread+0uLL)*buckets) / total;
+		state->scanend    = ((thread+1uLL)*buckets) / total;
+		state->htiter = ht.createIterator();
+		if (state->scanbucket < state->scanend) {
+			ht.placeIterator(state->htiter, state->scanbucket);
+		}
+	}
+
+	const char wanted = (jointype == RightSemiJoin) ? 1 : 0;
+
+	while (state->scanbucket < state->scanend)
+	{
+		while ( (tup1 = state->htiter.next()) ) {
+			if (*(reinterpret_cast<char*>(tup1) + markoffset) != wanted) {
+				continue;
+			}
+
+			void* target = out->allocateTuple();
+			dbg2assert(target!=NULL);
+
+			constructOutputTuple(tup1, NULL, target);
+
+			// If buffer full, return with Ready. htiter remembers position.
+			if (!out->canStoreTuple()) {
+				TRACE('R');
+				return make_pair(Ready, out);
+			}
+		}
+
+		state->scanbucket++;
+		if (state->scanbucket < state->scanend) {
+			ht.placeIterator(state->htiter, state->scanbucket);
+		}
+	}
+
+	TRACE('F');
+	return make_pair(Operator::Finished, out);
+}
+
+void HashJoinOp::migrateDenseKeysToHashTable(unsigned short threadid, unsigned short groupno)
+{
+	DenseKeyTable& dt = densetable[groupno];
+	unsigned long long thread = threadposingrp.at(threadid);
+	unsigned long long total = groupsize.at(groupno);
+	unsigned long long slots = dt.getNumberOfSlots();
+
+	unsigned long long startoffset = ((thread+0uLL)*slots) / total;
+	unsigned long long endoffset   = ((thread+1uLL)*slots) / total;
+
+	for (unsigned long long i = startoffset; i < endoffset; ++i)
+	{
+		void* tup = dt.slotIfPresent(i);
+		if (tup == NULL)
+			continue;
+
+		unsigned int hashbucket = densefallbackhasher.hash(tup);
+		void* target = hashtable[groupno].atomicAllocate(hashbucket, this);
+		sbuild.copyTuple(target, tup);
+	}
+}
+
+void HashJoinOp::copyToReplica(unsigned short threadid, unsigned short groupno)
+{
+	HashJoinState* state = hashjoinstate[threadid];
+	HashTable& source = hashtable[groupno];
+	HashTable& replica = replicas[groupno][state->replicanode];
+	unsigned long long thread = state->replicarank;
+	unsigned long long total = replicathreads[groupno][state->replicanode];
+	unsigned long long buckets = source.getNumberOfBuckets();
+
+	unsigned long long startoffset = ((thread+0uLL)*buckets) / total;
+	unsigned long long endoffset   = ((thread+1uLL)*buckets) / total;
+
+	// Buckets are split between the threads of this node, so each bucket
+	// of the replica only has one writer.
+	//
+	HashTable::Iterator it = source.createIterator();
+	for (unsigned long long i = startoffset; i < endoffset; ++i)
+	{
+		void* tup;
+		source.placeIterator(it, i);
+		while ( (tup = it.next()) )
+		{
+			void* target = replica.allocate(i, this);
+			sbuild.copyTuple(target, tup);
+		}
+	}
+}
+
+void* HashJoinOp::readNextTupleFromProbe(unsigned short threadid)
+{
+	if (!usespill)
+		return readNextTupleFromProbeOp(threadid);
+
+	SpillThreadState* ss = spillthreadstate[threadid];
+	SpillGroupState* sg = spillgroupstate[threadgroups[threadid]];
+
+	// Set aside the tuples of spilled partitions, until the probe input 
+	// has been consumed.
+	//
+	while (!ss->joiningspilled)
+	{
+		void* tup = readNextTupleFromProbeOp(threadid);
+		if (tup == NULL)
+		{
+			startJoiningSpilled(threadid);
+			break;
+		}
+
+		unsigned int part = spillPartition(probehasher.hash(tup), 0);
+		if (!sg->spilled[part])
+			return tup;
+
+		if (ss->probefile[part] == NULL)
+		{
+			ss->probefile[part] = new SpillFile();
+			ss->probefile[part]->create(spilldirectory);
+		}
+		ss->probefile[part]->append(tup, probeOp->getOutSchema().getTupleSize());
+		ss->probetuplesspilled++;
+	}
+
+	return readNextSpilledProbeTuple(threadid);
+}
+
+void HashJoinOp::placeProbeIterator(unsigned short threadid, void* tup)
+{
+	HashJoinState* state = hashjoinstate[threadid];
+	unsigned int bucket;
+
+	if (keycolumns > 1)
+	{
+		packKey(probeOp->getOutSchema(), tup, joinattrs2, state->packedkey);
+		bucket = probehasher.hash(state->packedkey);
+	}
+	else
+	{
+		bucket = probehasher.hash(tup);
+	}
+
+	if (usespill && spillthreadstate[threadid]->joiningspilled)
+	{
+		SpillThreadState* ss = spillthreadstate[threadid];
+		ss->table.placeIterator(state->htiter, 
+			(bucket >> ss->tableshift) % ss->table.getNumberOfBuckets());
+		return;
+	}
+
+	probeTable(threadid).placeIterator(state->htiter, bucket);
+}
+
+/**
+ * Reads next tuple from probe. WARNING: non-existent error-handling.
+ * As a side-effect, it sets the \a pgiter in the \a hashjoinstate for the
+ * current thread.
+ * @return Next tuple if available, otherwise NULL.
+ * @bug Remove exception, make proper returns with error checking.
+ */
+void* HashJoinOp::readNextTupleFromProbeOp(unsigned short threadid) {
+	void* ret;
+	GetNextResultT result;
+
+	// Scan forward from pgit. 
+	Page::Iterator& pgit = hashjoinstate[threadid]->pgiter;
+	ret = pgit.next();
+
+	// If valid tuple, return it.
+	if (ret != NULL)
+		return ret;
+
+	// If probe depleted, nothing more to do here.
+	if (hashjoinstate[threadid]->probedepleted)
+		return NULL;
+
+	// Request next page and place iterator.
+	result = probeOp->getNext(threadid);
+
+	if (result.first == Operator::Error) {
+		throw QueryExecutionError();
+	}
+
+	pgit.place(result.second);
+	
+	// If return code was Finished, return tuple. Otherwise, recurse. 
+	// (Rationale for recursion: Perhaps it's an empty page in a Ready stream.)
+	if (result.first == Operator::Finished) {
+		hashjoinstate[threadid]->probedepleted = true;
+		return pgit.next();
+	}
+	return readNextTupleFromProbeOp(threadid);
+}
+
+void HashJoinOp::threadClose(unsigned short threadid)
+{
+	int replicanode = 0;
+	unsigned int replicarank = 0;
+
+	if (hashjoinstate[threadid]) {
+		replicanode = hashjoinstate[threadid]->replicanode;
+		replicarank = hashjoinstate[threadid]->replicarank;
+		if (hashjoinstate[threadid]->packedkey) {
+			numadeallocate(hashjoinstate[threadid]->packedkey);
+		}
+		numadeallocate(hashjoinstate[threadid]);
+	}
+	hashjoinstate[threadid] = NULL;
+
+	if (output[threadid]) {
+		numadeallocate(output[threadid]);
+	}
+	output[threadid] = NULL;
+
+	// Wait for all threads to finish, then clear buckets and destroy hashtable.
+	//
+	const unsigned short groupno = threadgroups.at(threadid);
+
+	barriers[groupno].Arrive();
+	hashtable[groupno].bucketclear(threadposingrp.at(threadid), groupsize.at(groupno));
+	if (replicate)
+	{
+		replicas[groupno][replicanode].bucketclear(replicarank,
+				replicathreads[groupno][replicanode]);
+	}
+
+	if (usespill && spillthreadstate[threadid])
+	{
+		SpillThreadState* ss = spillthreadstate[threadid];
+
+		// Delete files left over if the join did not run to completion.
+		//
+		for (unsigned int p=0; p<MAX_SPILL_PARTS; ++p)
+		{
+			vector<SpillFile*> files;
+			if (ss->buildfile[p] != NULL)
+				files.push_back(ss->buildfile[p]);
+			if (ss->probefile[p] != NULL)
+				files.push_back(ss->probefile[p]);
+			deleteSpillFiles(files);
+		}
+		for (unsigned int i=0; i<ss->pending.size(); ++i)
+		{
+			deleteSpillFiles(ss->pending[i].build);
+			deleteSpillFiles(ss->pending[i].probe);
+		}
+		deleteSpillFiles(ss->current.build);
+		deleteSpillFiles(ss->current.probe);
+
+		if (ss->tableinitialized)
+		{
+			for (unsigned int b=0; b<ss->table.getNumberOfBuckets(); ++b)
+				ss->table.clearbucket(b);
+			ss->table.destroy();
+		}
+
+		ss->buildstaging->~Page();
+		numadeallocate(ss->buildstaging);
+		ss->probestaging->~Page();
+		numadeallocate(ss->probestaging);
+		numadeallocate(ss->scratch);
+
+		ss->~SpillThreadState();
+		numadeallocate(ss);
+		spillthreadstate[threadid] = NULL;
+	}
+
+	barriers[groupno].Arrive();
+	if (replicate && replicarank == 0)
+	{
+		replicas[groupno][replicanode].destroy();
+		replicathreads[groupno][replicanode] = 0;
+	}
+
+	if (groupleader.at(groupno) == threadid)
+	{
+		hashtable[groupno].destroy();
+
+		if (usedensekeys)
+		{
+			densetable[groupno].destroy();
+		}
+
+		if (usespill)
+		{
+			pthread_mutex_destroy(&spillgroupstate[groupno]->evictlock);
+			numadeallocate(spillgroupstate[groupno]);
+			spillgroupstate[groupno] = NULL;
+		}
+	}
+}
+
+void HashJoinOp::destroy()
+{
+	buildhasher.destroy();
+	probehasher.destroy();
+	densefallbackhasher.destroy();
+
+#ifdef TRACELOG
+	dbgDumpTraceToFile("hjtrace");
+#endif
+}
+
+bool HashJoinOp::usedDenseKeyTable(unsigned short groupno)
+{
+	return usedensekeys 
+		&& densetable.at(groupno).getNumberOfSlots() != 0
+		&& !densetable[groupno].hasFailed();
+}
+
+unsigned long long HashJoinOp::spilledBuildTuples()
+{
+	unsigned long long ret = 0;
+	for (unsigned int t=0; t<spillthreadstate.size(); ++t)
+	{
+		if (spillthreadstate[t] != NULL)
+			ret += spillthreadstate[t]->buildtuplesspilled;
+	}
+	return ret;
+}
+
+void HashJoinOp::buildFromPage(Page* page, unsigned short threadid)
+{
+	void* tup = NULL;
+	void* target = NULL;
+	Schema& buildschema = buildOp->getOutSchema();
+	const unsigned short groupno = threadgroups[threadid];
+
+	if (usespill) {
+		Page::Iterator it = page->createIterator();
+		while( (tup = it.next()) ) {
+			buildWithSpill(threadid, tup);
+		}
+		return;
+	}
+
+	// Composite keys are packed before hashing.
+	if (keycolumns > 1) {
+		void* key = hashjoinstate[threadid]->packedkey;
+		Page::Iterator it = page->createIterator();
+		while( (tup = it.next()) ) {
+			packKey(buildschema, tup, joinattrs1, key);
+			target = hashtable[groupno].atomicAllocate(buildhasher.hash(key), this);
+			projectBuildTuple(tup, target);
+		}
+		return;
+	}
+
+	// Hash the page in batches, then insert each tuple.
+	unsigned int hashbucket[TupleHasher::BatchSize];
+	const unsigned int tuples = page->getNumTuples();
+
+	for (unsigned int first=0; first<tuples; first+=TupleHasher::BatchSize) {
+		const unsigned int count = 
+			std::min(TupleHasher::BatchSize, tuples - first);
+
+		// Tuples are only hashed one at a time if they did not fit in the
+		// dense key table.
+		if (!usedensekeys)
+			buildhasher.hashBatch(page, first, count, hashbucket);
+
+		for (unsigned int i=0; i<count; ++i) {
+			tup = page->getTupleOffset(first + i);
+			target = NULL;
+
+			// Claim the slot in the dense key table, if possible. Otherwise,
+			// mark the table as failed and place tuple in the hash table.
+			if (usedensekeys) {
+				CtLong key = readIntegerKey(
+						buildschema.calcOffset(tup, joinattr1), buildkeytype);
+				target = densetable[groupno].atomicAllocate(key);
+				if (target == NULL)
+					densetable[groupno].markFailed();
+			}
+
+			if (target == NULL) {
+				// Find destination bucket.
+				unsigned int bucket = 
+					usedensekeys ? buildhasher.hash(tup) : hashbucket[i];
+				target = hashtable[groupno].atomicAllocate(bucket, this);
+			}
+
+			projectBuildTuple(tup, target);
+		}
+	}
+}
+
+void HashJoinOp::projectBuildTuple(void* tup, void* target)
+{
+	Schema& buildschema = buildOp->getOutSchema();
+
+	// Project on build, copy result to target.
+	packKey(buildschema, tup, joinattrs1, target);
+	for (unsigned int j=0, buildattrtarget=keycolumns; j<projection.size(); ++j) 
+	{
+		if (projection[j].first != BuildSide)
+			continue; 
+
+		unsigned int attr = projection[j].second;
+		if (attr == RowPointer)
+			sbuild.writeData(target, buildattrtarget, &tup);
+		else
+			sbuild.writeData(target, buildattrtarget,	// dest, col in output
+					buildschema.calcOffset(tup, attr));	// src 
+		buildattrtarget++;
+	}
+
+	if (isRightJoin())
+		*(reinterpret_cast<char*>(target) + markoffset) = 0;
+}
+
+void HashJoinOp::packKey(Schema& tupschema, void* tup, 
+		const vector<unsigned int>& attrs, void* target)
+{
+	for (unsigned int i=0; i<keycolumns; ++i)
+	{
+		sbuild.writeData(target, i, tupschema.calcOffset(tup, attrs[i]));
+	}
+}
+
+/**
+ * The bucket lock serializes insertions with the eviction of the partition
+ * of the bucket: a tuple either lands in the hash table before the evicting
+ * thread flushes its bucket, or it sees the partition marked as spilled.
+ */
+void HashJoinOp::buildWithSpill(unsigned short threadid, void* tup)
+{
+	const unsigned short groupno = threadgroups[threadid];
+	SpillGroupState* sg = spillgroupstate[groupno];
+	SpillThreadState* ss = spillthreadstate[threadid];
+	HashTable& ht = hashtable[groupno];
+	const unsigned int tuplesize = sbuild.getTupleSize();
+
+	unsigned int bucket = buildhasher.hash(tup);
+	unsigned int part = spillPartition(bucket, 0);
+
+	ht.lockbucket(bucket);
+	if (!sg->spilled[part])
+	{
+		void* target = ht.allocate(bucket, this);
+		projectBuildTuple(tup, target);
+		atomic_increment(&sg->partbytes[part], (unsigned long long)tuplesize);
+		atomic_increment(&sg->residentbytes, (unsigned long long)tuplesize);
+		ht.unlockbucket(bucket);
+
+		if (sg->residentbytes > spillbudget)
+			evictPartitions(threadid);
+		return;
+	}
+	ht.unlockbucket(bucket);
+
+	projectBuildTuple(tup, ss->scratch);
+	if (ss->buildfile[part] == NULL)
+	{
+		ss->buildfile[part] = new SpillFile();
+		ss->buildfile[part]->create(spilldirectory);
+	}
+	ss->buildfile[part]->append(ss->scratch, tuplesize);
+	ss->buildtuplesspilled++;
+}
+
+void HashJoinOp::evictPartitions(unsigned short threadid)
+{
+	const unsigned short groupno = threadgroups[threadid];
+	SpillGroupState* sg = spillgroupstate[groupno];
+	SpillThreadState* ss = spillthreadstate[threadid];
+	HashTable& ht = hashtable[groupno];
+	const unsigned int tuplesize = sbuild.getTupleSize();
+	const unsigned int nbuckets = ht.getNumberOfBuckets();
+
+	if (pthread_mutex_trylock(&sg->evictlock) != 0)
+		return;
+
+	HashTable::Iterator it = ht.createIterator();
+
+	while (sg->residentbytes > spillbudget)
+	{
+		// Pick the largest partition that is still in memory.
+		//
+		unsigned int victim = spillparts;
+		for (unsigned int p=0; p<spillparts; ++p)
+		{
+			if (sg->spilled[p])
+				continue;
+			if (victim == spillparts || sg->partbytes[p] > sg->partbytes[victim])
+				victim = p;
+		}
+
+		if (victim == spillparts)
+			break;
+
+		sg->spilled[victim] = true;
+
+		if (ss->buildfile[victim] == NULL)
+		{
+			ss->buildfile[victim] = new SpillFile();
+			ss->buildfile[victim]->create(spilldirectory);
+		}
+		SpillFile* f = ss->buildfile[victim];
+
+		unsigned long long flushed = 0;
+		for (unsigned int b=victim; b<nbuckets; b+=spillparts)
+		{
+			ht.lockbucket(b);
+			ht.placeIterator(it, b);
+			void* tup;
+			while ( (tup = it.next()) )
+			{
+				f->append(tup, tuplesize);
+				flushed += tuplesize;
+				ss->buildtuplesspilled++;
+			}
+			ht.clearbucket(b);
+			ht.unlockbucket(b);
+		}
+
+		atomic_increment(&sg->partbytes[victim], 0 - flushed);
+		atomic_increment(&sg->residentbytes, 0 - flushed);
+	}
+
+	pthread_mutex_unlock(&sg->evictlock);
 }
 
 /**
- * Reads next tuple from probe. WARNING: non-existent error-handling.
- * As a side-effect, it sets the \a pgiter in the \a hashjoinstate for the
- * current thread.
- * @return Next tuple if available, otherwise NULL.
- * @bug Remove exception, make proper returns with error checking.
+ * Partition p is joined by the thread at position p % groupsize in the
+ * group, which takes over the files of partition p from all threads.
  */
-void* HashJoinOp::readNextTupleFromProbe(unsigned short threadid) {
-	void* ret;
-	GetNextResultT result;
+void HashJoinOp::startJoiningSpilled(unsigned short threadid)
+{
+	const unsigned short groupno = threadgroups[threadid];
+	SpillGroupState* sg = spillgroupstate[groupno];
+	SpillThreadState* ss = spillthreadstate[threadid];
 
-	// Scan forward from pgit. 
-	Page::Iterator& pgit = hashjoinstate[threadid]->pgiter;
-	ret = pgit.next();
+	for (unsigned int p=0; p<spillparts; ++p)
+	{
+		if (ss->buildfile[p] != NULL)
+			ss->buildfile[p]->rewind();
+		if (ss->probefile[p] != NULL)
+			ss->probefile[p]->rewind();
+	}
 
-	// If valid tuple, return it.
-	if (ret != NULL)
-		return ret;
+	barriers[groupno].Arrive();
 
-	// If probe depleted, nothing more to do here.
-	if (hashjoinstate[threadid]->probedepleted)
-		return NULL;
+	for (unsigned int p=threadposingrp[threadid]; p<spillparts; p+=groupsize[groupno])
+	{
+		if (!sg->spilled[p])
+			continue;
 
-	// Request next page and place iterator.
-	result = probeOp->getNext(threadid);
+		SpilledPartition part;
+		for (unsigned int t=0; t<threadgroups.size(); ++t)
+		{
+			if (threadgroups[t] != groupno)
+				continue;
 
-	if (result.first == Operator::Error) {
-		throw QueryExecutionError();
+			SpillThreadState* owner = spillthreadstate[t];
+			if (owner->buildfile[p] != NULL)
+				part.build.push_back(owner->buildfile[p]);
+			if (owner->probefile[p] != NULL)
+				part.probe.push_back(owner->probefile[p]);
+			owner->buildfile[p] = NULL;
+			owner->probefile[p] = NULL;
+		}
+		ss->pending.push_back(part);
 	}
 
-	pgit.place(result.second);
-	
-	// If return code was Finished, return tuple. Otherwise, recurse. 
-	// (Rationale for recursion: Perhaps it's an empty page in a Ready stream.)
-	if (result.first == Operator::Finished) {
-		hashjoinstate[threadid]->probedepleted = true;
-		return pgit.next();
-	}
-	return readNextTupleFromProbe(threadid);
+	ss->joiningspilled = true;
+	ss->probestaging->clear();
+	hashjoinstate[threadid]->pgiter.place(ss->probestaging);
 }
 
-void HashJoinOp::threadClose(unsigned short threadid)
+bool HashJoinOp::startNextSpilledPartition(unsigned short threadid)
 {
-	if (hashjoinstate[threadid]) {
-		numadeallocate(hashjoinstate[threadid]);
-	}
-	hashjoinstate[threadid] = NULL;
+	const unsigned short groupno = threadgroups[threadid];
+	SpillThreadState* ss = spillthreadstate[threadid];
+	const unsigned int buildtuplesize = sbuild.getTupleSize();
+	const unsigned int probetuplesize = probeOp->getOutSchema().getTupleSize();
+	const unsigned int nbuckets = hashtable[groupno].getNumberOfBuckets();
 
-	if (output[threadid]) {
-		numadeallocate(output[threadid]);
+	// Release the partition that was just joined.
+	//
+	deleteSpillFiles(ss->current.build);
+	deleteSpillFiles(ss->current.probe);
+	if (ss->tableinitialized)
+	{
+		for (unsigned int b=0; b<ss->table.getNumberOfBuckets(); ++b)
+			ss->table.clearbucket(b);
+		ss->table.destroy();
+		ss->tableinitialized = false;
 	}
-	output[threadid] = NULL;
 
-	// Wait for all threads to finish, then clear buckets and destroy hashtable.
-	//
-	const unsigned short groupno = threadgroups.at(threadid);
+	while (!ss->pending.empty())
+	{
+		SpilledPartition part = ss->pending.back();
+		ss->pending.pop_back();
 
-	barriers[groupno].Arrive();
-	hashtable[groupno].bucketclear(threadposingrp.at(threadid), groupsize.at(groupno));
+		unsigned long long buildbytes = sizeOfSpillFiles(part.build);
+		if (buildbytes == 0 || sizeOfSpillFiles(part.probe) == 0)
+		{
+			deleteSpillFiles(part.build);
+			deleteSpillFiles(part.probe);
+			continue;
+		}
 
-	barriers[groupno].Arrive();
-	if (groupleader.at(groupno) == threadid)
-	{
-		hashtable[groupno].destroy();
-	}
-}
+		const unsigned int nextlevel = part.level + 1;
+		const unsigned int nextshift = nextlevel * log2spillparts;
+		Page::Iterator it;
+		void* tup;
 
-void HashJoinOp::destroy()
-{
-	buildhasher.destroy();
-	probehasher.destroy();
+		// Too large for the memory of one thread. Partition on the next
+		// hash bits, if there are bits left.
+		//
+		if (buildbytes > spillbudget / groupsize[groupno] 
+				&& nextshift < 32 && ((nbuckets - 1) >> nextshift) != 0)
+		{
+			SpilledPartition children[MAX_SPILL_PARTS];
+			for (unsigned int p=0; p<spillparts; ++p)
+			{
+				children[p].level = nextlevel;
+				children[p].build.push_back(new SpillFile());
+				children[p].build[0]->create(spilldirectory);
+				children[p].probe.push_back(new SpillFile());
+				children[p].probe[0]->create(spilldirectory);
+			}
 
-#ifdef TRACELOG
-	dbgDumpTraceToFile("hjtrace");
-#endif
+			for (unsigned int i=0; i<part.build.size(); ++i)
+			{
+				while (part.build[i]->readTuples(ss->buildstaging, buildtuplesize))
+				{
+					it.place(ss->buildstaging);
+					while ( (tup = it.next()) )
+					{
+						unsigned int p = 
+							spillPartition(densefallbackhasher.hash(tup), nextlevel);
+						children[p].build[0]->append(tup, buildtuplesize);
+					}
+				}
+			}
+
+			for (unsigned int i=0; i<part.probe.size(); ++i)
+			{
+				while (part.probe[i]->readTuples(ss->probestaging, probetuplesize))
+				{
+					it.place(ss->probestaging);
+					while ( (tup = it.next()) )
+					{
+						unsigned int p = 
+							spillPartition(probehasher.hash(tup), nextlevel);
+						children[p].probe[0]->append(tup, probetuplesize);
+					}
+				}
+			}
+
+			for (unsigned int p=0; p<spillparts; ++p)
+			{
+				children[p].build[0]->rewind();
+				children[p].probe[0]->rewind();
+				ss->pending.push_back(children[p]);
+			}
+
+			deleteSpillFiles(part.build);
+			deleteSpillFiles(part.probe);
+			ss->repartitions++;
+			continue;
+		}
+
+		// Load build side in a hash table indexed by the hash bits that 
+		// partitioning has not used.
+		//
+		ss->tableshift = (nextshift < 32) ? nextshift : 31;
+		unsigned int buckets = nbuckets >> ss->tableshift;
+		if (buckets == 0)
+			buckets = 1;
+
+		ss->table.init(buckets, buildpagesize, buildtuplesize, vector<char>(), this);
+		ss->table.bucketclear(0, 1);
+		ss->tableinitialized = true;
+
+		for (unsigned int i=0; i<part.build.size(); ++i)
+		{
+			while (part.build[i]->readTuples(ss->buildstaging, buildtuplesize))
+			{
+				it.place(ss->buildstaging);
+				while ( (tup = it.next()) )
+				{
+					unsigned int bucket = 
+						(densefallbackhasher.hash(tup) >> ss->tableshift) % buckets;
+					void* target = ss->table.allocate(bucket, this);
+					memcpy(target, tup, buildtuplesize);
+				}
+			}
+		}
+
+		ss->current = part;
+		ss->currentprobefile = 0;
+		ss->probestaging->clear();
+		hashjoinstate[threadid]->pgiter.place(ss->probestaging);
+		ss->partitionsjoined++;
+		return true;
+	}
+
+	return false;
 }
 
-void HashJoinOp::buildFromPage(Page* page, unsigned short groupno)
+void* HashJoinOp::readNextSpilledProbeTuple(unsigned short threadid)
 {
-	void* tup = NULL;
-	void* target = NULL;
-	unsigned int hashbucket;
-	Schema& buildschema = buildOp->getOutSchema();
+	SpillThreadState* ss = spillthreadstate[threadid];
+	Page::Iterator& pgit = hashjoinstate[threadid]->pgiter;
+	const unsigned int probetuplesize = probeOp->getOutSchema().getTupleSize();
 
-	Page::Iterator it = page->createIterator();
-	while( (tup = it.next()) ) {
-		// Find destination bucket.
-		hashbucket = buildhasher.hash(tup);
-		target = hashtable[groupno].atomicAllocate(hashbucket, this);
+	while (1)
+	{
+		void* tup = pgit.next();
+		if (tup != NULL)
+			return tup;
 
-		// Project on build, copy result to target.
-		sbuild.writeData(target, 0, buildschema.calcOffset(tup, joinattr1));
-		for (unsigned int j=0, buildattrtarget=0; j<projection.size(); ++j) 
+		if (ss->currentprobefile < ss->current.probe.size())
 		{
-			if (projection[j].first != BuildSide)
-				continue; 
-
-			unsigned int attr = projection[j].second;
-			sbuild.writeData(target, buildattrtarget+1,	// dest, col in output
-					buildschema.calcOffset(tup, attr));	// src 
-			buildattrtarget++;
+			SpillFile* f = ss->current.probe[ss->currentprobefile];
+			if (f->readTuples(ss->probestaging, probetuplesize) == 0)
+				ss->currentprobefile++;
+			pgit.place(ss->probestaging);
+			continue;
 		}
+
+		if (!startNextSpilledPartition(threadid))
+			return NULL;
 	}
 }
 
@@ -678,6 +1861,12 @@ void SortMergeJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 {
 	JoinOp::init(root, node);
 
+	// Build tuples are copied when buffered, so there is no stable row to
+	// point to.
+	//
+	if (projectsRowPointer())
+		throw InvalidParameter();
+
 	// Populate group->thread mapping.
 	//
 	libconfig::Setting& partnode = node["threadgroups"];
@@ -695,40 +1884,35 @@ void SortMergeJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 		}
 	}
 
-	// Compute max size of staging area used for sorting inputs/outputs.
+	// Inputs are staged in segments that are added as input arrives. The
+	// optional maxbuildtuples and maxprobetuples hints only size the 
+	// segments.
 	//
-	unsigned long maxbuildtuples;
-	if (node.exists("maxbuildtuplesinM"))
-	{
-		maxbuildtuples = node["maxbuildtuplesinM"];
-		maxbuildtuples *= 1024 * 1024;
-	}
-	else
-	{
-		maxbuildtuples = node["maxbuildtuples"];
-	}
-
-	unsigned long maxprobetuples;
-	if (node.exists("maxprobetuplesinM"))
-	{
-		maxprobetuples = node["maxprobetuplesinM"];
-		maxprobetuples *= 1024 * 1024;
-	}
-	else
-	{
-		maxprobetuples = node["maxprobetuples"];
-	}
-
 	int totalthreads = 0;
 	for (unsigned int i=0; i<groupsize.size(); ++i)
 		totalthreads += groupsize[i];
 
-	// Allow for a per-thread variance of 20 buffers + 30% of input size.
+	buildsegmentsize = stagingSegmentSize(node, "maxbuildtuples",
+			buildOp->getOutSchema().getTupleSize(), totalthreads);
+	probesegmentsize = stagingSegmentSize(node, "maxprobetuples",
+			probeOp->getOutSchema().getTupleSize(), totalthreads);
+
+	// Can the build side spill to disk?
 	//
-	perthreadbuildtuples = 20 * buffsize/buildOp->getOutSchema().getTupleSize() 
-		+ (maxbuildtuples * 1.3 / totalthreads);
-	perthreadprobetuples = 20 * buffsize/probeOp->getOutSchema().getTupleSize()
-		+ (maxprobetuples * 1.3 / totalthreads);
+	if (node.exists("spill"))
+	{
+		libconfig::Setting& spillnode = node["spill"];
+		int budgetinM = spillnode["memoryinM"];
+		if (budgetinM <= 0)
+			throw InvalidParameter();
+
+		usespill = true;
+		spillbudget = budgetinM * 1024uLL * 1024uLL;
+		spilldirectory = "/tmp";
+		spillnode.lookupValue("directory", spilldirectory);
+
+		buildsegmentsize = std::min(buildsegmentsize, spillbudget);
+	}
 
 	// Create comparators.
 	//
@@ -745,6 +1929,23 @@ void SortMergeJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 			buildOp->getOutSchema(), joinattr1,
 			Comparator::Equal);
 
+	// Composite keys are compared column by column. Sorted runs on disk are
+	// merged on a single column, so composite keys cannot spill.
+	//
+	if (compositeKey())
+	{
+		if (usespill)
+			throw InvalidParameter();
+
+		vector<unsigned short> buildattrs(joinattrs1.begin(), joinattrs1.end());
+		vector<unsigned short> probeattrs(joinattrs2.begin(), joinattrs2.end());
+		vector<bool> ascending(buildattrs.size(), true);
+		buildkey.init(buildOp->getOutSchema(), buildattrs, ascending);
+		probekey.init(probeOp->getOutSchema(), probeattrs, ascending);
+		probebuildkey.init(probeOp->getOutSchema(), probeattrs,
+				buildOp->getOutSchema(), buildattrs);
+	}
+
 	// Is any input already sorted?
 	//
 	buildpresorted = false;
@@ -761,14 +1962,41 @@ void SortMergeJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 		probepresorted = (str == "yes");
 	}
 
+	// Composite keys are always sorted by comparison.
+	//
+	sortalgo = parseSortAlgorithm(node);
+	if (compositeKey() && sortalgo != TupleBuffer::ComparisonSort)
+		throw InvalidParameter();
+
 	// Is build prepartitioned?
 	//
+	prepartsampled = false;
 	if (node.exists("buildprepartitioned"))
 	{
-		int min = node["buildprepartitioned"]["range"][0];
-		int max = node["buildprepartitioned"]["range"][1];
-		int buckets = node["buildprepartitioned"]["buckets"];
-		prepartfn = ExactRangeValueHasher(min, max, buckets);
+		libconfig::Setting& prepart = node["buildprepartitioned"];
+		int buckets = prepart["buckets"];
+
+		// If the build side has been partitioned on sampled splitters, the
+		// partition ranges are not known until the build side has been
+		// buffered. Only the number of partitions is kept in prepartfn.
+		//
+		string splitters = "range";
+		prepart.lookupValue("splitters", splitters);
+		if (splitters == "sampled")
+		{
+			prepartsampled = true;
+			prepartfn = ExactRangeValueHasher(0, buckets-1, buckets);
+		}
+		else if (splitters == "range")
+		{
+			int min = prepart["range"][0];
+			int max = prepart["range"][1];
+			prepartfn = ExactRangeValueHasher(min, max, buckets);
+		}
+		else
+		{
+			throw InvalidParameter();
+		}
 	}
 
 	// Create state, output and build/probe staging areas.
@@ -779,6 +2007,7 @@ void SortMergeJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 		sortmergejoinstate.push_back(NULL);
 		buildpage.push_back(NULL);
 		probepage.push_back(NULL);
+		buildmerger.push_back(NULL);
 	}
 }
 
@@ -797,13 +2026,15 @@ void SortMergeJoinOp::threadInit(unsigned short threadid)
 	probetuplesize = probeOp->getOutSchema().getTupleSize();
 
 
+	// Pages are replaced by pages that fit the input in BufferAndSort.
+	//
 	space = numaallocate_local("SMJb", sizeof(Page), this);
 	buildpage[threadid] = new (space) 
-		Page(perthreadbuildtuples*buildtuplesize, buildtuplesize, this, "SMJb");
+		Page(buildtuplesize, buildtuplesize, this, "SMJb");
 	
 	space = numaallocate_local("SMJp", sizeof(Page), this);
 	probepage[threadid] = new (space) 
-		Page(perthreadprobetuples*probetuplesize, probetuplesize, this, "SMJp");
+		Page(probetuplesize, probetuplesize, this, "SMJp");
 	
 	space = numaallocate_local("SMJo", sizeof(Page), this);
 	output[threadid] = new (space) Page(buffsize, schema.getTupleSize(), this, "SMJo");
@@ -816,12 +2047,16 @@ void SortMergeJoinOp::threadClose(unsigned short threadid)
 	}
 	sortmergejoinstate[threadid] = NULL;
 
+	destroyBuildMerger(threadid);
+
 	if (buildpage[threadid]) {
+		buildpage[threadid]->~Page();
 		numadeallocate(buildpage[threadid]);
 	}
 	buildpage[threadid] = NULL;
 
 	if (probepage[threadid]) {
+		probepage[threadid]->~Page();
 		numadeallocate(probepage[threadid]);
 	}
 	probepage[threadid] = NULL;
@@ -839,11 +2074,17 @@ namespace {
 
 /**
  * Copies all tuples from source operator \a op into staging area \a page.
+ * Tuples are buffered in segments of \a segmentsize bytes, which are then
+ * compacted into \a page, replacing it if it is too small.
  * Assumes operator has scan-started successfully for this threadid.
  * Error handling is non-existant, asserts if anything is not expected.
  */
-void copySourceIntoPage(Operator* op, Operator::Page* page, unsigned short threadid)
+void copySourceIntoPage(Operator* op, Operator::Page*& page, unsigned short threadid,
+		unsigned long long segmentsize, const char tag[4], void* allocsource)
 {
+	unsigned int tuplesize = op->getOutSchema().getTupleSize();
+	SegmentedTupleBuffer staging(segmentsize, tuplesize, allocsource, tag);
+
 	Operator::GetNextResultT result;
 	result.first = Operator::Ready;
 
@@ -857,13 +2098,12 @@ void copySourceIntoPage(Operator* op, Operator::Page* page, unsigned short threa
 		if (datastart == 0)
 			continue;
 
-		unsigned int datasize = result.second->getUsedSpace();
-		void* space = page->allocate(datasize);
-		assert(space != NULL);
-		memcpy(space, datastart, datasize);
+		staging.append(datastart, result.second->getUsedSpace());
 	}
 
 	assert(result.first == Operator::Finished);
+
+	moveIntoPage(staging, page, tuplesize, tag, allocsource);
 }
 
 void verifysorted(Operator::Page* page, Schema& schema, unsigned int joinattr)
@@ -890,27 +2130,53 @@ void verifysorted(Operator::Page* page, Schema& schema, unsigned int joinattr)
 /**
  * Sorts all tuples in given page.
  */
-void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr)
+void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr,
+		TupleBuffer::SortAlgorithm algo)
 {
 	unsigned int keyoffset = (unsigned long long)schema.calcOffset(0, joinattr);
 
 	switch(schema.getColumnType(joinattr))
 	{
 		case CT_INTEGER:
-			page->sort<CtInt>(keyoffset);
+			page->sort<CtInt>(keyoffset, algo);
 			break;
 		case CT_LONG:
 		case CT_DATE:
-			page->sort<CtLong>(keyoffset);
+			page->sort<CtLong>(keyoffset, algo);
 			break;
 		case CT_DECIMAL:
-			page->sort<CtDecimal>(keyoffset);
+			page->sort<CtDecimal>(keyoffset, algo);
 			break;
 		default:
 			throw NotYetImplemented();
 	}
 }
 
+/**
+ * Orders tuples on a composite key, for TupleBuffer::sortby().
+ */
+class CompositeKeyOrder
+{
+	public:
+		CompositeKeyOrder(const KeyComparator& c) : cmp(c) { }
+
+		inline bool operator()(void* l, void* r) const
+		{
+			return cmp.less(l, r);
+		}
+
+	private:
+		const KeyComparator& cmp;
+};
+
+/**
+ * Sorts all tuples in given page on composite key \a key.
+ */
+void sortAllInPage(Operator::Page* page, const KeyComparator& key)
+{
+	page->sortby(CompositeKeyOrder(key));
+}
+
 /**
  * Returns smallest tuple index for given value. 
  * \pre Page must be sorted on \a joinattr.
@@ -950,21 +2216,27 @@ void SortMergeJoinOp::BufferAndSort(unsigned short threadid,
 
 	// Copy build side chunks into staging area, buildpage[threadid].
 	//
+	threadstate->buildusedbytes = 0;
+	threadstate->buildrunsspilled = 0;
 	assert(Ready == buildOp->scanStart(threadid, indexdatapage, indexdataschema));
-	copySourceIntoPage(buildOp, buildpage[threadid], threadid);
+	if (usespill)
+		bufferBuildWithSpill(threadid);
+	else
+		copySourceIntoPage(buildOp, buildpage[threadid], threadid, 
+				buildsegmentsize, "SMJb", this);
 	assert(Ready == buildOp->scanStop(threadid));
-	threadstate->buildusedbytes = buildpage[threadid]->getUsedSpace();
+	threadstate->buildusedbytes += buildpage[threadid]->getUsedSpace();
 	
-	// Sort build side.
+	// Sort build side, unless it has been sorted in runs on disk.
 	//
-	if (buildpresorted == false)
+	if (buildpresorted == false && buildmerger[threadid] == NULL)
 	{
 		startTimer(&threadstate->buildsortcycles);
-#ifdef BITONIC_SORT
-		buildpage[threadid]->bitonicsort();
-#else
-		sortAllInPage(buildpage[threadid], buildOp->getOutSchema(), joinattr1);
-#endif
+		if (compositeKey())
+			sortAllInPage(buildpage[threadid], buildkey);
+		else
+			sortAllInPage(buildpage[threadid], buildOp->getOutSchema(), 
+					joinattr1, sortalgo);
 		stopTimer(&threadstate->buildsortcycles);
 	}
 #ifdef DEBUG
@@ -974,7 +2246,8 @@ void SortMergeJoinOp::BufferAndSort(unsigned short threadid,
 	// Copy probe side chunks into staging area, probepage[threadid].
 	//
 	assert(Ready == probeOp->scanStart(threadid, indexdatapage, indexdataschema));
-	copySourceIntoPage(probeOp, probepage[threadid], threadid);
+	copySourceIntoPage(probeOp, probepage[threadid], threadid, 
+			probesegmentsize, "SMJp", this);
 	assert(Ready == probeOp->scanStop(threadid));
 	threadstate->probeusedbytes = probepage[threadid]->getUsedSpace();
 
@@ -983,11 +2256,11 @@ void SortMergeJoinOp::BufferAndSort(unsigned short threadid,
 	if (probepresorted == false)
 	{
 		startTimer(&threadstate->probesortcycles);
-#ifdef BITONIC_SORT
-		probepage[threadid]->bitonicsort();
-#else
-		sortAllInPage(probepage[threadid], probeOp->getOutSchema(), joinattr2);
-#endif
+		if (compositeKey())
+			sortAllInPage(probepage[threadid], probekey);
+		else
+			sortAllInPage(probepage[threadid], probeOp->getOutSchema(), 
+					joinattr2, sortalgo);
 		stopTimer(&threadstate->probesortcycles);
 	}
 #ifdef DEBUG
@@ -1015,7 +2288,7 @@ Operator::ResultCode SortMergeJoinOp::scanStart(unsigned short threadid,
 	startTimer(&threadstate->setitercycles);
 	Page::Iterator iter(buildpage[threadid]->createIterator());
 	threadstate->builditer = iter;
-	threadstate->buildtup  = threadstate->builditer.next();
+	threadstate->buildtup  = nextBuildTuple(threadid);
 	threadstate->probepageidxmax = grouptothreads.at(groupno).size();
 
 	threadstate->probetuplesread = 0;
@@ -1031,8 +2304,9 @@ Operator::ResultCode SortMergeJoinOp::scanStart(unsigned short threadid,
 			assert(prepartfn.buckets() == threadstate->probepageidxmax);
 			dbgassert(threadid < prepartfn.buckets());
 
-			CtLong minvalincl = prepartfn.minimumforbucket(threadid);
-			CtLong maxvalexcl = prepartfn.minimumforbucket(threadid+1);
+			CtLong minvalincl;
+			CtLong maxvalexcl;
+			prepartitionedRange(threadid, minvalincl, maxvalexcl);
 			unsigned int mintidincl = 
 				findInPage(p, probeOp->getOutSchema(), joinattr2, minvalincl);
 			unsigned int maxtidexcl = 
@@ -1055,6 +2329,41 @@ Operator::ResultCode SortMergeJoinOp::scanStart(unsigned short threadid,
 	return Ready;
 }
 
+void SortMergeJoinOp::prepartitionedRange(unsigned short threadid, 
+		CtLong& minvalincl, CtLong& maxvalexcl)
+{
+	if (!prepartsampled)
+	{
+		minvalincl = prepartfn.minimumforbucket(threadid);
+		maxvalexcl = prepartfn.minimumforbucket(threadid+1);
+		return;
+	}
+
+	// Partition ranges are unknown, but the build side of this thread is 
+	// sorted and holds one partition. Probe tuples outside the range of 
+	// build keys will not produce output.
+	//
+	if (buildmerger[threadid] != NULL)
+	{
+		minvalincl = sortmergejoinstate[threadid]->spilledminkey;
+		maxvalexcl = sortmergejoinstate[threadid]->spilledmaxkey + 1;
+		return;
+	}
+
+	Page* p = buildpage[threadid];
+	Schema& s = buildOp->getOutSchema();
+	unsigned int tuplesize = s.getTupleSize();
+	if (p->getUsedSpace() == 0)
+	{
+		minvalincl = 0;
+		maxvalexcl = 0;
+		return;
+	}
+	unsigned int lasttuple = p->getUsedSpace() / tuplesize - 1;
+	minvalincl = keyAsLong(s, p->getTupleOffset(0), joinattr1);
+	maxvalexcl = keyAsLong(s, p->getTupleOffset(lasttuple), joinattr1) + 1;
+}
+
 Operator::GetNextResultT SortMergeJoinOp::getNext(unsigned short threadid)
 {
 	void* buildtup = NULL;
@@ -1085,7 +2394,7 @@ Operator::GetNextResultT SortMergeJoinOp::getNext(unsigned short threadid)
 			void* probetup = state->probetups[i];
 
 			while ((probetup != NULL) 
-					&& (probekeylessthanbuildkey.eval(probetup, buildtup)))
+					&& (probeKeyLessThanBuildKey(probetup, buildtup)))
 			{
 				// Skip tuples if probe side key less than build side key. 
 				//
@@ -1094,7 +2403,7 @@ Operator::GetNextResultT SortMergeJoinOp::getNext(unsigned short threadid)
 			}
 
 			if ((probetup != NULL) 
-					&& (probekeyequalsbuildkey.eval(probetup, buildtup)))
+					&& (probeKeyEqualsBuildKey(probetup, buildtup)))
 			{
 				// If keys match, join tuples and write to the output.
 				//
@@ -1111,7 +2420,7 @@ Operator::GetNextResultT SortMergeJoinOp::getNext(unsigned short threadid)
 				// this probe staging area.
 				//
 				dbgassert( (state->probetups[i] == NULL) 
-						|| (probekeylessthanbuildkey.eval(state->probetups[i], buildtup) == false) );
+						|| (probeKeyLessThanBuildKey(state->probetups[i], buildtup) == false) );
 
 				// Break to outer loop but do not advance build iterator. 
 				// This will guard that there is enough space in the 
@@ -1142,8 +2451,8 @@ Operator::GetNextResultT SortMergeJoinOp::getNext(unsigned short threadid)
 			for (unsigned int i=0; i<state->probepageidxmax; ++i)
 			{
 				assert( (state->probetups[i] == NULL) 
-						|| ( (probekeylessthanbuildkey.eval(state->probetups[i], buildtup) == false)
-							&& (probekeyequalsbuildkey.eval(state->probetups[i], buildtup) == false) 
+						|| ( (probeKeyLessThanBuildKey(state->probetups[i], buildtup) == false)
+							&& (probeKeyEqualsBuildKey(state->probetups[i], buildtup) == false) 
 							) 
 						);
 			}
@@ -1152,14 +2461,14 @@ Operator::GetNextResultT SortMergeJoinOp::getNext(unsigned short threadid)
 			// Advance build iterator.
 			//
 			void* oldbuildtup = buildtup;
-			buildtup = state->builditer.next();
+			buildtup = nextBuildTuple(threadid);
 			state->probepageidx = 0;
 
 			// If new key equals old key, reposition all current probe
 			// iterators on the start of this key (old iterator set).
 			//
 			if ((buildtup != NULL) 
-					&& (buildkeyequalsbuildkey.eval(oldbuildtup, buildtup)))
+					&& (buildKeyEqualsBuildKey(oldbuildtup, buildtup)))
 			{
 				for (unsigned int i=0; i<state->probepageidxmax; ++i)
 				{
@@ -1186,6 +2495,7 @@ Operator::ResultCode SortMergeJoinOp::scanStop(unsigned short threadid)
 	// 
 	buildpage[threadid]->clear();
 	probepage[threadid]->clear();
+	destroyBuildMerger(threadid);
 	
 	return Ready;
 }
@@ -1194,10 +2504,117 @@ void SortMergeJoinOp::destroy()
 {
 }
 
+void SortMergeJoinOp::bufferBuildWithSpill(unsigned short threadid)
+{
+	SortMergeState* state = sortmergejoinstate[threadid];
+	unsigned int tuplesize = buildOp->getOutSchema().getTupleSize();
+	SegmentedTupleBuffer staging(buildsegmentsize, tuplesize, this, "SMJb");
+	vector<SpillFile*> runs;
+
+	GetNextResultT result;
+	result.first = Ready;
+
+	while (result.first == Ready)
+	{
+		result = buildOp->getNext(threadid);
+		assert(result.first != Error);
+
+		void* datastart = result.second->getTupleOffset(0);
+		if (datastart == 0)
+			continue;
+
+		// Buffer up to the memory limit, then sort the buffered tuples and
+		// write them as a new run.
+		//
+		unsigned int datasize = result.second->getUsedSpace();
+		if (staging.getUsedSpace() + datasize > spillbudget)
+		{
+			moveIntoPage(staging, buildpage[threadid], tuplesize, "SMJb", this);
+			spillBuildRun(threadid, runs);
+		}
+
+		staging.append(datastart, datasize);
+	}
+
+	assert(result.first == Finished);
+
+	moveIntoPage(staging, buildpage[threadid], tuplesize, "SMJb", this);
+
+	if (runs.empty())
+		return;
+
+	// The rest of the input becomes the last run.
+	//
+	spillBuildRun(threadid, runs);
+
+	Comparator less = Schema::createComparator(
+			buildOp->getOutSchema(), joinattr1,
+			buildOp->getOutSchema(), joinattr1,
+			Comparator::Less);
+	void* space = numaallocate_local("SMJm", sizeof(SortedRunMerger), this);
+	buildmerger[threadid] = new (space) SortedRunMerger();
+	buildmerger[threadid]->init(runs, tuplesize, less, buffsize, this);
+	state->buildrunsspilled = runs.size();
+}
+
+void SortMergeJoinOp::spillBuildRun(unsigned short threadid, 
+		vector<SpillFile*>& runs)
+{
+	SortMergeState* state = sortmergejoinstate[threadid];
+	Page* page = buildpage[threadid];
+	Schema& s = buildOp->getOutSchema();
+
+	if (page->getUsedSpace() == 0)
+		return;
+
+	if (buildpresorted == false)
+	{
+		unsigned long long cycles;
+		startTimer(&cycles);
+		sortAllInPage(page, s, joinattr1, sortalgo);
+		stopTimer(&cycles);
+		state->buildsortcycles += cycles;
+	}
+
+	// Remember the range of keys, for prepartitionedRange().
+	//
+	if (prepartsampled)
+	{
+		unsigned int lasttuple = page->getUsedSpace() / s.getTupleSize() - 1;
+		CtLong first = keyAsLong(s, page->getTupleOffset(0), joinattr1);
+		CtLong last = keyAsLong(s, page->getTupleOffset(lasttuple), joinattr1);
+		if (runs.empty() || first < state->spilledminkey)
+			state->spilledminkey = first;
+		if (runs.empty() || last > state->spilledmaxkey)
+			state->spilledmaxkey = last;
+	}
+
+	SpillFile* file = new SpillFile();
+	file->create(spilldirectory);
+	file->append(page->getTupleOffset(0), page->getUsedSpace());
+	file->rewind();
+	runs.push_back(file);
+
+	state->buildusedbytes += page->getUsedSpace();
+	page->clear();
+}
+
+void SortMergeJoinOp::destroyBuildMerger(unsigned short threadid)
+{
+	if (buildmerger[threadid] == NULL)
+		return;
+
+	buildmerger[threadid]->destroy();
+	buildmerger[threadid]->~SortedRunMerger();
+	numadeallocate(buildmerger[threadid]);
+	buildmerger[threadid] = NULL;
+}
+
 SortMergeJoinOp::SortMergeState::SortMergeState() 
 	: buildsortcycles(0), buildusedbytes(0), 
 	  probesortcycles(0), probeusedbytes(0), probetuplesread(0), 
-	  setitercycles(0), buildtup(NULL), 
+	  setitercycles(0), buildrunsspilled(0), spilledminkey(0), 
+	  spilledmaxkey(0), buildtup(NULL), 
 	  probepageidx(0), probepageidxmax(0)
 {
 }
@@ -1263,7 +2680,7 @@ Operator::GetNextResultT OldMPSMJoinOp::getNext(unsigned short threadid)
 		void* probetup = state->probetups[i];
 
 		while ((probetup != NULL) 
-				&& (probekeylessthanbuildkey.eval(probetup, buildtup)))
+				&& (probeKeyLessThanBuildKey(probetup, buildtup)))
 		{
 			// Skip probe tuples if probe side key less than probe side key. 
 			//
@@ -1276,7 +2693,7 @@ Operator::GetNextResultT OldMPSMJoinOp::getNext(unsigned short threadid)
 		}
 
 		if ((probetup != NULL) 
-				&& (probekeyequalsbuildkey.eval(probetup, buildtup)))
+				&& (probeKeyEqualsBuildKey(probetup, buildtup)))
 		{
 			// If keys match, join tuples and write to the output.
 			//
@@ -1293,7 +2710,7 @@ Operator::GetNextResultT OldMPSMJoinOp::getNext(unsigned short threadid)
 			// this probe staging area.
 			//
 			dbgassert( (state->probetups[i] == NULL) 
-					|| (probekeylessthanbuildkey.eval(state->probetups[i], buildtup) == false) );
+					|| (probeKeyLessThanBuildKey(state->probetups[i], buildtup) == false) );
 
 			// Break to outer loop to check that there is enough 
 			// space in the output buffer before continuing.
@@ -1320,12 +2737,12 @@ Operator::GetNextResultT OldMPSMJoinOp::getNext(unsigned short threadid)
 			buildtup = state->buildtup;
 		} while ((probetup != NULL) 
 				&& (buildtup != NULL)
-				&& (buildkeyequalsbuildkey.eval(oldbuildtup, buildtup) == false)
-				&& (buildkeylessthanprobekey.eval(buildtup, probetup))
+				&& (buildKeyEqualsBuildKey(oldbuildtup, buildtup) == false)
+				&& (buildKeyLessThanProbeKey(buildtup, probetup))
 				);
 
 		if ((buildtup != NULL) 
-				&& (buildkeyequalsbuildkey.eval(oldbuildtup, buildtup)))
+				&& (buildKeyEqualsBuildKey(oldbuildtup, buildtup)))
 		{
 			// 1.
 			// If new key equals old key, reposition current probe
@@ -1374,6 +2791,11 @@ void OldMPSMJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 {
 	SortMergeJoinOp::init(root, node);
 
+	// The build side is accessed in place, so it cannot spill.
+	//
+	if (usespill)
+		throw InvalidParameter();
+
 	buildkeylessthanprobekey = Schema::createComparator(
 			buildOp->getOutSchema(), joinattr1,
 			probeOp->getOutSchema(), joinattr2,
@@ -1384,6 +2806,11 @@ void MPSMJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
 {
 	SortMergeJoinOp::init(root, node);
 
+	// The build side is accessed in place, so it cannot spill.
+	//
+	if (usespill)
+		throw InvalidParameter();
+
 	fakebuildop.schema = buildOp->getOutSchema();
 	fakeprobeop.schema = probeOp->getOutSchema();
 	mergejoinop.buildOp = &fakebuildop;
@@ -1455,8 +2882,9 @@ Operator::ResultCode MPSMJoinOp::scanStart(unsigned short threadid,
 			assert(prepartfn.buckets() == tids.size());
 			dbgassert(threadid < prepartfn.buckets());
 
-			CtLong minvalincl = prepartfn.minimumforbucket(threadid);
-			CtLong maxvalexcl = prepartfn.minimumforbucket(threadid+1);
+			CtLong minvalincl;
+			CtLong maxvalexcl;
+			prepartitionedRange(threadid, minvalincl, maxvalexcl);
 			unsigned int mintidincl = 
 				findInPage(p, probeOp->getOutSchema(), joinattr2, minvalincl);
 			unsigned int maxtidexcl = 
@@ -1559,6 +2987,12 @@ void PresortedPrepartitionedMergeJoinOp::init(libconfig::Config& root, libconfig
 {
 	JoinOp::init(root, node);
 
+	// Build tuples are copied when buffered, so there is no stable row to
+	// point to.
+	//
+	if (projectsRowPointer())
+		throw InvalidParameter();
+
 	/*
 	 * Not true if called from within MPSM.
 	 *
@@ -1592,6 +3026,16 @@ void PresortedPrepartitionedMergeJoinOp::init(libconfig::Config& root, libconfig
 			probeOp->getOutSchema(), joinattr2,
 			Comparator::Equal);
 
+	if (compositeKey())
+	{
+		vector<unsigned short> buildattrs(joinattrs1.begin(), joinattrs1.end());
+		vector<unsigned short> probeattrs(joinattrs2.begin(), joinattrs2.end());
+		vector<bool> ascending(buildattrs.size(), true);
+		buildkey.init(buildOp->getOutSchema(), buildattrs, ascending);
+		buildprobekey.init(buildOp->getOutSchema(), buildattrs,
+				probeOp->getOutSchema(), probeattrs);
+	}
+
 	// Create state, output and build/probe staging areas.
 	//
 	for (int i=0; i<MAX_THREADS; ++i) 
@@ -1796,7 +3240,7 @@ bool PresortedPrepartitionedMergeJoinOp::populateBuffer(unsigned short threadid)
 
 		src = readBuildTuple(threadid);
 	} 
-	while (buildkeyequalsbuildkey.eval(buf->getTupleOffset(0), src));
+	while (buildKeyEqualsBuildKey(buf->getTupleOffset(0), src));
 
 #ifdef DEBUG
 	assert(buf->getTupleOffset(0) != NULL);
@@ -1804,7 +3248,7 @@ bool PresortedPrepartitionedMergeJoinOp::populateBuffer(unsigned short threadid)
 	void* tup;
 	while ( (tup = it.next()) )
 	{
-		assert(buildkeyequalsbuildkey.eval(buf->getTupleOffset(0), tup));
+		assert(buildKeyEqualsBuildKey(buf->getTupleOffset(0), tup));
 	}
 #endif
 	return ret;
@@ -1839,7 +3283,7 @@ bool PresortedPrepartitionedMergeJoinOp::advanceIteratorsAndPopulateBuffer(unsig
 	// Is key the same as in build buffer? If yes, return true.
 	//
 	tupinbuf = buf->getTupleOffset(0);
-	if ((tupinbuf != NULL) && (buildkeyequalsprobekey.eval(tupinbuf, probe)))
+	if ((tupinbuf != NULL) && (buildKeyEqualsProbeKey(tupinbuf, probe)))
 	{
 		goto exit;
 	}
@@ -1864,12 +3308,12 @@ bool PresortedPrepartitionedMergeJoinOp::advanceIteratorsAndPopulateBuffer(unsig
 
 	// While keys are not equal, ...
 	//
-	while (buildkeyequalsprobekey.eval(build, probe) == false)
+	while (buildKeyEqualsProbeKey(build, probe) == false)
 	{
 		// ... advance either build or probe, depending which has lower value.
 		// If either depleted, stop; we're done.
 		//
-		if (buildkeylessthanprobekey.eval(build, probe) == true)
+		if (buildKeyLessThanProbeKey(build, probe) == true)
 		{
 			hasmore = advanceBuild(threadid);
 			if (!hasmore)
@@ -1904,7 +3348,7 @@ exit:
 	probe = readProbeTuple(threadid);
 	assert(tupinbuf != NULL);
 	assert(probe != NULL);
-	assert(buildkeyequalsprobekey.eval(tupinbuf, probe));
+	assert(buildKeyEqualsProbeKey(tupinbuf, probe));
 #endif
 	return true;
 
@@ -0,0 +1,268 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "operators.h"
+#include "operators_priv.h"
+
+#include "../util/numaallocate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+using std::make_pair;
+using std::ostringstream;
+
+static Operator::Page* NullPage = 0;
+
+LikeFilter::Segment LikeFilter::makeSegment(const string& text)
+{
+	LikeFilter::Segment ret;
+	ret.text = text;
+	ret.wildcards = (text.find('_') != string::npos);
+	return ret;
+}
+
+void LikeFilter::init(libconfig::Config& root, libconfig::Setting& cfg)
+{
+	MapWrapper::init(root, cfg);	//< calls LikeFilter::mapinit below
+
+	fieldno = (int) cfg["field"];
+	if (fieldno >= schema.columns() || schema.getColumnType(fieldno) != CT_CHAR)
+		throw IllegalSchemaDeclarationException();
+
+	string tmpstr = cfg["pattern"];
+	pattern = tmpstr;
+
+	// Split the pattern at every "%".
+	//
+	vector<string> parts;
+	size_t start = 0;
+	size_t end;
+	while ((end = pattern.find('%', start)) != string::npos)
+	{
+		parts.push_back(pattern.substr(start, end - start));
+		start = end + 1;
+	}
+	parts.push_back(pattern.substr(start));
+
+	exact = (parts.size() == 1);
+	prefix = makeSegment(parts.front());
+	suffix = makeSegment(exact ? string() : parts.back());
+	for (unsigned int i=1; i+1<parts.size(); ++i)
+	{
+		if (!parts[i].empty())
+			middle.push_back(makeSegment(parts[i]));
+	}
+
+	isa = strKernelDetectIsa();
+
+	ostringstream oss;
+	oss << "LikeFilter: $" << fieldno + 1 << " like '" << pattern << "'";
+	description = oss.str();
+
+	for (int i=0; i<MAX_THREADS; ++i)
+	{
+		positions.push_back(NULL);
+	}
+}
+
+void LikeFilter::mapinit(Schema& schema)
+{
+	schema = nextOp->getOutSchema();
+}
+
+void LikeFilter::threadInit(unsigned short threadid)
+{
+	MapWrapper::threadInit(threadid);
+
+	void* space = numaallocate_local("LkFp", BatchSize * sizeof(unsigned int), this);
+	positions[threadid] = reinterpret_cast<unsigned int*>(space);
+}
+
+void LikeFilter::threadClose(unsigned short threadid)
+{
+	if (positions[threadid]) {
+		numadeallocate(positions[threadid]);
+	}
+	positions[threadid] = NULL;
+
+	MapWrapper::threadClose(threadid);
+}
+
+bool LikeFilter::matchesAt(const Segment& seg, const char* value)
+{
+	if (!seg.wildcards)
+		return memcmp(value, seg.text.data(), seg.text.size()) == 0;
+
+	for (size_t i=0; i<seg.text.size(); ++i)
+	{
+		if (seg.text[i] != '_' && seg.text[i] != value[i])
+			return false;
+	}
+	return true;
+}
+
+int LikeFilter::find(const Segment& seg, const char* value, size_t len)
+{
+	if (!seg.wildcards)
+		return strfind(value, len, seg.text.data(), seg.text.size(), isa);
+
+	for (size_t i=0; i + seg.text.size() <= len; ++i)
+	{
+		if (matchesAt(seg, value + i))
+			return i;
+	}
+	return -1;
+}
+
+bool LikeFilter::matches(const char* value, size_t len)
+{
+	if (exact)
+		return len == prefix.text.size() && matchesAt(prefix, value);
+
+	if (len < prefix.text.size() + suffix.text.size())
+		return false;
+	if (!matchesAt(prefix, value))
+		return false;
+	if (!matchesAt(suffix, value + len - suffix.text.size()))
+		return false;
+
+	// Find the middle parts in order, each as early as possible, between
+	// the prefix and the suffix.
+	//
+	size_t pos = prefix.text.size();
+	const size_t end = len - suffix.text.size();
+	for (unsigned int i=0; i<middle.size(); ++i)
+	{
+		int found = find(middle[i], value + pos, end - pos);
+		if (found < 0)
+			return false;
+		pos += found + middle[i].text.size();
+	}
+	return true;
+}
+
+unsigned int LikeFilter::select(const char* first, unsigned int count, 
+		unsigned int* positions)
+{
+	const unsigned int stride = schema.getTupleSize();
+	const unsigned int fieldsize = schema.get(fieldno).size;
+	const char* field = reinterpret_cast<const char*>(
+			schema.calcOffset(const_cast<char*>(first), fieldno));
+
+	unsigned int matched = 0;
+	for (unsigned int i=0; i<count; ++i)
+	{
+		const char* value = field + i * stride;
+		if (matches(value, strnlen(value, fieldsize)))
+			positions[matched++] = i;
+	}
+	return matched;
+}
+
+// Copy-paste from MapWrapper, filtering a batch of tuples at a time.
+//
+Operator::GetNextResultT LikeFilter::getNext(unsigned short threadid)
+{
+	Page* in;
+	Operator::ResultCode rc;
+	unsigned int tupoffset;
+
+	Page* out = output[threadid];
+	unsigned int* pos = positions[threadid];
+	out->clear();
+
+	const unsigned int tuplesize = schema.getTupleSize();
+	const unsigned int outcapacity = out->capacity() / tuplesize;
+
+	// Recover state information and start.
+	// 
+	in = state[threadid].input;
+	rc = state[threadid].prevresult;
+	tupoffset = state[threadid].prevoffset;
+
+	while (rc != Error) 
+	{
+		dbgassert(rc != Error);
+		dbgassert(in != NULL);
+
+		unsigned int intuples = in->getNumTuples();
+
+		while (tupoffset < intuples)
+		{
+			// Every tuple of the batch fits in the output if all match.
+			//
+			unsigned int count = intuples - tupoffset;
+			count = std::min(count, outcapacity - (unsigned int) out->getNumTuples());
+			count = std::min(count, BatchSize);
+
+			const char* first = 
+				reinterpret_cast<const char*>(in->getTupleOffset(tupoffset));
+			unsigned int matched = select(first, count, pos);
+
+			for (unsigned int i=0; i<matched; ++i)
+			{
+				void* dest = out->allocateTuple();
+				dbgassert(out->isValidTupleAddress(dest));
+				schema.copyTuple(dest, first + pos[i] * tuplesize);
+			}
+			tupoffset += count;
+
+			// If output buffer full, record state and return.
+			// 
+			if (!out->canStoreTuple()) 
+			{
+				state[threadid] = State(in, rc, tupoffset);
+				return make_pair(Ready, out);
+			}
+		}
+
+		// If input source depleted, remove state information and return.
+		//
+		if (rc == Finished) 
+		{
+			state[threadid] = State(&EmptyPage, Finished, 0);
+			return make_pair(Finished, out);
+		}
+
+		// Read more input.
+		//
+		Operator::GetNextResultT result = nextOp->getNext(threadid);
+		rc = result.first;
+		in = result.second;
+		tupoffset = 0;
+	}
+
+	state[threadid] = State(NullPage, Error, 0);
+	return make_pair(Error, NullPage);	// Reached on Error
+}
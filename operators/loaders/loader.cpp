@@ -70,6 +70,7 @@ typedef ParallelQueue<ParseWorkT*, QueueSize> WorkQueueT;
 struct ThreadArg
 {
 	Schema* schema;
+	StringHeap* heap;
 	Parser* parser;
 	WorkQueueT* queue;
 	WorkQueueT* emptyqueue;
@@ -82,6 +83,7 @@ void* parse(void* arg)
 	ParseWorkT* work = NULL;
 
 	Schema* schema = ((ThreadArg*) arg)->schema;
+	StringHeap* heap = ((ThreadArg*) arg)->heap;
 	Parser* parser = ((ThreadArg*) arg)->parser;
 	WorkQueueT* queue = ((ThreadArg*) arg)->queue;
 	WorkQueueT* emptyqueue = ((ThreadArg*) arg)->emptyqueue;
@@ -95,7 +97,7 @@ void* parse(void* arg)
 
 			parseresultcount = parser->parseLine(work->WorkUnit[i].input, parseresult, Loader::MAX_COL);
 			assert(parseresultcount == schema->columns());
-			schema->parseTuple(work->WorkUnit[i].target, parseresult);
+			schema->parseTuple(work->WorkUnit[i].target, parseresult, heap);
 		}
 
 		// Push structure back to producer.
@@ -189,6 +191,7 @@ void Loader::load(const string& filename, PreloadedTextTable& output, bool verbo
 		WorkQueueT emptyqueue;
 		ThreadArg targ;
 		targ.schema = output.schema();
+		targ.heap = output.stringHeap();
 		targ.parser = &parser;
 		targ.queue = &queue;
 		targ.emptyqueue = &emptyqueue;
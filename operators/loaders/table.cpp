@@ -86,13 +86,13 @@ void PreloadedTextTable::append(const char** data, unsigned int count)
 {
 	void* target = allocateTuple();
 	dbg2assert(count==_schema->columns());
-	_schema->parseTuple(target, data);
+	_schema->parseTuple(target, data, heap);
 }
 
 void PreloadedTextTable::append(const vector<string>& input) 
 {
 	void* target = allocateTuple();
-	_schema->parseTuple(target, input);
+	_schema->parseTuple(target, input, heap);
 }
 
 void PreloadedTextTable::append(const void* const src) 
@@ -141,6 +141,14 @@ void PreloadedTextTable::concatenate(const PreloadedTextTable& table)
 	last = table.last;
 }
 
+void PreloadedTextTable::close()
+{
+	Table::close();
+
+	delete heap;
+	heap = NULL;
+}
+
 void PreloadedTextTable::init(Schema* s, unsigned int size)
 {
 	Table::init(s);
@@ -149,6 +157,7 @@ void PreloadedTextTable::init(Schema* s, unsigned int size)
 	data = new LinkedTupleBuffer(size, s->getTupleSize(), this);
 	last = data;
 	cur = data;
+	heap = new StringHeap();
 }
 
 /**
@@ -331,6 +340,8 @@ Table::LoadErrorT MemMappedTable::doload(const string& filepattern,
 
 		::close(fd);	// fd is no longer needed
 
+		advisehugepages(mapaddress, size);
+
 		// Create LinkedTupleBuffer on memory, and add it after "last".
 		//
 		void* space = numaallocate_local("Mtbl", sizeof(LinkedTupleBuffer), this);
@@ -38,6 +38,7 @@
 #include <vector>
 #include "../../schema.h"
 #include "../../util/buffer.h"
+#include "../../util/stringheap.h"
 #include "../../lock.h"
 
 class TupleBufferCursor 
@@ -182,7 +183,7 @@ class Table : public TupleBufferCursor {
 
 class PreloadedTextTable : public Table {
 	public:
-		PreloadedTextTable() : last(NULL), size(0) { }
+		PreloadedTextTable() : last(NULL), size(0), heap(NULL) { }
 		virtual ~PreloadedTextTable() { }
 
 		void init(Schema* s, unsigned int size);
@@ -214,9 +215,24 @@ class PreloadedTextTable : public Table {
 		 */
 		void* allocateTuple();
 
+		/**
+		 * Returns the heap that holds the bytes of the "varchar" columns of
+		 * this table. Strings remain valid until the table is closed.
+		 */
+		StringHeap* stringHeap()
+		{
+			return heap;
+		}
+
+		/**
+		 * Closes the table, and frees the bytes of its "varchar" columns.
+		 */
+		virtual void close();
+
 	protected:
 		LinkedTupleBuffer* last;
 		unsigned int size;
+		StringHeap* heap;
 };
 
 class MemMappedTable : public Table
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "operators.h"
+#include "operators_priv.h"
+
+#include <sstream>
+using std::istringstream;
+using std::ostringstream;
+
+/**
+ * Appends to \a joins the hash joins in the subtree of \a op that project
+ * "B$rowid".
+ */
+static void findRowPointerJoins(Operator* op, vector<HashJoinOp*>& joins)
+{
+	if (op == NULL)
+		return;
+
+	HashJoinOp* join = dynamic_cast<HashJoinOp*>(op);
+	if (join != NULL && join->projectsRowPointer())
+		joins.push_back(join);
+
+	SingleInputOp* single = dynamic_cast<SingleInputOp*>(op);
+	if (single != NULL)
+		findRowPointerJoins(single->nextOp, joins);
+
+	DualInputOp* dual = dynamic_cast<DualInputOp*>(op);
+	if (dual != NULL)
+	{
+		findRowPointerJoins(dual->buildOp, joins);
+		findRowPointerJoins(dual->probeOp, joins);
+	}
+}
+
+/**
+ * True if the columns of \a l and \a r have the same types and sizes.
+ */
+static bool sameColumns(Schema& l, Schema& r)
+{
+	if (l.columns() != r.columns())
+		return false;
+
+	for (unsigned int i=0; i<l.columns(); ++i)
+	{
+		if (l.getColumnType(i) != r.getColumnType(i) 
+				|| l.get(i).size != r.get(i).size)
+			return false;
+	}
+	return true;
+}
+
+void MaterializeOp::init(libconfig::Config& root, libconfig::Setting& cfg)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+
+	rowid = (int) cfg["rowid"];
+	if (rowid >= srcschema.columns() 
+			|| srcschema.getColumnType(rowid) != CT_POINTER)
+		throw IllegalSchemaDeclarationException();
+
+	// The tuples pointed to are build tuples of a join below. A declared
+	// schema must match one of them, otherwise there must be a single join.
+	//
+	vector<HashJoinOp*> joins;
+	findRowPointerJoins(nextOp, joins);
+	if (joins.empty())
+		throw InvalidParameter();
+
+	if (cfg.exists("schema"))
+	{
+		rowschema = Schema::create(cfg["schema"]);
+
+		bool found = false;
+		for (unsigned int i=0; i<joins.size(); ++i)
+			found |= sameColumns(rowschema, joins[i]->buildOp->getOutSchema());
+		if (!found)
+			throw IllegalSchemaDeclarationException();
+	}
+	else
+	{
+		if (joins.size() != 1)
+			throw InvalidParameter();
+		rowschema = joins[0]->buildOp->getOutSchema();
+	}
+
+	// Parse "$<n>" and "R$<n>" into (fromrow, column) pairs.
+	//
+	libconfig::Setting& node = cfg["projection"];
+	dbgassert(node.isList() || node.isArray());
+
+	for (int idx = 0; idx < node.getLength(); ++idx)
+	{
+		string s = node[idx];
+		size_t l = s.find('$');
+
+		if (l == string::npos || (l != 0 && s.substr(0, l) != "R"))
+			throw InvalidParameter();
+
+		unsigned int attr;
+		istringstream ss(s.substr(l+1));
+		ss >> attr;
+		if (!ss)
+			throw InvalidParameter();
+
+		bool fromrow = (l != 0);
+		Schema& from = fromrow ? rowschema : srcschema;
+		if (attr >= from.columns())
+			throw IllegalSchemaDeclarationException();
+
+		projection.push_back(make_pair(fromrow, attr));
+	}
+
+	MapWrapper::init(root, cfg);
+}
+
+void MaterializeOp::mapinit(Schema& schema)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+	for (unsigned int i=0; i<projection.size(); ++i)
+	{
+		Schema& from = projection[i].first ? rowschema : srcschema;
+		schema.add(from.get(projection[i].second));
+	}
+
+	ostringstream oss;
+	oss << "Materialize: Fetches columns of the tuples at $" << rowid + 1 << ".";
+	description = oss.str();
+}
+
+/**
+ * Copies the projected attributes of the input tuple and of the tuple
+ * that it points to.
+ */
+void MaterializeOp::map(void* tuple, Page* out, Schema& schema)
+{
+	Schema& srcschema = nextOp->getOutSchema();
+	void* dest = out->allocateTuple();
+	dbgassert(dest != NULL);
+
+	void* row = *reinterpret_cast<void**>(srcschema.calcOffset(tuple, rowid));
+
+	for (unsigned int i=0; i<projection.size(); ++i)
+	{
+		void* src = projection[i].first
+			? rowschema.calcOffset(row, projection[i].second)
+			: srcschema.calcOffset(tuple, projection[i].second);
+		schema.writeData(dest, i, src);
+	}
+}
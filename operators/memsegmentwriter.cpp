@@ -48,6 +48,8 @@ using std::endl;
 #include <fcntl.h>
 #include <unistd.h>
 
+#include "../util/hugepages.h"
+
 /**
  * Attempts to do a full copy of \a in from tuple \a idx into \a out.
  * If there is no space for a full copy, a partial copy of as much data as
@@ -196,6 +198,11 @@ void* creatememsegment(const string& fullname, size_t size)
 	//
 	close(fd);
 
+	// Shared memory cannot use MAP_HUGETLB, but tmpfs can back the segment
+	// with transparent huge pages.
+	//
+	advisehugepages(memory, size);
+
 	return memory;
 }
 
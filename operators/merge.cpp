@@ -37,6 +37,7 @@
 #include "../visitors/allvisitors.h"
 
 #include "../util/numaasserts.h"
+#include "../util/numaallocate.h"
 
 #include <unistd.h>
 #include <sys/mman.h>
@@ -113,8 +114,12 @@ void* threntrypoint(void* param)
 	MergeOp* obj = ((MergeOp::ParamObj*)param)->obj;
 	unsigned short threadid = ((MergeOp::ParamObj*)param)->threadid;
 
+	numaallocate_setarena(((MergeOp::ParamObj*)param)->arena);
+
 	obj->realentry(threadid);
 
+	numaallocate_setarena(NULL);
+
 	return NULL;
 }
 
@@ -320,6 +325,7 @@ void MergeOp::threadInit(unsigned short threadid)
 	for (int i=0; i<spawnedthr; ++i) {
 		producerinfo[i].threadparams.obj = this;
 		producerinfo[i].threadparams.threadid = i;
+		producerinfo[i].threadparams.arena = numaallocate_getarena();
 		TRACEID("Consumer creates thread", i);
 		pthread_create(&producerinfo[i].threadcontext, &producerinfo[i].threadattr, 
 				MergeOpNS::threntrypoint, &producerinfo[i].threadparams);
@@ -359,6 +365,7 @@ Operator::ResultCode MergeOp::scanStart(unsigned short threadid,
 
 	this->indexdatapage=indexdatapage;
 	this->indexdataschema=&indexdataschema;
+	remainingthr = spawnedthr;
 
 	ResultCode ret = Ready;
 
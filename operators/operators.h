@@ -48,8 +48,19 @@
 #include "../schema.h"
 #include "../hash.h"
 #include "../util/hashtable.h"
+#include "../util/densekeytable.h"
+#include "../util/heavyhitters.h"
+#include "../util/spillfile.h"
+#include "../util/runmerger.h"
+#include "../util/segmentedbuffer.h"
+#include "../util/exprkernels.h"
+#include "../util/strkernels.h"
+#include "../util/dictionary.h"
+#include "../util/arena.h"
 #include "../Barrier.h"
 #include "../conjunctionevaluator.h"
+#include "../keycomparator.h"
+#include "../lock.h"
 
 #include "../visitors/visitor.h"
 #include "../util/affinitizer.h"
@@ -221,13 +232,18 @@ class SingleInputOp : public virtual Operator {
  * a hash table shared by all threads.
  * \li \c threads (mandatory if "global" is set) specifies number of threads to
  * synchronize with on barriers.
+ *
+ * If no grouping fields are given and the subclass implements \a foldidentity,
+ * \a foldpage and \a foldmerge, the hash table is bypassed: each thread
+ * reduces whole input pages into a private accumulator, and partial results
+ * are merged once at the end.
  */
 class GenericAggregate : public virtual SingleInputOp {
 	public:
 		friend class PrettyPrinterVisitor;
 
 		GenericAggregate() 
-			: aggregationmode(Unset), threads(0)
+			: aggregationmode(Unset), threads(0), pagefold(false)
 		{}
 		virtual ~GenericAggregate() { }
 
@@ -269,6 +285,32 @@ class GenericAggregate : public virtual SingleInputOp {
 		 */
 		virtual void fold(void* partialresult, void* tuple) = 0;
 
+		/**
+		 * Writes the identity element of the fold in \a output and returns
+		 * true, if the subclass supports page-at-a-time reduction for
+		 * aggregation without grouping. The default returns false, and all
+		 * tuples are aggregated through the hash table.
+		 */
+		virtual bool foldidentity(void* output) { return false; }
+
+		/**
+		 * Folds every tuple in \a page into \a partialresult. \a page is
+		 * never empty. Only called if \a foldidentity returned true.
+		 */
+		virtual void foldpage(void* partialresult, Page* page)
+		{
+			throw NotYetImplemented();
+		}
+
+		/**
+		 * Combines the partial result in \a otherpartial into \a
+		 * partialresult. Only called if \a foldidentity returned true.
+		 */
+		virtual void foldmerge(void* partialresult, void* otherpartial)
+		{
+			throw NotYetImplemented();
+		}
+
 		/**
 		 * Aggregates bucket utilization statistics from all hash tables, as
 		 * reported by HashTable::statBuckets().
@@ -290,7 +332,9 @@ class GenericAggregate : public virtual SingleInputOp {
 			Global
 		};
 
-		void remember(void* tuple, HashTable::Iterator& it, unsigned short threadid);
+		void remember(void* tuple, unsigned int h, HashTable::Iterator& it, 
+				unsigned short threadid);
+		ResultCode scanStartPageFold(unsigned short threadid);
 
 		vector<unsigned short> aggfields;
 		ConjunctionEqualsEvaluator comparator;
@@ -299,6 +343,12 @@ class GenericAggregate : public virtual SingleInputOp {
 		unsigned short threads;
 		PThreadLockCVBarrier barrier;
 
+		/**
+		 * True if aggregating without grouping through \a foldpage,
+		 * bypassing the hash table.
+		 */
+		bool pagefold;
+
 		/**
 		 * Either one hashtable per thread if thread-local aggregation, or 
 		 * a single hashtable if global aggregation.
@@ -308,7 +358,8 @@ class GenericAggregate : public virtual SingleInputOp {
 		class State {
 			public:
 				State(HashTable::Iterator it)
-					: iterator(it), bucket(0), startoffset(0), endoffset(0), step(0)
+					: iterator(it), bucket(0), startoffset(0), endoffset(0), step(0),
+					partial(0), foldedtuples(0)
 				{ }
 
 				char padding1[64];
@@ -319,6 +370,10 @@ class GenericAggregate : public virtual SingleInputOp {
 				unsigned int endoffset;
 				unsigned int step;
 
+				/** Accumulator and input count when \a pagefold is set. */
+				void* partial;
+				unsigned long long foldedtuples;
+
 				char padding2[64];
 		};
 		vector<State> state;
@@ -337,6 +392,10 @@ class AggregateSum : public GenericAggregate {
 		virtual void foldstart(void* output, void* tuple);
 		virtual void fold(void* partialresult, void* tuple);
 
+		virtual bool foldidentity(void* output);
+		virtual void foldpage(void* partialresult, Page* page);
+		virtual void foldmerge(void* partialresult, void* otherpartial);
+
 	private:
 		Schema aggregateschema;
 		unsigned int sumfieldno;
@@ -354,6 +413,10 @@ class AggregateCount : public GenericAggregate {
 		virtual void foldstart(void* output, void* tuple);
 		virtual void fold(void* partialresult, void* tuple);
 
+		virtual bool foldidentity(void* output);
+		virtual void foldpage(void* partialresult, Page* page);
+		virtual void foldmerge(void* partialresult, void* otherpartial);
+
 	private:
 		Schema aggregatecountschema;
 
@@ -411,7 +474,9 @@ class ZeroInputOp : public virtual Operator
 /**
  * Single-threaded operator for file scan.
  * Takes five parameters:
- * \li \c schema Describes the schema of the input.
+ * \li \c schema Describes the schema of the input. A "varchar" column keeps
+ * its bytes in a heap of the table, and is only supported if \c filetype is
+ * "text". Its values remain valid until the scan is closed.
  * \li \c file The input file name. The global configuration parameter \c path
  * is prepended to this string to get the filename that will be opened.
  * \li (Optional) \c filetype If this string is "text", the file will be treated as a
@@ -424,6 +489,18 @@ class ZeroInputOp : public virtual Operator
  * \li (Optional) \c verbose If set, and the load operation is lengthy, a
  * progress bar will be displayed on stdout. Setting it on more than one scan
  * operators in a tree will clobber stdout with garbage.
+ * \li (Optional) \c dictionary If \c filetype is "text", a list of "char"
+ * columns to encode at load time, each given as a group with the \c column
+ * number and, optionally, the \c name of the dictionary. Each column is 
+ * replaced by an "int" column of 32-bit codes that hashes, compares and 
+ * sorts as an integer, and is decoded back to text only when printed. Codes
+ * preserve equality but not order. Columns encoded with the same \c name, 
+ * even in different scans, share a dictionary and can be joined on their 
+ * codes; the dictionary of a column without a \c name is private. Joins
+ * reject keys encoded with different dictionaries, and filters reject
+ * comparisons other than equality on encoded columns.
+ *
+ * dictionary := ( { column = <int>; name = <string>; }, ... )
  */
 class ScanOp : public virtual ZeroInputOp 
 {
@@ -449,12 +526,18 @@ class ScanOp : public virtual ZeroInputOp
 		virtual ~ScanOp() { }
 
 	protected:
+		/**
+		 * Replaces the columns listed in \a node with dictionary codes.
+		 */
+		void encodeColumns(libconfig::Setting& node);
+
 		vector<std::string> vec_filename;
 		vector<Table*> vec_tbl;
 		bool parsetext;
 		Table::GlobParamT globparam;
 		Table::VerbosityT verbose;
 		string separators;
+		vector<Dictionary*> dictionaries;
 };
 
 /**
@@ -541,6 +624,7 @@ class MergeOp : public virtual SingleInputOp {
 		struct ParamObj {
 			MergeOp* obj;
 			unsigned short threadid;
+			QueryArena* arena;	///< Arena of the spawning thread.
 		};
 
 	private:
@@ -737,7 +821,6 @@ class ShuffleOp : public virtual SingleInputOp
 
 /**
  * Generic join class.
- * No support for composite keys yet.
  *
  * Parameter \a projection :
  * projection := [ <join-attribute-proj>, <join-attribute-proj>, ... ]
@@ -749,15 +832,25 @@ class ShuffleOp : public virtual SingleInputOp
  * attribute from the probe side ("P$1"), and the third attribute from the
  * build side ("B$0").
  *
+ * HashJoinOp also accepts "B$rowid", which projects a pointer to the build
+ * tuple instead of copying its columns. The hash table then only stores the
+ * key and the pointer, and a MaterializeOp higher in the plan fetches the
+ * build columns of the output tuples that survive. The build input must be
+ * a ScanOp, or a scan derived from it, whose table stays in memory until the
+ * query ends. Probe pages are reused once consumed, so the probe columns are
+ * always copied.
+ *
  * Paramter \a buildjattr :
- * buildjattr := <scalar>
+ * buildjattr := <scalar> | [ <scalar>, <scalar>, ... ]
  *
- * Attribiute to join on on the build side.
+ * Attribiute to join on on the build side. A list of attributes forms a
+ * composite key; only HashJoinOp supports composite keys.
  *
  * Paramter \a probejattr :
- * probejattr := <scalar>
+ * probejattr := <scalar> | [ <scalar>, <scalar>, ... ]
  *
- * Attribiute to join on on the probe side.
+ * Attribiute to join on on the probe side. Must have as many attributes as
+ * \a buildjattr.
  *
  * Paramter \a threadgroups :
  * threadgroups := [ <threadgroup>, <threadgroup>, ... ]
@@ -781,11 +874,20 @@ class JoinOp : public virtual DualInputOp {
 		enum JoinSrcT { BuildSide, ProbeSide };
 		typedef pair<JoinSrcT, unsigned int> JoinPrjT; //< <source, attribute> pair
 
+		/** Attribute of the "B$rowid" projection. */
+		static const unsigned int RowPointer = static_cast<unsigned int>(-1);
+
+		/**
+		 * True if the projection has "B$rowid".
+		 */
+		bool projectsRowPointer();
+
 	protected:
 		void constructOutputTuple(void* tupbuild, void* tupprobe, void* output);
 
 		vector<JoinPrjT> projection;
-		unsigned int joinattr1, joinattr2;
+		unsigned int joinattr1, joinattr2;	///< First key attribute.
+		vector<unsigned int> joinattrs1, joinattrs2;	///< All key attributes.
 
 		vector<unsigned short> threadgroups;  //< threadid->groupid
 		vector<unsigned short> threadposingrp;//< threadid->position in group
@@ -805,21 +907,76 @@ class JoinOp : public virtual DualInputOp {
  * Parameter block \a algorithm :
  * tuplesperbucket = <size of each bucket, in tuples>
  *
- * allocpolicy = "local" | "striped"
+ * allocpolicy = "local" | "striped" | "replicated"
  * If "local", hash table is local to the NUMA node of the first thread in the
  * threadgroup that calls \a threadInit.
  * If "striped", hash table will be striped. The NUMA node where each 
  * partition will reside in depends on the (optional) parameter "stripeon".
+ * If "replicated", the hash table is built once as with "local", and is then
+ * copied by the threads of every NUMA node in the threadgroup into a replica
+ * on their node. Threads probe the replica of their own node, so a small
+ * build side costs one copy per node but the probe only touches local
+ * memory. Cannot be combined with \c spill.
  *
  * stripeon = <list of NUMA nodes>
  * List of NUMA nodes hash table will be striped on. If "stripeon" is absent,
  * hash table will be striped across all NUMA nodes.
+ *
+ * densekeys = [ <min>, <max> ]
+ * (Optional.) Declares that the build keys are unique integers within the
+ * dense range [min, max], inclusive. The build side is then stored in a
+ * DenseKeyTable, a direct-indexed array with a presence bitmap, and each
+ * probe is a bounds check and a single load. The build key must be an "int"
+ * or "long", and the bounds must fit in its type. If a build key is found to
+ * be a duplicate or out of range, the thread group transparently falls back
+ * to the regular hash table.
+ *
+ * densekeysmaxslots = <number>
+ * (Optional, default 64M.) Largest number of slots, max - min + 1, of a
+ * dense key table. Wider \c densekeys ranges use the regular hash table.
+ *
+ * spill = { memoryinM = <number>; directory = <path>; partitions = <number>; }
+ * (Optional.) Limits the memory that build tuples take in the hash table of
+ * each thread group to \c memoryinM megabytes. Hash buckets are grouped in
+ * \c partitions (default 16, a power of two up to 64) partitions. When the
+ * build side outgrows the limit, the largest partition that is still in
+ * memory is written to a file in \c directory (default "/tmp"), and so are 
+ * all build and probe tuples of this partition that arrive later. Spilled
+ * partitions are joined from disk after the probe input has been consumed,
+ * and are partitioned again on more hash bits if they still do not fit.
+ * Cannot be combined with \c densekeys.
+ *
+ * Composite keys are packed once, when the build side is inserted: the key
+ * columns are written one after the other at the start of each tuple in the
+ * hash table, and every probe key is packed the same way before it is
+ * hashed. Hashing and comparison are then a single pass over the packed
+ * bytes, so the key columns must have the same types and widths on both
+ * sides, and \a hash must be a function on bytes ("bytes" or "crc32").
+ * Composite keys cannot be combined with \c densekeys or \c spill.
+ *
+ * jointype = "inner" | "leftsemi" | "leftanti" | "rightsemi" | "rightanti"
+ * (Optional, default "inner".) The left input is the probe side, and the
+ * right input is the build side. A left semi (anti) join outputs every probe
+ * tuple that matches some (no) build tuple, once. Probing stops at the first
+ * match in the bucket, and the projection may only refer to the probe side,
+ * so no build payload is stored in the hash table. A right semi (anti) join
+ * outputs every build tuple that matches some (no) probe tuple, once. Each
+ * build tuple carries a mark that is set when it is matched; once the probe
+ * input of a thread group has been consumed, the threads of the group scan
+ * the hash table and output the marked (unmarked) tuples. The projection may
+ * only refer to the build side. Right joins cannot be combined with \c
+ * densekeys, \c spill or replicated allocation.
  */
 class HashJoinOp : public JoinOp {
 	public:
 		friend class PrettyPrinterVisitor;
 
-		HashJoinOp() : buildpagesize(0) { }
+		HashJoinOp() 
+			: buildpagesize(0), keycolumns(1), keysize(0), 
+			  jointype(InnerJoin), markoffset(0), usedensekeys(false), densemin(0), densemax(0),
+			  replicate(false), numanodes(1), usespill(false), spillbudget(0),
+			  spillparts(1), log2spillparts(0)
+		{ }
 
 		virtual void accept(Visitor* v) { v->visit(this); }
 
@@ -832,21 +989,183 @@ class HashJoinOp : public JoinOp {
 		virtual void threadClose(unsigned short threadid);
 		virtual void destroy();
 
+		/**
+		 * True if the build side of thread group \a groupno is kept in its
+		 * DenseKeyTable, rather than in the hash table after a fallback.
+		 * Valid after the build phase and until \a threadClose.
+		 */
+		bool usedDenseKeyTable(unsigned short groupno);
+
+		/**
+		 * Returns the number of build tuples that all threads wrote to
+		 * disk because the build side outgrew the \c spill budget. Valid
+		 * after the build phase and until \a threadClose.
+		 */
+		unsigned long long spilledBuildTuples();
+
+		enum JoinTypeT { 
+			InnerJoin, 
+			LeftSemiJoin, 	///< Probe tuples with a match.
+			LeftAntiJoin, 	///< Probe tuples without a match.
+			RightSemiJoin, 	///< Build tuples with a match.
+			RightAntiJoin	///< Build tuples without a match.
+		};
+
 	protected:
 		void constructOutputTuple(void* tupbuild, void* tupprobe, void* output);
 
 		/**
-		 * Inserts all the data items in the \a page in the hash table.
+		 * Inserts all the data items in the \a page in the hash table of
+		 * the group of \a threadid.
 		 * @param page Page to insert from.
-		 * @param groupno Hash table index to insert in.
+		 * @param threadid Thread that is building.
+		 */
+		void buildFromPage(Page* page, unsigned short threadid);
+
+		/**
+		 * Writes the join key and the build projection of \a tup at \a target.
+		 */
+		void projectBuildTuple(void* tup, void* target);
+
+		/**
+		 * Writes the \a attrs of \a tup, which is in \a tupschema, packed at
+		 * \a target, as the first \a keycolumns columns of \a sbuild.
 		 */
-		void buildFromPage(Page* page, unsigned short groupno);
+		void packKey(Schema& tupschema, void* tup, 
+				const vector<unsigned int>& attrs, void* target);
 
+		/**
+		 * True if the key of build tuple \a tupbuild, in \a sbuild format, 
+		 * differs from the key of probe tuple \a tupprobe. For composite
+		 * keys, \a packedprobe must hold the key of \a tupprobe, packed.
+		 */
+		inline bool keysDiffer(void* tupbuild, void* tupprobe, void* packedprobe)
+		{
+			if (keycolumns == 1)
+				return keycomparator.eval(tupbuild, tupprobe);
+			return memcmp(tupbuild, packedprobe, keysize) != 0;
+		}
+
+		/**
+		 * Returns the next probe tuple that joins with the hash table in
+		 * memory, or NULL if the probe is over. With spilling, this reads
+		 * probe tuples of spilled partitions back from disk once the probe
+		 * input has been consumed.
+		 */
 		void* readNextTupleFromProbe(unsigned short threadid);
 
+		/**
+		 * Reads the next tuple from \a probeOp.
+		 */
+		void* readNextTupleFromProbeOp(unsigned short threadid);
+
+		/**
+		 * Places the hash table iterator of \a threadid on the bucket of
+		 * probe tuple \a tup.
+		 */
+		void placeProbeIterator(unsigned short threadid, void* tup);
+
+		/**
+		 * Moves this thread's share of the dense key table of group \a
+		 * groupno into the hash table of the group, after a fallback.
+		 */
+		void migrateDenseKeysToHashTable(unsigned short threadid, unsigned short groupno);
+
+		/**
+		 * Copies this thread's share of the buckets of the hash table of
+		 * group \a groupno into the replica on the NUMA node of \a threadid.
+		 */
+		void copyToReplica(unsigned short threadid, unsigned short groupno);
+
+		/**
+		 * Returns the hash table that \a threadid probes: the replica on its
+		 * NUMA node if replicated, or the hash table of its group otherwise.
+		 */
+		inline HashTable& probeTable(unsigned short threadid)
+		{
+			const unsigned short groupno = threadgroups[threadid];
+			if (replicate)
+				return replicas[groupno][hashjoinstate[threadid]->replicanode];
+			return hashtable[groupno];
+		}
+
+		/**
+		 * Probe loop used when the build side fits in a DenseKeyTable.
+		 */
+		GetNextResultT getNextDenseKeys(unsigned short threadid);
+
+		/**
+		 * Probe loop of left semi and anti joins. Stops scanning the bucket
+		 * of each probe tuple at the first match.
+		 */
+		GetNextResultT getNextLeftSemiAnti(unsigned short threadid);
+
+		/**
+		 * Probe loop of right semi and anti joins. Marks the matching build 
+		 * tuples until the probe input is consumed, then outputs the marked
+		 * or unmarked build tuples of this thread's share of buckets.
+		 */
+		GetNextResultT getNextRightSemiAnti(unsigned short threadid);
+
+		inline bool isRightJoin()
+		{
+			return jointype == RightSemiJoin || jointype == RightAntiJoin;
+		}
+
+		/**
+		 * Spills to disk, or inserts in the hash table of the group, the
+		 * build tuple \a tup. Evicts partitions if over the memory limit.
+		 */
+		void buildWithSpill(unsigned short threadid, void* tup);
+
+		/**
+		 * Writes partitions of the hash table of the group of \a threadid to
+		 * disk, largest first, until the group is within its memory limit.
+		 * Returns immediately if another thread is already evicting.
+		 */
+		void evictPartitions(unsigned short threadid);
+
+		/**
+		 * Called when the probe input of \a threadid has been consumed.
+		 * Waits for the other threads of the group, then claims this
+		 * thread's share of spilled partitions.
+		 */
+		void startJoiningSpilled(unsigned short threadid);
+
+		/**
+		 * Loads the build side of the next spilled partition of \a threadid
+		 * in memory, partitioning it further first if it is too large.
+		 * @return False if there are no more spilled partitions.
+		 */
+		bool startNextSpilledPartition(unsigned short threadid);
+
+		/**
+		 * Returns the next probe tuple of the spilled partition being joined.
+		 */
+		void* readNextSpilledProbeTuple(unsigned short threadid);
+
+		/**
+		 * Returns the spill partition of \a bucket at recursion \a level.
+		 */
+		inline unsigned int spillPartition(unsigned int bucket, unsigned int level)
+		{
+			return (bucket >> (level * log2spillparts)) & (spillparts - 1);
+		}
+
 		vector<HashTable> hashtable;
 		int buildpagesize;
 
+		unsigned int keycolumns;	///< Columns in join key.
+		unsigned int keysize;	///< Bytes of packed key, if composite.
+
+		JoinTypeT jointype;
+		unsigned int markoffset;	///< Offset of match mark, for right joins.
+
+		vector<DenseKeyTable> densetable;
+		bool usedensekeys;
+		CtLong densemin, densemax;
+		ColumnType buildkeytype, probekeytype;
+
 		Schema sbuild;		///< join key + build projection
 
 		struct HashJoinState {
@@ -857,13 +1176,94 @@ class HashJoinOp : public JoinOp {
 			HashTable::Iterator htiter;	///< Current iterator on build.
 			Page::Iterator pgiter;	///< Current iterator on probe.
 			bool probedepleted; ///< Don't bother continuing the probe.
+			void* packedkey;	///< Scratch for composite keys.
+			int replicanode;	///< NUMA node of replica, if replicated.
+			unsigned int replicarank;	///< Position among threads on node.
+			bool scanningbuild;	///< Right joins: outputting from build.
+			unsigned long long scanbucket;	///< Right joins: bucket scanned.
+			unsigned long long scanend;	///< Right joins: end of share.
 			char padding2[64];
 		};
 		vector<HashJoinState*> hashjoinstate;
 
+		bool replicate;
+		unsigned int numanodes;
+		vector<vector<HashTable> > replicas;	///< groupid->node->replica
+		vector<vector<unsigned int> > replicathreads;	///< groupid->node->threads
+
 		TupleHasher buildhasher;
 		TupleHasher probehasher;
 
+		/** 
+		 * Hashes tuples in \a sbuild format; used when migrating dense keys
+		 * and when reading spilled build tuples.
+		 */
+		TupleHasher densefallbackhasher;
+
+		static const long DefaultDenseKeyMaxSlots = 64L * 1024 * 1024;
+
+		static const unsigned int MAX_SPILL_PARTS = 64;
+
+		bool usespill;
+		unsigned long long spillbudget;	///< Bytes of build tuples per group.
+		string spilldirectory;
+		unsigned int spillparts;
+		unsigned int log2spillparts;
+
+		struct SpillGroupState {
+			SpillGroupState();
+
+			char padding1[64];
+			volatile unsigned long long residentbytes;
+			volatile unsigned long long partbytes[MAX_SPILL_PARTS];
+			volatile bool spilled[MAX_SPILL_PARTS];
+			pthread_mutex_t evictlock;
+			char padding2[64];
+		};
+		vector<SpillGroupState*> spillgroupstate;
+
+		/**
+		 * A spilled partition, at recursion \a level, to be joined from disk.
+		 */
+		struct SpilledPartition {
+			SpilledPartition() : level(0) { }
+
+			unsigned int level;
+			vector<SpillFile*> build;
+			vector<SpillFile*> probe;
+		};
+
+		struct SpillThreadState {
+			SpillThreadState();
+
+			char padding1[64];
+
+			/** Files this thread writes spilled tuples of partition i to. */
+			SpillFile* buildfile[MAX_SPILL_PARTS];
+			SpillFile* probefile[MAX_SPILL_PARTS];
+
+			bool joiningspilled;	///< Probe input consumed, joining from disk.
+			vector<SpilledPartition> pending;
+			SpilledPartition current;
+			unsigned int currentprobefile;
+
+			HashTable table;	///< Hash table of \a current partition.
+			bool tableinitialized;
+			unsigned int tableshift;	///< Bucket bits used by partitioning.
+
+			Page* buildstaging;
+			Page* probestaging;
+			void* scratch;	///< Holds one build tuple in \a sbuild format.
+
+			unsigned long long buildtuplesspilled;
+			unsigned long long probetuplesspilled;
+			unsigned long long partitionsjoined;
+			unsigned long long repartitions;
+
+			char padding2[64];
+		};
+		vector<SpillThreadState*> spillthreadstate;
+
 	private:
 		vector<Page*> output;
 
@@ -872,6 +1272,132 @@ class HashJoinOp : public JoinOp {
 		vector<char> allocpolicy;
 };
 
+/**
+ * Star join: joins the fact table, which is the input of this operator, with
+ * the dimension tables in \a dimensionOps in one pass. Every dimension is
+ * built into a hash table, and every fact tuple probes all hash tables in
+ * turn and is dropped at the first dimension that has no match. The output 
+ * tuple is constructed directly from the fact tuple and the dimension tuples
+ * it matched, so no intermediate result is written between the joins.
+ *
+ * Each thread probes the dimensions in the order of their observed
+ * selectivity: the dimension that rejects the most fact tuples is probed
+ * first. Observations are halved whenever the order is recomputed, so the
+ * order follows changes in the input.
+ *
+ * Dimension join keys are assumed to be unique, as is the case for the 
+ * primary keys of a star schema; each fact tuple joins with the first
+ * matching tuple of each dimension.
+ *
+ * Parameter \a dimensions :
+ * dimensions := ( <dimension>, <dimension>, ... )
+ * dimension := { buildjattr = <scalar>; probejattr = <scalar>; 
+ * 		hash = <hash function>; tuplesperbucket = <scalar>; }
+ * One entry per operator of \a dimensionOps, in the same order. The 
+ * attribute \a buildjattr of the dimension joins with attribute \a
+ * probejattr of the fact table. See HashJoinOp for the \a hash and \a 
+ * tuplesperbucket parameters.
+ *
+ * Parameter \a projection :
+ * projection := [ <attr>, <attr>, ... ]
+ * attr := "P$<scalar>" | "D<dimension>$<scalar>"
+ * "P$1" is the second attribute of the fact table, and "D0$1" is the second
+ * attribute of the first dimension.
+ *
+ * Parameter \a threads :
+ * The number of threads that execute the operator, with thread ids starting
+ * from 0. All threads build the hash tables together before probing.
+ */
+class StarJoinOp : public virtual SingleInputOp {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		virtual void accept(Visitor* v) { v->visit(this); }
+
+		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+		virtual void threadInit(unsigned short threadid);
+		virtual ResultCode scanStart(unsigned short threadid,
+			Page* indexdatapage, Schema& indexdataschema);
+		virtual GetNextResultT getNext(unsigned short threadid);
+		virtual ResultCode scanStop(unsigned short threadid);
+		virtual void threadClose(unsigned short threadid);
+		virtual void destroy();
+
+		/** Dimension table inputs, joined with the fact table in \a nextOp. */
+		vector<Operator*> dimensionOps;
+
+		/** Fact tuples probed between recomputations of the probe order. */
+		static const unsigned int ReorderInterval = 1024;
+
+	protected:
+		/**
+		 * Hash table and join parameters of one dimension.
+		 */
+		struct Dimension {
+			Dimension() : buildjattr(0), probejattr(0), buildpagesize(0) { }
+
+			unsigned int buildjattr, probejattr;
+			int buildpagesize;
+			Schema sbuild;		///< join key + projected dimension attributes
+			vector<unsigned int> buildattrs;	///< Source of each \a sbuild column.
+			HashTable hashtable;
+			TupleHasher buildhasher;
+			TupleHasher probehasher;
+			Comparator keycomparator;
+		};
+
+		struct StarJoinState {
+			StarJoinState(unsigned int dimensions);
+
+			char padding1[64];
+			Page* input;
+			ResultCode prevresult;
+			unsigned int prevoffset;
+			vector<unsigned int> order;	///< Dimensions, in probe order.
+			vector<unsigned long long> probes;	///< Per dimension.
+			vector<unsigned long long> misses;	///< Per dimension.
+			vector<void*> matches;	///< Matching tuple of each dimension.
+			vector<HashTable::Iterator> htiter;	///< Per dimension.
+			unsigned int sincereorder;
+			char padding2[64];
+		};
+
+		/**
+		 * Inserts the tuples of \a page in the hash table of \a dimension.
+		 */
+		void buildFromPage(unsigned int dimension, Page* page);
+
+		/**
+		 * Probes the dimensions with fact tuple \a tup in the order of \a
+		 * state, stopping at the first miss. 
+		 * @return True if all dimensions matched, with the matching tuples
+		 * in \a state->matches.
+		 */
+		bool probeDimensions(StarJoinState* state, void* tup);
+
+		/**
+		 * Sorts the probe order of \a state on the observed miss rates.
+		 */
+		void reorderProbes(StarJoinState* state);
+
+		void constructOutputTuple(void* tupfact, StarJoinState* state, void* output);
+
+		vector<Dimension> dimensions;
+
+		/** 
+		 * Source of each output attribute: -1 for the fact table, or the 
+		 * dimension, and the attribute in the fact table or in \a sbuild of
+		 * the dimension.
+		 */
+		vector<pair<int, unsigned int> > projection;
+
+		unsigned int threads;
+		PThreadLockCVBarrier barrier;
+
+		vector<StarJoinState*> state;
+		vector<Page*> output;
+};
+
 /**
  * Class provides map-like functionality to derived classes. 
  *
@@ -924,13 +1450,41 @@ class MapWrapper : public virtual SingleInputOp {
 /**
  * Sort-Merge join class. 
  *
+ * Takes optional parameters:
+ * \li \c buildpresorted, \c probepresorted If "yes", the respective input
+ * is buffered but not sorted.
+ * \li \c sortalgorithm One of "comparison" (default), "radix", "bitonic" or
+ * "index", the algorithm that sorts the buffered inputs.
+ * \li \c buildprepartitioned If the build side of each thread is one range
+ * partition of the input. Either the \c buckets and the \c range that was
+ * partitioned, or the \c buckets and \c splitters = "sampled" when the build
+ * side comes from a PartitionOp with sampled splitters. Heavy hitters that
+ * PartitionOp has split are joined correctly, as every thread reads the
+ * matching range of all probe inputs.
+ * \li \c spill A group with \c memoryinM and, optionally, \c directory
+ * (default "/tmp"). Limits the buffered build input of each thread to
+ * \c memoryinM megabytes. When the limit is reached, the buffered tuples are
+ * sorted and written to a temporary file in \c directory as a run, and the
+ * join reads the build side by merging the runs. The probe side stays in 
+ * memory, as all threads of a group search it.
+ *
+ * Each input is buffered in segments that are added as tuples arrive, and
+ * then compacted into one page that fits it exactly, as sorting and merging
+ * need the tuples to be contiguous. The optional \c maxbuildtuples and 
+ * \c maxprobetuples hints only pick the size of the segments.
+ *
+ * The join key may be composite, if the key columns have the same type and
+ * size on both sides. Inputs are then sorted on all key columns by 
+ * comparison, and a prepartitioned build side must be range partitioned on
+ * the first key column. Composite keys cannot be combined with \c spill.
  */
 class SortMergeJoinOp : public JoinOp {
 	public:
 		friend class PrettyPrinterVisitor;
 
 		SortMergeJoinOp() 
-			: prepartfn(0, 0, 1) 
+			: prepartfn(0, 0, 1), prepartsampled(false),
+			  usespill(false), spillbudget(0)
 		{ }
 
 		virtual void accept(Visitor* v) { v->visit(this); }
@@ -956,6 +1510,10 @@ class SortMergeJoinOp : public JoinOp {
 			unsigned long long probeusedbytes;
 			unsigned long long probetuplesread;
 			unsigned long long setitercycles;
+			unsigned long long buildrunsspilled;
+
+			/** Range of build keys, if the build side has spilled. */
+			CtLong spilledminkey, spilledmaxkey;
 
 			void* buildtup;		///< Current build tuple. NULL means depleted.
 			Page::Iterator builditer;	///< Current iterator on build.
@@ -990,13 +1548,93 @@ class SortMergeJoinOp : public JoinOp {
 		Comparator probekeyequalsbuildkey;
 		Comparator buildkeyequalsbuildkey;
 
-		unsigned long perthreadbuildtuples;
-		unsigned long perthreadprobetuples;
+		/** 
+		 * Composite join keys of build tuples, probe tuples, and of probe
+		 * tuples against build tuples. Unused for single column keys.
+		 */
+		KeyComparator buildkey;
+		KeyComparator probekey;
+		KeyComparator probebuildkey;
+
+		inline bool compositeKey()
+		{
+			return joinattrs1.size() > 1;
+		}
+
+		inline bool probeKeyLessThanBuildKey(void* probetup, void* buildtup)
+		{
+			if (!compositeKey())
+				return probekeylessthanbuildkey.eval(probetup, buildtup);
+			return probebuildkey.less(probetup, buildtup);
+		}
+
+		inline bool probeKeyEqualsBuildKey(void* probetup, void* buildtup)
+		{
+			if (!compositeKey())
+				return probekeyequalsbuildkey.eval(probetup, buildtup);
+			return probebuildkey.equal(probetup, buildtup);
+		}
+
+		inline bool buildKeyEqualsBuildKey(void* buildtup1, void* buildtup2)
+		{
+			if (!compositeKey())
+				return buildkeyequalsbuildkey.eval(buildtup1, buildtup2);
+			return buildkey.equal(buildtup1, buildtup2);
+		}
+
+		unsigned long long buildsegmentsize;	///< Bytes of each build segment.
+		unsigned long long probesegmentsize;	///< Bytes of each probe segment.
 
 		bool buildpresorted;
 		bool probepresorted;
+		TupleBuffer::SortAlgorithm sortalgo;
 
 		ExactRangeValueHasher prepartfn;
+		bool prepartsampled;
+
+		bool usespill;
+		unsigned long long spillbudget;	///< Bytes of build buffered per thread.
+		string spilldirectory;
+
+		/**
+		 * Merges the spilled runs of the build side of each thread, or 
+		 * NULL if the build side of the thread is in memory.
+		 */
+		vector<SortedRunMerger*> buildmerger;
+
+		/**
+		 * Returns the range of join keys that the build side of 
+		 * \a threadid holds if the build is prepartitioned.
+		 */
+		void prepartitionedRange(unsigned short threadid, 
+				CtLong& minvalincl, CtLong& maxvalexcl);
+
+		/**
+		 * Buffers the build side of \a threadid, writing sorted runs to
+		 * disk whenever the memory limit is reached.
+		 */
+		void bufferBuildWithSpill(unsigned short threadid);
+
+		/**
+		 * Sorts the buffered build tuples of \a threadid and writes them to
+		 * disk as a new run in \a runs.
+		 */
+		void spillBuildRun(unsigned short threadid, vector<SpillFile*>& runs);
+
+		/**
+		 * Returns the next build tuple of \a threadid in join key order.
+		 */
+		inline void* nextBuildTuple(unsigned short threadid)
+		{
+			if (buildmerger[threadid] != NULL)
+				return buildmerger[threadid]->next();
+			return sortmergejoinstate[threadid]->builditer.next();
+		}
+
+		/**
+		 * Deletes the spilled runs of \a threadid, if any.
+		 */
+		void destroyBuildMerger(unsigned short threadid);
 
 		void BufferAndSort(unsigned short threadid,
 				Page* indexdatapage, Schema& indexdataschema);
@@ -1023,6 +1661,13 @@ class OldMPSMJoinOp : public SortMergeJoinOp
 	
 	private:
 		Comparator buildkeylessthanprobekey;
+
+		inline bool buildKeyLessThanProbeKey(void* buildtup, void* probetup)
+		{
+			if (!compositeKey())
+				return buildkeylessthanprobekey.eval(buildtup, probetup);
+			return probebuildkey.compare(probetup, buildtup) > 0;
+		}
 };
 
 /**
@@ -1032,6 +1677,9 @@ class OldMPSMJoinOp : public SortMergeJoinOp
  * region. Each key can now be processed sequentially, so the buffer
  * should only have enough space to hold the tuples that contain the
  * most frequently occuring join key. 
+ *
+ * The join key may be composite, if the key columns have the same type and
+ * size on both sides, and the inputs are sorted on all key columns.
  */
 class PresortedPrepartitionedMergeJoinOp : public JoinOp
 {
@@ -1101,6 +1749,39 @@ class PresortedPrepartitionedMergeJoinOp : public JoinOp
 		Comparator buildkeylessthanprobekey;
 		Comparator buildkeyequalsbuildkey;
 		Comparator buildkeyequalsprobekey;
+
+		/** 
+		 * Composite join keys of build tuples, and of build tuples against
+		 * probe tuples. Unused for single column keys.
+		 */
+		KeyComparator buildkey;
+		KeyComparator buildprobekey;
+
+		inline bool compositeKey()
+		{
+			return joinattrs1.size() > 1;
+		}
+
+		inline bool buildKeyLessThanProbeKey(void* buildtup, void* probetup)
+		{
+			if (!compositeKey())
+				return buildkeylessthanprobekey.eval(buildtup, probetup);
+			return buildprobekey.less(buildtup, probetup);
+		}
+
+		inline bool buildKeyEqualsBuildKey(void* buildtup1, void* buildtup2)
+		{
+			if (!compositeKey())
+				return buildkeyequalsbuildkey.eval(buildtup1, buildtup2);
+			return buildkey.equal(buildtup1, buildtup2);
+		}
+
+		inline bool buildKeyEqualsProbeKey(void* buildtup, void* probetup)
+		{
+			if (!compositeKey())
+				return buildkeyequalsprobekey.eval(buildtup, probetup);
+			return buildprobekey.equal(buildtup, probetup);
+		}
 };
 
 /*
@@ -1210,23 +1891,193 @@ class Filter : public MapWrapper {
 	private:
 		Comparator comparator;
 		char value[FILTERMAXWIDTH];
+		StringHeap valueheap;	//< bytes of \a value, if it is a "varchar"
 
 		unsigned int fieldno;	//< for pretty printing only
 		string opstr;			//< for pretty printing only
 };
 
 /**
- * Operator writes into a memory segment. It takes the following configuration
- * parameters: \a policy, \a numanodes, \a paths and \a size.
+ * Filter on a list of predicates, each of the form of Filter, that are
+ * combined with "and" or "or". Every thread evaluates the predicates in its
+ * own order, and stops at the first predicate that decides the outcome.
  *
- * Size is a scalar specifiying the size of each segment, in bytes.
- *
- * size := <scalar>
- *
- *
- * Policy specifies the numa affinitization policy.
- *
- * policy := "bind" | "round-robin" | "interleave"
+ * One in \a SampleInterval tuples is evaluated on all predicates, timing each
+ * one, to estimate its pass rate p and its cost c in cycles. Every \a
+ * ReorderInterval tuples each thread sorts its predicates on c/(1-p) for a
+ * conjunction, or on c/p for a disjunction, so that cheap predicates that
+ * decide the outcome most often run first. Estimates are halved after
+ * sorting, so the order follows changes in the input.
+ *
+ * Parameter \a predicates :
+ * predicates := ( <predicate>, <predicate>, ... )
+ * predicate := { field = <scalar>; op = <op>; value = <string>; }
+ * See Filter for \a field, \a op and \a value.
+ *
+ * Parameter \a combine :
+ * combine := "and" | "or"
+ * (Optional, default "and".) 
+ */
+class AdaptiveFilter : public MapWrapper {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+		virtual void threadInit(unsigned short threadid);
+		virtual GetNextResultT getNext(unsigned short threadid);
+		virtual void threadClose(unsigned short threadid);
+
+		virtual void accept(Visitor* v) { v->visit(this); }
+
+		virtual void mapinit(Schema& schema);
+
+		/** Never called from AdaptiveFilter::getNext(). */
+		virtual void map(void* tuple, Page* out, Schema& schema)
+		{ 
+			assert(false);
+		}
+
+		static const unsigned int SampleInterval = 64;
+		static const unsigned int ReorderInterval = 4096;
+
+	protected:
+		struct Predicate {
+			Comparator comparator;
+			char value[FILTERMAXWIDTH];
+			unsigned int fieldno;	//< for pretty printing only
+			string opstr;			//< for pretty printing only
+		};
+
+		struct FilterState {
+			FilterState(unsigned int predicates);
+
+			char padding1[64];
+			vector<unsigned int> order;	///< Predicates, in evaluation order.
+			vector<double> evaluated;	///< Sampled tuples, per predicate.
+			vector<double> passed;		///< Sampled tuples that passed.
+			vector<double> cycles;		///< Cycles spent on sampled tuples.
+			unsigned int sincesample;
+			unsigned int sincereorder;
+			char padding2[64];
+		};
+
+		/**
+		 * Evaluates the predicates on \a tuple in the order of \a state.
+		 */
+		bool evaluate(FilterState* state, void* tuple);
+
+		/**
+		 * Evaluates all predicates on \a tuple, recording pass rates and
+		 * cycles in \a state.
+		 */
+		bool evaluateAndSample(FilterState* state, void* tuple);
+
+		/**
+		 * Sorts the predicates of \a state on their estimated rank.
+		 */
+		void reorder(FilterState* state);
+
+		vector<Predicate> predicates;
+		StringHeap valueheap;	//< bytes of "varchar" values of predicates
+		bool disjunction;
+		vector<FilterState*> filterstate;
+};
+
+/**
+ * Filters on a LIKE pattern over a "char" column. In the pattern, "%"
+ * matches any sequence of characters and "_" matches any single character;
+ * there is no escape character. Prefix, suffix and substring predicates are
+ * the patterns "abc%", "%abc" and "%abc%".
+ *
+ * The pattern is split at every "%". The first and the last part must be
+ * found at the start and at the end of the value, and the parts in between
+ * are searched for in order with the kernels of util/strkernels.h. Each
+ * thread evaluates the pattern on up to \a BatchSize tuples of the input
+ * page at a time, and then copies the tuples that match.
+ *
+ * Parameter \a field : the column to filter on, which must be "char".
+ * Parameter \a pattern : the LIKE pattern.
+ */
+class LikeFilter : public MapWrapper {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+		virtual void threadInit(unsigned short threadid);
+		virtual GetNextResultT getNext(unsigned short threadid);
+		virtual void threadClose(unsigned short threadid);
+
+		virtual void accept(Visitor* v) { v->visit(this); }
+
+		virtual void mapinit(Schema& schema);
+
+		/** Never called from LikeFilter::getNext(). */
+		virtual void map(void* tuple, Page* out, Schema& schema)
+		{ 
+			assert(false);
+		}
+
+		static const unsigned int BatchSize = 1024;
+
+	protected:
+		/**
+		 * Part of the pattern between two "%".
+		 */
+		struct Segment {
+			string text;
+			bool wildcards;		///< If \a text contains "_".
+		};
+
+		static Segment makeSegment(const string& text);
+
+		/**
+		 * Returns true if \a seg matches the bytes at \a value.
+		 */
+		static bool matchesAt(const Segment& seg, const char* value);
+
+		/**
+		 * Returns the first position of \a seg in the \a len bytes at \a 
+		 * value, or -1 if there is none.
+		 */
+		int find(const Segment& seg, const char* value, size_t len);
+
+		/**
+		 * Returns true if the \a len bytes at \a value match the pattern.
+		 */
+		bool matches(const char* value, size_t len);
+
+		/**
+		 * Evaluates the pattern on the \a count input tuples that start at 
+		 * \a first, and stores the positions of the matches in \a positions.
+		 * Returns the number of matches.
+		 */
+		unsigned int select(const char* first, unsigned int count, 
+				unsigned int* positions);
+
+		unsigned int fieldno;
+		string pattern;			///< For pretty printing only.
+
+		bool exact;				///< If there is no "%" in the pattern.
+		Segment prefix;
+		vector<Segment> middle;
+		Segment suffix;
+		StrKernelIsa isa;
+
+		vector<unsigned int*> positions;	///< \a BatchSize per thread.
+};
+
+/**
+ * Operator writes into a memory segment. It takes the following configuration
+ * parameters: \a policy, \a numanodes, \a paths and \a size.
+ *
+ * Size is a scalar specifiying the size of each segment, in bytes.
+ *
+ * size := <scalar>
+ *
+ *
+ * Policy specifies the numa affinitization policy.
+ *
+ * policy := "bind" | "round-robin" | "interleave"
  *
  *
  * Numanodes specifies the numa node(s) this policy is applicable to.
@@ -1351,6 +2202,164 @@ class Project : public MapWrapper {
 		vector<unsigned short> projlist;
 };
 
+/**
+ * Fetches the columns of the tuples that an input column points to, such as
+ * the build tuples of a HashJoinOp that projects "B$rowid". Placing it above
+ * the operators that discard join output copies the build columns of the
+ * surviving tuples only.
+ *
+ * Parameter \a rowid :
+ * rowid := <scalar>
+ * The input column that holds the pointer.
+ *
+ * Parameter \a schema :
+ * (Optional.) The schema of the tuples pointed to, in the format of ScanOp.
+ * The pointers must come from a HashJoinOp below that projects "B$rowid",
+ * and the tuples pointed to have the output schema of its build input. If
+ * given, \a schema must match that schema column for column. It may only be
+ * omitted if a single such join is below.
+ *
+ * Parameter \a projection :
+ * projection := [ <attr>, <attr>, ... ]
+ * attr := "$<scalar>" | "R$<scalar>"
+ * "$<scalar>" copies a column of the input tuple, and "R$<scalar>" copies a
+ * column of the tuple that it points to.
+ */
+class MaterializeOp : public MapWrapper {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+	
+		virtual void accept(Visitor* v) { v->visit(this); }
+
+		virtual void mapinit(Schema& schema);
+		virtual void map(void* tuple, Page* out, Schema& schema);
+
+	private:
+		unsigned int rowid;
+		Schema rowschema;
+		vector<pair<bool, unsigned int> > projection;	///< <fromrow, attribute>
+};
+
+/**
+ * Computes every output column from an arithmetic expression over the
+ * columns of the input, so derived values like l_extendedprice * (1 -
+ * l_discount) do not need a user-defined operator. The expressions are
+ * compiled at init into typed expression trees, which each thread evaluates
+ * column-at-a-time on batches of up to \a BatchSize input tuples with the
+ * kernels of util/exprkernels.h.
+ *
+ * Parameter \a expressions :
+ * expressions := ( <expression>, <expression>, ... )
+ * expression := <term> | <expression> ( "+" | "-" ) <term>
+ * term := <factor> | <term> ( "*" | "/" ) <factor>
+ * factor := "$" <column> | <number> | "-" <factor> | "(" <expression> ")"
+ *		| ( "int" | "long" | "decimal" ) "(" <expression> ")"
+ *		| ( "year" | "month" | "day" ) "(" "$" <column> ")"
+ *
+ * Columns are counted from zero. Integers and longs are computed as longs,
+ * and an operation with a decimal operand as a decimal. Integer division
+ * truncates, and division by zero yields zero. "int", "long" and "decimal"
+ * convert their argument, and "year", "month" and "day" extract a part of a
+ * date column. An expression that is only a column copies it unchanged,
+ * whatever its type.
+ */
+class ComputeOp : public MapWrapper {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+		virtual void threadInit(unsigned short threadid);
+		virtual GetNextResultT getNext(unsigned short threadid);
+		virtual void threadClose(unsigned short threadid);
+
+		virtual void accept(Visitor* v) { v->visit(this); }
+
+		virtual void mapinit(Schema& schema);
+
+		/** Never called from ComputeOp::getNext(). */
+		virtual void map(void* tuple, Page* out, Schema& schema)
+		{ 
+			assert(false);
+		}
+
+		static const unsigned int BatchSize = 1024;
+
+	protected:
+		enum NodeKind 
+		{
+			ColumnNode,		///< Reads \a column of the input.
+			DatePartNode,	///< Extracts \a part of date \a column of the input.
+			ConstantNode,	///< Literal \a longval or \a doubleval.
+			ArithNode,		///< \a left \a op \a right.
+			ConvertNode		///< \a left, converted to \a type.
+		};
+
+		enum DatePart { Year, Month, Day };
+
+		/**
+		 * Node of an expression tree. Nodes of type CT_DECIMAL hold doubles,
+		 * and nodes of type CT_INTEGER or CT_LONG hold longs.
+		 */
+		struct Node 
+		{
+			NodeKind kind;
+			ColumnType type;
+			unsigned int column;
+			DatePart part;
+			ExprArithOp op;
+			unsigned int left;
+			unsigned int right;
+			long long longval;
+			double doubleval;
+			bool copy;	///< Output column copied from \a column as is.
+		};
+
+		/**
+		 * Recursive descent parser of \a expr from \a pos onwards. Each call
+		 * appends the nodes of a subtree after the nodes of its operands, and
+		 * returns the index of the root of the subtree.
+		 */
+		unsigned int parseExpression(const string& expr, size_t& pos);
+		unsigned int parseTerm(const string& expr, size_t& pos);
+		unsigned int parseFactor(const string& expr, size_t& pos);
+
+		unsigned int addNode(const Node& node);
+		unsigned int addConstant(long long val);
+		unsigned int addArith(ExprArithOp op, unsigned int left, unsigned int right);
+
+		/**
+		 * Returns a node with the value of node \a idx as \a type. Constants
+		 * are converted in place.
+		 */
+		unsigned int convert(unsigned int idx, ColumnType type);
+
+		/**
+		 * Evaluates all nodes for the \a count input tuples that start at 
+		 * \a first, and writes \a count output tuples to \a out.
+		 */
+		void computeBatch(unsigned short threadid, const char* first, 
+				unsigned int count, Page* out);
+
+		inline long long* longValues(unsigned short threadid, unsigned int idx)
+		{
+			return reinterpret_cast<long long*>(values[threadid]) + idx * BatchSize;
+		}
+
+		inline double* doubleValues(unsigned short threadid, unsigned int idx)
+		{
+			return reinterpret_cast<double*>(values[threadid]) + idx * BatchSize;
+		}
+
+		vector<Node> nodes;			///< Nodes of all trees, in postfix order.
+		vector<unsigned int> roots;	///< Root node of each output column.
+		vector<string> expressions;	///< For pretty printing only.
+		ExprKernelIsa isa;
+
+		vector<char*> values;		///< \a BatchSize values per node, per thread.
+};
+
 /**
  * Checks that the call order does not violate state contract.
  */
@@ -1463,65 +2472,289 @@ class CallCountPrinter : public virtual SingleInputOp
 		char padding3[128];
 };
 
-//sortlimit
-//an orderby with a limit. with small limits, no need to worry about disk spill
+/**
+ * Top-K operator: an ORDER BY with a LIMIT. With small limits, there is no
+ * need to worry about disk spills.
+ *
+ * Every thread keeps the best \a limit tuples it has seen in a bounded
+ * max-heap, whose root is the worst tuple retained. Once a heap is full, its
+ * root is published as a threshold shared by all threads; tuples that do not
+ * precede the threshold are discarded without touching the heap. After the
+ * input is consumed, thread 0 merges the sorted per-thread heaps and produces
+ * the entire output.
+ *
+ * Parameters:
+ * \li \c by a list of strings "$<number>" with the sort key columns, in order
+ * of significance. First attribute in tuple is zero.
+ * \li \c asc an array with either one value, 1 for ascending and 0 for
+ * descending order of all columns, or one such value per column in \c by.
+ * \li \c limit an array with the number of tuples to output.
+ * \li \c threads number of threads that run this operator, which
+ * synchronize on barriers.
+ */
 class SortLimit : public virtual SingleInputOp  {
 	public:
 		friend class PrettyPrinterVisitor;
 
+		SortLimit() 
+			: limit(0), threads(0), sharedthreshold(0), hassharedthreshold(false)
+		{ }
+
 		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+		virtual void threadInit(unsigned short threadid);
+		virtual ResultCode scanStart(unsigned short threadid,
+			Page* indexdatapage, Schema& indexdataschema);
+		virtual GetNextResultT getNext(unsigned short threadid);
+
+		/**
+		 * Scan is started and stopped inside \a scanStart.
+		 */
+		virtual ResultCode scanStop(unsigned short threadid)
+		{
+			return Ready;
+		}
+
+		virtual void threadClose(unsigned short threadid);
+		virtual void destroy();
 	
 		virtual void accept(Visitor* v) { v->visit(this); }
+
+	private:
+		/**
+		 * Orders heap entries, placing the tuple that should be output last
+		 * at the root of the heap.
+		 */
+		class HeapOrder {
+			public:
+				HeapOrder(const KeyComparator& c) : cmp(c) { }
+
+				inline bool operator()(void* l, void* r) const
+				{
+					return cmp.less(l, r);
+				}
+
+			private:
+				const KeyComparator& cmp;
+		};
+
+		void insert(unsigned short threadid, void* tuple);
+		void publishThreshold(unsigned short threadid);
+		void mergeHeaps();
+
+		class State {
+			public:
+				State()
+					: arena(0), heap(0), size(0), threshold(0), 
+					hasthreshold(false), outputpos(0)
+				{ }
+
+				char padding1[64];
+
+				/** Space for \a limit tuples. */
+				void* arena;
+
+				/** Pointers into \a arena, forming a heap of \a size entries. */
+				void** heap;
+				unsigned int size;
+
+				/** Thread-local copy of the shared threshold tuple. */
+				void* threshold;
+				bool hasthreshold;
+
+				/** Position of next output tuple in \a merged. */
+				unsigned int outputpos;
+
+				char padding2[64];
+		};
+
+		vector<Page*> output;
+		vector<State> state;
+
+		vector<unsigned short> orderby;
+		vector<bool> asc;
+		KeyComparator comparator;
+
+		unsigned int limit;
+		unsigned short threads;
+		PThreadLockCVBarrier barrier;
+
+		/**
+		 * Best threshold published by any thread, protected by 
+		 * \a thresholdlock. Owned by the class.
+		 */
+		Lock thresholdlock;
+		void* sharedthreshold;
+		volatile bool hassharedthreshold;
+
+		/** Final top-K tuples, in output order. Produced by thread 0. */
+		vector<void*> merged;
+};
+
+/**
+ * Parallel sort on a composite key. 
+ *
+ * Each thread buffers and sorts its input locally. Threads then sample their
+ * sorted runs, and thread 0 picks \c threads - 1 splitters from the sorted
+ * samples. Every thread locates the splitters in its own run, and thread \a i
+ * merges the \a i-th range from the runs of all threads into local pages.
+ * All merges run in parallel in \a scanStart.
+ *
+ * Threads hand out their merged pages in threadid order: a thread blocks in
+ * \a getNext until all threads with a smaller threadid have returned 
+ * Finished. The
+ * output is therefore globally ordered even when consumed through a
+ * MergeOp.
+ *
+ * Parameters:
+ * \li \c by a list of strings "$<number>" with the sort key columns, in order
+ * of significance. First attribute in tuple is zero.
+ * \li \c asc an array with either one value, 1 for ascending and 0 for
+ * descending order of all columns, or one such value per column in \c by.
+ * \li \c threads number of threads that run this operator, which
+ * synchronize on barriers.
+ * \li \c samples (optional, default 64) number of samples per thread used
+ * to pick splitters.
+ */
+class SortOp : public virtual SingleInputOp  {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		SortOp() 
+			: threads(0), samplesperthread(0), samplearea(0), splitters(0), 
+			nsplitters(0), turn(0)
+		{ }
+
+		virtual void init(libconfig::Config& root, libconfig::Setting& node);
+		virtual void threadInit(unsigned short threadid);
 		virtual ResultCode scanStart(unsigned short threadid,
 			Page* indexdatapage, Schema& indexdataschema);
 		virtual GetNextResultT getNext(unsigned short threadid);
-		virtual void threadInit(unsigned short threadid) ;
-		virtual void threadClose(unsigned short threadid) ;
-
-    protected:
-        class sortnode{
-            public:
-                sortnode():payload(NULL), next(NULL), prev(NULL){}
-                ~sortnode(){ delete reinterpret_cast<char*>(payload);}
-                void* payload;
-                sortnode* next;
-                sortnode* prev;
-        };
-        sortnode* createNode(void* tuple, int size);
 
-	private:
+		/**
+		 * Scan is started and stopped inside \a scanStart.
+		 */
+		virtual ResultCode scanStop(unsigned short threadid)
+		{
+			return Ready;
+		}
+
+		virtual void threadClose(unsigned short threadid);
+		virtual void destroy();
+	
+		virtual void accept(Visitor* v) { v->visit(this); }
+
+	protected:
+		/**
+		 * Cursor in a sorted run, during the multi-way merge.
+		 */
+		struct Cursor
+		{
+			void** pos;
+			void** end;
+		};
 
-        class State {
-            public:
-                State(Page* i, Operator::ResultCode r, unsigned int c) 
-                    : input(i), prevresult(r), prevoffset(c)
-                { }
+		/**
+		 * Orders cursors so that the cursor pointing to the tuple that
+		 * should be output first is at the root of the heap.
+		 */
+		class CursorOrder {
+			public:
+				CursorOrder(const KeyComparator& c) : cmp(c) { }
+
+				inline bool operator()(const Cursor& l, const Cursor& r) const
+				{
+					return cmp.less(*r.pos, *l.pos);
+				}
+
+			private:
+				const KeyComparator& cmp;
+		};
+
+		/**
+		 * Orders tuple pointers by key.
+		 */
+		class TupleOrder {
+			public:
+				TupleOrder(const KeyComparator& c) : cmp(c) { }
+
+				inline bool operator()(void* l, void* r) const
+				{
+					return cmp.less(l, r);
+				}
+
+			private:
+				const KeyComparator& cmp;
+		};
+
+		void sample(unsigned short threadid);
+		void pickSplitters();
+		void findBoundaries(unsigned short threadid);
+		void startMerge(unsigned short threadid);
+		void merge(unsigned short threadid);
+
+		void waitForTurn(unsigned short threadid);
+		void passTurn(unsigned short threadid);
+
+		class State {
+			public:
+				State() 
+					: padding1(), nsamples(0), nextmerged(0), hasturn(false), 
+					passedturn(false), padding2()
+				{ }
 
 				char padding1[64];
-                Page* input;
-                Operator::ResultCode prevresult;
-                unsigned int prevoffset;
+
+				/** Pages holding local input, owned by this thread. */
+				vector<Page*> pages;
+
+				/** Pointers to tuples in \a pages, sorted after the scan. */
+				vector<void*> run;
+				unsigned int nsamples;
+
+				/** 
+				 * Offsets in \a run where each output range starts. Has
+				 * \a threads + 1 entries.
+				 */
+				vector<unsigned long long> bounds;
+
+				/** Heap of cursors merged by this thread. */
+				vector<Cursor> cursors;
+
+				/** 
+				 * Output of the merge, owned by this thread. Pages are
+				 * handed out in order, when this thread has the turn.
+				 */
+				vector<Page*> merged;
+				unsigned int nextmerged;
+
+				bool hasturn;
+				bool passedturn;
+
 				char padding2[64];
-        };
+		};
 
-        vector<Page*> output;
-        vector<State> state;
+		vector<Page*> output;
+		vector<State> state;
 
-        vector<unsigned short> orderby;
+		vector<unsigned short> orderby;
+		vector<bool> asc;
+		KeyComparator comparator;
 
-        void sortHelper(void* tuple);
+		unsigned short threads;
+		unsigned int samplesperthread;
+		PThreadLockCVBarrier barrier;
 
-        //AT THE MOMENT THIS IS SINGLE THREADED
-        vector<ConjunctionEvaluator> faster;
-        vector< vector <Comparator::Comparison> > allpossible;
-        sortnode* head;
-        sortnode* last;
-        int sortnodesize;
-        //AT THE MOMENT THIS IS SINGLE THREADED
+		/** Samples, \a samplesperthread slots per thread. Owned by the class. */
+		void* samplearea;
 
+		/** Splitter tuples, picked by thread 0. Owned by the class. */
+		void* splitters;
+		unsigned int nsplitters;
 
-        bool asc;
-        int limit;
+		/** Threadid of the thread allowed to produce output. */
+		volatile unsigned short turn;
+		pthread_mutex_t turnlock;
+		pthread_cond_t turncv;
 };
 
 
@@ -1732,10 +2965,13 @@ class ThreadIdPrependOp : public MapWrapper
  * largest key is 1024.)
  * \li \c threads The number of threads participating, which is also the 
  * number of output partitions.
- * \li \c maxtuples The number of tuples of the input. This is used to size 
- * the buffer that will store the input for sorting.
+ * \li \c maxtuples (Optional) The number of tuples of the input. Input is
+ * buffered in segments and compacted into one page for sorting, and this 
+ * hint only picks the size of the segments.
  * \li \c presorted If "yes", the input will be buffered, but no sorting 
  * will happen under the assumption that the input was already sorted.
+ * \li \c sortalgorithm (Optional) One of "comparison" (default), "radix",
+ * "bitonic" or "index".
  */
 class SortAndRangePartitionOp : public virtual SingleInputOp
 {
@@ -1775,9 +3011,10 @@ class SortAndRangePartitionOp : public virtual SingleInputOp
 		PThreadLockCVBarrier barrier;
 
 		unsigned int attribute;
-		unsigned long perthreadtuples;
+		unsigned long long segmentsize;	///< Bytes of each staging segment.
 		unsigned short threads;
 		bool presorted;
+		TupleBuffer::SortAlgorithm sortalgo;
 
 		vector<CtLong> mininclusive; ///< Minimum (inclusive) of each partition range.
 		vector<CtLong> maxexclusive; ///< Maximum (exclusive) of each partition range.
@@ -1794,14 +3031,34 @@ class SortAndRangePartitionOp : public virtual SingleInputOp
  * \li \c range A range of values, such as [1, 1024] that specify the
  * min-max range of keys in the input, inclusive of the values
  * specified. (That is, in this example, the smallest key is 1 and the
- * largest key is 1024.)
+ * largest key is 1024.) Not needed if splitters are sampled.
  * \li \c buckets The number of of output partitions, which is also the number
  * of threads participating in the partitioning.
- * \li \c maxtuples The number of tuples of the input. This is used to size 
- * the buffer that will store the input for sorting.
+ * \li \c maxtuples (Optional) The number of tuples of the input. Input is
+ * buffered in segments that are added as it arrives, and this hint only
+ * picks the size of the segments.
+ * \li \c spill (Optional) A group with \c memoryinM and, optionally, 
+ * \c directory (default "/tmp"). Limits the buffered input of each thread to
+ * \c memoryinM megabytes; input beyond that is written to a temporary file
+ * in \c directory and read back when partitioning.
+ * \li \c splitters (Optional) Either "range" (default), where partitions 
+ * equally divide \c range, or "sampled", where every thread samples its
+ * input after buffering it and the partition boundaries are picked so that
+ * each partition receives roughly the same number of tuples.
+ * \li \c samplesize (Optional) Number of keys each thread samples if
+ * splitters are sampled. Defaults to 1024.
+ * \li \c heavyhitters (Optional) Either "none" (default) or "split". If 
+ * "split", splitters must be sampled. A space-saving sketch over the sample
+ * finds keys that hold more tuples than one partition should, and the tuples
+ * of each such key are spread over a run of adjacent partitions instead of
+ * all landing in one. Partitions stay ordered, but a heavy hitter can then
+ * appear in more than one partition.
  * \li \c sort If "yes", output will be sorted.
  * \li \c sortattr (Optional) Attribute to sort on, if sorting has been
  * requested, starting from 0. By default, the same as \c attr.
+ * \li \c sortalgorithm (Optional) One of "comparison" (default), "radix",
+ * "bitonic" or "index", the algorithm that sorts the output if sorting has
+ * been requested.
  */
 class PartitionOp : public virtual SingleInputOp 
 {
@@ -1818,6 +3075,40 @@ class PartitionOp : public virtual SingleInputOp
 		virtual void threadClose(unsigned short threadid);
 
 	protected:
+		/**
+		 * Samples the buffered input of this thread.
+		 */
+		void sampleInput(unsigned short threadid);
+
+		/**
+		 * Picks equi-depth splitters from the samples of all threads.
+		 * Called by a single thread after all threads have sampled.
+		 */
+		void chooseSplitters();
+
+		/**
+		 * Copies all input of \a threadid into its staging area, and 
+		 * populates histogram \a hist unless it is NULL.
+		 */
+		void bufferInput(unsigned short threadid, unsigned int* hist);
+
+		/**
+		 * Writes the staging area of \a threadid to disk and empties it.
+		 */
+		void spillInput(unsigned short threadid);
+
+		/**
+		 * Starts reading the input staged by \a threadid from the start.
+		 */
+		void rewindStagedInput(unsigned short threadid);
+
+		/**
+		 * Returns the next page of the input staged by \a threadid, first
+		 * the spilled part and then each segment in memory, or NULL at the
+		 * end.
+		 */
+		Page* nextStagedPage(unsigned short threadid);
+
 		struct PartitionState {
 			PartitionState();
 
@@ -1836,6 +3127,12 @@ class PartitionOp : public virtual SingleInputOp
 			unsigned long long bufferingcycles;
 			unsigned long long sortcycles;
 			unsigned long long usedtuples;
+			unsigned int samplecount;
+
+			SpillFile* spillfile;	///< Input that did not fit in memory.
+			Page* spillreadpage;	///< Holds the part of \a spillfile being read.
+			unsigned long long tuplesspilled;
+			unsigned int stagedstep;	///< 0: reading file, 1+i: segment i next.
 
 			/**
 			 * First tuple to be returned at next getNext for this thread.
@@ -1854,17 +3151,29 @@ class PartitionOp : public virtual SingleInputOp
 		vector<PartitionState*> partitionstate;
 
 		vector<Page*> output;
-		vector<Page*> input;
+		vector<SegmentedTupleBuffer*> input;
 
 		PThreadLockCVBarrier barrier;
 
 		unsigned int attribute;
-		unsigned long perthreadtuples;
+		unsigned long long segmentsize;	///< Bytes of each staging segment.
+
+		bool usespill;
+		unsigned long long spillbudget;	///< Bytes of input buffered per thread.
+		string spilldirectory;
 
 		TupleHasher hashfn;
 
+		bool sampledsplitters;
+		unsigned int samplesize;
+		vector<CtLong*> samples; ///< Keys sampled by each thread.
+
+		bool splitheavyhitters;
+		vector<SpaceSavingSketch<CtLong>::Counter> heavyhitters;
+
 		bool sortoutput;
 		unsigned int sortattribute;
+		TupleBuffer::SortAlgorithm sortalgo;
 };
 
 #ifdef ENABLE_HDF5
@@ -1995,7 +3304,10 @@ class RandomLookupsHdf5Op : public IndexHdf5Op
  * Hash join operator, where the probe side is an index scan.
  *
  * Parameters:
- * Same as HashJoinOp.
+ * Same as HashJoinOp. The probe side receives the first column of the join
+ * key of every build tuple. If the join key is composite, the index is
+ * looked up on that column and the rest of the key is matched in the hash
+ * table.
  */
 class IndexHashJoinOp : public HashJoinOp
 {
@@ -32,3 +32,85 @@
  */
 
 static Operator::Page EmptyPage(static_cast<void*>(0), 0, static_cast<void*>(0), 0);
+
+/**
+ * Reads the sort key columns from the \c by list of "$<number>" strings and
+ * the sort order from the \c asc array of \a cfg. \c asc has either one value
+ * for all columns or one value per column, 1 for ascending and 0 for
+ * descending order. Defined in sortlimit.cpp.
+ */
+void parseSortKeys(libconfig::Setting& cfg, Schema& schema,
+		vector<unsigned short>& orderby, vector<bool>& asc);
+
+/**
+ * Reads the optional \c sortalgorithm setting of \a cfg, which is one of
+ * "comparison" (the default), "radix", "bitonic" or "index". Defined in 
+ * sortlimit.cpp.
+ */
+TupleBuffer::SortAlgorithm parseSortAlgorithm(libconfig::Setting& cfg);
+
+/**
+ * Returns the \c sortalgorithm configuration string for \a algo.
+ */
+inline const char* sortAlgorithmName(TupleBuffer::SortAlgorithm algo)
+{
+	switch (algo)
+	{
+		case TupleBuffer::RadixSort:
+			return "radix";
+		case TupleBuffer::BitonicSort:
+			return "bitonic";
+		case TupleBuffer::IndexSort:
+			return "index";
+		default:
+			return "comparison";
+	}
+}
+
+/**
+ * Returns the segment size of a SegmentedTupleBuffer that stages the input
+ * of one of \a threads threads. If \a node has an estimate of the input 
+ * tuples, either in \a countname or in millions in \a countname + "inM", 
+ * segments are sized so that each thread fills about 16 of them. Otherwise
+ * segments are 1MB. Defined in partition.cpp.
+ */
+unsigned long long stagingSegmentSize(libconfig::Setting& node, 
+		const string& countname, unsigned int tuplesize, unsigned int threads);
+
+/**
+ * Moves all tuples of \a staging into \a page, so that they can be sorted
+ * and searched in place. \a page is replaced by a page on the local NUMA
+ * node that fits the tuples exactly, if it is NULL or too small. Defined in
+ * partition.cpp.
+ */
+void moveIntoPage(SegmentedTupleBuffer& staging, Operator::Page*& page,
+		unsigned int tuplesize, const char tag[4], void* allocsource);
+
+/**
+ * Rejects an ordering comparison \a op on \a column if it holds dictionary
+ * codes, which preserve equality but not order.
+ */
+inline void checkDictionaryComparison(Schema& schema, unsigned int column,
+		Comparator::Comparison op)
+{
+	if (schema.getDictionary(column) != NULL
+			&& op != Comparator::Equal && op != Comparator::NotEqual)
+		throw InvalidParameter();
+}
+
+/**
+ * Returns the value of numeric attribute \a attr of \a tup.
+ */
+inline CtLong keyAsLong(Schema& schema, void* tup, unsigned int attr)
+{
+	switch (schema.getColumnType(attr))
+	{
+		case CT_INTEGER:
+			return schema.asInt(tup, attr);
+		case CT_LONG:
+		case CT_DATE:
+			return schema.asLong(tup, attr);
+		default:
+			throw NotYetImplemented();
+	}
+}
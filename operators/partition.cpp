@@ -32,6 +32,9 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <limits>
+
 #include "operators.h"
 #include "operators_priv.h"
 #include "../rdtsc.h"
@@ -52,32 +55,80 @@ PartitionOp::init(libconfig::Config& root, libconfig::Setting& node)
 	//
 	attribute = node["attr"];
 
+	// Are partition ranges given by the user, or computed from a sample?
+	//
+	string splitters = "range";
+	node.lookupValue("splitters", splitters);
+	if (splitters == "sampled")
+		sampledsplitters = true;
+	else if (splitters == "range")
+		sampledsplitters = false;
+	else
+		throw InvalidParameter();
+
+	samplesize = 1024;
+	node.lookupValue("samplesize", samplesize);
+	if (samplesize == 0)
+		throw InvalidParameter();
+
+	// Are heavy hitters split across partitions? This needs sampling.
+	//
+	string heavyhitterpolicy = "none";
+	node.lookupValue("heavyhitters", heavyhitterpolicy);
+	if (heavyhitterpolicy == "split")
+		splitheavyhitters = true;
+	else if (heavyhitterpolicy == "none")
+		splitheavyhitters = false;
+	else
+		throw InvalidParameter();
+	if (splitheavyhitters && !sampledsplitters)
+		throw InvalidParameter();
+
 	// Hash function & total threads involved. 
 	// This is also the number of output partitions.
 	//
-	node.add("field", libconfig::Setting::TypeInt) = (int) attribute;
-	node.add("fn", libconfig::Setting::TypeString) = "exactrange";
-	hashfn = TupleHasher::create(schema, node);
-	node.remove("fn");
-	node.remove("field");
+	if (sampledsplitters)
+	{
+		int buckets = node["buckets"];
+		if (buckets <= 0)
+			throw InvalidParameter();
+		hashfn = TupleHasher::createSplitters(schema, attribute, buckets);
+	}
+	else
+	{
+		node.add("field", libconfig::Setting::TypeInt) = (int) attribute;
+		node.add("fn", libconfig::Setting::TypeString) = "exactrange";
+		hashfn = TupleHasher::create(schema, node);
+		node.remove("fn");
+		node.remove("field");
+	}
 	assert(hashfn.buckets() < MAX_THREADS);
 	barrier.init(hashfn.buckets());
 
-	// Compute max size of staging area used for buffering input.
-	// Allow for a per-thread variance of 20 buffers + 30% of input size.
+	// Input is staged in segments that are added as input arrives. The
+	// optional maxtuples hint only sizes the segments.
 	//
-	unsigned long maxtuples;
-	if (node.exists("maxtuplesinM"))
-	{
-		maxtuples = node["maxtuplesinM"];
-		maxtuples *= 1024 * 1024;
-	}
-	else
+	segmentsize = stagingSegmentSize(node, "maxtuples",
+			nextOp->getOutSchema().getTupleSize(), hashfn.buckets());
+
+	// Is buffered input allowed to spill to disk?
+	//
+	usespill = false;
+	spillbudget = 0;
+	if (node.exists("spill"))
 	{
-		maxtuples = node["maxtuples"];
+		libconfig::Setting& spillnode = node["spill"];
+		int budgetinM = spillnode["memoryinM"];
+		if (budgetinM <= 0)
+			throw InvalidParameter();
+
+		usespill = true;
+		spillbudget = budgetinM * 1024uLL * 1024uLL;
+		spilldirectory = "/tmp";
+		spillnode.lookupValue("directory", spilldirectory);
+
+		segmentsize = std::min(segmentsize, spillbudget);
 	}
-	perthreadtuples = 20 * buffsize/nextOp->getOutSchema().getTupleSize() 
-		+ (maxtuples * 1.3 / hashfn.buckets());
 
 	// Sorting output?
 	//
@@ -93,6 +144,7 @@ PartitionOp::init(libconfig::Config& root, libconfig::Setting& node)
 	{
 		sortattribute = 0xFFFF;
 	}
+	sortalgo = parseSortAlgorithm(node);
 
 	// Create state, output and build/probe staging areas.
 	//
@@ -101,11 +153,13 @@ PartitionOp::init(libconfig::Config& root, libconfig::Setting& node)
 		output.push_back(NULL);
 		partitionstate.push_back(NULL);
 		input.push_back(NULL);
+		samples.push_back(NULL);
 	}
 }
 
 PartitionOp::PartitionState::PartitionState()
-	: bufferingcycles(0), sortcycles(0), usedtuples(0), 
+	: bufferingcycles(0), sortcycles(0), usedtuples(0), samplecount(0),
+	  spillfile(NULL), spillreadpage(NULL), tuplesspilled(0), stagedstep(0),
 	  outputloc(0), trueoutput(EmptyPage)
 {
 	for (unsigned short t=0; t<MAX_THREADS; ++t)
@@ -127,11 +181,17 @@ PartitionOp::threadInit(unsigned short threadid)
 	unsigned int tuplesize;
 	tuplesize = nextOp->getOutSchema().getTupleSize();
 
-	space = numaallocate_local("PRTi", sizeof(Page), this);
+	space = numaallocate_local("PRTi", sizeof(SegmentedTupleBuffer), this);
 	input[threadid] = new (space) 
-		Page(perthreadtuples*tuplesize, tuplesize, this, "PRTi");
+		SegmentedTupleBuffer(segmentsize, tuplesize, this, "PRTi");
 	
 	output[threadid] = NULL;
+
+	if (sampledsplitters)
+	{
+		samples[threadid] = (CtLong*) numaallocate_local("PRTm", 
+				samplesize * sizeof(CtLong), this);
+	}
 }
 
 void 
@@ -150,6 +210,12 @@ PartitionOp::threadClose(unsigned short threadid)
 		numadeallocate(output[threadid]);
 	}
 	output[threadid] = NULL;
+
+	if (samples[threadid])
+	{
+		numadeallocate(samples[threadid]);
+	}
+	samples[threadid] = NULL;
 }
 
 // The following functions are reused in sortandrangepartition.cpp and
@@ -158,45 +224,24 @@ PartitionOp::threadClose(unsigned short threadid)
 namespace {	
 
 /**
- * Copies all tuples from source operator \a op into staging area \a page, and
- * popoulates histogram \a hist by hashing values using a \a hashfn.
- * Assumes operator has scan-started successfully for this threadid.
- * Error handling is non-existant, asserts if anything is not expected.
+ * Adds to histogram \a hist the hashes of all tuples in \a page.
  */
-void copySourceIntoPageAndPopulateHistogram(Operator* op, Operator::Page* page, 
-		unsigned short threadid, unsigned int* hist, TupleHasher& hashfn)
+void populateHistogram(Operator::Page* page, unsigned int* hist, 
+		TupleHasher& hashfn)
 {
-	Operator::Page::Iterator it = EmptyPage.createIterator();
-	Schema& s = op->getOutSchema();
-
-	Operator::GetNextResultT result;
-	result.first = Operator::Ready;
-
-	while (result.first == Operator::Ready)
+	unsigned int h[TupleHasher::BatchSize];
+	const unsigned int tuples = page->getNumTuples();
+	for (unsigned int first=0; first<tuples; first+=TupleHasher::BatchSize)
 	{
-		result = op->getNext(threadid);
-		assert(result.first != Operator::Error);
-
-		void* tup = NULL;
-		it.place(result.second);
-
-		while( (tup = it.next()) )
+		const unsigned int count = 
+			std::min(TupleHasher::BatchSize, tuples - first);
+		hashfn.hashBatch(page, first, count, h);
+		for (unsigned int i=0; i<count; ++i)
 		{
-			// Hash tup, update histogram.
-			//
-			unsigned int h = hashfn.hash(tup);
-			dbgassert(h < hashfn.buckets());
-			++hist[h];
-
-			// Copy tup into page.
-			//
-			void* space = page->allocateTuple();
-			assert(space != NULL);
-			s.copyTuple(space, tup);
+			dbgassert(h[i] < hashfn.buckets());
+			++hist[h[i]];
 		}
 	}
-
-	assert(result.first == Operator::Finished);
 }
 
 void verifysorted(Operator::Page* page, Schema& schema, unsigned int joinattr)
@@ -223,21 +268,22 @@ void verifysorted(Operator::Page* page, Schema& schema, unsigned int joinattr)
 /**
  * Sorts all tuples in given page.
  */
-void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr)
+void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr,
+		TupleBuffer::SortAlgorithm algo)
 {
 	unsigned int keyoffset = (unsigned long long)schema.calcOffset(0, joinattr);
 
 	switch(schema.getColumnType(joinattr))
 	{
 		case CT_INTEGER:
-			page->sort<CtInt>(keyoffset);
+			page->sort<CtInt>(keyoffset, algo);
 			break;
 		case CT_LONG:
 		case CT_DATE:
-			page->sort<CtLong>(keyoffset);
+			page->sort<CtLong>(keyoffset, algo);
 			break;
 		case CT_DECIMAL:
-			page->sort<CtDecimal>(keyoffset);
+			page->sort<CtDecimal>(keyoffset, algo);
 			break;
 		default:
 			throw NotYetImplemented();
@@ -246,25 +292,83 @@ void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr)
 
 };
 
+unsigned long long stagingSegmentSize(libconfig::Setting& node, 
+		const string& countname, unsigned int tuplesize, unsigned int threads)
+{
+	const unsigned long long DefaultSegmentSize = 1024 * 1024;
+	const unsigned long long MinSegmentSize = 64 * 1024;
+	const unsigned long long MaxSegmentSize = 64 * 1024 * 1024;
+
+	unsigned long long tuples;
+	if (node.exists(countname + "inM"))
+	{
+		unsigned long millions = node[countname + "inM"];
+		tuples = millions * 1024uLL * 1024uLL;
+	}
+	else if (node.exists(countname))
+	{
+		unsigned long count = node[countname];
+		tuples = count;
+	}
+	else
+	{
+		return DefaultSegmentSize;
+	}
+
+	unsigned long long size = tuples * tuplesize / threads / 16;
+	size = std::max(size, MinSegmentSize);
+	size = std::min(size, MaxSegmentSize);
+	return size;
+}
+
+void moveIntoPage(SegmentedTupleBuffer& staging, Operator::Page*& page,
+		unsigned int tuplesize, const char tag[4], void* allocsource)
+{
+	unsigned long long bytes = staging.getUsedSpace();
+
+	if (page == NULL || page->capacity() < bytes)
+	{
+		if (page != NULL)
+		{
+			page->~TupleBuffer();
+			numadeallocate(page);
+		}
+
+		unsigned long long capacity = (bytes != 0) ? bytes : tuplesize;
+		void* space = numaallocate_local(tag, sizeof(Operator::Page), allocsource);
+		page = new (space) Operator::Page(capacity, tuplesize, allocsource, tag);
+	}
+
+	staging.moveTo(page);
+}
+
 void
 repartition (Schema& schema, Operator::Page* in, 
 		unsigned int* idxstart, vector<Operator::Page*>& out, TupleHasher& hashfn)
 {
-	Operator::Page::Iterator it = in->createIterator();
-	void* tup = NULL;
-	while ( (tup = it.next()) )
+	unsigned int hashes[TupleHasher::BatchSize];
+	const unsigned int tuples = in->getNumTuples();
+	for (unsigned int first=0; first<tuples; first+=TupleHasher::BatchSize)
 	{
-		// Hash tup, update histogram.
+		// Hash a batch of tuples.
 		//
-		unsigned int h = hashfn.hash(tup);
-		dbgassert(h < hashfn.buckets());
+		const unsigned int count = 
+			std::min(TupleHasher::BatchSize, tuples - first);
+		hashfn.hashBatch(in, first, count, hashes);
 
-		// Copy tup into out[idxstart[h]], increment idxstart[h].
-		//
-		void* dest = out[h]->getTupleOffset(idxstart[h]);
-		dbgassert(dest != NULL);
-		++idxstart[h];
-		schema.copyTuple(dest, tup);
+		for (unsigned int i=0; i<count; ++i)
+		{
+			void* tup = in->getTupleOffset(first + i);
+			unsigned int h = hashes[i];
+			dbgassert(h < hashfn.buckets());
+
+			// Copy tup into out[idxstart[h]], increment idxstart[h].
+			//
+			void* dest = out[h]->getTupleOffset(idxstart[h]);
+			dbgassert(dest != NULL);
+			++idxstart[h];
+			schema.copyTuple(dest, tup);
+		}
 	}
 }
 
@@ -279,11 +383,31 @@ PartitionOp::scanStart(unsigned short threadid,
 	//
 	assert(Ready == nextOp->scanStart(threadid, indexdatapage, indexdataschema));
 	startTimer(&state->bufferingcycles);
-	copySourceIntoPageAndPopulateHistogram(nextOp, input[threadid], 
-			threadid, state->tuplesforpartition, hashfn);
+	bufferInput(threadid, sampledsplitters ? NULL : state->tuplesforpartition);
 	stopTimer(&state->bufferingcycles);
 	assert(Ready == nextOp->scanStop(threadid));
-	state->usedtuples = input[threadid]->getUsedSpace() / schema.getTupleSize();
+	state->usedtuples = state->tuplesspilled + input[threadid]->getNumTuples();
+
+	// If splitters are sampled, the histogram is populated after all threads
+	// have contributed their sample and thread 0 has picked the splitters.
+	//
+	if (sampledsplitters)
+	{
+		sampleInput(threadid);
+		barrier.Arrive();
+		if (threadid == 0)
+		{
+			chooseSplitters();
+		}
+		barrier.Arrive();
+
+		Page* page;
+		rewindStagedInput(threadid);
+		while ( (page = nextStagedPage(threadid)) )
+		{
+			populateHistogram(page, state->tuplesforpartition, hashfn);
+		}
+	}
 	
 	// Wait on barrier for all histograms to be built. 
 	// Combine histograms to compute output target. Each thread computes the
@@ -323,16 +447,32 @@ PartitionOp::scanStart(unsigned short threadid,
 	// Wait on barrier for allocation to complete. Then repartition.
 	// 
 	barrier.Arrive();
-	repartition(schema, input[threadid], state->idxstart, output, hashfn);
+	Page* page;
+	rewindStagedInput(threadid);
+	while ( (page = nextStagedPage(threadid)) )
+	{
+		repartition(schema, page, state->idxstart, output, hashfn);
+	}
 
 	// Release unneeded memory.
 	//
 	if (input[threadid]) 
 	{
+		input[threadid]->~SegmentedTupleBuffer();
 		numadeallocate(input[threadid]);
 	}
 	input[threadid] = NULL;
 
+	if (state->spillfile)
+	{
+		state->spillfile->close();
+		delete state->spillfile;
+		state->spillreadpage->~Page();
+		numadeallocate(state->spillreadpage);
+	}
+	state->spillfile = NULL;
+	state->spillreadpage = NULL;
+
 	// Wait for other threads to complete writes to this thread's output.
 	// If sorting, do it now; no need to syncrhonize.
 	//
@@ -340,13 +480,7 @@ PartitionOp::scanStart(unsigned short threadid,
 	if (sortoutput)
 	{
 		startTimer(&state->sortcycles);
-#ifdef BITONIC_SORT
-//		system("./systemstats-pre.sh");
-		output[threadid]->bitonicsort();
-//		system("./systemstats-post.sh");
-#else
-		sortAllInPage(output[threadid], schema, sortattribute);
-#endif
+		sortAllInPage(output[threadid], schema, sortattribute, sortalgo);
 		stopTimer(&state->sortcycles);
 #ifdef DEBUG
 		verifysorted(output[threadid], schema, sortattribute);
@@ -358,6 +492,256 @@ PartitionOp::scanStart(unsigned short threadid,
 	return Ready;
 }
 
+void
+PartitionOp::bufferInput(unsigned short threadid, unsigned int* hist)
+{
+	unsigned int tuplesize = schema.getTupleSize();
+	Page::Iterator it = EmptyPage.createIterator();
+
+	GetNextResultT result;
+	result.first = Ready;
+
+	while (result.first == Ready)
+	{
+		result = nextOp->getNext(threadid);
+		assert(result.first != Error);
+
+		void* tup = NULL;
+		it.place(result.second);
+
+		// Hash page, update histogram.
+		//
+		if (hist != NULL)
+		{
+			populateHistogram(result.second, hist, hashfn);
+		}
+
+		while( (tup = it.next()) )
+		{
+			// Copy tup into staging area, spilling it first if it is full.
+			//
+			if (usespill && 
+				input[threadid]->getUsedSpace() + tuplesize > spillbudget)
+			{
+				spillInput(threadid);
+			}
+			void* space = input[threadid]->allocateTuple();
+			schema.copyTuple(space, tup);
+		}
+	}
+
+	assert(result.first == Finished);
+}
+
+void
+PartitionOp::spillInput(unsigned short threadid)
+{
+	PartitionState* state = partitionstate[threadid];
+	SegmentedTupleBuffer* staging = input[threadid];
+	unsigned int tuplesize = schema.getTupleSize();
+
+	if (state->spillfile == NULL)
+	{
+		state->spillfile = new SpillFile();
+		state->spillfile->create(spilldirectory);
+
+		void* space = numaallocate_local("PRTr", sizeof(Page), this);
+		state->spillreadpage = new (space) Page(buffsize, tuplesize, this, "PRTr");
+	}
+
+	for (unsigned int i=0; i<staging->getNumSegments(); ++i)
+	{
+		Page* segment = staging->getSegment(i);
+		state->spillfile->append(segment->getTupleOffset(0), 
+				segment->getUsedSpace());
+	}
+	state->tuplesspilled += staging->getNumTuples();
+	staging->clear();
+}
+
+void
+PartitionOp::rewindStagedInput(unsigned short threadid)
+{
+	PartitionState* state = partitionstate[threadid];
+	if (state->spillfile)
+	{
+		state->spillfile->rewind();
+		state->stagedstep = 0;
+	}
+	else
+	{
+		state->stagedstep = 1;
+	}
+}
+
+Operator::Page*
+PartitionOp::nextStagedPage(unsigned short threadid)
+{
+	PartitionState* state = partitionstate[threadid];
+
+	if (state->stagedstep == 0)
+	{
+		if (state->spillfile->readTuples(state->spillreadpage, 
+					schema.getTupleSize()) != 0)
+			return state->spillreadpage;
+		state->stagedstep = 1;
+	}
+
+	// Steps after the first return the segments in memory, one at a time.
+	//
+	unsigned int segment = state->stagedstep - 1;
+	if (segment < input[threadid]->getNumSegments())
+	{
+		state->stagedstep++;
+		return input[threadid]->getSegment(segment);
+	}
+
+	return NULL;
+}
+
+void
+PartitionOp::sampleInput(unsigned short threadid)
+{
+	PartitionState* state = partitionstate[threadid];
+	unsigned int tuplesize = schema.getTupleSize();
+
+	// Systematic sample: every (usedtuples/samplesize)-th tuple. Staged
+	// pages are read in order, so that spilled input is read once.
+	//
+	unsigned long long tuples = state->usedtuples;
+	unsigned int count = std::min<unsigned long long>(samplesize, tuples);
+	unsigned long long pagestart = 0;
+	unsigned int i = 0;
+	Page* page;
+
+	rewindStagedInput(threadid);
+	while (i < count && (page = nextStagedPage(threadid)) )
+	{
+		unsigned long long pagetuples = page->getUsedSpace() / tuplesize;
+		while (i < count && (i * tuples) / count < pagestart + pagetuples)
+		{
+			void* tup = page->getTupleOffset((i * tuples) / count - pagestart);
+			samples[threadid][i] = keyAsLong(schema, tup, attribute);
+			++i;
+		}
+		pagestart += pagetuples;
+	}
+	state->samplecount = count;
+}
+
+void
+PartitionOp::chooseSplitters()
+{
+	// Collect samples of all threads. Each sample stands for as many tuples
+	// as the input of its thread divided by the sample size, so that
+	// splitters are equi-depth even if threads have unequal inputs.
+	//
+	vector<pair<CtLong, double> > all;
+	double totaltuples = 0;
+	for (unsigned int t=0; t<hashfn.buckets(); ++t)
+	{
+		PartitionState* state = partitionstate[t];
+		if (state->samplecount == 0)
+			continue;
+
+		double weight = state->usedtuples / (double) state->samplecount;
+		for (unsigned int i=0; i<state->samplecount; ++i)
+		{
+			all.push_back(make_pair(samples[t][i], weight));
+		}
+		totaltuples += state->usedtuples;
+	}
+
+	// Find keys that hold more tuples than one partition should.
+	//
+	const unsigned int buckets = hashfn.buckets();
+	const double share = totaltuples / buckets;
+	vector<CtLong> hotkeys;
+	if (splitheavyhitters)
+	{
+		SpaceSavingSketch<CtLong> sketch(2 * buckets);
+		for (unsigned int i=0; i<all.size(); ++i)
+		{
+			sketch.add(all[i].first, all[i].second);
+		}
+		heavyhitters = sketch.heavyhitters(share);
+		for (unsigned int i=0; i<heavyhitters.size(); ++i)
+		{
+			hotkeys.push_back(heavyhitters[i].key);
+		}
+	}
+
+	std::sort(all.begin(), all.end());
+
+	// Splitter i is the first sampled key that has at least i/buckets of 
+	// the input before it. The tuples of a heavy hitter are spread over
+	// every partition whose share of the input it overlaps, in proportion
+	// to the overlap. A heavy hitter starts at the partition of the previous
+	// key, and a splitter is added for every partition boundary it crosses,
+	// so that the keys that follow it, sampled or not, start at its last
+	// partition.
+	//
+	vector<CtLong> splitters;
+	vector<SplitterValueHasher::SpreadKey> spreadkeys;
+	double before = 0;
+	for (unsigned int i=0; i<all.size(); ++i)
+	{
+		while (splitters.size() < buckets-1
+				&& before >= (splitters.size() + 1) * share)
+		{
+			splitters.push_back(all[i].first);
+		}
+
+		bool firstofkey = (i == 0) || (all[i-1].first != all[i].first);
+		if (firstofkey && std::binary_search(hotkeys.begin(), hotkeys.end(), 
+					all[i].first))
+		{
+			double end = before;
+			for (unsigned int j=i; j<all.size() && all[j].first==all[i].first; ++j)
+			{
+				end += all[j].second;
+			}
+			double weight = end - before;
+
+			unsigned int first = splitters.size();
+			unsigned int last = first;
+			while (last < buckets-1 && end > (last + 1) * share)
+			{
+				splitters.push_back(all[i].first);
+				++last;
+			}
+
+			if (last > first)
+			{
+				SplitterValueHasher::SpreadKey sk;
+				sk.key = all[i].first;
+				sk.first = first;
+				double overlap = 0;
+				for (unsigned int b=first; b<=last; ++b)
+				{
+					overlap += std::min(end, (b+1) * share) 
+						- std::max(before, b * share);
+					sk.cumulative.push_back(std::min(overlap / weight, 1.0));
+				}
+				sk.cumulative.back() = 1.0;
+				spreadkeys.push_back(sk);
+			}
+		}
+
+		before += all[i].second;
+	}
+	while (splitters.size() < buckets-1)
+	{
+		splitters.push_back(std::numeric_limits<CtLong>::max());
+	}
+
+	SplitterValueHasher* fn = 
+		dynamic_cast<SplitterValueHasher*>(hashfn.function());
+	assert(fn != NULL);
+	fn->setsplitters(splitters);
+	fn->setspreadkeys(spreadkeys);
+}
+
 Operator::ResultCode 
 PartitionOp::scanStop(unsigned short threadid)
 {
@@ -73,12 +73,71 @@ void ScanOp::init(libconfig::Config& root, libconfig::Setting& cfg)
 
 	cfg.lookupValue("separators", separators);
 
+	// Binary files are not parsed, so their columns can't be encoded, and
+	// they can't hold the bytes of varchars. This is checked before any
+	// dictionary is acquired, so nothing is leaked when it throws.
+	//
+	if (cfg.exists("dictionary") && !parsetext)
+		throw InvalidParameter();
+
+	for (unsigned int i=0; i<schema.columns(); ++i)
+	{
+		if (schema.getColumnType(i) == CT_VARCHAR && !parsetext)
+			throw InvalidParameter();
+	}
+
+	if (cfg.exists("dictionary"))
+	{
+		encodeColumns(cfg["dictionary"]);
+	}
+
 	vec_tbl.push_back(NULL);
 
 	dbgassert(vec_filename.size() == 1);
 	dbgassert(vec_tbl.size() == 1);
 }	
 
+void ScanOp::encodeColumns(libconfig::Setting& node)
+{
+	vector<Dictionary*> coldict(schema.columns(), (Dictionary*) NULL);
+
+	// Check every column before acquiring any dictionary, so that a bad
+	// column does not leak the dictionaries of the columns before it.
+	//
+	vector<bool> seen(schema.columns(), false);
+	for (int i=0; i<node.getLength(); ++i)
+	{
+		unsigned int column = (int) node[i]["column"];
+		if (column >= schema.columns() 
+				|| schema.getColumnType(column) != CT_CHAR
+				|| seen[column])
+			throw IllegalSchemaDeclarationException();
+		seen[column] = true;
+	}
+
+	for (int i=0; i<node.getLength(); ++i)
+	{
+		unsigned int column = (int) node[i]["column"];
+		string name;
+		node[i].lookupValue("name", name);
+		coldict[column] = Dictionary::acquire(name);
+		dictionaries.push_back(coldict[column]);
+	}
+
+	// Rebuild the schema, with codes in place of the encoded columns.
+	//
+	Schema encoded;
+	for (unsigned int i=0; i<schema.columns(); ++i)
+	{
+		if (coldict[i] == NULL)
+			encoded.add(schema.get(i));
+		else
+			encoded.add(ColumnSpec(CT_INTEGER, sizeof(CtInt), 
+						Schema::UninitializedFormatString, coldict[i]));
+	}
+	schema = encoded;
+}
+
 void ScanOp::threadInit(unsigned short threadid)
 {
 	dbgSetSingleThreaded(threadid);
@@ -140,6 +199,10 @@ void ScanOp::destroy()
 	dbgassert(vec_tbl.at(0) == NULL);
 	vec_filename.clear();
 	vec_tbl.clear();
+
+	for (unsigned int i=0; i<dictionaries.size(); ++i)
+		Dictionary::release(dictionaries[i]);
+	dictionaries.clear();
 }
 
 Operator::GetNextResultT ScanOp::getNext(unsigned short threadid)
@@ -266,12 +266,25 @@ void ShuffleOp::produce(unsigned short threadid){
     int totaltups = 0;
     int tupssent = 0;
 
+    unsigned int hashes[TupleHasher::BatchSize];
+    unsigned int batchpos = TupleHasher::BatchSize;
+
     while (1) {
-        while ( (tuple = in->getTupleOffset(tupoffset++)) ) {
+        while ( (tuple = in->getTupleOffset(tupoffset)) ) {
+
+            // Hash the next batch of tuples of the page.
+            //
+            if (batchpos == TupleHasher::BatchSize) {
+                unsigned int count = std::min<unsigned long long>(
+                        TupleHasher::BatchSize, in->getNumTuples() - tupoffset);
+                hashfn.hashBatch(in, tupoffset, count, hashes);
+                batchpos = 0;
+            }
 
+            tupoffset++;
             totaltups += 1;
 
-            hashbucket = hashfn.hash(tuple);
+            hashbucket = hashes[batchpos++];
 
             void * bucketspace = noutput[hashbucket]->allocateTuple();
 			dbgassert(bucketspace != NULL);
@@ -306,6 +319,7 @@ void ShuffleOp::produce(unsigned short threadid){
         rc = result.first;
         in = result.second;
         tupoffset = 0;
+        batchpos = TupleHasher::BatchSize;
 
         if (rc == Error) {
             throw new ShuffleProducerPullError();
@@ -0,0 +1,363 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "operators.h"
+#include "operators_priv.h"
+
+#include "../util/numaallocate.h"
+
+#include <algorithm>
+using namespace std;
+
+void SortOp::init(libconfig::Config& root, libconfig::Setting& cfg)
+{
+	Operator::init(root, cfg);
+
+	schema = nextOp->getOutSchema();
+
+	parseSortKeys(cfg, schema, orderby, asc);
+	comparator.init(schema, orderby, asc);
+
+	int thr = 1;
+	cfg.lookupValue("threads", thr);
+	threads = thr;
+	barrier.init(threads);
+
+	int samples = 64;
+	cfg.lookupValue("samples", samples);
+	if (samples <= 0)
+		throw InvalidParameter();
+	samplesperthread = samples;
+
+	const unsigned int tuplesize = schema.getTupleSize();
+	samplearea = numaallocate_local("SrtS", 
+			threads * samplesperthread * tuplesize, this);
+	splitters = numaallocate_local("SrtT", threads * tuplesize, this);
+	nsplitters = 0;
+
+	turn = 0;
+	assert(!pthread_mutex_init(&turnlock, NULL));
+	assert(!pthread_cond_init(&turncv, NULL));
+
+	for (int i=0; i<MAX_THREADS; ++i) 
+	{
+		output.push_back(NULL);
+		state.push_back(State());
+	}
+}
+
+void SortOp::threadInit(unsigned short threadid)
+{
+	dbgassert(threadid < threads);
+
+	void* space = numaallocate_local("SrtO", sizeof(Page), this);
+	output[threadid] = new(space) Page(buffsize, schema.getTupleSize(), this);
+
+	state[threadid] = State();
+}
+
+void SortOp::sample(unsigned short threadid)
+{
+	State& st = state[threadid];
+	const unsigned int tuplesize = schema.getTupleSize();
+	const unsigned long long runsize = st.run.size();
+
+	char* dest = (char*)samplearea + threadid * samplesperthread * tuplesize;
+
+	// Take equally spaced samples from the sorted run.
+	//
+	st.nsamples = min<unsigned long long>(samplesperthread, runsize);
+	for (unsigned int i=0; i<st.nsamples; ++i)
+	{
+		unsigned long long pos = ((i * 2 + 1) * runsize) / (st.nsamples * 2);
+		schema.copyTuple(dest + i * tuplesize, st.run[pos]);
+	}
+}
+
+void SortOp::pickSplitters()
+{
+	const unsigned int tuplesize = schema.getTupleSize();
+
+	vector<void*> samples;
+	for (unsigned int t=0; t<threads; ++t)
+	{
+		char* src = (char*)samplearea + t * samplesperthread * tuplesize;
+		for (unsigned int i=0; i<state[t].nsamples; ++i)
+		{
+			samples.push_back(src + i * tuplesize);
+		}
+	}
+
+	sort(samples.begin(), samples.end(), TupleOrder(comparator));
+
+	// Splitter k is the first key of range k+1. If there are no samples,
+	// all tuples are in range 0.
+	//
+	nsplitters = 0;
+	if (samples.empty())
+		return;
+
+	for (unsigned int k=1; k<threads; ++k)
+	{
+		void* s = samples[(k * samples.size()) / threads];
+		schema.copyTuple((char*)splitters + nsplitters * tuplesize, s);
+		nsplitters++;
+	}
+}
+
+void SortOp::findBoundaries(unsigned short threadid)
+{
+	State& st = state[threadid];
+	const unsigned int tuplesize = schema.getTupleSize();
+
+	st.bounds.assign(threads + 1, st.run.size());
+	st.bounds[0] = 0;
+
+	for (unsigned int k=0; k<nsplitters; ++k)
+	{
+		void* s = (char*)splitters + k * tuplesize;
+		st.bounds[k+1] = lower_bound(st.run.begin(), st.run.end(), s, 
+				TupleOrder(comparator)) - st.run.begin();
+	}
+}
+
+void SortOp::startMerge(unsigned short threadid)
+{
+	State& st = state[threadid];
+
+	st.cursors.clear();
+	for (unsigned int t=0; t<threads; ++t)
+	{
+		State& src = state[t];
+		if (src.bounds[threadid] == src.bounds[threadid+1])
+			continue;
+
+		Cursor c;
+		c.pos = &src.run[0] + src.bounds[threadid];
+		c.end = &src.run[0] + src.bounds[threadid+1];
+		st.cursors.push_back(c);
+	}
+
+	make_heap(st.cursors.begin(), st.cursors.end(), CursorOrder(comparator));
+}
+
+void SortOp::merge(unsigned short threadid)
+{
+	State& st = state[threadid];
+	const unsigned int tuplesize = schema.getTupleSize();
+
+	vector<Cursor>& cursors = st.cursors;
+	CursorOrder order(comparator);
+	Page* out = NULL;
+
+	while (!cursors.empty())
+	{
+		if (out == NULL || !out->canStoreTuple())
+		{
+			void* space = numaallocate_local("SrtP", sizeof(Page), this);
+			out = new(space) Page(buffsize, tuplesize, this, "SrtM");
+			st.merged.push_back(out);
+		}
+
+		pop_heap(cursors.begin(), cursors.end(), order);
+		Cursor& c = cursors.back();
+
+		void* dest = out->allocateTuple();
+		dbgassert(out->isValidTupleAddress(dest));
+		schema.copyTuple(dest, *c.pos);
+
+		if (++c.pos == c.end)
+		{
+			cursors.pop_back();
+		}
+		else
+		{
+			push_heap(cursors.begin(), cursors.end(), order);
+		}
+	}
+}
+
+Operator::ResultCode SortOp::scanStart(unsigned short threadid,
+		Page* indexdatapage, Schema& indexdataschema)
+{
+	GetNextResultT result;
+	ResultCode rescode;
+	State& st = state[threadid];
+	const unsigned int tuplesize = schema.getTupleSize();
+
+	rescode = nextOp->scanStart(threadid, indexdatapage, indexdataschema);
+	if (rescode == Operator::Error) {
+		return Error;
+	}
+
+	// Copy all input locally.
+	//
+	Page* local = NULL;
+	do {
+		result = nextOp->getNext(threadid);
+
+		Page::Iterator it = result.second->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+			if (local == NULL || !local->canStoreTuple())
+			{
+				void* space = numaallocate_local("SrtP", sizeof(Page), this);
+				local = new(space) Page(buffsize, tuplesize, this, "SrtD");
+				st.pages.push_back(local);
+			}
+			void* dest = local->allocateTuple();
+			schema.copyTuple(dest, tuple);
+			st.run.push_back(dest);
+		}
+	} while (result.first == Operator::Ready);
+
+	rescode = nextOp->scanStop(threadid);
+
+	// Sort local run and take samples.
+	//
+	sort(st.run.begin(), st.run.end(), TupleOrder(comparator));
+	sample(threadid);
+
+	barrier.Arrive();
+
+	if (threadid == 0)
+	{
+		pickSplitters();
+		turn = 0;
+	}
+
+	barrier.Arrive();
+
+	findBoundaries(threadid);
+
+	barrier.Arrive();
+
+	startMerge(threadid);
+	merge(threadid);
+
+	// Threads merge ranges from the runs of all threads, so no run can be
+	// freed before every thread is done.
+	//
+	barrier.Arrive();
+
+	for (unsigned int i=0; i<st.pages.size(); ++i)
+	{
+		st.pages[i]->~Page();
+		numadeallocate(st.pages[i]);
+	}
+	st.pages.clear();
+	st.run.clear();
+
+	// If scan failed, return Error. Otherwise return what scanClose returned.
+	//
+	return ((result.first != Operator::Error) ? rescode : Operator::Error);
+}
+
+void SortOp::waitForTurn(unsigned short threadid)
+{
+	pthread_mutex_lock(&turnlock);
+	while (turn != threadid)
+	{
+		pthread_cond_wait(&turncv, &turnlock);
+	}
+	pthread_mutex_unlock(&turnlock);
+}
+
+void SortOp::passTurn(unsigned short threadid)
+{
+	pthread_mutex_lock(&turnlock);
+	dbgassert(turn == threadid);
+	turn = threadid + 1;
+	pthread_cond_broadcast(&turncv);
+	pthread_mutex_unlock(&turnlock);
+}
+
+Operator::GetNextResultT SortOp::getNext(unsigned short threadid)
+{
+	State& st = state[threadid];
+
+	if (!st.hasturn)
+	{
+		waitForTurn(threadid);
+		st.hasturn = true;
+	}
+
+	// Hand out the merged pages in order. The last page is consumed before
+	// the turn is passed, so no other thread produces output before it.
+	//
+	if (st.nextmerged < st.merged.size())
+		return make_pair(Ready, st.merged[st.nextmerged++]);
+
+	if (!st.passedturn)
+	{
+		passTurn(threadid);
+		st.passedturn = true;
+	}
+
+	Page* out = output[threadid];
+	out->clear();
+	return make_pair(Finished, out);
+}
+
+void SortOp::threadClose(unsigned short threadid)
+{
+	if (output[threadid]) {
+		output[threadid]->~Page();
+		numadeallocate(output[threadid]);
+	}
+	output[threadid] = NULL;
+
+	State& st = state[threadid];
+	for (unsigned int i=0; i<st.pages.size(); ++i)
+	{
+		st.pages[i]->~Page();
+		numadeallocate(st.pages[i]);
+	}
+	for (unsigned int i=0; i<st.merged.size(); ++i)
+	{
+		st.merged[i]->~Page();
+		numadeallocate(st.merged[i]);
+	}
+	state[threadid] = State();
+}
+
+void SortOp::destroy()
+{
+	numadeallocate(samplearea);
+	samplearea = NULL;
+	numadeallocate(splitters);
+	splitters = NULL;
+
+	assert(!pthread_mutex_destroy(&turnlock));
+	assert(!pthread_cond_destroy(&turncv));
+}
@@ -94,22 +94,17 @@ SortAndRangePartitionOp::init(libconfig::Config& root, libconfig::Setting& node)
 	mininclusive.push_back((threads-1)*step+minkey);
 	maxexclusive.push_back(maxkey);
 
-	// Compute max size of staging area used for sorting inputs.
+	// Input is staged in segments that are added as input arrives. The
+	// optional maxtuples hint only sizes the segments.
 	//
-	int maxtuples;
-	maxtuples = node["maxtuples"];
-
-	// Allow for a per-thread variance of 20 buffers + 10% of input size.
-	// This is an ad-hoc metric that worked for SortMergeJoinOp, just
-	// replicating it here for consistency. :)
-	//
-	perthreadtuples = 20 * buffsize/nextOp->getOutSchema().getTupleSize() 
-		+ (maxtuples * 1.1 / threads);
+	segmentsize = stagingSegmentSize(node, "maxtuples",
+			nextOp->getOutSchema().getTupleSize(), threads);
 
 	// Is input already sorted?
 	//
 	string str = node["presorted"];
 	presorted = (str == "yes");
+	sortalgo = parseSortAlgorithm(node);
 	
 	// Create state, output and build/probe staging areas.
 	//
@@ -138,9 +133,10 @@ SortAndRangePartitionOp::threadInit(unsigned short threadid)
 	unsigned int tuplesize;
 	tuplesize = nextOp->getOutSchema().getTupleSize();
 
+	// Replaced by a page that fits the input in scanStart.
+	//
 	space = numaallocate_local("SRPi", sizeof(Page), this);
-	input[threadid] = new (space) 
-		Page(perthreadtuples*tuplesize, tuplesize, this);
+	input[threadid] = new (space) Page(tuplesize, tuplesize, this, "SRPi");
 	
 	space = numaallocate_local("SRPo", sizeof(Page), this);
 	output[threadid] = new (space) Page(buffsize, schema.getTupleSize(), this);
@@ -157,6 +153,7 @@ SortAndRangePartitionOp::threadClose(unsigned short threadid)
 
 	if (input[threadid]) 
 	{
+		input[threadid]->~Page();
 		numadeallocate(input[threadid]);
 	}
 	input[threadid] = NULL;
@@ -175,11 +172,17 @@ namespace {
 
 /**
  * Copies all tuples from source operator \a op into staging area \a page.
+ * Tuples are buffered in segments of \a segmentsize bytes, which are then
+ * compacted into \a page, replacing it if it is too small.
  * Assumes operator has scan-started successfully for this threadid.
  * Error handling is non-existant, asserts if anything is not expected.
  */
-void copySourceIntoPage(Operator* op, Operator::Page* page, unsigned short threadid)
+void copySourceIntoPage(Operator* op, Operator::Page*& page, unsigned short threadid,
+		unsigned long long segmentsize, void* allocsource)
 {
+	unsigned int tuplesize = op->getOutSchema().getTupleSize();
+	SegmentedTupleBuffer staging(segmentsize, tuplesize, allocsource, "SRPi");
+
 	Operator::GetNextResultT result;
 	result.first = Operator::Ready;
 
@@ -193,13 +196,12 @@ void copySourceIntoPage(Operator* op, Operator::Page* page, unsigned short threa
 		if (datastart == 0)
 			continue;
 
-		unsigned int datasize = result.second->getUsedSpace();
-		void* space = page->allocate(datasize);
-		assert(space != NULL);
-		memcpy(space, datastart, datasize);
+		staging.append(datastart, result.second->getUsedSpace());
 	}
 
 	assert(result.first == Operator::Finished);
+
+	moveIntoPage(staging, page, tuplesize, "SRPi", allocsource);
 }
 
 void verifysorted(Operator::Page* page, Schema& schema, unsigned int joinattr)
@@ -226,21 +228,22 @@ void verifysorted(Operator::Page* page, Schema& schema, unsigned int joinattr)
 /**
  * Sorts all tuples in given page.
  */
-void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr)
+void sortAllInPage(Operator::Page* page, Schema& schema, unsigned int joinattr,
+		TupleBuffer::SortAlgorithm algo)
 {
 	unsigned int keyoffset = (unsigned long long)schema.calcOffset(0, joinattr);
 
 	switch(schema.getColumnType(joinattr))
 	{
 		case CT_INTEGER:
-			page->sort<CtInt>(keyoffset);
+			page->sort<CtInt>(keyoffset, algo);
 			break;
 		case CT_LONG:
 		case CT_DATE:
-			page->sort<CtLong>(keyoffset);
+			page->sort<CtLong>(keyoffset, algo);
 			break;
 		case CT_DECIMAL:
-			page->sort<CtDecimal>(keyoffset);
+			page->sort<CtDecimal>(keyoffset, algo);
 			break;
 		default:
 			throw NotYetImplemented();
@@ -259,7 +262,7 @@ SortAndRangePartitionOp::scanStart(unsigned short threadid,
 	// Copy chunks into staging area input[threadid].
 	//
 	assert(Ready == nextOp->scanStart(threadid, indexdatapage, indexdataschema));
-	copySourceIntoPage(nextOp, input[threadid], threadid);
+	copySourceIntoPage(nextOp, input[threadid], threadid, segmentsize, this);
 	assert(Ready == nextOp->scanStop(threadid));
 	state->usedbytes = input[threadid]->getUsedSpace();
 	
@@ -268,7 +271,8 @@ SortAndRangePartitionOp::scanStart(unsigned short threadid,
 	startTimer(&state->sortcycles);
 	if (presorted == false)
 	{
-		sortAllInPage(input[threadid], nextOp->getOutSchema(), attribute);
+		sortAllInPage(input[threadid], nextOp->getOutSchema(), attribute,
+				sortalgo);
 	}
 	stopTimer(&state->sortcycles);
 #ifdef DEBUG
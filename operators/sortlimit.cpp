@@ -34,12 +34,12 @@
 #include "operators.h"
 #include "operators_priv.h"
 
+#include "../util/numaallocate.h"
+
+#include <algorithm>
 #include <sstream>
-#include <iostream>
 using namespace std;
 
-//#define VERBOSE
-
 unsigned short parseSortInput(const string& s)
 {
 	size_t l = s.find('$');
@@ -53,259 +53,299 @@ unsigned short parseSortInput(const string& s)
 	return ss ? ret : -1;
 }
 
-void SortLimit::init(libconfig::Config& root, libconfig::Setting& cfg)
+void parseSortKeys(libconfig::Setting& cfg, Schema& schema,
+		vector<unsigned short>& orderby, vector<bool>& asc)
+{
+	// Read sort key columns.
+	//
+	libconfig::Setting& field = cfg["by"];
+	for (int i=0; i<field.getLength(); ++i)
+	{
+		string projattrstr = field[i];
+		unsigned short col = parseSortInput(projattrstr);
+		if (col >= schema.columns())
+			throw InvalidParameter();
+		orderby.push_back(col);
+	}
+
+	// Read sort order, either for all columns or for each column.
+	//
+	libconfig::Setting& ascnode = cfg["asc"];
+	if (ascnode.getLength() == 1)
+	{
+		asc.assign(orderby.size(), (1 == (int) ascnode[0]));
+	}
+	else if (ascnode.getLength() == (int) orderby.size())
+	{
+		for (int i=0; i<ascnode.getLength(); ++i)
+		{
+			asc.push_back(1 == (int) ascnode[i]);
+		}
+	}
+	else
+	{
+		throw InvalidParameter();
+	}
+}
+
+TupleBuffer::SortAlgorithm parseSortAlgorithm(libconfig::Setting& cfg)
 {
+	string algostr = "comparison";
+	cfg.lookupValue("sortalgorithm", algostr);
+
+	if (algostr == "comparison")
+		return TupleBuffer::ComparisonSort;
+	if (algostr == "radix")
+		return TupleBuffer::RadixSort;
+	if (algostr == "bitonic")
+		return TupleBuffer::BitonicSort;
+	if (algostr == "index")
+		return TupleBuffer::IndexSort;
+
+	throw UnknownAlgorithmException();
+}
 
+void SortLimit::init(libconfig::Config& root, libconfig::Setting& cfg)
+{
 	Operator::init(root, cfg);
 
 	schema = nextOp->getOutSchema();
 
-    //get the sort order list
-    libconfig::Setting& field = cfg["by"];
-    for (int i=0; i<field.getLength(); i+=1)
-    {
-		string projattrstr = field[i];
-        orderby.push_back(parseSortInput(projattrstr));
-    }
+	parseSortKeys(cfg, schema, orderby, asc);
+
+	int lim = cfg["limit"][0];
+	if (lim <= 0)
+		throw InvalidParameter();
+	limit = lim;
+
+	// Thread 0 merges the heaps of all threads, so every thread that runs
+	// this operator must be counted.
+	//
+	int thr = cfg["threads"];
+	if (thr <= 0)
+		throw InvalidParameter();
+	threads = thr;
+	barrier.init(threads);
 
-    //get whether or not its ascending
-    asc = (1==(int)cfg["asc"][0]);
+	comparator.init(schema, orderby, asc);
 
-    //get the limit
-    limit = cfg["limit"][0];
+	sharedthreshold = numaallocate_local("SLtS", schema.getTupleSize(), this);
+	hassharedthreshold = false;
+	thresholdlock.reset();
 
-    for (int i=0; i<MAX_THREADS; ++i) {
-        output.push_back(NULL);
-        state.push_back(State(0, Ready, 0));
+	for (int i=0; i<MAX_THREADS; ++i) 
+	{
+		output.push_back(NULL);
+		state.push_back(State());
 	}
+}
+
+void SortLimit::threadInit(unsigned short threadid)
+{
+	if (threadid >= threads)
+		throw InvalidParameter();
+
+	const unsigned int tuplesize = schema.getTupleSize();
 
-    sortnodesize = 0;
-
-    for (int i = 0 ; i < orderby.size() ; i += 1){
-        allpossible.push_back( vector<Comparator::Comparison>());
-    }
-    int equalpos = 0;
-    while (equalpos < orderby.size() ){
-        vector<Comparator::Comparison> &op = allpossible[equalpos];
-        int i;
-        for (i = 0  ; i < orderby.size()  ; i += 1){
-            if (i < equalpos){
-                op.push_back(Comparator::Equal);
-            }
-            else{
-                if (asc)
-                    op.push_back(Comparator::Less);
-                else
-                    op.push_back(Comparator::Greater);
-                break;
-            }
-        }
-        equalpos += 1;
-    }
-    for (int i = 0 ; i < orderby.size() ; i += 1){
-        faster.push_back(ConjunctionEvaluator());
-        faster.back().init(schema, schema, orderby, orderby, allpossible[i]);
-    }
+	void* space = numaallocate_local("SLtO", sizeof(Page), this);
+	output[threadid] = new(space) Page(buffsize, tuplesize, this);
+
+	State& st = state[threadid];
+	st.arena = numaallocate_local("SLtA", limit * tuplesize, this);
+	st.heap = (void**) numaallocate_local("SLtH", limit * sizeof(void*), this);
+	st.threshold = numaallocate_local("SLtT", tuplesize, this);
+	st.size = 0;
+	st.hasthreshold = false;
+	st.outputpos = 0;
 }
 
-SortLimit::sortnode* SortLimit::createNode(void* tuple, int size){
-    sortnode* t = new sortnode();
-    t->payload = reinterpret_cast<void*>(new char[schema.getTupleSize()]);
-    memcpy(t->payload, tuple, schema.getTupleSize());
-    return t;
-};
+void SortLimit::insert(unsigned short threadid, void* tuple)
+{
+	State& st = state[threadid];
+
+	// Prune against the best threshold seen so far.
+	//
+	if (st.hasthreshold && !comparator.less(tuple, st.threshold))
+		return;
+
+	if (st.size < limit)
+	{
+		void* slot = (char*)st.arena + st.size * schema.getTupleSize();
+		schema.copyTuple(slot, tuple);
+		st.heap[st.size++] = slot;
+		push_heap(st.heap, st.heap + st.size, HeapOrder(comparator));
+		return;
+	}
+
+	// Heap is full. Replace root if tuple precedes it.
+	//
+	if (!comparator.less(tuple, st.heap[0]))
+		return;
 
-void SortLimit::sortHelper(void* tuple)
+	pop_heap(st.heap, st.heap + limit, HeapOrder(comparator));
+	schema.copyTuple(st.heap[limit-1], tuple);
+	push_heap(st.heap, st.heap + limit, HeapOrder(comparator));
+}
+
+void SortLimit::publishThreshold(unsigned short threadid)
+{
+	State& st = state[threadid];
+	const bool full = (st.size == limit);
+
+	if (!full && !hassharedthreshold)
+		return;
+
+	thresholdlock.lock();
+
+	if (full && (!hassharedthreshold 
+				|| comparator.less(st.heap[0], sharedthreshold)))
+	{
+		schema.copyTuple(sharedthreshold, st.heap[0]);
+		hassharedthreshold = true;
+	}
+
+	schema.copyTuple(st.threshold, sharedthreshold);
+	st.hasthreshold = true;
+
+	thresholdlock.unlock();
+}
+
+void SortLimit::mergeHeaps()
 {
-    if (sortnodesize == limit){
-        //might not even need to create another sortnode
-        //run search first before materialize and copy
-
-        sortnode* c = head;
-        bool aheadof ;
-        while (true){
-            aheadof = false;
-            for (int i = 0 ; i < orderby.size()  ; i += 1){
-                //evaluator.init(schema, schema, orderby, orderby,allpossible[i]); 
-                if (faster[i].eval(tuple,c->payload)){
-                    aheadof = true;
-                    break;
-                }
-            }
-            if (aheadof) break;
-            if (c->next!= NULL){
-                c = c->next;
-            }else{
-                break;
-            }
-        }
-
-        //decided we need to add 
-        if (aheadof){
-            sortnode* t =    createNode(tuple, schema.getTupleSize());
-            if (c == head){
-                t->next = head;
-                head->prev = t;
-                head = t;
-            }
-            else {
-                c->prev->next = t;
-                t->prev = c->prev;
-                t->next = c;
-                c->prev = t;
-            }
-
-            last = last->prev;
-            last->next= NULL;
-        }
-
-    }
-    //all is empty, there is no head
-    else if (sortnodesize == 0){
-        head = createNode(tuple, schema.getTupleSize());
-        last = head;
-        sortnodesize += 1;
-    }
-    //not yet hit the limit
-    else if (sortnodesize < limit){
-        sortnode* t = createNode(tuple, schema.getTupleSize());
-
-        //need to sort now
-        //for each node already collected
-        sortnode* c = head;
-        bool aheadof ;
-        while (true){
-            aheadof = false;
-            for (int i = 0 ; i < orderby.size()  ; i += 1){
-                //evaluator.init(schema, schema, orderby, orderby,allpossible[i]); 
-                if (faster[i].eval(t->payload,c->payload)){
-                    aheadof = true;
-                    break;
-                }
-            }
-            if (aheadof) break;
-            if (c->next!= NULL){
-                c = c->next;
-            }else{
-                break;
-            }
-        }
-
-        if (aheadof){
-            if (c == head){
-                t->next = head;
-                head->prev = t;
-                head = t;
-            }
-            else {
-                c->prev->next = t;
-                t->prev = c->prev;
-                t->next = c;
-                c->prev = t;
-            }
-        }
-        else{
-            c->next = t;
-            t->prev = c;
-            last = t;
-        }
-
-        sortnodesize += 1;
-    }
-
-    else{
-        //WTF?!?!?
-        cerr<<"sort op, shouldn't have gotten here\n";
-        throw QueryExecutionError();
-    }
-};
+	// Heaps have been sorted by each thread, so this is a multi-way merge 
+	// of sorted runs that stops after \a limit tuples.
+	//
+	vector<unsigned int> pos(threads, 0);
+
+	merged.clear();
+	merged.reserve(limit);
+
+	while (merged.size() < limit)
+	{
+		int best = -1;
+		for (unsigned int i=0; i<threads; ++i)
+		{
+			if (pos[i] == state[i].size)
+				continue;
+
+			if (best < 0 || comparator.less(state[i].heap[pos[i]], 
+						state[best].heap[pos[best]]))
+			{
+				best = i;
+			}
+		}
+
+		if (best < 0)
+			break;
+
+		merged.push_back(state[best].heap[pos[best]++]);
+	}
+}
 
 Operator::ResultCode SortLimit::scanStart(unsigned short threadid,
 		Page* indexdatapage, Schema& indexdataschema)
 {
-    // AT THE MOMENT ASSUME SORT LIMIT IS NOT PARALLEL CAPABLE, THREADID MUST = 0
-    // IF WANT PARALLEL, MUST MAKE SORT LL HEAD AN ARRAY OF HEADS
-    if (threadid > 0) {
-        cerr<<"sort op, not parallel capable yet, read comment\n";
-        throw NotYetImplemented();
-    }
-
-    ResultCode rescode;
 	GetNextResultT result;
-    void* tuple;
-    Page* in;
-    Operator::ResultCode rc;
-
-    
-
-
-    rescode = nextOp->scanStart(threadid, indexdatapage, indexdataschema);
-    if (rescode == Operator::Error) {
-        return Error;
-    }
-
-    result = nextOp->getNext(threadid);
-    //consume all input and find the limit tuples
-	while (result.first != Operator::Error) {
-        in = result.second;
-        unsigned int tupoffset=0;
-        while ((tuple=in->getTupleOffset(tupoffset++))){
-#ifdef VERBOSE
-            cout << schema.prettyprint(tuple, ' ') << endl;
-#endif
-            
-            sortHelper(tuple);
-
-#ifdef VERBOSE
-            sortnode* pdebug = head;
-            for (int j = 0 ; j < sortnodesize ; j += 1){
-                cout<<"\t\t"<<schema.prettyprint(pdebug->payload, ' ')<<endl;
-                pdebug=pdebug->next;
-            }
-#endif
-        }
-
-        if (result.first == Operator::Finished) break;
-        result = nextOp->getNext(threadid);
+	ResultCode rescode;
+	State& st = state[threadid];
+
+	// Forget the heap and thresholds of a previous execution. The shared
+	// threshold may have been published by a thread that has already 
+	// started this scan, which only loses some pruning.
+	//
+	st.size = 0;
+	st.hasthreshold = false;
+	thresholdlock.lock();
+	hassharedthreshold = false;
+	thresholdlock.unlock();
+
+	rescode = nextOp->scanStart(threadid, indexdatapage, indexdataschema);
+	if (rescode == Operator::Error) {
+		return Error;
 	}
 
-	return rescode;
+	// Consume all input, keeping the best \a limit tuples in local heap.
+	// The threshold is exchanged with other threads once per page.
+	//
+	do {
+		result = nextOp->getNext(threadid);
 
-}
+		Page::Iterator it = result.second->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+			insert(threadid, tuple);
+		}
 
+		publishThreshold(threadid);
+	} while (result.first == Operator::Ready);
 
- Operator::GetNextResultT SortLimit::getNext(unsigned short threadid)
-{
+	rescode = nextOp->scanStop(threadid);
 
-    Page* out = output[threadid];
-    State& st = state[threadid];
-    sortnode* t;
-
-    out->clear();
-
-    while (out->canStoreTuple() && sortnodesize > 0){
-        memcpy(out->atomicAllocateTuple(), head->payload, schema.getTupleSize());
-        t = head->next;
-        if (t != NULL){
-            t->prev = NULL;
-        }
-        delete head;
-        head = t;
-        sortnodesize --;
-    }
-    if (sortnodesize == 0)
-        return make_pair(Finished, output[threadid]);
-    else
-        return make_pair(Ready, output[threadid]);
+	// Sort local heap in output order, then wait for all threads to finish
+	// before merging.
+	//
+	sort_heap(st.heap, st.heap + st.size, HeapOrder(comparator));
+
+	barrier.Arrive();
+
+	if (threadid == 0)
+	{
+		mergeHeaps();
+	}
+	st.outputpos = 0;
+
+	// If scan failed, return Error. Otherwise return what scanClose returned.
+	//
+	return ((result.first != Operator::Error) ? rescode : Operator::Error);
 }
 
-void SortLimit::threadInit(unsigned short threadid)
+Operator::GetNextResultT SortLimit::getNext(unsigned short threadid)
 {
-	output[threadid] = new Page(buffsize, schema.getTupleSize(), this);
-}
+	Page* out = output[threadid];
+	out->clear();
+
+	// Only thread 0 produces output.
+	//
+	if (threadid != 0)
+		return make_pair(Finished, out);
+
+	State& st = state[threadid];
+	while (st.outputpos < merged.size())
+	{
+		if (!out->canStoreTuple())
+			return make_pair(Ready, out);
+
+		void* dest = out->allocateTuple();
+		dbgassert(out->isValidTupleAddress(dest));
+		schema.copyTuple(dest, merged[st.outputpos++]);
+	}
 
+	return make_pair(Finished, out);
+}
 
 void SortLimit::threadClose(unsigned short threadid)
 {
-    delete output[threadid];
+	// Thread 0 outputs tuples from the heaps of all threads, so no heap can
+	// be freed before every thread is done.
+	//
+	barrier.Arrive();
+
+	if (output[threadid]) {
+		output[threadid]->~Page();
+		numadeallocate(output[threadid]);
+	}
+	output[threadid] = NULL;
+
+	State& st = state[threadid];
+	numadeallocate(st.arena);
+	numadeallocate(st.heap);
+	numadeallocate(st.threshold);
+	st = State();
+}
+
+void SortLimit::destroy()
+{
+	numadeallocate(sharedthreshold);
+	sharedthreshold = NULL;
+	merged.clear();
 }
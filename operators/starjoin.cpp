@@ -0,0 +1,454 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "operators.h"
+#include "operators_priv.h"
+
+#include "../util/numaallocate.h"
+
+#include <sstream>
+using std::istringstream;
+using std::make_pair;
+
+StarJoinOp::StarJoinState::StarJoinState(unsigned int dimensions)
+	: input(&EmptyPage), prevresult(Ready), prevoffset(0),
+	  probes(dimensions, 0), misses(dimensions, 0), 
+	  matches(dimensions, NULL), htiter(dimensions), sincereorder(0)
+{
+	for (unsigned int i=0; i<dimensions; ++i)
+	{
+		order.push_back(i);
+	}
+}
+
+void StarJoinOp::init(libconfig::Config& root, libconfig::Setting& node)
+{
+	Operator::init(root, node);
+
+	Schema& factschema = nextOp->getOutSchema();
+
+	threads = (int) node["threads"];
+	barrier.init(threads);
+
+	libconfig::Setting& dimnode = node["dimensions"];
+	if (dimnode.getLength() != static_cast<int>(dimensionOps.size()))
+		throw InvalidParameter();
+
+	// Join key comes first in the hash table of each dimension.
+	//
+	dimensions.resize(dimensionOps.size());
+	for (unsigned int i=0; i<dimensions.size(); ++i)
+	{
+		Dimension& dim = dimensions[i];
+		Schema& dimschema = dimensionOps[i]->getOutSchema();
+
+		dim.buildjattr = (int) dimnode[i]["buildjattr"];
+		dim.probejattr = (int) dimnode[i]["probejattr"];
+		if (dim.buildjattr >= dimschema.columns() 
+				|| dim.probejattr >= factschema.columns())
+			throw IllegalSchemaDeclarationException();
+		if (dimschema.getDictionary(dim.buildjattr) 
+				!= factschema.getDictionary(dim.probejattr))
+			throw InvalidParameter();
+
+		dim.sbuild.add(dimschema.get(dim.buildjattr));
+		dim.buildattrs.push_back(dim.buildjattr);
+	}
+
+	// Parse "P$<n>" and "D<dimension>$<n>", and compute the output schema.
+	//
+	libconfig::Setting& projnode = node["projection"];
+	for (int i=0; i<projnode.getLength(); ++i)
+	{
+		string s = projnode[i];
+		size_t l = s.find('$');
+
+		if (l == string::npos || l == 0)
+			throw InvalidParameter();
+
+		unsigned int attr;
+		istringstream ss(s.substr(l+1));
+		ss >> attr;
+		if (!ss)
+			throw InvalidParameter();
+
+		string source = s.substr(0, l);
+		if (source == "P")
+		{
+			if (attr >= factschema.columns())
+				throw IllegalSchemaDeclarationException();
+
+			projection.push_back(make_pair(-1, attr));
+			schema.add(factschema.get(attr));
+			continue;
+		}
+
+		unsigned int d;
+		istringstream ds(source.substr(1));
+		ds >> d;
+		if (source[0] != 'D' || !ds || d >= dimensions.size())
+			throw InvalidParameter();
+
+		Dimension& dim = dimensions[d];
+		Schema& dimschema = dimensionOps[d]->getOutSchema();
+		if (attr >= dimschema.columns())
+			throw IllegalSchemaDeclarationException();
+
+		dim.sbuild.add(dimschema.get(attr));
+		dim.buildattrs.push_back(attr);
+		projection.push_back(make_pair(static_cast<int>(d), dim.sbuild.columns() - 1));
+		schema.add(dimschema.get(attr));
+	}
+
+	// Initialize hash functions and key comparators, as HashJoinOp does.
+	//
+	for (unsigned int i=0; i<dimensions.size(); ++i)
+	{
+		Dimension& dim = dimensions[i];
+		libconfig::Setting& hashnode = dimnode[i]["hash"];
+
+		dbgassert(!hashnode.exists("field"));
+
+		hashnode.add("field", libconfig::Setting::TypeInt) = (int) dim.buildjattr;
+		dim.buildhasher = TupleHasher::create(dimensionOps[i]->getOutSchema(), hashnode);
+		hashnode.remove("field");
+
+		hashnode.add("field", libconfig::Setting::TypeInt) = (int) dim.probejattr;
+		dim.probehasher = TupleHasher::create(factschema, hashnode);
+		hashnode.remove("field");
+
+		dbgassert(dim.buildhasher.buckets() == dim.probehasher.buckets());
+
+		dim.keycomparator = Schema::createComparator(
+				dim.sbuild, 0,
+				factschema, dim.probejattr,
+				Comparator::NotEqual);
+
+		dim.buildpagesize = dimnode[i]["tuplesperbucket"];
+		dim.buildpagesize *= dim.sbuild.getTupleSize();
+	}
+
+	for (int i=0; i<MAX_THREADS; ++i) 
+	{
+		state.push_back(NULL);
+		output.push_back(NULL);
+	}
+}
+
+void StarJoinOp::threadInit(unsigned short threadid)
+{
+	dbgassert(threadid < threads);
+
+	void* space = numaallocate_local("SJst", sizeof(StarJoinState), this);
+	state[threadid] = new (space) StarJoinState(dimensions.size());
+
+	if (threadid == 0)
+	{
+		for (unsigned int i=0; i<dimensions.size(); ++i)
+		{
+			Dimension& dim = dimensions[i];
+			dim.hashtable.init(dim.buildhasher.buckets(), dim.buildpagesize,
+					dim.sbuild.getTupleSize(), vector<char>(), this);
+		}
+	}
+
+	// Wait for hashtable init before clearing bucket space and creating
+	// iterators.
+	//
+	barrier.Arrive();
+	for (unsigned int i=0; i<dimensions.size(); ++i)
+	{
+		dimensions[i].hashtable.bucketclear(threadid, threads);
+	}
+
+	barrier.Arrive();
+	for (unsigned int i=0; i<dimensions.size(); ++i)
+	{
+		state[threadid]->htiter[i] = dimensions[i].hashtable.createIterator();
+	}
+
+	space = numaallocate_local("SJpg", sizeof(Page), this);
+	output[threadid] = new (space) Page(buffsize, schema.getTupleSize(), this, "SJpg");
+}
+
+/**
+ * BUG: On error, other threads will get stuck at the barrier.
+ */
+Operator::ResultCode StarJoinOp::scanStart(unsigned short threadid,
+		Page* indexdatapage, Schema& indexdataschema)
+{
+	ResultCode rescode;
+
+	// Build the hash table of every dimension.
+	//
+	for (unsigned int i=0; i<dimensionOps.size(); ++i)
+	{
+		GetNextResultT result;
+
+		rescode = dimensionOps[i]->scanStart(threadid, indexdatapage, indexdataschema);
+		if (rescode == Operator::Error) {
+			return Error;
+		}
+
+		while (result.first == Operator::Ready) {
+			result = dimensionOps[i]->getNext(threadid);
+			buildFromPage(i, result.second);
+		}
+
+		if (result.first == Operator::Error) {
+			return Error;
+		}
+
+		rescode = dimensionOps[i]->scanStop(threadid);
+		if (rescode == Operator::Error) {
+			return Error;
+		}
+	}
+
+	// Wait for all threads to finish building before probing.
+	//
+	barrier.Arrive();
+
+	StarJoinState* st = state[threadid];
+	st->input = &EmptyPage;
+	st->prevresult = Ready;
+	st->prevoffset = 0;
+
+	return nextOp->scanStart(threadid, indexdatapage, indexdataschema);
+}
+
+void StarJoinOp::buildFromPage(unsigned int dimension, Page* page)
+{
+	Dimension& dim = dimensions[dimension];
+	Schema& dimschema = dimensionOps[dimension]->getOutSchema();
+	void* tup;
+
+	Page::Iterator it = page->createIterator();
+	while ( (tup = it.next()) )
+	{
+		unsigned int bucket = dim.buildhasher.hash(tup);
+		void* target = dim.hashtable.atomicAllocate(bucket, this);
+
+		for (unsigned int j=0; j<dim.buildattrs.size(); ++j)
+		{
+			dim.sbuild.writeData(target, j, 
+					dimschema.calcOffset(tup, dim.buildattrs[j]));
+		}
+	}
+}
+
+bool StarJoinOp::probeDimensions(StarJoinState* st, void* tup)
+{
+	for (unsigned int k=0; k<st->order.size(); ++k)
+	{
+		unsigned int d = st->order[k];
+		Dimension& dim = dimensions[d];
+		HashTable::Iterator& it = st->htiter[d];
+		void* match;
+
+		st->probes[d]++;
+
+		dim.hashtable.placeIterator(it, dim.probehasher.hash(tup));
+		while ( (match = it.next()) ) {
+			if (!dim.keycomparator.eval(match, tup)) {
+				break;
+			}
+		}
+
+		// Short-circuit on the first miss.
+		if (match == NULL) {
+			st->misses[d]++;
+			return false;
+		}
+
+		st->matches[d] = match;
+	}
+
+	return true;
+}
+
+/**
+ * Insertion sort, as there are only a few dimensions. Dimension a is probed
+ * before dimension b if misses[a]/probes[a] > misses[b]/probes[b].
+ */
+void StarJoinOp::reorderProbes(StarJoinState* st)
+{
+	vector<unsigned int>& order = st->order;
+
+	for (unsigned int i=1; i<order.size(); ++i)
+	{
+		unsigned int d = order[i];
+		unsigned int j = i;
+		while (j > 0)
+		{
+			unsigned int e = order[j-1];
+			if (st->misses[d] * st->probes[e] <= st->misses[e] * st->probes[d])
+				break;
+			order[j] = e;
+			--j;
+		}
+		order[j] = d;
+	}
+
+	// Age observations, so that the order adapts to the input.
+	//
+	for (unsigned int i=0; i<order.size(); ++i)
+	{
+		st->probes[i] /= 2;
+		st->misses[i] /= 2;
+	}
+
+	st->sincereorder = 0;
+}
+
+void StarJoinOp::constructOutputTuple(void* tupfact, StarJoinState* st, void* output)
+{
+	Schema& factschema = nextOp->getOutSchema();
+
+	for (unsigned int j=0; j<projection.size(); ++j)
+	{
+		int source = projection[j].first;
+		unsigned int attr = projection[j].second;
+		void* tupattr = (source < 0)
+			? factschema.calcOffset(tupfact, attr)
+			: dimensions[source].sbuild.calcOffset(st->matches[source], attr);
+		schema.writeData(output, j, tupattr);
+	}
+}
+
+Operator::GetNextResultT StarJoinOp::getNext(unsigned short threadid)
+{
+	StarJoinState* st = state[threadid];
+	Page* out = output[threadid];
+	out->clear();
+
+	// Recover state information and start.
+	// 
+	Page* in = st->input;
+	ResultCode rc = st->prevresult;
+	unsigned int tupoffset = st->prevoffset;
+
+	while (rc != Error) 
+	{
+		void* tuple;
+
+		while ( (tuple = in->getTupleOffset(tupoffset++)) ) 
+		{
+			if (probeDimensions(st, tuple))
+			{
+				void* target = out->allocateTuple();
+				dbg2assert(target != NULL);
+
+				constructOutputTuple(tuple, st, target);
+			}
+
+			if (++st->sincereorder == ReorderInterval)
+				reorderProbes(st);
+
+			// If output buffer full, record state and return.
+			// 
+			if (!out->canStoreTuple()) 
+			{
+				st->input = in;
+				st->prevresult = rc;
+				st->prevoffset = tupoffset;
+				return make_pair(Ready, out);
+			}
+		}
+
+		// If input source depleted, remove state information and return.
+		//
+		if (rc == Finished) 
+		{
+			st->input = &EmptyPage;
+			st->prevoffset = 0;
+			return make_pair(Finished, out);
+		}
+
+		// Read more input.
+		//
+		GetNextResultT result = nextOp->getNext(threadid);
+		rc = result.first;
+		in = result.second;
+		tupoffset = 0;
+	}
+
+	st->prevresult = Error;
+	return make_pair(Error, &EmptyPage);
+}
+
+Operator::ResultCode StarJoinOp::scanStop(unsigned short threadid)
+{
+	return nextOp->scanStop(threadid);
+}
+
+void StarJoinOp::threadClose(unsigned short threadid)
+{
+	if (state[threadid]) {
+		state[threadid]->~StarJoinState();
+		numadeallocate(state[threadid]);
+	}
+	state[threadid] = NULL;
+
+	if (output[threadid]) {
+		numadeallocate(output[threadid]);
+	}
+	output[threadid] = NULL;
+
+	// Wait for all threads to finish, then clear buckets and destroy
+	// hashtables.
+	//
+	barrier.Arrive();
+	for (unsigned int i=0; i<dimensions.size(); ++i)
+	{
+		dimensions[i].hashtable.bucketclear(threadid, threads);
+	}
+
+	barrier.Arrive();
+	if (threadid == 0)
+	{
+		for (unsigned int i=0; i<dimensions.size(); ++i)
+		{
+			dimensions[i].hashtable.destroy();
+		}
+	}
+}
+
+void StarJoinOp::destroy()
+{
+	for (unsigned int i=0; i<dimensions.size(); ++i)
+	{
+		dimensions[i].buildhasher.destroy();
+		dimensions[i].probehasher.destroy();
+	}
+}
@@ -177,10 +177,18 @@ void constructsubtree(
 			tmp = new MemSegmentWriter();
 		else if (type == "filter")
 			tmp = new Filter();
+		else if (type == "adaptivefilter")
+			tmp = new AdaptiveFilter();
+		else if (type == "like")
+			tmp = new LikeFilter();
 		else if (type == "cycle_accountant")
 			tmp = new CycleAccountant();
 		else if (type == "projection")
 			tmp = new Project();
+		else if (type == "materialize")
+			tmp = new MaterializeOp();
+		else if (type == "compute")
+			tmp = new ComputeOp();
 		else if (type == "checker_callstate")
 			tmp = new CallStateChecker();
 		else if (type == "printer_schema")
@@ -191,6 +199,8 @@ void constructsubtree(
 			tmp = new PerfCountPrinter();
 		else if (type == "sort")
 			tmp = new SortLimit();
+		else if (type == "orderby")
+			tmp = new SortOp();
 		else if (type == "printer_bitentropy")
 			tmp = new BitEntropyPrinter();
 		else if (type == "consumer")
@@ -201,6 +211,8 @@ void constructsubtree(
 			tmp = new ThreadIdPrependOp();
 		else if (type == "partition")
 			tmp = new PartitionOp();
+		else if (type == "starjoin")
+			tmp = new StarJoinOp();
 		else
 		{
 			// It's a user-defined type?
@@ -224,6 +236,23 @@ void constructsubtree(
 
 		sanitycheck(cfg, cfgnode, "input");
 		constructsubtree(cfg, cfgnode["input"], &(tmp->nextOp), udops, level+1, depthmap);
+
+		// A star join also has one subtree per dimension.
+		//
+		StarJoinOp* star = dynamic_cast<StarJoinOp*>(tmp);
+		if (star != NULL)
+		{
+			libconfig::Setting& dimnode = cfgnode["dimensions"];
+			for (int i=0; i<dimnode.getLength(); ++i)
+			{
+				if (!dimnode[i].exists("name"))
+					throw MissingParameterException("Cannot find `name' attribute in query subtree.");
+
+				star->dimensionOps.push_back(NULL);
+				constructsubtree(cfg, dimnode[i], &(star->dimensionOps.back()), 
+						udops, level+1, depthmap);
+			}
+		}
 	}
 
 	// Call Operator::init on this node.
@@ -239,6 +268,15 @@ void constructsubtree(
  * emptied, and it's now the responsibility of the Query to destroy the object.
  *
  * @param cfg Configuration file to initialize tree with.
+ * If the top level of the configuration has \c arena = "yes", the query 
+ * allocates from its own QueryArena, starting with operator initialization
+ * in the calling thread. Memory freed by operators is then reused by later
+ * allocations of the query, and all memory is released by destroy().
+ *
+ * If the top level has \c hugepages set to one of "none", "thp", "2MB" or 
+ * "1GB", this huge page policy is applied to all memory the process maps
+ * from now on, including mapped tables. See HugePagePolicy.
+ *
  * @param udops User-defined operator map. Each operator must have been
  * 		allocated with new. If it is used, the entry is set to NULL, and then
  * 		it becomes the Query responsibility to call delete on the operator
@@ -248,6 +286,20 @@ void Query::create(libconfig::Config& cfg, UserDefinedOpMapT& udops)
 {
 	sanitycheck(cfg, cfg.getRoot(), "treeroot");
 
+	string hugepages;
+	if (cfg.getRoot().lookupValue("hugepages", hugepages))
+	{
+		numaallocate_sethugepages(parsehugepagepolicy(hugepages));
+	}
+
+	string usearena = "no";
+	cfg.getRoot().lookupValue("arena", usearena);
+	if (usearena == "yes")
+	{
+		arena = new QueryArena();
+		numaallocate_setarena(arena);
+	}
+
 	constructsubtree(cfg, cfg.lookup("treeroot"), &tree, udops, 0, operatorDepth);
 }
 
@@ -34,6 +34,8 @@
 
 #include "operators/operators.h"
 #include "visitors/allvisitors.h"
+#include "util/arena.h"
+#include "util/numaallocate.h"
 
 #include <map>
 
@@ -41,12 +43,15 @@ class Query
 {
 	public:
 		Query() 
-			: tree(0) 
+			: tree(0), arena(0)
 		{ 
 		}
 
 		inline void threadInit()
 		{
+			if (arena)
+				numaallocate_setarena(arena);
+
 			ThreadInitVisitor tiv(0);
 			accept(&tiv);
 		}
@@ -84,6 +89,10 @@ class Query
 			accept(&rdv);
 		}
 
+		/**
+		 * Destroys and frees all operators. If the query has an arena, all
+		 * its memory is then returned to the system at once.
+		 */
 		inline void destroy()
 		{
 			RecursiveDestroyVisitor rdv;
@@ -91,6 +100,13 @@ class Query
 
 			RecursiveFreeVisitor rfv;
 			accept(&rfv);
+
+			if (arena)
+			{
+				numaallocate_setarena(NULL);
+				delete arena;
+				arena = 0;
+			}
 		}
 
 		inline Schema& getOutSchema() 
@@ -127,6 +143,12 @@ class Query
 	// protected:
 		Operator* tree;
 
+		/**
+		 * Arena that serves the allocations of all threads of this query, 
+		 * or NULL if they go to the process-wide allocator.
+		 */
+		QueryArena* arena;
+
 		typedef std::map<Operator*, int> OperatorDepthT;
 	private:
 		// Map used for pretty-printing and debugging.
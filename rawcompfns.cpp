@@ -36,6 +36,7 @@
 
 #include "rawcompfns.h"
 #include "exceptions.h"
+#include "schema.h"
 
 bool MakesNoSense(void* lhs, void* rhs, int n)
 {
@@ -356,6 +357,39 @@ bool CharCharNotEqual(void* lhs, void* rhs, int n)
 	return strncmp((char*)lhs, (char*)rhs, n) != 0;
 }
 
+// Varchar to varchar comparison
+//
+
+bool VarcharVarcharEqual(void* lhs, void* rhs, int n)
+{
+	return CtVarchar::equals(*(CtVarchar*)lhs, *(CtVarchar*)rhs);
+}
+
+bool VarcharVarcharLess(void* lhs, void* rhs, int n)
+{
+	return CtVarchar::compare(*(CtVarchar*)lhs, *(CtVarchar*)rhs) < 0;
+}
+
+bool VarcharVarcharLessEqual(void* lhs, void* rhs, int n)
+{
+	return CtVarchar::compare(*(CtVarchar*)lhs, *(CtVarchar*)rhs) <= 0;
+}
+
+bool VarcharVarcharGreater(void* lhs, void* rhs, int n)
+{
+	return CtVarchar::compare(*(CtVarchar*)lhs, *(CtVarchar*)rhs) > 0;
+}
+
+bool VarcharVarcharGreaterEqual(void* lhs, void* rhs, int n)
+{
+	return CtVarchar::compare(*(CtVarchar*)lhs, *(CtVarchar*)rhs) >= 0;
+}
+
+bool VarcharVarcharNotEqual(void* lhs, void* rhs, int n)
+{
+	return !CtVarchar::equals(*(CtVarchar*)lhs, *(CtVarchar*)rhs);
+}
+
 // Pointer to pointer comparison
 //
 
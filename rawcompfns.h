@@ -92,5 +92,11 @@ bool CharCharLessEqual(void* lhs, void* rhs, int n);
 bool CharCharGreater(void* lhs, void* rhs, int n);
 bool CharCharGreaterEqual(void* lhs, void* rhs, int n);
 bool CharCharNotEqual(void* lhs, void* rhs, int n);
+bool VarcharVarcharEqual(void* lhs, void* rhs, int n);
+bool VarcharVarcharLess(void* lhs, void* rhs, int n);
+bool VarcharVarcharLessEqual(void* lhs, void* rhs, int n);
+bool VarcharVarcharGreater(void* lhs, void* rhs, int n);
+bool VarcharVarcharGreaterEqual(void* lhs, void* rhs, int n);
+bool VarcharVarcharNotEqual(void* lhs, void* rhs, int n);
 bool PointerPointerEqual(void* lhs, void* rhs, int n);
 bool PointerPointerNotEqual(void* lhs, void* rhs, int n);
@@ -35,6 +35,8 @@
 #include <cassert>
 #include <cstdlib>
 #include "schema.h"
+#include "util/dictionary.h"
+#include "util/stringheap.h"
 #include <iomanip>
 #include <algorithm>
 
@@ -51,6 +53,7 @@ void Schema::add(ColumnSpec desc) {
 	if (desc.type != CT_DATE)
 	{
 		add(desc.type, desc.size);
+		vdictionary.back() = desc.dictionary;
 	} 
 	else
 	{
@@ -69,6 +72,7 @@ void Schema::add(ColumnType ct, const string& formatstr)
 	vct.push_back(ct);
 	voffset.push_back(totalsize);
 	vmetadataidx.push_back(vformatstr.size());
+	vdictionary.push_back(NULL);
 	vformatstr.push_back(formatstr.substr(0, formatstr.find(')')));
 	totalsize += sizeof(CtDate);
 }
@@ -84,6 +88,7 @@ void Schema::add(ColumnType ct, unsigned int size /* = 0 */) {
 	vct.push_back(ct);
 	voffset.push_back(totalsize);
 	vmetadataidx.push_back(-1);
+	vdictionary.push_back(NULL);
 
 	int s=-1;
 	switch (ct) {
@@ -109,6 +114,9 @@ void Schema::add(ColumnType ct, unsigned int size /* = 0 */) {
 		case CT_POINTER:
 			s = sizeof(void*);
 			break;
+		case CT_VARCHAR:
+			s = sizeof(CtVarchar);
+			break;
 		default:
 			throw IllegalSchemaDeclarationException();
 	}
@@ -116,22 +124,27 @@ void Schema::add(ColumnType ct, unsigned int size /* = 0 */) {
 	totalsize+=s;
 }
 
-void Schema::parseTuple(void* dest, const vector<string>& input) {
+void Schema::parseTuple(void* dest, const vector<string>& input, 
+		StringHeap* heap /* = NULL */) {
 	dbg2assert(input.size()>=columns());
 	const char** data = new const char*[columns()];
 	for (unsigned int i=0; i<columns(); ++i) {
 		data[i] = input[i].c_str();
 	}
-	parseTuple(dest, data);
+	parseTuple(dest, data, heap);
 	delete[] data;
 }
 
-void Schema::parseTuple(void* dest, const char** input) {
+void Schema::parseTuple(void* dest, const char** input, 
+		StringHeap* heap /* = NULL */) {
 	for (unsigned int i=0; i<columns(); ++i) {
 		switch (vct[i]) {
 			case CT_INTEGER: {
 				int val;
-				val = atoi(input[i]);
+				if (vdictionary[i] != NULL)
+					val = vdictionary[i]->encode(input[i], strlen(input[i]));
+				else
+					val = atoi(input[i]);
 				writeData(dest, i, &val);
 				break;
 			}
@@ -160,6 +173,20 @@ void Schema::parseTuple(void* dest, const char** input) {
 				writeData(dest, i, &val);
 				break;
 			}
+			case CT_VARCHAR: {
+				CtVarchar val;
+				if (heap == NULL)
+					throw IllegalConversionException();
+				val.length = strlen(input[i]);
+				memset(val.prefix, 0, sizeof(val.prefix));
+				memcpy(val.prefix, input[i], 
+						min<size_t>(val.length, CtVarchar::PrefixSize));
+				val.data = (val.length <= CtVarchar::PrefixSize)
+					? NULL 
+					: heap->store(input[i], val.length);
+				writeData(dest, i, &val);
+				break;
+			}
 			case CT_POINTER:
 				throw IllegalConversionException();
 				break;
@@ -173,7 +200,10 @@ vector<string> Schema::outputTuple(void* data) {
 		ostringstream oss;
 		switch (vct[i]) {
 			case CT_INTEGER: 
-				oss << asInt(data, i);
+				if (vdictionary[i] != NULL)
+					oss << vdictionary[i]->decode(asInt(data, i));
+				else
+					oss << asInt(data, i);
 				break;
 			case CT_LONG: 
 				oss << asLong(data, i);
@@ -198,6 +228,11 @@ vector<string> Schema::outputTuple(void* data) {
 				oss << outbuf;
 				break;
 			}
+			case CT_VARCHAR: {
+				const CtVarchar& val = asVarchar(data, i);
+				oss << string(val.str(), val.length);
+				break;
+			}
 			case CT_POINTER:
 				throw IllegalConversionException();
 				break;
@@ -230,7 +265,11 @@ Schema Schema::create(const libconfig::Setting& line) {
 		itend = (ndx == string::npos) ? val.end() : (val.begin() += ndx);
 		transform(val.begin(), itend, val.begin(), ::tolower);
 
-		if (val.find("int")==0) {
+		if (val.find("varchar")==0) {
+			// Maximum length, if given, is not enforced: bytes are stored
+			// out-of-line, so any length fits.
+			ret.add(CT_VARCHAR);
+		} else if (val.find("int")==0) {
 			ret.add(CT_INTEGER);
 		} else if (val.find("long")==0) {
 			ret.add(CT_LONG);
@@ -55,7 +55,8 @@ enum ColumnType {
 	CT_DECIMAL,	/**< Decimal is sizeof(double). */
 	CT_CHAR,	/**< Char has user-defined length, no zero padding is done in this class. */
 	CT_DATE,	/**< Date is sizeof(CtLong), custom format (see DateT class). */
-	CT_POINTER	/**< Pointer is sizeof(void*). */
+	CT_POINTER,	/**< Pointer is sizeof(void*). */
+	CT_VARCHAR	/**< Varchar is sizeof(CtVarchar), bytes are kept in a StringHeap. */
 };
 
 typedef int CtInt;
@@ -115,6 +116,24 @@ class DateT
 			out->tm_year = (date >> SHIFTYEAR)  & MASKYEAR;
 		}
 
+		/** Returns the year, as in 1998. */
+		inline int year() const
+		{
+			return ((date >> SHIFTYEAR) & MASKYEAR) + 1900;
+		}
+
+		/** Returns the month, from 1 to 12. */
+		inline int month() const
+		{
+			return ((date >> SHIFTMONTH) & MASKMONTH) + 1;
+		}
+
+		/** Returns the day of the month, from 1 to 31. */
+		inline int day() const
+		{
+			return (date >> SHIFTDAY) & MASKDAY;
+		}
+
 	private:
 		static const unsigned long long MASK4  = 0x0000F;
 		static const unsigned long long MASK5  = 0x0001F;
@@ -145,15 +164,88 @@ class DateT
 
 typedef class DateT CtDate;
 
+/**
+ * Inline part of a "varchar" value. The bytes of the string live in a
+ * StringHeap that belongs to the table the value was loaded in, and remain
+ * valid for as long as the table is open.
+ *
+ * The first \a PrefixSize bytes are also kept in \a prefix, zero-padded, so
+ * that most comparisons are decided without following \a data. Strings of
+ * up to \a PrefixSize bytes are only kept in \a prefix, and do not use the
+ * heap.
+ */
+struct VarcharT
+{
+	static const unsigned int PrefixSize = 4;
+
+	unsigned int length;
+	char prefix[PrefixSize];
+	const char* data;
+
+	/** Returns the address of the first byte of the string. */
+	inline const char* str() const
+	{
+		return (length <= PrefixSize) ? prefix : data;
+	}
+
+	/**
+	 * Returns true if \a l and \a r hold the same string. The length and
+	 * prefix are compared as one word, and the heap is only read if they
+	 * match and the strings are longer than the prefix.
+	 */
+	static inline bool equals(const VarcharT& l, const VarcharT& r)
+	{
+		static_assert(sizeof(unsigned int) + PrefixSize == sizeof(CtLong));
+		if (*reinterpret_cast<const CtLong*>(&l) 
+				!= *reinterpret_cast<const CtLong*>(&r))
+			return false;
+		return (l.length <= PrefixSize) 
+			|| memcmp(l.data + PrefixSize, r.data + PrefixSize, 
+					l.length - PrefixSize) == 0;
+	}
+
+	/**
+	 * Returns a negative number, zero, or a positive number if \a l sorts
+	 * before, together with, or after \a r, in byte order. Strings that
+	 * differ in their prefix are ordered without reading the heap.
+	 */
+	static inline int compare(const VarcharT& l, const VarcharT& r)
+	{
+		int res = memcmp(l.prefix, r.prefix, PrefixSize);
+		if (res != 0)
+			return res;
+
+		// Prefixes match. Unless both strings continue in the heap, one is
+		// a prefix of the other, so the shorter string goes first.
+		//
+		if (l.length > PrefixSize && r.length > PrefixSize)
+		{
+			unsigned int len = (l.length < r.length) ? l.length : r.length;
+			res = memcmp(l.data + PrefixSize, r.data + PrefixSize, 
+					len - PrefixSize);
+			if (res != 0)
+				return res;
+		}
+		return (l.length < r.length) ? -1 : ((l.length > r.length) ? 1 : 0);
+	}
+};
+
+typedef struct VarcharT CtVarchar;
+
+class Dictionary;
+class StringHeap;
+
 struct ColumnSpec 
 {
-	ColumnSpec(ColumnType ct, unsigned int sz, const string& str) 
-		: type(ct), size(sz), formatstr(str) 
+	ColumnSpec(ColumnType ct, unsigned int sz, const string& str, 
+			Dictionary* dict = NULL) 
+		: type(ct), size(sz), formatstr(str), dictionary(dict)
 	{ }
 
 	ColumnType type;			/**< Type of field. */
 	unsigned int size;			/**< Size of field, in bytes. */
 	const string& formatstr;	/**< Format string, only valid for CT_DATE. */
+	Dictionary* dictionary;		/**< Dictionary of codes, only valid for CT_INTEGER. */
 };
 
 #include "comparator.h"
@@ -193,6 +285,13 @@ class Schema {
 		inline
 		ColumnSpec get(unsigned int pos);
 
+		/**
+		 * Returns the dictionary that column \a pos holds codes of, or NULL
+		 * if the column is not dictionary-encoded.
+		 */
+		inline
+		Dictionary* getDictionary(unsigned int pos);
+
 		/**
 		 * Get width (in bytes) of column \a pos.
 		 */
@@ -222,6 +321,15 @@ class Schema {
 		inline
 		const CtChar* asString(void* data, unsigned int pos);
 
+		/**
+		 * Return the "varchar" in column \a pos.
+		 * @param data Tuple to work on.
+		 * @param pos Position of column to parse.
+		 * @throw IllegalConversionException.
+		 */
+		inline
+		const CtVarchar& asVarchar(void* data, unsigned int pos);
+
 		/**
 		 * Calculate the position of data item \a pos inside tuple \a data.
 		 * @param data Tuple to work on.
@@ -293,9 +401,14 @@ class Schema {
 		 * @pre Caller must have preallocated enough memory at \a dest.
 		 * @param dest Destination tuple to write.
 		 * @param input Vector of string inputs.
+		 * @param heap Heap to store the bytes of "varchar" columns in. 
+		 * @throw IllegalConversionException Schema has "varchar" columns
+		 * and \a heap is NULL.
 		 */
-		void parseTuple(void* dest, const std::vector<std::string>& input);
-		void parseTuple(void* dest, const char** input);
+		void parseTuple(void* dest, const std::vector<std::string>& input,
+				StringHeap* heap = NULL);
+		void parseTuple(void* dest, const char** input, 
+				StringHeap* heap = NULL);
 
 		/**
 		 * Returns a string representation of each column in the tuple.
@@ -346,6 +459,7 @@ class Schema {
 		vector<unsigned short> voffset;
 		vector<short> vmetadataidx;
 		vector<string> vformatstr;
+		vector<Dictionary*> vdictionary;
 		int totalsize;
 };
 
@@ -87,6 +87,11 @@ void Schema::writeData(void* dest, unsigned int pos, const void* const data)
 			*reinterpret_cast<CtDate*>(d) = *val;
 			break;
 		}
+		case CT_VARCHAR: {
+			const CtVarchar* val = reinterpret_cast<const CtVarchar*>(data);
+			*reinterpret_cast<CtVarchar*>(d) = *val;
+			break;
+		}
 
 	}
 
@@ -124,7 +129,13 @@ ColumnSpec Schema::get(unsigned int pos)
 		(idx == -1) 
 		? UninitializedFormatString 
 		: vformatstr[idx];
-	return ColumnSpec(vct[pos], val2-val1, formatstr);
+	return ColumnSpec(vct[pos], val2-val1, formatstr, vdictionary[pos]);
+}
+
+Dictionary* Schema::getDictionary(unsigned int pos)
+{
+	dbg2assert(pos<columns());
+	return vdictionary[pos];
 }
 
 const CtChar* Schema::asString(void* data, unsigned int pos) 
@@ -138,6 +149,17 @@ const CtChar* Schema::asString(void* data, unsigned int pos)
 	return reinterpret_cast<const CtChar*> (d+voffset[pos]);
 }
 
+const CtVarchar& Schema::asVarchar(void* data, unsigned int pos) 
+{
+#ifdef DEBUG2
+	assert(pos<columns());
+	if (vct[pos]!=CT_VARCHAR)
+		throw IllegalConversionException();
+#endif
+	char* d = reinterpret_cast<char*> (data);
+	return *reinterpret_cast<const CtVarchar*> (d+voffset[pos]);
+}
+
 const CtLong Schema::asLong(void* data, unsigned int pos) 
 {
 #ifdef DEBUG2
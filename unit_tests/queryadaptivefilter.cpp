@@ -0,0 +1,197 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+// Tuple i is (i, i%10, text). The first half of the input has text "aaa" 
+// and the second half "bbb", so the predicate on text is the least
+// selective in the first half and the most selective in the second.
+//
+const int TUPLES = 40000;
+
+using namespace std;
+using namespace libconfig;
+
+int verify[TUPLES];
+
+const char* tempfilename = "testfileadaptivefilter.tmp";
+
+void createfile()
+{
+	ofstream of(tempfilename);
+	for (int i=0; i<TUPLES; ++i)
+	{
+		of << i << "|" << i % 10 << "|" << (i < TUPLES/2 ? "aaa" : "bbb") << endl;
+	}
+	of.close();
+}
+
+void addpredicate(Setting& predicates, int field, const char* op, const char* value)
+{
+	Setting& pred = predicates.add(Setting::TypeGroup);
+	pred.add("field", Setting::TypeInt) = field;
+	pred.add("op", Setting::TypeString) = op;
+	pred.add("value", Setting::TypeString) = value;
+}
+
+/**
+ * Runs ($1 < 5) <combine> ($2 = "aaa") <combine> ($0 >= 100).
+ */
+void runfilter(const char* combine)
+{
+	const int buffsize = 1 << 10;
+	const int threads = 4;
+
+	for (int i=0; i<TUPLES; ++i)
+		verify[i] = 0;
+
+	Config cfg;
+	Query q;
+	ParallelScanOp node1;
+	AdaptiveFilter node2;
+	MergeOp node3;
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = tempfilename;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	Setting& mappinggroup0 = mapping.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mappinggroup0.add(Setting::TypeInt) = i;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "int";
+	schemanode.add(Setting::TypeString) = "char(3)";
+
+	Setting& filternode = cfg.getRoot().add("filter", Setting::TypeGroup);
+	filternode.add("combine", Setting::TypeString) = combine;
+	Setting& predicates = filternode.add("predicates", Setting::TypeList);
+	addpredicate(predicates, 1, "<", "5");
+	addpredicate(predicates, 2, "=", "aaa");
+	addpredicate(predicates, 0, ">=", "100");
+
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	q.tree = &node3;
+	node3.nextOp = &node2;
+	node2.nextOp = &node1;
+
+	node1.init(cfg, scannode);
+	node2.init(cfg, filternode);
+	node3.init(cfg, mergenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v < 0 || v >= TUPLES)
+				fail("Values that never were generated appear in the output stream.");
+			verify[v]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+	q.destroynofree();
+}
+
+void check(bool isand)
+{
+	for (int i=0; i<TUPLES; ++i)
+	{
+		bool p1 = (i % 10) < 5;
+		bool p2 = i < TUPLES/2;
+		bool p3 = i >= 100;
+		bool expected = isand ? (p1 && p2 && p3) : (p1 || p2 || p3);
+
+		if (expected && verify[i] < 1)
+			fail("Tuples are missing from output.");
+		if (expected && verify[i] > 1)
+			fail("Extra tuples are in output.");
+		if (!expected && verify[i] != 0)
+			fail("Tuples that should have been filtered appear in output.");
+	}
+}
+
+int main()
+{
+	createfile();
+
+	runfilter("and");
+	check(true);
+
+	runfilter("or");
+	check(false);
+
+	deletefile(tempfilename);
+
+	return 0;
+}
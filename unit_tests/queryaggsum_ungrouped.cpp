@@ -0,0 +1,192 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+#include <cmath>
+
+#include "common.h"
+const char* tempfilename = "artzimpourtzikaioloulas.tmp";
+
+// #define VERBOSE
+
+const int TUPLES = 1000;
+
+using namespace std;
+using namespace libconfig;
+
+/**
+ * Runs query and returns the sum of the first output column over all output
+ * tuples. Fails if more than \a maxtuples tuples are produced.
+ */
+double compute(Query& q, const int maxtuples) 
+{
+	double total = 0;
+	int outtuples = 0;
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			if (q.getOutSchema().getColumnType(0) == CT_DECIMAL)
+				total += q.getOutSchema().asDecimal(tuple, 0);
+			else
+				total += q.getOutSchema().asLong(tuple, 0);
+			if (++outtuples > maxtuples)
+				fail("Too many tuples in output of ungrouped aggregation.");
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+
+	return total;
+}
+
+/**
+ * Aggregates without grouping on \a sumfield (or counts, if \a sumfield is
+ * negative), and checks result.
+ */
+void dotest(const int threads, const bool global, const int sumfield)
+{
+	Query q;
+
+	const int buffsize = 16;
+
+	createfile(tempfilename, TUPLES);
+
+	MergeOp mergeop;
+	AggregateSum nodesum;
+	AggregateCount nodecount;
+	GenericAggregate* node2 = &nodesum;
+	if (sumfield < 0)
+		node2 = &nodecount;
+	ParallelScanOp node3;
+
+	Config cfg;
+
+	// init mergeop
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// init node2
+	Setting& aggnode2 = cfg.getRoot().add("agg", Setting::TypeGroup);
+	aggnode2.add("fields", Setting::TypeArray);
+	if (sumfield >= 0)
+		aggnode2.add("sumfield", Setting::TypeInt) = sumfield;
+	if (global)
+	{
+		aggnode2.add("global", Setting::TypeBoolean) = true;
+		aggnode2.add("threads", Setting::TypeInt) = threads;
+	}
+	
+	// init node3
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = tempfilename;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	Setting& mappinggroup0 = mapping.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mappinggroup0.add(Setting::TypeInt) = i;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "dec";
+
+	// build plan tree
+	q.tree = &mergeop;
+	mergeop.nextOp = node2;
+	node2->nextOp = &node3;
+
+	// initialize each node
+	node3.init(cfg, scannode);
+	node2->init(cfg, aggnode2);
+	mergeop.init(cfg, mergenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	double result = compute(q, global ? 1 : threads);
+	double expected = (sumfield < 0) ? TUPLES : (TUPLES*(TUPLES+1)/2);
+	if (lrint(result) != lrint(expected))
+		fail("Aggregated value is wrong.");
+
+	q.destroynofree();
+
+	deletefile(tempfilename);
+}
+
+int main()
+{
+	const int threads[] = {1, 2, 4, 8};
+
+	for (unsigned int i=0; i<sizeof(threads)/sizeof(threads[0]); ++i)
+	{
+		dotest(threads[i], false,  0);
+		dotest(threads[i], false,  1);
+		dotest(threads[i], false, -1);
+		dotest(threads[i], true,   0);
+		dotest(threads[i], true,   1);
+		dotest(threads[i], true,  -1);
+	}
+
+	return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+const int TUPLES = 5000;
+
+using namespace std;
+using namespace libconfig;
+
+Query q;
+
+ParallelScanOp node1;
+ComputeOp node2;
+MergeOp node3;
+
+int verify[TUPLES];
+
+const char* expressions[] = {
+	"$0",
+	"$5",
+	"$2 * (1 - $3)",
+	"($1 + $0) / 2",
+	"-$0 * 3 + 7",
+	"year($4)",
+	"month( $4 ) * 100 + day($4)",
+	"int($2)",
+	"decimal($0) / 4",
+	"$1 / ($0 - $0)",
+	"2 * 3.5",
+	"long($0)",
+	"int($1 * 1000000000) + 1",
+};
+
+const char* badexpressions[] = {
+	"$0 +",
+	"($0 + 1",
+	"$0 $1",
+	"$9",
+	"foo($0)",
+	"$5 + 1",
+	"year($0)",
+	"year($4 + 1)",
+	"1.2.3",
+};
+
+double discount(int i)
+{
+	return (i % 10) / 100.0;
+}
+
+void compute() 
+{
+	for (int i=0; i<TUPLES; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	Schema& s = q.getOutSchema();
+
+	if (s.getColumnType(11) != CT_LONG || s.get(11).size != sizeof(CtLong))
+		fail("Conversion to long does not produce a long column.");
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << s.prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = s.asInt(tuple, 0);
+			if (v <= 0 || v > TUPLES)
+				fail("Values that never were generated appear in the output stream.");
+
+			ostringstream name;
+			name << "s" << v;
+			if (strcmp(s.asString(tuple, 1), name.str().c_str()) != 0)
+				fail("Copied char column is wrong.");
+
+			double expected = (v + 0.5) * (1 - discount(v));
+			if (fabs(s.asDecimal(tuple, 2) - expected) > 1e-9)
+				fail("Decimal arithmetic is wrong.");
+			if (s.asLong(tuple, 3) != (3 * v + v) / 2)
+				fail("Long arithmetic is wrong.");
+			if (s.asLong(tuple, 4) != -v * 3 + 7)
+				fail("Negation is wrong.");
+			if (s.asInt(tuple, 5) != 1990 + v % 10)
+				fail("Year extraction is wrong.");
+			if (s.asLong(tuple, 6) != (v % 12 + 1) * 100 + v % 28 + 1)
+				fail("Month or day extraction is wrong.");
+			if (s.asInt(tuple, 7) != v)
+				fail("Conversion to int is wrong.");
+			if (s.asDecimal(tuple, 8) != v / 4.0)
+				fail("Conversion to decimal is wrong.");
+			if (s.asLong(tuple, 9) != 0)
+				fail("Division by zero does not yield zero.");
+			if (s.asDecimal(tuple, 10) != 7.0)
+				fail("Constant expression is wrong.");
+			if (s.asLong(tuple, 11) != v)
+				fail("Conversion to long is wrong.");
+			if (s.asLong(tuple, 12) != (long long)(int)(v * 3 * 1000000000LL) + 1)
+				fail("Conversion to int does not truncate before arithmetic.");
+
+			verify[v-1]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+}
+
+void createfile(const char* filename)
+{
+	ofstream of(filename);
+	for (int i=1; i<=TUPLES; ++i)
+	{
+		of << i << "|" << i * 3 << "|" << i << ".5|" 
+			<< fixed << setprecision(2) << discount(i) << "|" 
+			<< (i % 28 + 1) << "/" << (i % 12 + 1) << "/" << 1990 + i % 10 << "|" 
+			<< "s" << i << endl;
+	}
+	of.close();
+}
+
+int main()
+{
+	const int buffsize = 1 << 16;
+	const int threads = 4;
+
+	const char* tempfilename = "testfilecompute.tmp";
+
+	Config cfg;
+
+	createfile(tempfilename);
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = tempfilename;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	Setting& mappinggroup0 = mapping.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mappinggroup0.add(Setting::TypeInt) = i;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "int";
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "dec";
+	schemanode.add(Setting::TypeString) = "dec";
+	schemanode.add(Setting::TypeString) = "date (%d/%m/%Y)";
+	schemanode.add(Setting::TypeString) = "char(8)";
+
+	// Init node2
+	Setting& computenode = cfg.getRoot().add("compute", Setting::TypeGroup);
+	Setting& exprnode = computenode.add("expressions", Setting::TypeList);
+	for (unsigned int i=0; i<sizeof(expressions)/sizeof(expressions[0]); ++i)
+		exprnode.add(Setting::TypeString) = expressions[i];
+
+	// Init node3
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &node3;
+	node3.nextOp = &node2;
+	node2.nextOp = &node1;
+
+	// initialize each node
+	node1.init(cfg, scannode);
+	node2.init(cfg, computenode);
+	node3.init(cfg, mergenode);
+
+	// Malformed or ill-typed expressions are rejected at init.
+	for (unsigned int i=0; i<sizeof(badexpressions)/sizeof(badexpressions[0]); ++i)
+	{
+		string name = "bad" + string(1, 'a' + i);
+		Setting& badnode = cfg.getRoot().add(name, Setting::TypeGroup);
+		Setting& badexpr = badnode.add("expressions", Setting::TypeList);
+		badexpr.add(Setting::TypeString) = badexpressions[i];
+
+		ComputeOp bad;
+		bad.nextOp = &node1;
+		bool thrown = false;
+		try {
+			bad.init(cfg, badnode);
+		} catch (InvalidParameter&) {
+			thrown = true;
+		} catch (IllegalSchemaDeclarationException&) {
+			thrown = true;
+		}
+		if (!thrown)
+			fail("Bad expression was not rejected.");
+	}
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute();
+
+	for (int i=0; i<TUPLES; ++i) {
+		if (verify[i] < 1)
+			fail("Tuples are missing from output.");
+		if (verify[i] > 1)
+			fail("Extra tuples are in output.");
+	}
+
+	q.destroynofree();
+
+	deletefile(tempfilename);
+
+	return 0;
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+const int NATIONS = 25;
+const int CUSTOMERS = 1000;		// per file
+const int threads = 4;
+
+using namespace std;
+using namespace libconfig;
+
+Query q;
+
+ParallelScanOp node1a;
+ParallelScanOp node1b;
+HashJoinOp node2;
+MergeOp node3;
+
+int verify[CUSTOMERS * threads];
+
+string nationname(int key)
+{
+	ostringstream oss;
+	oss << "NATION" << key;
+	return oss.str();
+}
+
+void compute() 
+{
+	for (int i=0; i<CUSTOMERS * threads; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	Schema& s = q.getOutSchema();
+	if (s.getColumnType(2) != CT_INTEGER || s.getDictionary(2) == NULL)
+		fail("Encoded column is not an integer with a dictionary.");
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << s.prettyprint(tuple, ' ') << endl;
+#endif
+			long long key = s.asLong(tuple, 0);
+			long long cust = s.asLong(tuple, 1);
+			if (cust < 0 || cust >= CUSTOMERS * threads)
+				fail("Values that never were generated appear in the output stream.");
+			if (key != cust % NATIONS)
+				fail("Customer joined with the wrong nation.");
+			if (s.outputTuple(tuple)[2] != nationname(key))
+				fail("Code does not decode to the nation name.");
+			verify[cust]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	// Customers of every file only use names of nations.
+	if (s.getDictionary(2)->size() != NATIONS)
+		fail("Dictionary has a wrong number of values.");
+
+	q.threadClose();
+}
+
+void createfiles(const char* nationfile, const char* customerfile)
+{
+	ofstream nation(nationfile);
+	for (int i=0; i<NATIONS; ++i)
+	{
+		nation << i << "|" << nationname(i) << endl;
+	}
+	nation.close();
+
+	for (int t=0; t<threads; ++t)
+	{
+		ostringstream name;
+		name << customerfile << t;
+		ofstream customer(name.str().c_str());
+		for (int i=t*CUSTOMERS; i<(t+1)*CUSTOMERS; ++i)
+		{
+			customer << i << "|" << nationname(i % NATIONS) << endl;
+		}
+		customer.close();
+	}
+}
+
+/*
+ * Encodes column 1 of \a scannode with the "nation" dictionary.
+ */
+void addDictionary(Setting& scannode)
+{
+	Setting& dictnode = scannode.add("dictionary", Setting::TypeList);
+	Setting& column = dictnode.add(Setting::TypeGroup);
+	column.add("column", Setting::TypeInt) = 1;
+	column.add("name", Setting::TypeString) = "nation";
+}
+
+/**
+ * Checks that a binary scan, which cannot encode columns, is rejected
+ * without holding on to the dictionary it names.
+ */
+void rejectbinary()
+{
+	Dictionary* held = Dictionary::acquire("binary");
+	held->encode("value", 5);
+
+	Config cfg;
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = 1 << 10;
+
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("file", Setting::TypeString) = "nonexistent.tmp";
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "char(25)";
+	Setting& dictnode = scannode.add("dictionary", Setting::TypeList);
+	Setting& column = dictnode.add(Setting::TypeGroup);
+	column.add("column", Setting::TypeInt) = 1;
+	column.add("name", Setting::TypeString) = "binary";
+
+	ScanOp scan;
+	bool thrown = false;
+	try {
+		scan.init(cfg, scannode);
+	} catch (InvalidParameter&) {
+		thrown = true;
+	}
+	if (!thrown)
+		fail("Binary scan with a dictionary was accepted.");
+
+	// If the scan had kept a reference, the old dictionary would survive.
+	Dictionary::release(held);
+	Dictionary* again = Dictionary::acquire("binary");
+	if (again->size() != 0)
+		fail("Rejected scan did not release its dictionary.");
+	Dictionary::release(again);
+}
+
+int main()
+{
+	const int buffsize = 1 << 10;
+
+	const char* tmpfilenation = "testfiledictionarynation.tmp";
+	const char* tmpfilecustomer = "testfiledictionarycustomer.tmp";
+
+	Config cfg;
+
+	createfiles(tmpfilenation, tmpfilecustomer);
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1a
+	Setting& scannode1 = cfg.getRoot().add("scan1", Setting::TypeGroup);
+	scannode1.add("filetype", Setting::TypeString) = "text";
+	Setting& files1 = scannode1.add("files", Setting::TypeList);
+	files1.add(Setting::TypeString) = tmpfilenation;
+	Setting& mapping1 = scannode1.add("mapping", Setting::TypeList);
+	Setting& mapping1group0 = mapping1.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping1group0.add(Setting::TypeInt) = i;
+	Setting& schemanode1 = scannode1.add("schema", Setting::TypeList);
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "char(25)";
+	addDictionary(scannode1);
+
+	// Init node1b, every thread loads and encodes its own file.
+	Setting& scannode2 = cfg.getRoot().add("scan2", Setting::TypeGroup);
+	scannode2.add("filetype", Setting::TypeString) = "text";
+	Setting& files2 = scannode2.add("files", Setting::TypeList);
+	Setting& mapping2 = scannode2.add("mapping", Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+	{
+		ostringstream name;
+		name << tmpfilecustomer << i;
+		files2.add(Setting::TypeString) = name.str();
+		Setting& mapping2group = mapping2.add(Setting::TypeList);
+		mapping2group.add(Setting::TypeInt) = i;
+	}
+	Setting& schemanode2 = scannode2.add("schema", Setting::TypeList);
+	schemanode2.add(Setting::TypeString) = "long";
+	schemanode2.add(Setting::TypeString) = "char(25)";
+	addDictionary(scannode2);
+
+	// Init node2, joining on the codes.
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "modulo";
+	joinhashnode.add("buckets", Setting::TypeInt) = 64;
+
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+
+	joinnode.add("buildjattr", Setting::TypeInt) = 1;
+	joinnode.add("probejattr", Setting::TypeInt) = 1;
+
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "B$0";
+	projectnode.add(Setting::TypeString) = "P$0";
+	projectnode.add(Setting::TypeString) = "P$1";
+
+	// Init node3
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &node3;
+	node3.nextOp = &node2;
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+
+	// initialize each node
+	node1a.init(cfg, scannode1);
+	node1b.init(cfg, scannode2);
+	node2.init(cfg, joinnode);
+	node3.init(cfg, mergenode);
+
+	// Codes can't be joined with plain integers, and aren't ordered.
+	{
+		Setting& badjoinnode = cfg.getRoot().add("badjoin", Setting::TypeGroup);
+		Setting& badhashnode = badjoinnode.add("hash", Setting::TypeGroup);
+		badhashnode.add("fn", Setting::TypeString) = "modulo";
+		badhashnode.add("buckets", Setting::TypeInt) = 64;
+		Setting& badpgnode = badjoinnode.add("threadgroups", Setting::TypeList);
+		badpgnode.add(Setting::TypeArray).add(Setting::TypeInt) = 0;
+		badjoinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+		badjoinnode.add("allocpolicy", Setting::TypeString) = "local";
+		badjoinnode.add("buildjattr", Setting::TypeInt) = 1;
+		badjoinnode.add("probejattr", Setting::TypeInt) = 0;
+		Setting& badprojnode = badjoinnode.add("projection", Setting::TypeList);
+		badprojnode.add(Setting::TypeString) = "P$0";
+
+		HashJoinOp badjoin;
+		badjoin.buildOp = &node1a;
+		badjoin.probeOp = &node1b;
+		bool thrown = false;
+		try {
+			badjoin.init(cfg, badjoinnode);
+		} catch (InvalidParameter&) {
+			thrown = true;
+		}
+		if (!thrown)
+			fail("Join of codes with a plain column was accepted.");
+
+		Setting& filternode = cfg.getRoot().add("badfilter", Setting::TypeGroup);
+		filternode.add("field", Setting::TypeInt) = 1;
+		filternode.add("op", Setting::TypeString) = "<";
+		filternode.add("value", Setting::TypeString) = nationname(1);
+
+		Filter badfilter;
+		badfilter.nextOp = &node1a;
+		thrown = false;
+		try {
+			badfilter.init(cfg, filternode);
+		} catch (InvalidParameter&) {
+			thrown = true;
+		}
+		if (!thrown)
+			fail("Ordering comparison on codes was accepted.");
+	}
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute();
+
+	for (int i=0; i<CUSTOMERS * threads; ++i) {
+		if (verify[i] < 1)
+			fail("Tuples are missing from output.");
+		if (verify[i] > 1)
+			fail("Extra tuples are in output.");
+	}
+
+	q.destroynofree();
+
+	rejectbinary();
+
+	deletefile(tmpfilenation);
+	for (int i=0; i<threads; ++i)
+	{
+		ostringstream name;
+		name << tmpfilecustomer << i;
+		deletefile(name.str().c_str());
+	}
+
+	return 0;
+}
@@ -0,0 +1,362 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+const int TUPLES = 200;
+const int PROBETUPLES = TUPLES + 20;	// Some probe keys fall outside range.
+const int DUPLICATEKEY = TUPLES / 2;
+const long long LONGKEYBASE = 1ll << 40;	// Bounds that do not fit in an int.
+
+using namespace std;
+using namespace libconfig;
+
+int verify[PROBETUPLES];
+
+/**
+ * Runs \a q, and checks that the build side of \a join stayed in the dense
+ * key table if \a expectdense.
+ */
+void compute(Query& q, HashJoinOp& join, bool expectdense) 
+{
+	for (int i=0; i<PROBETUPLES; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v <= 0 || v > TUPLES)
+				fail("Values that never were generated appear in the output stream.");
+			double d1 = q.getOutSchema().asDecimal(tuple, 1);
+			double d2 = v + 0.1;
+			if (d1 != d2)
+				fail("Wrong tuple detected at join output.");
+			verify[v-1]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	if (join.usedDenseKeyTable(0) != expectdense)
+		fail(expectdense ? "Dense key table was not used." 
+				: "Dense key table was used despite a duplicate key.");
+
+	q.threadClose();
+}
+
+void createfiledouble(const char* filename, const unsigned int maxnum,
+		long long keybase)
+{
+	ofstream of(filename);
+	for (unsigned int i=1; i<(maxnum+1); ++i)
+	{
+		of << keybase + i << "|" << fixed << setprecision(1) << i + 0.1 << endl;
+	}
+	of.close();
+}
+
+void createfilelong(const char* filename, const unsigned int maxnum,
+		long long keybase)
+{
+	ofstream of(filename);
+	for (unsigned int i=1; i<(maxnum+1); ++i)
+	{
+		of << keybase + i << "|" << i << endl;
+	}
+	of.close();
+}
+
+/**
+ * Runs the join with the build side read from \a buildfile and the probe side
+ * read from \a probefile, with dense keys in [\a keybase + 1, \a keybase +
+ * TUPLES]. Results are accumulated in the verify[] array.
+ */
+void runjoin(const char* buildfile, const char* probefile, long long keybase,
+		bool expectdense, long maxslots = 0)
+{
+	const int buffsize = 1 << 4;
+	const int threads = 4;
+
+	Query q;
+
+	ParallelScanOp node1a;
+	ParallelScanOp node1b;
+	HashJoinOp node2;
+	MergeOp node3;
+
+	Config cfg;
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1a
+	Setting& scannode1 = cfg.getRoot().add("scan1", Setting::TypeGroup);
+	scannode1.add("filetype", Setting::TypeString) = "text";
+	Setting& files1 = scannode1.add("files", Setting::TypeList);
+	files1.add(Setting::TypeString) = buildfile;
+	Setting& mapping1 = scannode1.add("mapping", Setting::TypeList);
+	Setting& mapping1group0 = mapping1.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping1group0.add(Setting::TypeInt) = i;
+	Setting& schemanode1 = scannode1.add("schema", Setting::TypeList);
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "long";
+
+	// Init node1b
+	Setting& scannode2 = cfg.getRoot().add("scan2", Setting::TypeGroup);
+	scannode2.add("filetype", Setting::TypeString) = "text";
+	Setting& files2 = scannode2.add("files", Setting::TypeList);
+	files2.add(Setting::TypeString) = probefile;
+	Setting& mapping2 = scannode2.add("mapping", Setting::TypeList);
+	Setting& mapping2group0 = mapping2.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping2group0.add(Setting::TypeInt) = i;
+	Setting& schemanode2 = scannode2.add("schema", Setting::TypeList);
+	schemanode2.add(Setting::TypeString) = "long";
+	schemanode2.add(Setting::TypeString) = "dec";
+
+	// Init node2
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+
+	// Hash tree, with data properties of hash function.
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "modulo";
+	joinhashnode.add("buckets", Setting::TypeInt) = 16;
+
+	// Dense key range.
+	Setting& densenode = joinnode.add("densekeys", Setting::TypeArray);
+	densenode.add(Setting::TypeInt) = (long) (keybase + 1);
+	densenode.add(Setting::TypeInt) = (long) (keybase + TUPLES);
+	if (maxslots != 0)
+		joinnode.add("densekeysmaxslots", Setting::TypeInt) = maxslots;
+
+	// Partition group tree.
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+
+	// Join attribute and projection tree.
+	joinnode.add("buildjattr", Setting::TypeInt) = 0;
+	joinnode.add("probejattr", Setting::TypeInt) = 0;
+
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "B$1";
+	projectnode.add(Setting::TypeString) = "P$1";
+
+	// Init node3
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &node3;
+	node3.nextOp = &node2;
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+
+	// initialize each node
+	node1a.init(cfg, scannode1);
+	node1b.init(cfg, scannode2);
+	node2.init(cfg, joinnode);
+	node3.init(cfg, mergenode);
+
+	compute(q, node2, expectdense);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	q.destroynofree();
+}
+
+/**
+ * Checks that bounds that do not fit in an "int" build key are rejected.
+ */
+void rejectintoverflow(const char* buildfile)
+{
+	ParallelScanOp node1a;
+	ParallelScanOp node1b;
+	HashJoinOp node2;
+
+	Config cfg;
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = 1 << 4;
+
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = buildfile;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	mapping.add(Setting::TypeList).add(Setting::TypeInt) = 0;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "int";
+	schemanode.add(Setting::TypeString) = "int";
+
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "modulo";
+	joinhashnode.add("buckets", Setting::TypeInt) = 16;
+	Setting& densenode = joinnode.add("densekeys", Setting::TypeArray);
+	densenode.add(Setting::TypeInt) = 1;
+	densenode.add(Setting::TypeInt) = (long) LONGKEYBASE;
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	pgnode.add(Setting::TypeArray).add(Setting::TypeInt) = 0;
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+	joinnode.add("buildjattr", Setting::TypeInt) = 0;
+	joinnode.add("probejattr", Setting::TypeInt) = 0;
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "B$1";
+	projectnode.add(Setting::TypeString) = "P$1";
+
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+	node1a.init(cfg, scannode);
+	node1b.init(cfg, scannode);
+
+	bool thrown = false;
+	try {
+		node2.init(cfg, joinnode);
+	} catch (InvalidParameter&) {
+		thrown = true;
+	}
+	if (!thrown)
+		fail("Dense key bounds outside the range of an int key were accepted.");
+
+	node1a.destroy();
+	node1b.destroy();
+}
+
+int main()
+{
+	const char* tmpfileint = "testfileinttoint.tmp";
+	const char* tmpfileintdup = "testfileinttointdup.tmp";
+	const char* tmpfiledouble = "testfileinttodouble.tmp";
+
+	const long long keybases[] = { 0, LONGKEYBASE };
+
+	for (unsigned int k=0; k<sizeof(keybases)/sizeof(keybases[0]); ++k)
+	{
+		const long long keybase = keybases[k];
+
+		createfilelong(tmpfileint, TUPLES, keybase);
+		createfiledouble(tmpfiledouble, PROBETUPLES, keybase);
+
+		// Build side with unique keys in range: served from the dense table.
+		//
+		runjoin(tmpfileint, tmpfiledouble, keybase, true);
+
+		for (int i=0; i<PROBETUPLES; ++i) {
+			if (i < TUPLES && verify[i] < 1)
+				fail("Tuples are missing from output.");
+			if (i < TUPLES && verify[i] > 1)
+				fail("Extra tuples are in output.");
+			if (i >= TUPLES && verify[i] != 0)
+				fail("Out of range probe keys produced output.");
+		}
+
+		// Range wider than the slot limit: served from the hash table.
+		//
+		runjoin(tmpfileint, tmpfiledouble, keybase, false, TUPLES - 1);
+
+		for (int i=0; i<PROBETUPLES; ++i) {
+			if (verify[i] != (i < TUPLES ? 1 : 0))
+				fail("Wrong output when dense range exceeds slot limit.");
+		}
+
+		// Build side with one duplicate key: must fall back to hash table.
+		//
+		createfilelong(tmpfileintdup, TUPLES, keybase);
+		{
+			ofstream of(tmpfileintdup, ios::app);
+			of << keybase + DUPLICATEKEY << "|" << DUPLICATEKEY << endl;
+			of.close();
+		}
+
+		runjoin(tmpfileintdup, tmpfiledouble, keybase, false);
+
+		for (int i=0; i<PROBETUPLES; ++i) {
+			int expected = (i >= TUPLES) ? 0 : ((i+1 == DUPLICATEKEY) ? 2 : 1);
+			if (verify[i] < expected)
+				fail("Tuples are missing from output after fallback.");
+			if (verify[i] > expected)
+				fail("Extra tuples are in output after fallback.");
+		}
+	}
+
+	createfile(tmpfileint, TUPLES);
+	rejectintoverflow(tmpfileint);
+
+	deletefile(tmpfileint);
+	deletefile(tmpfileintdup);
+	deletefile(tmpfiledouble);
+
+	return 0;
+}
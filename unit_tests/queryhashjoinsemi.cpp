@@ -0,0 +1,247 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+// Build side has every key in [0, BUILDKEYS) twice, with payload key*10 and
+// key*10+1. Probe side has every key in [PROBEMIN, PROBEMIN+PROBEKEYS)
+// once, with payload key+1000.
+//
+const int BUILDKEYS = 100;
+const int PROBEMIN = 50;
+const int PROBEKEYS = 100;
+const int MAXPAYLOAD = 2000;
+
+using namespace std;
+using namespace libconfig;
+
+int verify[MAXPAYLOAD];
+
+const char* tmpfilebuild = "testfilesemibuild.tmp";
+const char* tmpfileprobe = "testfilesemiprobe.tmp";
+
+void createfiles()
+{
+	ofstream build(tmpfilebuild);
+	for (int k=0; k<BUILDKEYS; ++k)
+	{
+		build << k << "|" << k*10 << endl;
+		build << k << "|" << k*10 + 1 << endl;
+	}
+	build.close();
+
+	ofstream probe(tmpfileprobe);
+	for (int k=PROBEMIN; k<PROBEMIN+PROBEKEYS; ++k)
+	{
+		probe << k << "|" << k + 1000 << endl;
+	}
+	probe.close();
+}
+
+void addscan(Config& cfg, const char* name, const char* file, int threads)
+{
+	Setting& scannode = cfg.getRoot().add(name, Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = file;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	Setting& mappinggroup0 = mapping.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mappinggroup0.add(Setting::TypeInt) = i;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "long";
+}
+
+/**
+ * Runs the join in mode \a jointype, projecting column 1 of \a side, and
+ * counts each output payload in \a verify.
+ */
+void runjoin(const char* jointype, const char* side)
+{
+	const int buffsize = 1 << 4;
+	const int threads = 4;
+
+	for (int i=0; i<MAXPAYLOAD; ++i)
+		verify[i] = 0;
+
+	Config cfg;
+	Query q;
+	ParallelScanOp node1a;
+	ParallelScanOp node1b;
+	HashJoinOp node2;
+	MergeOp node3;
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	addscan(cfg, "scan1", tmpfilebuild, threads);
+	addscan(cfg, "scan2", tmpfileprobe, threads);
+
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "modulo";
+	joinhashnode.add("buckets", Setting::TypeInt) = 16;
+
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 4;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+	joinnode.add("jointype", Setting::TypeString) = jointype;
+	joinnode.add("buildjattr", Setting::TypeInt) = 0;
+	joinnode.add("probejattr", Setting::TypeInt) = 0;
+
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = side;
+
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	q.tree = &node3;
+	node3.nextOp = &node2;
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+
+	node1a.init(cfg, cfg.lookup("scan1"));
+	node1b.init(cfg, cfg.lookup("scan2"));
+	node2.init(cfg, joinnode);
+	node3.init(cfg, mergenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v < 0 || v >= MAXPAYLOAD)
+				fail("Values that never were generated appear in the output stream.");
+			verify[v]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+	q.destroynofree();
+}
+
+bool buildMatches(int key)
+{
+	return key >= PROBEMIN && key < PROBEMIN + PROBEKEYS;
+}
+
+bool probeMatches(int key)
+{
+	return key < BUILDKEYS;
+}
+
+/**
+ * Checks that payload \a v appears once if \a expected, and never otherwise.
+ */
+void check(int v, bool expected)
+{
+	if (expected && verify[v] < 1)
+		fail("Tuples are missing from output.");
+	if (expected && verify[v] > 1)
+		fail("Extra tuples are in output.");
+	if (!expected && verify[v] != 0)
+		fail("Tuples that should have been filtered appear in output.");
+}
+
+int main()
+{
+	createfiles();
+
+	runjoin("leftsemi", "P$1");
+	for (int k=PROBEMIN; k<PROBEMIN+PROBEKEYS; ++k)
+		check(k + 1000, probeMatches(k));
+
+	runjoin("leftanti", "P$1");
+	for (int k=PROBEMIN; k<PROBEMIN+PROBEKEYS; ++k)
+		check(k + 1000, !probeMatches(k));
+
+	runjoin("rightsemi", "B$1");
+	for (int k=0; k<BUILDKEYS; ++k)
+	{
+		check(k*10, buildMatches(k));
+		check(k*10 + 1, buildMatches(k));
+	}
+
+	runjoin("rightanti", "B$1");
+	for (int k=0; k<BUILDKEYS; ++k)
+	{
+		check(k*10, !buildMatches(k));
+		check(k*10 + 1, !buildMatches(k));
+	}
+
+	deletefile(tmpfilebuild);
+	deletefile(tmpfileprobe);
+
+	return 0;
+}
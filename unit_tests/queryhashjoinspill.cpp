@@ -0,0 +1,245 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+// Build side is 16-byte tuples, so this is about 3MB, three times the 
+// memory limit of the join. 
+const int TUPLES = 200000;
+const int PROBETUPLES = TUPLES + 20;	// Some probe keys do not join.
+
+using namespace std;
+using namespace libconfig;
+
+int verify[PROBETUPLES];
+
+/**
+ * Runs \a q, and checks that the build side of \a join was spilled.
+ */
+void compute(Query& q, HashJoinOp& join) 
+{
+	for (int i=0; i<PROBETUPLES; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v <= 0 || v > TUPLES)
+				fail("Values that never were generated appear in the output stream.");
+			double d1 = q.getOutSchema().asDecimal(tuple, 1);
+			double d2 = v + 0.1;
+			if (d1 != d2)
+				fail("Wrong tuple detected at join output.");
+			verify[v-1]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	if (join.spilledBuildTuples() == 0)
+		fail("Build side did not spill under the memory limit.");
+
+	q.threadClose();
+}
+
+void createfiledouble(const char* filename, const unsigned int maxnum)
+{
+	ofstream of(filename);
+	for (unsigned int i=1; i<(maxnum+1); ++i)
+	{
+		of << i << "|" << fixed << setprecision(1) << i + 0.1 << endl;
+	}
+	of.close();
+}
+
+/**
+ * Runs the join with the build side read from \a buildfile and the probe side
+ * read from \a probefile. Results are accumulated in the verify[] array.
+ */
+void runjoin(const char* buildfile, const char* probefile)
+{
+	const int buffsize = 1 << 4;
+	const int threads = 4;
+
+	Query q;
+
+	ParallelScanOp node1a;
+	ParallelScanOp node1b;
+	HashJoinOp node2;
+	MergeOp node3;
+
+	Config cfg;
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1a
+	Setting& scannode1 = cfg.getRoot().add("scan1", Setting::TypeGroup);
+	scannode1.add("filetype", Setting::TypeString) = "text";
+	Setting& files1 = scannode1.add("files", Setting::TypeList);
+	files1.add(Setting::TypeString) = buildfile;
+	Setting& mapping1 = scannode1.add("mapping", Setting::TypeList);
+	Setting& mapping1group0 = mapping1.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping1group0.add(Setting::TypeInt) = i;
+	Setting& schemanode1 = scannode1.add("schema", Setting::TypeList);
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "long";
+
+	// Init node1b
+	Setting& scannode2 = cfg.getRoot().add("scan2", Setting::TypeGroup);
+	scannode2.add("filetype", Setting::TypeString) = "text";
+	Setting& files2 = scannode2.add("files", Setting::TypeList);
+	files2.add(Setting::TypeString) = probefile;
+	Setting& mapping2 = scannode2.add("mapping", Setting::TypeList);
+	Setting& mapping2group0 = mapping2.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping2group0.add(Setting::TypeInt) = i;
+	Setting& schemanode2 = scannode2.add("schema", Setting::TypeList);
+	schemanode2.add(Setting::TypeString) = "long";
+	schemanode2.add(Setting::TypeString) = "dec";
+
+	// Init node2
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+
+	// Hash tree, with data properties of hash function.
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "modulo";
+	joinhashnode.add("buckets", Setting::TypeInt) = 1 << 16;
+
+	// Memory limit, low enough that most partitions spill, and that each
+	// spilled partition is partitioned once more before it fits.
+	Setting& spillnode = joinnode.add("spill", Setting::TypeGroup);
+	spillnode.add("memoryinM", Setting::TypeInt) = 1;
+	spillnode.add("directory", Setting::TypeString) = "./";
+	spillnode.add("partitions", Setting::TypeInt) = 8;
+
+	// Partition group tree.
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+
+	// Join attribute and projection tree.
+	joinnode.add("buildjattr", Setting::TypeInt) = 0;
+	joinnode.add("probejattr", Setting::TypeInt) = 0;
+
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "B$1";
+	projectnode.add(Setting::TypeString) = "P$1";
+
+	// Init node3
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &node3;
+	node3.nextOp = &node2;
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+
+	// initialize each node
+	node1a.init(cfg, scannode1);
+	node1b.init(cfg, scannode2);
+	node2.init(cfg, joinnode);
+	node3.init(cfg, mergenode);
+
+	compute(q, node2);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	q.destroynofree();
+}
+
+int main()
+{
+	const char* tmpfileint = "testfileinttoint.tmp";
+	const char* tmpfiledouble = "testfileinttodouble.tmp";
+
+	createfile(tmpfileint, TUPLES);
+	createfiledouble(tmpfiledouble, PROBETUPLES);
+
+	runjoin(tmpfileint, tmpfiledouble);
+
+	for (int i=0; i<PROBETUPLES; ++i) {
+		if (i < TUPLES && verify[i] < 1)
+			fail("Tuples are missing from output.");
+		if (i < TUPLES && verify[i] > 1)
+			fail("Extra tuples are in output.");
+		if (i >= TUPLES && verify[i] != 0)
+			fail("Probe keys without a match produced output.");
+	}
+
+	deletefile(tmpfileint);
+	deletefile(tmpfiledouble);
+
+	return 0;
+}
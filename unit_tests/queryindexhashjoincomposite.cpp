@@ -0,0 +1,223 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+// Keys are (a, b) pairs, with a in [1, AKEYS] and b in [1, BKEYS]. The probe
+// side also has pairs with b in (BKEYS, BKEYS+EXTRAB], which do not join.
+// The probe is a plain scan, which ignores the index data it is given, so
+// the join has to match the whole key in the hash table.
+//
+const int AKEYS = 30;
+const int BKEYS = 7;
+const int EXTRAB = 2;
+
+using namespace std;
+using namespace libconfig;
+
+Query q;
+
+ScanOp node1a;
+ScanOp node1b;
+IndexHashJoinOp node2;
+
+int verify[AKEYS+1][BKEYS+EXTRAB+1];
+
+void compute() 
+{
+	for (int a=0; a<=AKEYS; ++a)
+		for (int b=0; b<=BKEYS+EXTRAB; ++b)
+			verify[a][b] = 0;
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() == Operator::Error) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long id = q.getOutSchema().asLong(tuple, 0);
+			double d = q.getOutSchema().asDecimal(tuple, 1);
+			int a = id / 100;
+			int b = id % 100;
+			if (a < 1 || a > AKEYS || b < 1 || b > BKEYS)
+				fail("Values that never were generated appear in the output stream.");
+			if (d != id + 0.5)
+				fail("Tuples with different keys were joined.");
+			verify[a][b]++;
+		}
+	}
+
+	if (q.scanStop() == Operator::Error) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+}
+
+void createfiles(const char* buildfile, const char* probefile)
+{
+	ofstream build(buildfile);
+	ofstream probe(probefile);
+	for (int a=1; a<=AKEYS; ++a)
+	{
+		for (int b=1; b<=BKEYS+EXTRAB; ++b)
+		{
+			if (b <= BKEYS)
+				build << a << "|" << b << "|" << a*100 + b << endl;
+			probe << a*100 + b << "." << 5 << "|" << b << "|" << a << endl;
+		}
+	}
+	build.close();
+	probe.close();
+}
+
+int main()
+{
+	const int buffsize = 1 << 6;
+	const int threads = 1;
+
+	const char* tmpfilebuild = "testfilecompositebuild.tmp";
+	const char* tmpfileprobe = "testfilecompositeprobe.tmp";
+
+	Config cfg;
+
+	createfiles(tmpfilebuild, tmpfileprobe);
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1a
+	Setting& scannode1 = cfg.getRoot().add("scan1", Setting::TypeGroup);
+	scannode1.add("filetype", Setting::TypeString) = "text";
+	scannode1.add("file", Setting::TypeString) = tmpfilebuild;
+	Setting& schemanode1 = scannode1.add("schema", Setting::TypeList);
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "int";
+	schemanode1.add(Setting::TypeString) = "long";
+
+	// Init node1b, with key columns in the opposite order.
+	Setting& scannode2 = cfg.getRoot().add("scan2", Setting::TypeGroup);
+	scannode2.add("filetype", Setting::TypeString) = "text";
+	scannode2.add("file", Setting::TypeString) = tmpfileprobe;
+	Setting& schemanode2 = scannode2.add("schema", Setting::TypeList);
+	schemanode2.add(Setting::TypeString) = "dec";
+	schemanode2.add(Setting::TypeString) = "int";
+	schemanode2.add(Setting::TypeString) = "long";
+
+	// Init node2
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+
+	// Hash tree, with data properties of hash function.
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "crc32";
+	joinhashnode.add("buckets", Setting::TypeInt) = 64;
+
+	// Partition group tree.
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+
+	// Join on (a, b).
+	Setting& buildjattr = joinnode.add("buildjattr", Setting::TypeArray);
+	buildjattr.add(Setting::TypeInt) = 0;
+	buildjattr.add(Setting::TypeInt) = 1;
+	Setting& probejattr = joinnode.add("probejattr", Setting::TypeArray);
+	probejattr.add(Setting::TypeInt) = 2;
+	probejattr.add(Setting::TypeInt) = 1;
+
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "B$2";
+	projectnode.add(Setting::TypeString) = "P$0";
+
+	// build plan tree
+	q.tree = &node2;
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+
+	// initialize each node
+	node1a.init(cfg, scannode1);
+	node1b.init(cfg, scannode2);
+	node2.init(cfg, joinnode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute();
+
+	for (int a=1; a<=AKEYS; ++a) {
+		for (int b=1; b<=BKEYS; ++b) {
+			if (verify[a][b] < 1)
+				fail("Tuples are missing from output.");
+			if (verify[a][b] > 1)
+				fail("Extra tuples are in output.");
+		}
+	}
+
+	q.destroynofree();
+
+	deletefile(tmpfilebuild);
+	deletefile(tmpfileprobe);
+
+	return 0;
+}
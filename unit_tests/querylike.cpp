@@ -0,0 +1,198 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+const int TUPLES = 5000;
+
+using namespace std;
+using namespace libconfig;
+
+const char* tempfilename = "testfilelike.tmp";
+
+const char* patterns[] = {
+	"%promo%",
+	"id1%",
+	"%sale",
+	"id_5%",
+	"%pro_o%sa%",
+	"%",
+	"id42",
+	"",
+	"%x%x%sale",
+	"%xxxxxxxxxxxxxxxxxx%",
+	"%_promo_%",
+	"id%%sale",
+};
+
+vector<string> values;
+
+/*
+ * LIKE the slow way, trying every split for each "%".
+ */
+bool reference(const char* s, const char* p)
+{
+	if (*p == 0)
+		return *s == 0;
+	if (*p == '%')
+		return reference(s, p+1) || (*s != 0 && reference(s+1, p));
+	if (*s == 0)
+		return false;
+	return (*p == '_' || *p == *s) && reference(s+1, p+1);
+}
+
+void createfile()
+{
+	ofstream of(tempfilename);
+	for (int i=1; i<=TUPLES; ++i)
+	{
+		ostringstream s;
+		s << "id" << i;
+		if (i % 3 == 0)
+			s << "promo";
+		s << string(i % 23, 'x');
+		if (i % 5 == 0)
+			s << "sale";
+		values.push_back(s.str());
+		of << i << "|" << s.str() << endl;
+	}
+	of.close();
+}
+
+void testpattern(const char* pattern)
+{
+	const int buffsize = 1 << 12;
+
+	Query q;
+	ScanOp node1;
+	LikeFilter node2;
+
+	Config cfg;
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	scannode.add("file", Setting::TypeString) = tempfilename;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "char(40)";
+
+	Setting& likenode = cfg.getRoot().add("like", Setting::TypeGroup);
+	likenode.add("field", Setting::TypeInt) = 1;
+	likenode.add("pattern", Setting::TypeString) = pattern;
+
+	q.tree = &node2;
+	node2.nextOp = &node1;
+
+	node1.init(cfg, scannode);
+	node2.init(cfg, likenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	vector<int> verify(TUPLES, 0);
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v <= 0 || v > TUPLES)
+				fail("Values that never were generated appear in the output stream.");
+			if (values[v-1] != q.getOutSchema().asString(tuple, 1))
+				fail("Output tuple is corrupted.");
+			verify[v-1]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+
+	for (int i=0; i<TUPLES; ++i) {
+		int expected = reference(values[i].c_str(), pattern) ? 1 : 0;
+		if (verify[i] < expected)
+			fail("Matching tuples are missing from output.");
+		if (verify[i] > expected)
+			fail("Tuples that do not match are in output.");
+	}
+
+	q.destroynofree();
+}
+
+int main()
+{
+	createfile();
+
+	for (unsigned int i=0; i<sizeof(patterns)/sizeof(patterns[0]); ++i)
+		testpattern(patterns[i]);
+
+	deletefile(tempfilename);
+
+	return 0;
+}
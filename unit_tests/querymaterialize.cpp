@@ -0,0 +1,304 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+const int TUPLES = 40;
+
+using namespace std;
+using namespace libconfig;
+
+Query q;
+
+ParallelScanOp node1a;
+ParallelScanOp node1b;
+HashJoinOp node2;
+MaterializeOp node3;
+MergeOp node4;
+
+int verify[TUPLES];
+
+void compute() 
+{
+	for (int i=0; i<TUPLES; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v <= 0 || v > TUPLES)
+				fail("Values that never were generated appear in the output stream.");
+			if (q.getOutSchema().asDecimal(tuple, 1) != v + 0.1)
+				fail("Wrong probe column detected at output.");
+			ostringstream name;
+			name << "name" << v;
+			if (strcmp(q.getOutSchema().asString(tuple, 2), name.str().c_str()) != 0)
+				fail("Wrong build column fetched.");
+			if (q.getOutSchema().asLong(tuple, 3) != v * 7)
+				fail("Wrong build column fetched.");
+			verify[v-1]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+}
+
+void createfiles(const char* buildfile, const char* probefile)
+{
+	ofstream build(buildfile);
+	for (int i=1; i<=TUPLES; ++i)
+	{
+		build << i << "|" << i * 7 << "|name" << i << endl;
+	}
+	build.close();
+
+	// Half of the probe tuples have no match.
+	ofstream probe(probefile);
+	for (int i=1; i<=TUPLES*2; ++i)
+	{
+		probe << i << "|" << fixed << setprecision(1) << i + 0.1 << endl;
+	}
+	probe.close();
+}
+
+int main()
+{
+	const int buffsize = 1 << 8;
+	const int threads = 4;
+
+	const char* tmpfilebuild = "testfilematerializebuild.tmp";
+	const char* tmpfileprobe = "testfilematerializeprobe.tmp";
+
+	Config cfg;
+
+	createfiles(tmpfilebuild, tmpfileprobe);
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1a
+	Setting& scannode1 = cfg.getRoot().add("scan1", Setting::TypeGroup);
+	scannode1.add("filetype", Setting::TypeString) = "text";
+	Setting& files1 = scannode1.add("files", Setting::TypeList);
+	files1.add(Setting::TypeString) = tmpfilebuild;
+	Setting& mapping1 = scannode1.add("mapping", Setting::TypeList);
+	Setting& mapping1group0 = mapping1.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping1group0.add(Setting::TypeInt) = i;
+	Setting& schemanode1 = scannode1.add("schema", Setting::TypeList);
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "char(16)";
+
+	// Init node1b
+	Setting& scannode2 = cfg.getRoot().add("scan2", Setting::TypeGroup);
+	scannode2.add("filetype", Setting::TypeString) = "text";
+	Setting& files2 = scannode2.add("files", Setting::TypeList);
+	files2.add(Setting::TypeString) = tmpfileprobe;
+	Setting& mapping2 = scannode2.add("mapping", Setting::TypeList);
+	Setting& mapping2group0 = mapping2.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping2group0.add(Setting::TypeInt) = i;
+	Setting& schemanode2 = scannode2.add("schema", Setting::TypeList);
+	schemanode2.add(Setting::TypeString) = "long";
+	schemanode2.add(Setting::TypeString) = "dec";
+
+	// Init node2
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+
+	// Hash tree, with data properties of hash function.
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "modulo";
+	joinhashnode.add("buckets", Setting::TypeInt) = 16;
+
+	// Partition group tree.
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+
+	joinnode.add("buildjattr", Setting::TypeInt) = 0;
+	joinnode.add("probejattr", Setting::TypeInt) = 0;
+
+	// Only a pointer to the build tuple is kept in the hash table.
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "P$1";
+	projectnode.add(Setting::TypeString) = "B$rowid";
+
+	// Init node3
+	Setting& matnode = cfg.getRoot().add("materialize", Setting::TypeGroup);
+	matnode.add("rowid", Setting::TypeInt) = 1;
+	Setting& rowschemanode = matnode.add("schema", Setting::TypeList);
+	rowschemanode.add(Setting::TypeString) = "long";
+	rowschemanode.add(Setting::TypeString) = "long";
+	rowschemanode.add(Setting::TypeString) = "char(16)";
+	Setting& matprojnode = matnode.add("projection", Setting::TypeList);
+	matprojnode.add(Setting::TypeString) = "R$0";
+	matprojnode.add(Setting::TypeString) = "$0";
+	matprojnode.add(Setting::TypeString) = "R$2";
+	matprojnode.add(Setting::TypeString) = "R$1";
+
+	// Init node4
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &node4;
+	node4.nextOp = &node3;
+	node3.nextOp = &node2;
+	node2.buildOp = &node1a;
+	node2.probeOp = &node1b;
+
+	// initialize each node
+	node1a.init(cfg, scannode1);
+	node1b.init(cfg, scannode2);
+	node2.init(cfg, joinnode);
+	node3.init(cfg, matnode);
+	node4.init(cfg, mergenode);
+
+	// Without a schema, the row schema is the build schema of the join.
+	{
+		Setting& derivednode = cfg.getRoot().add("derived", Setting::TypeGroup);
+		derivednode.add("rowid", Setting::TypeInt) = 1;
+		Setting& derivedprojnode = derivednode.add("projection", Setting::TypeList);
+		derivedprojnode.add(Setting::TypeString) = "R$2";
+
+		MaterializeOp derived;
+		derived.nextOp = &node2;
+		derived.init(cfg, derivednode);
+		if (derived.getOutSchema().getColumnType(0) != CT_CHAR
+				|| derived.getOutSchema().get(0).size != 17)
+			fail("Row schema was not derived from the build side.");
+	}
+
+	// A schema that does not match the build side is rejected.
+	{
+		Setting& badnode = cfg.getRoot().add("badschema", Setting::TypeGroup);
+		badnode.add("rowid", Setting::TypeInt) = 1;
+		Setting& badschemanode = badnode.add("schema", Setting::TypeList);
+		badschemanode.add(Setting::TypeString) = "long";
+		badschemanode.add(Setting::TypeString) = "char(16)";
+		badschemanode.add(Setting::TypeString) = "long";
+		Setting& badprojnode = badnode.add("projection", Setting::TypeList);
+		badprojnode.add(Setting::TypeString) = "R$1";
+
+		MaterializeOp bad;
+		bad.nextOp = &node2;
+		bool thrown = false;
+		try {
+			bad.init(cfg, badnode);
+		} catch (IllegalSchemaDeclarationException&) {
+			thrown = true;
+		}
+		if (!thrown)
+			fail("Row schema that does not match the build side was accepted.");
+	}
+
+	// Row pointers are only projected from tuples of a scan.
+	{
+		TupleCountPrinter counter;
+		counter.nextOp = &node1a;
+		counter.init(cfg, mergenode);
+
+		HashJoinOp bad;
+		bad.buildOp = &counter;
+		bad.probeOp = &node1b;
+		bool thrown = false;
+		try {
+			bad.init(cfg, joinnode);
+		} catch (InvalidParameter&) {
+			thrown = true;
+		}
+		if (!thrown)
+			fail("Row pointers into a build input that is not a scan were accepted.");
+	}
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute();
+
+	for (int i=0; i<TUPLES; ++i) {
+		if (verify[i] < 1)
+			fail("Tuples are missing from output.");
+		if (verify[i] > 1)
+			fail("Extra tuples are in output.");
+	}
+
+	q.destroynofree();
+
+	deletefile(tmpfilebuild);
+	deletefile(tmpfileprobe);
+
+	return 0;
+}
@@ -0,0 +1,227 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <vector>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+const char* tempfilename = "artzimpourtzikaioloulas.tmp";
+
+// #define VERBOSE
+
+const int TUPLES = 5000;
+const int DISTINCT = 23;
+
+using namespace std;
+using namespace libconfig;
+
+/**
+ * Reference order: second column descending, first column ascending.
+ */
+bool refless(const pair<long, double>& l, const pair<long, double>& r)
+{
+	if (l.second != r.second)
+		return l.second > r.second;
+	return l.first < r.first;
+}
+
+/**
+ * Checks that all threads have merged their ranges before thread 0 produces
+ * any output.
+ */
+class CheckedSortOp : public SortOp
+{
+	public:
+		CheckedSortOp() : checked(false) { }
+
+		virtual GetNextResultT getNext(unsigned short threadid)
+		{
+			if (threadid == 0 && !checked)
+			{
+				for (unsigned int t=0; t<threads; ++t)
+				{
+					if (!state[t].cursors.empty() || !state[t].run.empty())
+						fail("Thread 0 emits before all threads have merged.");
+				}
+				checked = true;
+			}
+
+			return SortOp::getNext(threadid);
+		}
+
+		bool checked;
+};
+
+void compute(Query& q, vector<pair<long, double> >& expected) 
+{
+	unsigned int c = 0;
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			if (c >= expected.size())
+				fail("Too many tuples in output.");
+			long v1 = q.getOutSchema().asLong(tuple, 0);
+			double v2 = q.getOutSchema().asDecimal(tuple, 1);
+			if (v1 != expected[c].first || v2 != expected[c].second)
+				fail("Output is not in the desired order.");
+			++c;
+		}
+	}
+
+	if (c != expected.size())
+		fail("Tuples are missing from output.");
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+}
+
+void dotest(const int threads, const int samples)
+{
+	Query q;
+
+	const int buffsize = 16;
+
+	// Create input with many duplicates in the first sort column.
+	//
+	vector<pair<long, double> > expected;
+	std::ofstream of(tempfilename);
+	for (int i=1; i<=TUPLES; ++i)
+	{
+		long v1 = (i * 104729) % TUPLES;
+		double v2 = (i % DISTINCT) + 0.5;
+		of << v1 << "|" << fixed << setprecision(1) << v2 << std::endl;
+		expected.push_back(make_pair(v1, v2));
+	}
+	of.close();
+	sort(expected.begin(), expected.end(), refless);
+
+	MergeOp mergeop;
+	CheckedSortOp node2;
+	ParallelScanOp node3;
+
+	Config cfg;
+
+	// init mergeop
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// init node2
+	Setting& sortnode = cfg.getRoot().add("sort", Setting::TypeGroup);
+	Setting& sortnodeattr = sortnode.add("by", Setting::TypeArray);
+	sortnodeattr.add(Setting::TypeString) = "$1";
+	sortnodeattr.add(Setting::TypeString) = "$0";
+	Setting& sortnodeasc = sortnode.add("asc", Setting::TypeArray);
+	sortnodeasc.add(Setting::TypeInt) = 0;
+	sortnodeasc.add(Setting::TypeInt) = 1;
+	sortnode.add("threads", Setting::TypeInt) = threads;
+	sortnode.add("samples", Setting::TypeInt) = samples;
+	
+	// init node3
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	Setting& scannode = cfg.getRoot().add("scan", Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = tempfilename;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	Setting& mappinggroup0 = mapping.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mappinggroup0.add(Setting::TypeInt) = i;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = "long";
+	schemanode.add(Setting::TypeString) = "dec";
+
+	// build plan tree
+	q.tree = &mergeop;
+	mergeop.nextOp = &node2;
+	node2.nextOp = &node3;
+
+	// initialize each node
+	node3.init(cfg, scannode);
+	node2.init(cfg, sortnode);
+	mergeop.init(cfg, mergenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute(q, expected);
+
+	if (!node2.checked)
+		fail("Sort output was not checked.");
+
+	q.destroynofree();
+
+	deletefile(tempfilename);
+}
+
+int main()
+{
+	dotest(1, 64);
+	dotest(2, 64);
+	dotest(4, 64);
+	dotest(8, 64);
+	dotest(8, 1);
+
+	return 0;
+}
@@ -163,6 +163,7 @@ int main()
     sortnodeasc.add(Setting::TypeInt) = 0;
     Setting& sortnodelimit = sortnode.add("limit", Setting::TypeArray);
     sortnodelimit.add(Setting::TypeInt) = 5;
+    sortnode.add("threads", Setting::TypeInt) = 1;
 
 
 	// init node2
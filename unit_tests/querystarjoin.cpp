@@ -0,0 +1,245 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+// Fact tuple i references dimension 0 with key i%12 and dimension 1 with key
+// i%7. Dimension 0 has keys [1, 10] and dimension 1 has keys [1, 5], so fact
+// tuples with i%12 in {0, 11} or with i%7 in {0, 6} have no match.
+//
+const int FACTS = 5000;
+const int DIM0KEYS = 10;
+const int DIM1KEYS = 5;
+
+using namespace std;
+using namespace libconfig;
+
+Query q;
+
+ParallelScanOp factscan;
+ParallelScanOp dim0scan;
+ParallelScanOp dim1scan;
+StarJoinOp starjoin;
+MergeOp mergeop;
+
+int verify[FACTS];
+
+bool expected(int i)
+{
+	int k0 = i % 12;
+	int k1 = i % 7;
+	return (k0 >= 1 && k0 <= DIM0KEYS && k1 >= 1 && k1 <= DIM1KEYS);
+}
+
+void compute() 
+{
+	for (int i=0; i<FACTS; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << q.getOutSchema().prettyprint(tuple, ' ') << endl;
+#endif
+			long long v = q.getOutSchema().asLong(tuple, 0);
+			if (v < 0 || v >= FACTS)
+				fail("Values that never were generated appear in the output stream.");
+			if (q.getOutSchema().asLong(tuple, 1) != (v % 12) * 100)
+				fail("Wrong attribute of dimension 0 at output.");
+			ostringstream name;
+			name << "n" << v % 7;
+			if (strcmp(q.getOutSchema().asString(tuple, 2), name.str().c_str()) != 0)
+				fail("Wrong attribute of dimension 1 at output.");
+			verify[v]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+}
+
+void createfiles(const char* factfile, const char* dim0file, const char* dim1file)
+{
+	ofstream fact(factfile);
+	for (int i=0; i<FACTS; ++i)
+	{
+		fact << i << "|" << i % 12 << "|" << i % 7 << endl;
+	}
+	fact.close();
+
+	ofstream dim0(dim0file);
+	for (int k=1; k<=DIM0KEYS; ++k)
+	{
+		dim0 << k * 100 << "|" << k << endl;
+	}
+	dim0.close();
+
+	ofstream dim1(dim1file);
+	for (int k=1; k<=DIM1KEYS; ++k)
+	{
+		dim1 << k << "|n" << k << endl;
+	}
+	dim1.close();
+}
+
+void addscan(Config& cfg, const char* name, const char* file, int threads,
+		const char* type0, const char* type1, const char* type2)
+{
+	Setting& scannode = cfg.getRoot().add(name, Setting::TypeGroup);
+	scannode.add("filetype", Setting::TypeString) = "text";
+	Setting& files = scannode.add("files", Setting::TypeList);
+	files.add(Setting::TypeString) = file;
+	Setting& mapping = scannode.add("mapping", Setting::TypeList);
+	Setting& mappinggroup0 = mapping.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mappinggroup0.add(Setting::TypeInt) = i;
+	Setting& schemanode = scannode.add("schema", Setting::TypeList);
+	schemanode.add(Setting::TypeString) = type0;
+	schemanode.add(Setting::TypeString) = type1;
+	if (type2 != NULL)
+		schemanode.add(Setting::TypeString) = type2;
+}
+
+void adddimension(Setting& dimensions, int buildjattr, int probejattr)
+{
+	Setting& dim = dimensions.add(Setting::TypeGroup);
+	dim.add("buildjattr", Setting::TypeInt) = buildjattr;
+	dim.add("probejattr", Setting::TypeInt) = probejattr;
+	dim.add("tuplesperbucket", Setting::TypeInt) = 2;
+	Setting& hashnode = dim.add("hash", Setting::TypeGroup);
+	hashnode.add("fn", Setting::TypeString) = "modulo";
+	hashnode.add("buckets", Setting::TypeInt) = 8;
+}
+
+int main()
+{
+	const int buffsize = 1 << 8;
+	const int threads = 4;
+
+	const char* tmpfilefact = "testfilestarfact.tmp";
+	const char* tmpfiledim0 = "testfilestardim0.tmp";
+	const char* tmpfiledim1 = "testfilestardim1.tmp";
+
+	Config cfg;
+
+	createfiles(tmpfilefact, tmpfiledim0, tmpfiledim1);
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	addscan(cfg, "fact", tmpfilefact, threads, "long", "long", "long");
+	addscan(cfg, "dim0", tmpfiledim0, threads, "long", "long", NULL);
+	addscan(cfg, "dim1", tmpfiledim1, threads, "long", "char(7)", NULL);
+
+	Setting& starnode = cfg.getRoot().add("star", Setting::TypeGroup);
+	starnode.add("threads", Setting::TypeInt) = threads;
+	Setting& dimensions = starnode.add("dimensions", Setting::TypeList);
+	adddimension(dimensions, 1, 1);
+	adddimension(dimensions, 0, 2);
+	Setting& projectnode = starnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "P$0";
+	projectnode.add(Setting::TypeString) = "D0$0";
+	projectnode.add(Setting::TypeString) = "D1$1";
+
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &mergeop;
+	mergeop.nextOp = &starjoin;
+	starjoin.nextOp = &factscan;
+	starjoin.dimensionOps.push_back(&dim0scan);
+	starjoin.dimensionOps.push_back(&dim1scan);
+
+	// initialize each node
+	factscan.init(cfg, cfg.lookup("fact"));
+	dim0scan.init(cfg, cfg.lookup("dim0"));
+	dim1scan.init(cfg, cfg.lookup("dim1"));
+	starjoin.init(cfg, starnode);
+	mergeop.init(cfg, mergenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute();
+
+	for (int i=0; i<FACTS; ++i) {
+		if (expected(i) && verify[i] < 1)
+			fail("Tuples are missing from output.");
+		if (expected(i) && verify[i] > 1)
+			fail("Extra tuples are in output.");
+		if (!expected(i) && verify[i] != 0)
+			fail("Tuples without a match in some dimension are in output.");
+	}
+
+	q.destroynofree();
+
+	deletefile(tmpfilefact);
+	deletefile(tmpfiledim0);
+	deletefile(tmpfiledim1);
+
+	return 0;
+}
@@ -0,0 +1,329 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../operators/operators.h"
+#include "../visitors/allvisitors.h"
+
+#include "common.h"
+
+// #define VERBOSE
+
+const int KEYS = 50;
+const int FACTS = 1000;		// per file
+const int EXCLUDED = 19;	// key that the filter removes
+const int threads = 4;
+
+using namespace std;
+using namespace libconfig;
+
+Query q;
+
+ParallelScanOp node1a;
+ParallelScanOp node1b;
+Filter node2;
+HashJoinOp node3;
+MergeOp node4;
+
+int verify[FACTS * threads];
+
+/*
+ * Returns the name of \a key. One in five names fits in the inline prefix;
+ * the others share their first four bytes, and keys that are seven apart
+ * have names of the same length, so they are told apart in the heap.
+ */
+string keyname(int key)
+{
+	ostringstream oss;
+	if (key % 5 == 0)
+		oss << key;
+	else
+		oss << "abcd" << key << string(key % 7, 'x');
+	return oss.str();
+}
+
+/*
+ * Returns a comment of 1 to 199 bytes, most of which are short. The loader
+ * skips empty fields, so comments are never empty.
+ */
+string comment(int fact)
+{
+	return string(1 + ((fact * 7) % 200 < 150 ? fact % 30 : fact % 199), 'c');
+}
+
+void compute() 
+{
+	for (int i=0; i<FACTS * threads; ++i) {
+		verify[i] = 0;
+	}
+
+	q.threadInit();
+
+	Operator::Page* out;
+	Operator::GetNextResultT result; 
+	
+	if (q.scanStart() != Operator::Ready) {
+		fail("Scan initialization failed.");
+	}
+
+	Schema& s = q.getOutSchema();
+	if (s.getColumnType(2) != CT_VARCHAR || s.getColumnType(3) != CT_VARCHAR)
+		fail("Output columns are not varchars.");
+	if (s.getTupleSize() != sizeof(CtLong) * 2 + sizeof(CtVarchar) * 2)
+		fail("Varchar columns are not stored out of line.");
+
+	while(result.first == Operator::Ready) {
+		result = q.getNext();
+
+		out = result.second;
+
+		Operator::Page::Iterator it = out->createIterator();
+		void* tuple;
+		while ( (tuple = it.next()) ) {
+#ifdef VERBOSE
+			cout << s.prettyprint(tuple, ' ') << endl;
+#endif
+			long long key = s.asLong(tuple, 0);
+			long long fact = s.asLong(tuple, 1);
+			if (fact < 0 || fact >= FACTS * threads)
+				fail("Values that never were generated appear in the output stream.");
+			if (key != fact % KEYS || key == EXCLUDED)
+				fail("Fact joined with the wrong key.");
+
+			const vector<string>& text = s.outputTuple(tuple);
+			if (text[2] != keyname(key))
+				fail("Join key is not printed as the original string.");
+			if (text[3] != comment(fact))
+				fail("Comment is not printed as the original string.");
+			const CtVarchar& val = s.asVarchar(tuple, 3);
+			if (val.length != comment(fact).size())
+				fail("Comment has a wrong length.");
+			verify[fact]++;
+		}
+	}
+
+	if (q.scanStop() != Operator::Ready) {
+		fail("Scan stop failed.");
+	}
+
+	q.threadClose();
+}
+
+void createfiles(const char* keyfile, const char* factfile)
+{
+	ofstream keys(keyfile);
+	for (int i=0; i<KEYS; ++i)
+	{
+		keys << i << "|" << keyname(i) << endl;
+	}
+	keys.close();
+
+	for (int t=0; t<threads; ++t)
+	{
+		ostringstream name;
+		name << factfile << t;
+		ofstream facts(name.str().c_str());
+		for (int i=t*FACTS; i<(t+1)*FACTS; ++i)
+		{
+			facts << i << "|" << keyname(i % KEYS) << "|" << comment(i) << endl;
+		}
+		facts.close();
+	}
+}
+
+/*
+ * Checks comparisons of varchars, against the order of std::string.
+ */
+void testcompare()
+{
+	Schema s;
+	s.add(CT_VARCHAR);
+	s.add(CT_VARCHAR);
+	StringHeap heap;
+	char tuple[sizeof(CtVarchar) * 2];
+
+	const char* values[] = { "", "a", "ab", "abcd", "abcde", "abcdx", 
+		"abcdxxxxxxxx", "abcdxxxxxxxy", "abce", "b" };
+	const int count = sizeof(values) / sizeof(values[0]);
+
+	Comparator less = Schema::createComparator(s, 0, s, 1, Comparator::Less);
+	Comparator equal = Schema::createComparator(s, 0, s, 1, Comparator::Equal);
+
+	for (int i=0; i<count; ++i)
+	{
+		for (int j=0; j<count; ++j)
+		{
+			const char* input[] = { values[i], values[j] };
+			s.parseTuple(tuple, input, &heap);
+
+			// Both sides compare their own copies, not the same bytes.
+			if (less.eval(tuple, tuple) != (string(values[i]) < string(values[j])))
+				fail("Varchar less-than does not follow byte order.");
+			if (equal.eval(tuple, tuple) != (i == j))
+				fail("Varchar equality is wrong.");
+		}
+	}
+}
+
+int main()
+{
+	const int buffsize = 1 << 10;
+
+	const char* tmpfilekeys = "testfilevarcharkeys.tmp";
+	const char* tmpfilefacts = "testfilevarcharfacts.tmp";
+
+	testcompare();
+
+	Config cfg;
+
+	createfiles(tmpfilekeys, tmpfilefacts);
+
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = buffsize;
+
+	// Init node1a
+	Setting& scannode1 = cfg.getRoot().add("scan1", Setting::TypeGroup);
+	scannode1.add("filetype", Setting::TypeString) = "text";
+	Setting& files1 = scannode1.add("files", Setting::TypeList);
+	files1.add(Setting::TypeString) = tmpfilekeys;
+	Setting& mapping1 = scannode1.add("mapping", Setting::TypeList);
+	Setting& mapping1group0 = mapping1.add(Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+		mapping1group0.add(Setting::TypeInt) = i;
+	Setting& schemanode1 = scannode1.add("schema", Setting::TypeList);
+	schemanode1.add(Setting::TypeString) = "long";
+	schemanode1.add(Setting::TypeString) = "varchar(20)";
+
+	// Init node1b, every thread loads its own file.
+	Setting& scannode2 = cfg.getRoot().add("scan2", Setting::TypeGroup);
+	scannode2.add("filetype", Setting::TypeString) = "text";
+	Setting& files2 = scannode2.add("files", Setting::TypeList);
+	Setting& mapping2 = scannode2.add("mapping", Setting::TypeList);
+	for (int i=0; i<threads; ++i)
+	{
+		ostringstream name;
+		name << tmpfilefacts << i;
+		files2.add(Setting::TypeString) = name.str();
+		Setting& mapping2group = mapping2.add(Setting::TypeList);
+		mapping2group.add(Setting::TypeInt) = i;
+	}
+	Setting& schemanode2 = scannode2.add("schema", Setting::TypeList);
+	schemanode2.add(Setting::TypeString) = "long";
+	schemanode2.add(Setting::TypeString) = "varchar(20)";
+	schemanode2.add(Setting::TypeString) = "varchar(200)";
+
+	// Init node2, removing one key that has the same prefix and length as
+	// another.
+	Setting& filternode = cfg.getRoot().add("filter", Setting::TypeGroup);
+	filternode.add("field", Setting::TypeInt) = 1;
+	filternode.add("op", Setting::TypeString) = "<>";
+	filternode.add("value", Setting::TypeString) = keyname(EXCLUDED);
+
+	// Init node3, joining on the varchars.
+	Setting& joinnode = cfg.getRoot().add("join", Setting::TypeGroup);
+
+	Setting& joinhashnode = joinnode.add("hash", Setting::TypeGroup);
+	joinhashnode.add("fn", Setting::TypeString) = "crc32";
+	joinhashnode.add("buckets", Setting::TypeInt) = 64;
+
+	Setting& pgnode = joinnode.add("threadgroups", Setting::TypeList);
+	Setting& singlepart = pgnode.add(Setting::TypeArray);
+	for (int i=0; i<threads; ++i)
+		singlepart.add(Setting::TypeInt) = i;
+
+	joinnode.add("tuplesperbucket", Setting::TypeInt) = 2;
+	joinnode.add("allocpolicy", Setting::TypeString) = "local";
+
+	joinnode.add("buildjattr", Setting::TypeInt) = 1;
+	joinnode.add("probejattr", Setting::TypeInt) = 1;
+
+	Setting& projectnode = joinnode.add("projection", Setting::TypeList);
+	projectnode.add(Setting::TypeString) = "B$0";
+	projectnode.add(Setting::TypeString) = "P$0";
+	projectnode.add(Setting::TypeString) = "B$1";
+	projectnode.add(Setting::TypeString) = "P$2";
+
+	// Init node4
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("threads", Setting::TypeInt) = threads;
+
+	// build plan tree
+	q.tree = &node4;
+	node4.nextOp = &node3;
+	node3.buildOp = &node1a;
+	node3.probeOp = &node2;
+	node2.nextOp = &node1b;
+
+	// initialize each node
+	node1a.init(cfg, scannode1);
+	node1b.init(cfg, scannode2);
+	node2.init(cfg, filternode);
+	node3.init(cfg, joinnode);
+	node4.init(cfg, mergenode);
+
+#ifdef VERBOSE
+	cout << "---------- QUERY PLAN START ----------" << endl;
+	PrettyPrinterVisitor ppv;
+	q.accept(&ppv);
+	cout << "----------- QUERY PLAN END -----------" << endl;
+#endif
+
+	compute();
+
+	for (int i=0; i<FACTS * threads; ++i) {
+		int expected = (i % KEYS == EXCLUDED) ? 0 : 1;
+		if (verify[i] < expected)
+			fail("Tuples are missing from output.");
+		if (verify[i] > expected)
+			fail("Extra tuples are in output.");
+	}
+
+	q.destroynofree();
+
+	deletefile(tmpfilekeys);
+	for (int i=0; i<threads; ++i)
+	{
+		ostringstream name;
+		name << tmpfilefacts << i;
+		deletefile(name.str().c_str());
+	}
+
+	return 0;
+}
@@ -38,6 +38,7 @@
 #include <sstream>
 
 #include "../hash.h"
+#include "../util/buffer.h"
 
 #include "common.h"
 
@@ -143,6 +144,144 @@ void testExactRange()
 	}
 }
 
+/**
+ * Checks that hashBatch() agrees with hash() for tuples of a long key, an
+ * int key and a char key, and that every hash kernel this CPU supports
+ * returns the same values.
+ */
+void testHashBatch()
+{
+	const unsigned int tuples = 3000;
+
+	Schema schema;
+	schema.add(CT_LONG);
+	schema.add(CT_INTEGER);
+	schema.add(CT_CHAR, 13);
+
+	TupleBuffer page(tuples * schema.getTupleSize(), schema.getTupleSize(), NULL);
+	for (unsigned int i=0; i<tuples; ++i)
+	{
+		void* tup = page.allocateTuple();
+		CtLong l = (i % 7 == 0) ? -lrand48() : lrand48() * (CtLong) lrand48();
+		CtInt n = (i % 5 == 0) ? -i : i;
+		ostringstream oss;
+		oss << "key" << lrand48();
+		schema.writeData(tup, 0, &l);
+		schema.writeData(tup, 1, &n);
+		schema.writeData(tup, 2, oss.str().c_str());
+	}
+
+	const char* fns[] = { "bytes", "crc32", "modulo", "knuth", "multiplyshift", 
+		"willis", "alwayszero" };
+	const int fields[] = { 0, 1, 2 };
+
+	for (unsigned int f=0; f<sizeof(fns)/sizeof(fns[0]); ++f)
+	{
+		for (unsigned int c=0; c<sizeof(fields)/sizeof(fields[0]); ++c)
+		{
+			string fn = fns[f];
+			bool bytes = (fn == "bytes" || fn == "crc32" || fn == "alwayszero");
+			if (!bytes && fields[c] == 2)
+				continue;
+
+			libconfig::Config cfg;
+			libconfig::Setting& node = cfg.getRoot().add("hash", libconfig::Setting::TypeGroup);
+			node.add("fn", libconfig::Setting::TypeString) = fn;
+			node.add("buckets", libconfig::Setting::TypeInt) = 1024;
+			node.add("field", libconfig::Setting::TypeInt) = fields[c];
+			TupleHasher hasher = TupleHasher::create(schema, node);
+
+			unsigned int out[TupleHasher::BatchSize];
+			for (unsigned int first=0; first<tuples; first+=TupleHasher::BatchSize)
+			{
+				unsigned int count = min(TupleHasher::BatchSize, tuples - first);
+				hasher.hashBatch(&page, first, count, out);
+				for (unsigned int i=0; i<count; ++i)
+				{
+					unsigned int h = hasher.hash(page.getTupleOffset(first + i));
+					if (out[i] != h)
+						fail("Batch hash differs from tuple-at-a-time hash.");
+					if (h >= hasher.buckets())
+						fail("Batch hash out of bounds.");
+				}
+			}
+
+			hasher.destroy();
+		}
+	}
+
+	// Every kernel the CPU has must agree with the scalar one.
+	//
+	const unsigned int stride = schema.getTupleSize();
+	char* first = static_cast<char*>(page.getTupleOffset(0));
+	unsigned int* expected = new unsigned int[tuples];
+	unsigned int* actual = new unsigned int[tuples];
+	HashKernelIsa best = hashKernelDetectIsa();
+
+	for (int isa=HashKernelScalar; isa<=best; ++isa)
+	{
+		for (unsigned int log2buckets=0; log2buckets<=32; log2buckets+=8)
+		{
+			hashmultiplyshift(first, tuples, stride, 8, log2buckets, expected, HashKernelScalar);
+			hashmultiplyshift(first, tuples, stride, 8, log2buckets, actual, (HashKernelIsa) isa);
+			if (memcmp(expected, actual, tuples * sizeof(unsigned int)) != 0)
+				fail("Multiply-shift kernels disagree on long keys.");
+
+			hashmultiplyshift(first + 8, tuples, stride, 4, log2buckets, expected, HashKernelScalar);
+			hashmultiplyshift(first + 8, tuples, stride, 4, log2buckets, actual, (HashKernelIsa) isa);
+			if (memcmp(expected, actual, tuples * sizeof(unsigned int)) != 0)
+				fail("Multiply-shift kernels disagree on int keys.");
+		}
+
+		for (unsigned int size=1; size<=stride; ++size)
+		{
+			hashcrc32(first, tuples, stride, size, 0xFFFFFFFFu, expected, HashKernelScalar);
+			hashcrc32(first, tuples, stride, size, 0xFFFFFFFFu, actual, (HashKernelIsa) isa);
+			if (memcmp(expected, actual, tuples * sizeof(unsigned int)) != 0)
+				fail("CRC32 kernels disagree.");
+		}
+	}
+
+	// An int and a long with the same value must hash alike.
+	//
+	CtLong l = -12345;
+	CtInt n = -12345;
+	MultiplyShiftValueHasher msh(1 << 20);
+	if (msh.hash(&l, sizeof(l)) != msh.hash(&n, sizeof(n)))
+		fail("Multiply-shift hashes int and long values differently.");
+
+	// The standard CRC32-C check value, before the final inversion.
+	//
+	if (~crc32key("123456789", 9) != 0xE3069283u)
+		fail("CRC32-C of check string is wrong.");
+
+	delete[] expected;
+	delete[] actual;
+}
+
+/**
+ * Splitter hashers are internal to PartitionOp and cannot be configured.
+ */
+void testSplittersNotConfigurable()
+{
+	Schema schema;
+	schema.add(CT_LONG);
+
+	libconfig::Config cfg;
+	libconfig::Setting& node = cfg.getRoot().add("hash", libconfig::Setting::TypeGroup);
+	node.add("fn", libconfig::Setting::TypeString) = "splitters";
+	node.add("buckets", libconfig::Setting::TypeInt) = 4;
+	node.add("field", libconfig::Setting::TypeInt) = 0;
+
+	bool thrown = false;
+	try {
+		TupleHasher::create(schema, node);
+	} catch (UnknownHashException&) {
+		thrown = true;
+	}
+	if (!thrown)
+		fail("Splitter hasher was created from a configuration.");
+}
 
 int main() {
 	srand48(time(NULL));
@@ -151,5 +290,7 @@ int main() {
 	testModuloBounds();
 	testAlwaysZeroFn();
 	testExactRange();
+	testHashBatch();
+	testSplittersNotConfigurable();
 	return 0;
 }
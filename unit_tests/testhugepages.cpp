@@ -0,0 +1,153 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cassert>
+#include <cstring>
+
+#include "../exceptions.h"
+#include "../util/hugepages.h"
+#include "../util/numaallocate.h"
+#include "../util/arena.h"
+
+#include "common.h"
+
+const size_t SIZE = 32uLL * 1024 * 1024;
+
+void testparse()
+{
+	assert(parsehugepagepolicy("none") == HugePagesNone);
+	assert(parsehugepagepolicy("thp") == HugePagesTransparent);
+	assert(parsehugepagepolicy("2MB") == HugePages2MB);
+	assert(parsehugepagepolicy("1GB") == HugePages1GB);
+
+	bool thrown = false;
+	try
+	{
+		parsehugepagepolicy("4KB");
+	}
+	catch (InvalidParameter& e)
+	{
+		thrown = true;
+	}
+	assertmsg(thrown, "Unknown policy has been accepted.");
+}
+
+/**
+ * Allocates and touches a region that is mapped from the system, and 
+ * returns how the statistics changed.
+ */
+HugePageStats allocate(HugePagePolicy policy)
+{
+	numaallocate_sethugepages(policy);
+	HugePageStats before = gethugepagestats();
+
+	char* p = (char*) numaallocate_local("Test", SIZE, NULL);
+	memset(p, 1, SIZE);
+	for (size_t i=0; i<SIZE; i+=4096)
+		assertmsg(p[i] == 1, "Memory is not usable.");
+	numadeallocate(p);
+
+	HugePageStats after = gethugepagestats();
+	HugePageStats diff;
+	diff.explicitbytes = after.explicitbytes - before.explicitbytes;
+	diff.advisedbytes = after.advisedbytes - before.advisedbytes;
+	diff.fallbacks = after.fallbacks - before.fallbacks;
+	diff.actualbytes = 0;
+	return diff;
+}
+
+void testpolicies()
+{
+	HugePageStats s;
+
+	s = allocate(HugePagesNone);
+	assertmsg(s.explicitbytes == 0 && s.advisedbytes == 0 && s.fallbacks == 0,
+			"Huge pages used without a policy.");
+
+	// Either madvise() succeeds, or the failure is counted.
+	//
+	s = allocate(HugePagesTransparent);
+	assertmsg(s.explicitbytes == 0, "Explicit huge pages used for THP.");
+	assertmsg(s.advisedbytes >= SIZE || s.fallbacks != 0, 
+			"Region has not been advised.");
+
+	// Either the pool of 2MB pages serves the region, or it falls back.
+	//
+	s = allocate(HugePages2MB);
+	assertmsg(s.explicitbytes >= SIZE || s.fallbacks != 0, 
+			"Region has not asked for explicit huge pages.");
+
+	// Arena chunks follow the policy too.
+	//
+	numaallocate_sethugepages(HugePagesTransparent);
+	HugePageStats before = gethugepagestats();
+	{
+		QueryArena arena;
+		numaallocate_setarena(&arena);
+		void* p = numaallocate_local("Test", 1024 * 1024, NULL);
+		memset(p, 1, 1024 * 1024);
+		numadeallocate(p);
+		numaallocate_setarena(NULL);
+	}
+	HugePageStats after = gethugepagestats();
+	assertmsg(after.advisedbytes > before.advisedbytes 
+			|| after.fallbacks > before.fallbacks, 
+			"Arena chunk has not been advised.");
+
+	// Chunks rounded up to a huge page, or mapped without one, are used and
+	// unmapped whole.
+	//
+	const HugePagePolicy explicitpolicies[] = { HugePages2MB, HugePages1GB };
+	for (unsigned int i=0; i<2; ++i)
+	{
+		numaallocate_sethugepages(explicitpolicies[i]);
+		QueryArena arena;
+		numaallocate_setarena(&arena);
+		void* p = numaallocate_local("Test", 1024 * 1024, NULL);
+		memset(p, 1, 1024 * 1024);
+		numadeallocate(p);
+		numaallocate_setarena(NULL);
+		assertmsg(arena.getBytesMapped() >= QueryArena::ChunkSize,
+				"Arena chunk is smaller than requested.");
+		arena.release();
+	}
+
+	numaallocate_sethugepages(HugePagesNone);
+}
+
+int main()
+{
+	testparse();
+	testpolicies();
+	return 0;
+}
@@ -39,7 +39,7 @@
 using namespace std;
 
 const int TESTS=10;
-const unsigned int TUPLESIZE = 8;	///< Bitonic sort only works on 8-byte entities.
+const unsigned int TUPLESIZE = 8;	///< bitonicsort() sorts 8-byte tuples.
 
 void randompopulate(TupleBuffer* tb, unsigned int elements)
 {
@@ -151,9 +151,7 @@ int main()
 	{
 		// Returning from 1 << 12 = 0x001000 (smallest)
 		//             to 1 << 23 = 0x800000 (largest)
-#ifdef BITONIC_SORT
 		testpagesort(1uL << ((lrand48() % 12) + 12));
-#endif
 	}
 	return 0;
 }
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../schema.h"
+#include "../util/buffer.h"
+
+#include "common.h"
+
+#include <vector>
+
+using namespace std;
+
+const int TESTS=10;
+
+/*
+ * Tuples are 20 bytes: 4 bytes of filler, the key at offset 4 (which is not
+ * aligned for 8-byte keys), a unique 4-byte tuple id at offset 12, and 4 more
+ * bytes of filler.
+ */
+const unsigned int TUPLESIZE = 20;
+const unsigned int KEYOFFSET = 4;
+const unsigned int IDOFFSET = 12;
+
+template <typename KeyT>
+KeyT randomkey();
+
+template <>
+CtInt randomkey<CtInt>()
+{
+	return mrand48();
+}
+
+template <>
+CtLong randomkey<CtLong>()
+{
+	return (((CtLong) mrand48()) << 32) ^ lrand48();
+}
+
+template <>
+CtDecimal randomkey<CtDecimal>()
+{
+	return (drand48() - 0.5) * mrand48();
+}
+
+template <typename KeyT>
+KeyT getkey(void* tup)
+{
+	KeyT ret;
+	memcpy(&ret, ((char*) tup) + KEYOFFSET, sizeof(KeyT));
+	return ret;
+}
+
+void verifypayloadintact(void* tup)
+{
+	char* tupchar = (char*) tup;
+	for (unsigned int i=0; i<KEYOFFSET; ++i)
+	{
+		assertmsg(tupchar[i] == (char) ('a' + i), "Non-key data have been modified.");
+	}
+	for (unsigned int i=IDOFFSET+4; i<TUPLESIZE; ++i)
+	{
+		assertmsg(tupchar[i] == (char) ('a' + i), "Non-key data have been modified.");
+	}
+}
+
+template <typename KeyT>
+void randompopulate(TupleBuffer* tb, unsigned int elements)
+{
+	for (unsigned int i=0; i<elements; ++i)
+	{
+		void* space = tb->allocateTuple();
+		assertmsg(space != NULL, "Not enough space in buffer.");
+
+		char* spacechar = (char*) space;
+		for (unsigned int j=0; j<TUPLESIZE; ++j)
+		{
+			spacechar[j] = 'a' + j;
+		}
+
+		// Draw from a small domain every other test, to get duplicates.
+		//
+		KeyT key = randomkey<KeyT>();
+		if (elements & 1)
+		{
+			key = (KeyT) (((CtLong) key) % 16);
+		}
+		memcpy(spacechar + KEYOFFSET, &key, sizeof(KeyT));
+		memcpy(spacechar + IDOFFSET, &i, sizeof(i));
+	}
+}
+
+template <typename KeyT>
+void verifysorted(TupleBuffer* tb, unsigned int elements)
+{
+	TupleBuffer::Iterator it = tb->createIterator();
+	vector<bool> seen(elements, false);
+
+	for (unsigned int i=0; i<elements; ++i)
+	{
+		void* tup = it.next();
+		assertmsg(tup != NULL, "Fewer elements than expected.");
+
+		verifypayloadintact(tup);
+
+		unsigned int id;
+		memcpy(&id, ((char*) tup) + IDOFFSET, sizeof(id));
+		assertmsg(id < elements, "Invalid tuple id.");
+		assertmsg(!seen[id], "Tuple appears twice in output.");
+		seen[id] = true;
+
+		if (i != 0)
+		{
+			void* prev = tb->getTupleOffset(i-1);
+			assertmsg(getkey<KeyT>(prev) <= getkey<KeyT>(tup), 
+					"Output not sorted.");
+		}
+	}
+
+	assertmsg(it.next() == NULL, "More elements than expected.");
+}
+
+template <typename KeyT>
+void testradixsort(unsigned int elements)
+{
+	TupleBuffer tb((elements + lrand48() % 10) * TUPLESIZE, TUPLESIZE, NULL);
+
+	randompopulate<KeyT>(&tb, elements);
+
+	tb.sort<KeyT>(KEYOFFSET, TupleBuffer::RadixSort);
+
+	verifysorted<KeyT>(&tb, elements);
+}
+
+int main()
+{
+	srand48(time(NULL));
+
+	testradixsort<CtInt>(0);
+	testradixsort<CtInt>(1);
+
+	for (int i=0; i<TESTS; ++i)
+	{
+		testradixsort<CtInt>(lrand48()%10000);
+		testradixsort<CtLong>(lrand48()%10000);
+		testradixsort<CtDecimal>(lrand48()%10000);
+	}
+	return 0;
+}
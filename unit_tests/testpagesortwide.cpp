@@ -0,0 +1,180 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../schema.h"
+#include "../util/buffer.h"
+
+#include "common.h"
+
+#include <vector>
+
+using namespace std;
+
+const int TESTS=10;
+
+/*
+ * Each tuple carries a key of type KeyT at keyoffset and a unique 4-byte
+ * tuple id at idoffset. Every other byte is set to a value that depends on
+ * the tuple id, so that tuples which get torn apart are detected.
+ */
+struct Layout
+{
+	unsigned int tuplesize;
+	unsigned int keyoffset;
+	unsigned int idoffset;
+};
+
+inline char filler(unsigned int id, unsigned int byte)
+{
+	return 'a' + ((id + byte) % 26);
+}
+
+template <typename KeyT>
+void populate(TupleBuffer* tb, const Layout& l, unsigned int elements)
+{
+	for (unsigned int i=0; i<elements; ++i)
+	{
+		char* tup = (char*) tb->allocateTuple();
+		assertmsg(tup != NULL, "Not enough space in buffer.");
+
+		for (unsigned int b=0; b<l.tuplesize; ++b)
+			tup[b] = filler(i, b);
+
+		KeyT key = (KeyT) (mrand48() % 100000);
+		memcpy(tup + l.keyoffset, &key, sizeof(KeyT));
+		memcpy(tup + l.idoffset, &i, sizeof(i));
+	}
+}
+
+template <typename KeyT>
+KeyT getkey(TupleBuffer* tb, const Layout& l, unsigned int idx)
+{
+	KeyT key;
+	memcpy(&key, (char*) tb->getTupleOffset(idx) + l.keyoffset, sizeof(KeyT));
+	return key;
+}
+
+template <typename KeyT>
+void verify(TupleBuffer* tb, const Layout& l, unsigned int elements)
+{
+	vector<bool> seen(elements, false);
+
+	for (unsigned int i=0; i<elements; ++i)
+	{
+		char* tup = (char*) tb->getTupleOffset(i);
+		assertmsg(tup != NULL, "Fewer elements than expected.");
+
+		unsigned int id;
+		memcpy(&id, tup + l.idoffset, sizeof(id));
+		assertmsg(id < elements && !seen[id], "Tuple lost or duplicated.");
+		seen[id] = true;
+
+		for (unsigned int b=0; b<l.tuplesize; ++b)
+		{
+			if (b >= l.keyoffset && b < l.keyoffset + sizeof(KeyT))
+				continue;
+			if (b >= l.idoffset && b < l.idoffset + sizeof(id))
+				continue;
+			assertmsg(tup[b] == filler(id, b), "Non-key data have been modified.");
+		}
+
+		if (i != 0)
+			assertmsg(getkey<KeyT>(tb, l, i-1) <= getkey<KeyT>(tb, l, i), 
+					"Output not sorted.");
+	}
+}
+
+template <typename KeyT>
+void testfindsmallest(TupleBuffer* tb, const Layout& l, unsigned int elements)
+{
+	for (unsigned int i=0; i<TESTS; ++i)
+	{
+		KeyT key = (KeyT) (mrand48() % 100000);
+		unsigned int idx = tb->findsmallest<KeyT>(l.keyoffset, key);
+
+		assertmsg(idx <= elements, "Index past end of array.");
+		if (idx != 0)
+			assertmsg(getkey<KeyT>(tb, l, idx-1) < key, 
+					"Previous key not less than key.");
+		if (idx != elements)
+			assertmsg(key <= getkey<KeyT>(tb, l, idx), 
+					"Current key less than key.");
+	}
+}
+
+template <typename KeyT>
+void testlayout(const Layout& l, TupleBuffer::SortAlgorithm algo)
+{
+	unsigned int elements = lrand48() % 5000;
+	TupleBuffer tb((elements + 1) * l.tuplesize, l.tuplesize, NULL);
+
+	populate<KeyT>(&tb, l, elements);
+	tb.sort<KeyT>(l.keyoffset, algo);
+	verify<KeyT>(&tb, l, elements);
+	testfindsmallest<KeyT>(&tb, l, elements);
+}
+
+template <typename KeyT>
+void testalllayouts(TupleBuffer::SortAlgorithm algo)
+{
+	// None of these tuple sizes and key offsets have a specialized 
+	// comparison sort.
+	//
+	Layout layouts[] = {
+		{ 12,  0,  8 },
+		{ 13,  1,  9 },
+		{ 40, 24,  4 },
+		{ 72, 60,  0 },
+		{ 200, 100, 196 },
+		{ 256, 8, 128 },
+	};
+
+	for (unsigned int i=0; i<sizeof(layouts)/sizeof(layouts[0]); ++i)
+		testlayout<KeyT>(layouts[i], algo);
+}
+
+int main()
+{
+	srand48(time(NULL));
+
+	for (int i=0; i<TESTS; ++i)
+	{
+		testalllayouts<CtInt>(TupleBuffer::ComparisonSort);
+		testalllayouts<CtLong>(TupleBuffer::ComparisonSort);
+		testalllayouts<CtDecimal>(TupleBuffer::ComparisonSort);
+		testalllayouts<CtInt>(TupleBuffer::IndexSort);
+		testalllayouts<CtLong>(TupleBuffer::IndexSort);
+	}
+
+	return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <vector>
+#include <pthread.h>
+#include "libconfig.h++"
+
+#include "../query.h"
+#include "../util/arena.h"
+#include "../util/numaallocate.h"
+
+#include "common.h"
+
+using namespace std;
+using namespace libconfig;
+
+const int THREADS = 4;
+const int ITERATIONS = 2000;
+const unsigned int LIVEBLOCKS = 16;
+
+void testreuse()
+{
+	QueryArena arena;
+	numaallocate_setarena(&arena);
+
+	// A freed page is handed out again to the next allocation of its class.
+	//
+	void* page = numaallocate_local("Test", 1024 * 1024, NULL);
+	memset(page, 1, 1024 * 1024);
+	numadeallocate(page);
+	void* again = numaallocate_local("Test", 1024 * 1024 - 100, NULL);
+	assertmsg(page == again, "Freed page has not been reused.");
+	assertmsg(arena.getBlocksReused() == 1, "Reuse has not been counted.");
+	numadeallocate(again);
+
+	// Small blocks are aligned and do not overlap.
+	//
+	vector<char*> small;
+	for (int i=0; i<1000; ++i)
+	{
+		char* p = (char*) numaallocate_local("Test", 40, NULL);
+		assertmsg((((unsigned long long) p) & 0xF) == 0, "Small block not aligned.");
+		memset(p, i & 0xFF, 40);
+		small.push_back(p);
+	}
+	for (int i=0; i<1000; ++i)
+		for (int b=0; b<40; ++b)
+			assertmsg(small[i][b] == (char)(i & 0xFF), "Small blocks overlap.");
+
+	numaallocate_setarena(NULL);
+}
+
+struct ThreadArg
+{
+	QueryArena* arena;
+	char id;
+};
+
+void* churn(void* p)
+{
+	ThreadArg* arg = (ThreadArg*) p;
+	numaallocate_setarena(arg->arena);
+
+	const size_t sizes[] = { 100, 8192, 60000, 1024 * 1024 };
+	char* live[LIVEBLOCKS];
+	size_t livesize[LIVEBLOCKS];
+	unsigned short seed[3] = { (unsigned short) arg->id, 1, 2 };
+
+	for (unsigned int i=0; i<LIVEBLOCKS; ++i)
+		live[i] = NULL;
+
+	for (int i=0; i<ITERATIONS; ++i)
+	{
+		unsigned int slot = nrand48(seed) % LIVEBLOCKS;
+		if (live[slot] != NULL)
+		{
+			for (size_t b=0; b<livesize[slot]; b+=512)
+				assertmsg(live[slot][b] == arg->id, "Block modified by another thread.");
+			numadeallocate(live[slot]);
+		}
+
+		livesize[slot] = sizes[nrand48(seed) % 4];
+		live[slot] = (char*) numaallocate_local("Test", livesize[slot], NULL);
+		memset(live[slot], arg->id, livesize[slot]);
+	}
+
+	for (unsigned int i=0; i<LIVEBLOCKS; ++i)
+		numadeallocate(live[i]);
+
+	numaallocate_setarena(NULL);
+	return NULL;
+}
+
+void testthreads()
+{
+	QueryArena arena;
+	pthread_t threads[THREADS];
+	ThreadArg args[THREADS];
+
+	for (int i=0; i<THREADS; ++i)
+	{
+		args[i].arena = &arena;
+		args[i].id = 'a' + i;
+		assert(!pthread_create(&threads[i], NULL, churn, &args[i]));
+	}
+
+	for (int i=0; i<THREADS; ++i)
+		assert(!pthread_join(threads[i], NULL));
+
+	assertmsg(arena.getBlocksReused() != 0, "No block has been reused.");
+}
+
+/**
+ * Runs a query created with an arena twice. The second run must reuse the 
+ * pages that the first run freed.
+ */
+void testquery()
+{
+	Config cfg;
+	cfg.getRoot().add("path", Setting::TypeString) = "./";
+	cfg.getRoot().add("buffsize", Setting::TypeInt) = 64 * 1024;
+	cfg.getRoot().add("arena", Setting::TypeString) = "yes";
+
+	Setting& gennode = cfg.getRoot().add("gen", Setting::TypeGroup);
+	gennode.add("type", Setting::TypeString) = "generator_int";
+	gennode.add("sizeinmb", Setting::TypeInt) = 1;
+	gennode.add("width", Setting::TypeInt) = 16;
+
+	Setting& mergenode = cfg.getRoot().add("merge", Setting::TypeGroup);
+	mergenode.add("type", Setting::TypeString) = "merge";
+	mergenode.add("threads", Setting::TypeInt) = 2;
+
+	Setting& treeroot = cfg.getRoot().add("treeroot", Setting::TypeGroup);
+	treeroot.add("name", Setting::TypeString) = "merge";
+	Setting& input = treeroot.add("input", Setting::TypeGroup);
+	input.add("name", Setting::TypeString) = "gen";
+
+	Query q;
+	q.create(cfg);
+	assertmsg(q.arena != NULL, "Query has no arena.");
+
+	unsigned long long reused = 0;
+	for (int run=0; run<2; ++run)
+	{
+		q.threadInit();
+		q.scanStart();
+
+		unsigned long long tuples = 0;
+		Operator::GetNextResultT result;
+		do
+		{
+			result = q.getNext();
+			assertmsg(result.first != Operator::Error, "Query failed.");
+			tuples += result.second->getUsedSpace() / 16;
+		} while (result.first == Operator::Ready);
+
+		assertmsg(tuples == 2 * 1024 * 1024 / 16, "Wrong number of tuples.");
+
+		q.scanStop();
+		q.threadClose();
+
+		if (run == 1)
+			assertmsg(q.arena->getBlocksReused() > reused, 
+					"Second run has not reused memory.");
+		reused = q.arena->getBlocksReused();
+	}
+
+	q.destroy();
+	assertmsg(q.arena == NULL, "Arena has not been released.");
+}
+
+int main()
+{
+	testreuse();
+	testthreads();
+	testquery();
+	return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../util/segmentedbuffer.h"
+
+#include "common.h"
+
+using namespace std;
+
+const int TESTS=10;
+const unsigned int TUPLESIZE=12;
+
+/*
+ * Tuple i holds i in its first four bytes, and a byte that depends on i in
+ * every other byte.
+ */
+void maketuple(char* tup, unsigned int i)
+{
+	memcpy(tup, &i, sizeof(i));
+	for (unsigned int b=sizeof(i); b<TUPLESIZE; ++b)
+		tup[b] = 'a' + ((i + b) % 26);
+}
+
+void verifytuple(void* tup, unsigned int i)
+{
+	char expected[TUPLESIZE];
+	maketuple(expected, i);
+	assertmsg(tup != NULL, "Fewer tuples than expected.");
+	assertmsg(memcmp(tup, expected, TUPLESIZE) == 0, "Tuple out of order or torn.");
+}
+
+void test(unsigned long long segmentsize, unsigned int elements)
+{
+	SegmentedTupleBuffer buf(segmentsize, TUPLESIZE, NULL);
+	char chunk[TUPLESIZE * 7];
+
+	// Add tuples one at a time and in chunks that straddle segments.
+	//
+	unsigned int i = 0;
+	while (i < elements)
+	{
+		if (i % 2 == 0 || i + 7 > elements)
+		{
+			maketuple((char*) buf.allocateTuple(), i);
+			++i;
+		}
+		else
+		{
+			for (unsigned int j=0; j<7; ++j)
+				maketuple(chunk + j * TUPLESIZE, i + j);
+			buf.append(chunk, sizeof(chunk));
+			i += 7;
+		}
+	}
+
+	assert(buf.getNumTuples() == elements);
+	assert(buf.getUsedSpace() == elements * TUPLESIZE);
+
+	unsigned long long segmenttuples = segmentsize / TUPLESIZE;
+	assert(buf.getNumSegments() == (elements + segmenttuples - 1) / segmenttuples);
+
+	// Iterator must return all tuples, in order, twice.
+	//
+	SegmentedTupleBuffer::Iterator it = buf.createIterator();
+	for (int pass=0; pass<2; ++pass)
+	{
+		for (unsigned int k=0; k<elements; ++k)
+			verifytuple(it.next(), k);
+		assertmsg(it.next() == NULL, "More tuples than expected.");
+		it.reset();
+	}
+
+	// Moving into a page must keep order and empty the buffer.
+	//
+	TupleBuffer page((elements + 1) * TUPLESIZE, TUPLESIZE, NULL);
+	buf.moveTo(&page);
+	assert(buf.getNumTuples() == 0);
+	assert(buf.getNumSegments() == 0);
+	assert(page.getUsedSpace() == elements * TUPLESIZE);
+	for (unsigned int k=0; k<elements; ++k)
+		verifytuple(page.getTupleOffset(k), k);
+}
+
+int main()
+{
+	srand48(time(NULL));
+
+	test(TUPLESIZE * 5, 0);
+	test(TUPLESIZE * 5, 3);
+
+	for (int i=0; i<TESTS; ++i)
+	{
+		// Segment sizes that are not a multiple of the tuple size are 
+		// rounded down.
+		//
+		test(TUPLESIZE * 5 + 7, lrand48() % 5000);
+		test(4096, lrand48() % 50000);
+	}
+
+	return 0;
+}
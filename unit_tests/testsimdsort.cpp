@@ -0,0 +1,174 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../schema.h"
+#include "../util/buffer.h"
+#include "../util/simdsort.h"
+
+#include "common.h"
+
+#include <vector>
+
+using namespace std;
+
+const int TESTS=10;
+
+/*
+ * Sorts random keys with the kernel of \a isa and checks that the output is
+ * sorted and that row ids still point at their original keys.
+ */
+void testkernel(SimdSortIsa isa, unsigned long long n, bool withrids, 
+		long long domain)
+{
+	vector<long long> keys(n + 1), orig(n + 1), tmpkeys(n + 1);
+	vector<unsigned long long> rids(n + 1), tmprids(n + 1);
+
+	for (unsigned long long i=0; i<n; ++i)
+	{
+		long long key = (((long long) mrand48()) << 32) ^ lrand48();
+		if (domain != 0)
+			key %= domain;
+		keys[i] = orig[i] = key;
+		rids[i] = i;
+	}
+
+	simdsort(&keys[0], withrids ? &rids[0] : 0, 
+			&tmpkeys[0], withrids ? &tmprids[0] : 0, n, isa);
+
+	vector<bool> seen(n, false);
+	for (unsigned long long i=0; i<n; ++i)
+	{
+		if (i != 0)
+			assertmsg(keys[i-1] <= keys[i], "Output not sorted.");
+
+		if (withrids)
+		{
+			assertmsg(rids[i] < n, "Invalid row id.");
+			assertmsg(!seen[rids[i]], "Row id appears twice in output.");
+			seen[rids[i]] = true;
+			assertmsg(orig[rids[i]] == keys[i], "Row id does not match key.");
+		}
+	}
+
+	if (!withrids)
+	{
+		std::sort(orig.begin(), orig.begin() + n);
+		for (unsigned long long i=0; i<n; ++i)
+			assertmsg(orig[i] == keys[i], "Output not a permutation of input.");
+	}
+}
+
+/*
+ * Sorts 20-byte tuples with a key at offset 4 and a tuple id at offset 12 
+ * through TupleBuffer::sort(), and checks the output.
+ */
+template <typename KeyT>
+void testpage(unsigned int elements)
+{
+	const unsigned int TUPLESIZE = 20;
+	TupleBuffer tb((elements + 1) * TUPLESIZE, TUPLESIZE, NULL);
+
+	for (unsigned int i=0; i<elements; ++i)
+	{
+		char* tup = (char*) tb.allocateTuple();
+		memset(tup, 'x', TUPLESIZE);
+		KeyT key = (KeyT) ((((CtLong) mrand48()) << 20) ^ mrand48());
+		memcpy(tup + 4, &key, sizeof(KeyT));
+		memcpy(tup + 12, &i, sizeof(i));
+	}
+
+	tb.sort<KeyT>(4, TupleBuffer::BitonicSort);
+
+	vector<bool> seen(elements, false);
+	for (unsigned int i=0; i<elements; ++i)
+	{
+		char* tup = (char*) tb.getTupleOffset(i);
+		unsigned int id;
+		memcpy(&id, tup + 12, sizeof(id));
+		assertmsg(id < elements && !seen[id], "Tuple lost or duplicated.");
+		seen[id] = true;
+		assertmsg(tup[0] == 'x' && tup[TUPLESIZE-1] == 'x', 
+				"Non-key data have been modified.");
+
+		if (i != 0)
+		{
+			KeyT prev, cur;
+			memcpy(&prev, (char*) tb.getTupleOffset(i-1) + 4, sizeof(KeyT));
+			memcpy(&cur, tup + 4, sizeof(KeyT));
+			assertmsg(prev <= cur, "Output not sorted.");
+		}
+	}
+}
+
+int main()
+{
+	srand48(time(NULL));
+
+	// Test every kernel this CPU supports.
+	//
+	vector<SimdSortIsa> isas;
+	isas.push_back(SimdNone);
+	if (simdSortDetectIsa() >= SimdSSE42)
+		isas.push_back(SimdSSE42);
+	if (simdSortDetectIsa() >= SimdAVX2)
+		isas.push_back(SimdAVX2);
+	if (simdSortDetectIsa() >= SimdAVX512)
+		isas.push_back(SimdAVX512);
+
+	for (unsigned int i=0; i<isas.size(); ++i)
+	{
+		for (unsigned long long n=0; n<40; ++n)
+		{
+			testkernel(isas[i], n, true, 0);
+			testkernel(isas[i], n, false, 0);
+		}
+
+		for (int j=0; j<TESTS; ++j)
+		{
+			unsigned long long n = lrand48() % 100000;
+			testkernel(isas[i], n, true, 0);
+			testkernel(isas[i], n, true, 16);
+			testkernel(isas[i], n, false, 0);
+			testkernel(isas[i], n, false, 1000);
+		}
+	}
+
+	for (int j=0; j<TESTS; ++j)
+	{
+		testpage<CtInt>(lrand48() % 10000);
+		testpage<CtLong>(lrand48() % 10000);
+		testpage<CtDecimal>(lrand48() % 10000);
+	}
+
+	return 0;
+}
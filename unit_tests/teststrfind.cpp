@@ -0,0 +1,122 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../util/strkernels.h"
+
+#include "common.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+const int TESTS=20000;
+
+/*
+ * Returns the first occurrence of \a needle in \a hay, the slow way.
+ */
+int reference(const string& hay, const string& needle)
+{
+	size_t pos = hay.find(needle);
+	return (pos == string::npos) ? -1 : pos;
+}
+
+/*
+ * Random string of \a len characters out of the first \a alphabet letters,
+ * so that partial matches are common.
+ */
+string randomstring(unsigned int len, unsigned int alphabet)
+{
+	string ret;
+	for (unsigned int i=0; i<len; ++i)
+		ret += (char) ('a' + lrand48() % alphabet);
+	return ret;
+}
+
+void testkernel(StrKernelIsa isa, const string& hay, const string& needle)
+{
+	// Copy the haystack to a buffer of its exact size, so that reading past
+	// its end would be visible to memory checkers.
+	//
+	vector<char> buf(hay.begin(), hay.end());
+	const char* h = buf.empty() ? "" : &buf[0];
+
+	int ret = strfind(h, hay.size(), needle.data(), needle.size(), isa);
+	assertmsg(ret == reference(hay, needle), "Kernel disagrees with string::find.");
+}
+
+int main()
+{
+	srand48(time(NULL));
+
+	// Test every kernel this CPU supports.
+	//
+	vector<StrKernelIsa> isas;
+	isas.push_back(StrKernelScalar);
+	if (strKernelDetectIsa() >= StrKernelSSE42)
+		isas.push_back(StrKernelSSE42);
+	if (strKernelDetectIsa() >= StrKernelAVX2)
+		isas.push_back(StrKernelAVX2);
+
+	for (unsigned int i=0; i<isas.size(); ++i)
+	{
+		testkernel(isas[i], "", "");
+		testkernel(isas[i], "abc", "");
+		testkernel(isas[i], "", "a");
+		testkernel(isas[i], "ab", "abc");
+		testkernel(isas[i], "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxpromo", "promo");
+		testkernel(isas[i], "xxxxxxxxxxxxxxxpromoxxxxxxxxxxxxxxxxxxxxxxxx", "promo");
+		testkernel(isas[i], "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaab", 
+				"aaaaaaaaaaaaaaaaaaaaab");
+
+		for (int j=0; j<TESTS; ++j)
+		{
+			unsigned int alphabet = 1 + lrand48() % 4;
+			string hay = randomstring(lrand48() % 100, alphabet);
+			string needle;
+			if (hay.size() > 0 && lrand48() % 2)
+			{
+				// Cut the needle out of the haystack, so it is found.
+				unsigned int start = lrand48() % hay.size();
+				needle = hay.substr(start, 1 + lrand48() % 24);
+			}
+			else
+			{
+				needle = randomstring(1 + lrand48() % 24, alphabet);
+			}
+			testkernel(isas[i], hay, needle);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef ENABLE_NUMA
+#include <numaif.h>
+#endif
+
+#include <sys/mman.h>
+#include <cassert>
+
+#include "arena.h"
+#include "atomics.h"
+#include "hugepages.h"
+#include "numaasserts.h"
+
+namespace {
+
+/**
+ * Every arena gets a new generation, so that a thread can tell if its cached
+ * ThreadCache belongs to a live arena without dereferencing it.
+ */
+volatile unsigned long long Generations = 0;
+
+__thread void* ThreadCachePtr = NULL;
+__thread unsigned long long ThreadCacheGeneration = 0;
+
+inline size_t classSize(unsigned int sizeclass)
+{
+	return ((2 * QueryArena::SmallBlockLimit) << sizeclass) 
+		+ QueryArena::ClassSlack;
+}
+
+inline unsigned int sizeClass(size_t size)
+{
+	unsigned int c = 0;
+	while (classSize(c) < size)
+		++c;
+	assert(c < QueryArena::SizeClasses);
+	return c;
+}
+
+/**
+ * Maps at least \a *size bytes of memory bound to NUMA node \a node,
+ * following the huge page policy, and returns the mapped size in \a *size.
+ */
+void* mapChunk(size_t* size, int node)
+{
+	void* memory = mmapanonymous(size);
+	assert(memory != MAP_FAILED);
+
+#ifdef ENABLE_NUMA
+	int retries = 1024;
+	unsigned long numanodemask = 1uLL << node;
+	unsigned long maxnode = sizeof(numanodemask);
+	int res = 0;
+	do
+	{
+		res = mbind(memory, *size, 
+				MPOL_BIND, &numanodemask, maxnode, 
+				MPOL_MF_STRICT | MPOL_MF_MOVE); 
+	}
+   	while ((res != 0) && ((--retries) != 0));
+	assert(res == 0);
+#endif
+
+	return memory;
+}
+
+};
+
+QueryArena::NodeArena::NodeArena()
+	: free(NULL), end(NULL)
+{
+	for (unsigned int c=0; c<SizeClasses; ++c)
+		freelist[c] = NULL;
+}
+
+QueryArena::QueryArena()
+	: bytesmapped(0), blocksreused(0)
+{
+	generation = atomic_increment(&Generations) + 1;
+}
+
+QueryArena::~QueryArena()
+{
+	release();
+}
+
+void QueryArena::release()
+{
+	for (int n=0; n<MaxNumaNodes; ++n)
+	{
+		NodeArena& na = nodes[n];
+		for (unsigned int i=0; i<na.chunks.size(); ++i)
+		{
+			int res = munmap(na.chunks[i].start, na.chunks[i].size);
+			assert(res == 0);
+		}
+		na.chunks.clear();
+		na.free = NULL;
+		na.end = NULL;
+		for (unsigned int c=0; c<SizeClasses; ++c)
+			na.freelist[c] = NULL;
+	}
+
+	// Thread caches lived in the chunks, so forget them all.
+	//
+	generation = atomic_increment(&Generations) + 1;
+}
+
+void* QueryArena::carve(int node, size_t size)
+{
+	NodeArena& na = nodes[node];
+
+	if (na.free == NULL || na.free + size > na.end)
+	{
+		Chunk chunk;
+		chunk.size = ChunkSize;
+		chunk.start = reinterpret_cast<char*>(mapChunk(&chunk.size, node));
+		na.chunks.push_back(chunk);
+		na.free = chunk.start;
+		na.end = chunk.start + chunk.size;
+		atomic_increment(&bytesmapped, (unsigned long long) chunk.size);
+	}
+
+	void* ret = na.free;
+	na.free += size;
+	return ret;
+}
+
+QueryArena::ThreadCache* QueryArena::getThreadCache()
+{
+	if (ThreadCacheGeneration == generation)
+		return reinterpret_cast<ThreadCache*>(ThreadCachePtr);
+
+	int node = localnumanode();
+	assert(node >= 0 && node < MaxNumaNodes);
+
+	nodes[node].lock.lock();
+	void* space = carve(node, ((sizeof(ThreadCache) + 63) / 64) * 64);
+	nodes[node].lock.unlock();
+
+	ThreadCache* cache = reinterpret_cast<ThreadCache*>(space);
+	cache->node = node;
+	cache->free = NULL;
+	cache->end = NULL;
+	for (unsigned int c=0; c<SizeClasses; ++c)
+	{
+		cache->freelist[c] = NULL;
+		cache->depth[c] = 0;
+	}
+
+	ThreadCachePtr = cache;
+	ThreadCacheGeneration = generation;
+	return cache;
+}
+
+void QueryArena::flushThreadCache()
+{
+	if (ThreadCacheGeneration != generation)
+		return;
+
+	ThreadCache* cache = reinterpret_cast<ThreadCache*>(ThreadCachePtr);
+	NodeArena& na = nodes[cache->node];
+
+	na.lock.lock();
+	for (unsigned int c=0; c<SizeClasses; ++c)
+	{
+		while (cache->freelist[c] != NULL)
+		{
+			FreeBlock* fb = cache->freelist[c];
+			cache->freelist[c] = fb->next;
+			fb->next = na.freelist[c];
+			na.freelist[c] = fb;
+		}
+		cache->depth[c] = 0;
+	}
+	na.lock.unlock();
+}
+
+void* QueryArena::allocateFromNode(int node, unsigned int sizeclass, size_t size)
+{
+	NodeArena& na = nodes[node];
+	void* ret;
+
+	na.lock.lock();
+	FreeBlock* fb = na.freelist[sizeclass];
+	if (fb != NULL)
+	{
+		na.freelist[sizeclass] = fb->next;
+		ret = fb;
+	}
+	else
+	{
+		ret = carve(node, size);
+	}
+	na.lock.unlock();
+
+	if (fb != NULL)
+		atomic_increment(&blocksreused);
+
+	return ret;
+}
+
+void* QueryArena::allocate(size_t size, int node, size_t* blocksize, int* blocknode)
+{
+	assert(size <= MaxBlockSize);
+	ThreadCache* cache = getThreadCache();
+
+	if (node == -1)
+		node = cache->node;
+	assert(node >= 0 && node < MaxNumaNodes);
+	*blocknode = node;
+
+	// Round up to the next 64-byte multiple to maintain alignment.
+	//
+	size = ((size + 63) / 64) * 64;
+
+	if (size <= SmallBlockLimit)
+	{
+		*blocksize = size;
+
+		if (node != cache->node)
+		{
+			nodes[node].lock.lock();
+			void* ret = carve(node, size);
+			nodes[node].lock.unlock();
+			return ret;
+		}
+
+		if (cache->free == NULL || cache->free + size > cache->end)
+		{
+			nodes[node].lock.lock();
+			cache->free = reinterpret_cast<char*>(carve(node, ThreadSlabSize));
+			nodes[node].lock.unlock();
+			cache->end = cache->free + ThreadSlabSize;
+		}
+
+		void* ret = cache->free;
+		cache->free += size;
+		return ret;
+	}
+
+	unsigned int c = sizeClass(size);
+	*blocksize = classSize(c);
+
+	if (node == cache->node && cache->freelist[c] != NULL)
+	{
+		FreeBlock* fb = cache->freelist[c];
+		cache->freelist[c] = fb->next;
+		cache->depth[c]--;
+		atomic_increment(&blocksreused);
+		return fb;
+	}
+
+	return allocateFromNode(node, c, *blocksize);
+}
+
+void QueryArena::recycle(void* block, size_t blocksize, int blocknode)
+{
+	// Small blocks are reclaimed by release().
+	//
+	if (blocksize <= SmallBlockLimit)
+		return;
+
+	unsigned int c = sizeClass(blocksize);
+	FreeBlock* fb = reinterpret_cast<FreeBlock*>(block);
+	ThreadCache* cache = getThreadCache();
+
+	if (blocknode == cache->node && cache->depth[c] < LocalCacheDepth)
+	{
+		fb->next = cache->freelist[c];
+		cache->freelist[c] = fb;
+		cache->depth[c]++;
+		return;
+	}
+
+	NodeArena& na = nodes[blocknode];
+	na.lock.lock();
+	fb->next = na.freelist[c];
+	na.freelist[c] = fb;
+	na.lock.unlock();
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYQUERYARENA__
+#define __MYQUERYARENA__
+
+#include <cstddef>
+#include <vector>
+using std::vector;
+
+#include "../lock.h"
+
+/**
+ * Memory arena that serves all allocations of one query. Each NUMA node 
+ * has its own list of large chunks, which are mapped on demand and bound to
+ * the node, and each thread carves its allocations from a thread-local
+ * cache, so most allocations take no lock and make no system call.
+ *
+ * Blocks of up to SmallBlockLimit bytes, such as operator state, are never
+ * reused. Larger blocks, such as TupleBuffer pages and hash table chunks,
+ * are rounded up to a power-of-two size class. When freed, they are kept in
+ * a free list of the freeing thread, or of their NUMA node if that list is
+ * full, and are handed out again to the next allocation of the same class.
+ * Nothing is returned to the system until release() unmaps all chunks at
+ * once.
+ *
+ * Threads route their allocations here with numaallocate_setarena(); 
+ * numaallocate_onnode() and numadeallocate() then call allocate() and 
+ * recycle().
+ */
+class QueryArena
+{
+	public:
+		static const size_t ChunkSize = 64uLL * 1024 * 1024;
+		static const size_t ThreadSlabSize = 256 * 1024;
+		static const size_t SmallBlockLimit = 4096;
+		static const unsigned int SizeClasses = 12;	///< 8KB to 16MB.
+
+		/**
+		 * Size classes have room for an allocation header on top of their
+		 * power-of-two size, so that power-of-two pages are not rounded up
+		 * to the next class.
+		 */
+		static const size_t ClassSlack = 64;
+		static const size_t MaxBlockSize = 16uLL * 1024 * 1024 + ClassSlack;
+		static const unsigned int LocalCacheDepth = 8;
+#ifdef ENABLE_NUMA
+		static const int MaxNumaNodes = 4;
+#else
+		static const int MaxNumaNodes = 1;
+#endif
+
+		QueryArena();
+		~QueryArena();
+
+		/**
+		 * Returns a 64-byte aligned block of at least \a size bytes, which
+		 * must not exceed MaxBlockSize, on NUMA node \a node, or on the
+		 * local node if \a node is -1. The size of the block and the node
+		 * it was acquired on are returned in \a blocksize and \a blocknode,
+		 * and must be passed to recycle().
+		 */
+		void* allocate(size_t size, int node, size_t* blocksize, int* blocknode);
+
+		/**
+		 * Makes a block returned by allocate() available for reuse.
+		 */
+		void recycle(void* block, size_t blocksize, int blocknode);
+
+		/**
+		 * Moves the free blocks cached by the calling thread to the free 
+		 * lists of their NUMA node, where other threads can reuse them.
+		 * Called when a thread stops using the arena.
+		 */
+		void flushThreadCache();
+
+		/**
+		 * Unmaps all memory of the arena. All blocks are invalidated.
+		 */
+		void release();
+
+		inline unsigned long long getBytesMapped()
+		{
+			return bytesmapped;
+		}
+
+		/**
+		 * Returns the number of allocations that reused a freed block.
+		 */
+		inline unsigned long long getBlocksReused()
+		{
+			return blocksreused;
+		}
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		/**
+		 * A chunk and the size it was mapped with, which may be larger than
+		 * ChunkSize if the huge page policy rounded it up.
+		 */
+		struct Chunk
+		{
+			char* start;
+			size_t size;
+		};
+
+		struct NodeArena
+		{
+			NodeArena();
+
+			Lock lock;
+			vector<Chunk> chunks;
+			char* free;
+			char* end;
+			FreeBlock* freelist[SizeClasses];
+		};
+
+		struct ThreadCache
+		{
+			int node;
+			char* free;	///< Slab for small blocks.
+			char* end;
+			FreeBlock* freelist[SizeClasses];
+			unsigned int depth[SizeClasses];
+		};
+
+		ThreadCache* getThreadCache();
+
+		/**
+		 * Carves \a size bytes from the chunks of \a node, mapping a new 
+		 * chunk if needed. Caller must hold the lock of the node.
+		 */
+		void* carve(int node, size_t size);
+
+		void* allocateFromNode(int node, unsigned int sizeclass, size_t size);
+
+		NodeArena nodes[MaxNumaNodes];
+
+		/**
+		 * Distinguishes this arena from arenas that have been destroyed,
+		 * and whose thread caches are still referenced by some thread.
+		 */
+		unsigned long long generation;
+
+		volatile unsigned long long bytesmapped;
+		volatile unsigned long long blocksreused;
+};
+
+#endif
@@ -43,6 +43,7 @@
 #endif
 
 #include "numaallocate.h"
+#include "simdsort.h"
 
 Buffer::Buffer(void* data, unsigned long long size, void* free)
 	: data(data), maxsize(size), owner(false), free(free)
@@ -89,23 +90,167 @@ TupleBuffer::TupleBuffer(void* data, unsigned long long size, void* free, unsign
 	dbgassert(size >= tuplesize);
 }
 
-#ifdef BITONIC_SORT
-#include "bitonicsort.cpp"
-#endif
+/*
+ * Accessors for the layouts of sort entries: a single word with the
+ * normalized key in the high bits and the tuple index in the low 32 bits, a
+ * bare tuple index, or a (normalized key, index) pair.
+ */
+struct PackedKeyOps
+{
+	typedef unsigned long long EntryT;
+	static unsigned long long key(const EntryT& e) { return e; }
+	static unsigned long long index(const EntryT& e) { return e & 0xFFFFFFFFuLL; }
+};
+
+template <typename PairT>
+struct PairKeyOps
+{
+	typedef PairT EntryT;
+	static unsigned long long key(const EntryT& e) { return e.key; }
+	static unsigned long long index(const EntryT& e) { return e.index; }
+};
+
+/*
+ * LSD radix sort of \a n entries in \a src on key bits [lobit, hibit), using
+ * \a tmp as the second buffer. Returns whichever of the two buffers holds the
+ * sorted output.
+ *
+ * Histograms of all digits are computed in a single pass over the input, and
+ * digits that are the same for every key are skipped. Digits are 11 bits so
+ * that each histogram (and the scatter pointers) fit in L1.
+ */
+template <typename KeyOps>
+typename KeyOps::EntryT* lsdRadixSort(typename KeyOps::EntryT* src, 
+		typename KeyOps::EntryT* tmp, unsigned long long n, 
+		unsigned int lobit, unsigned int hibit, void* source)
+{
+	typedef typename KeyOps::EntryT EntryT;
+	const unsigned int RADIXBITS = 11;
+	const unsigned int BUCKETS = 1 << RADIXBITS;
+	const unsigned int passes = (hibit - lobit + RADIXBITS - 1) / RADIXBITS;
+
+	unsigned long long* hist = (unsigned long long*) numaallocate_local(
+			"RdxH", passes * BUCKETS * sizeof(unsigned long long), source);
+	memset(hist, 0, passes * BUCKETS * sizeof(unsigned long long));
+
+	for (unsigned long long i=0; i<n; ++i)
+	{
+		unsigned long long k = KeyOps::key(src[i]) >> lobit;
+		for (unsigned int p=0; p<passes; ++p)
+		{
+			hist[p*BUCKETS + ((k >> (p*RADIXBITS)) & (BUCKETS-1))]++;
+		}
+	}
+
+	EntryT* dst = tmp;
+	for (unsigned int p=0; p<passes; ++p)
+	{
+		const unsigned int shift = lobit + p*RADIXBITS;
+		unsigned long long* count = &hist[p*BUCKETS];
+
+		// Skip pass if all keys have the same digit.
+		//
+		if (count[(KeyOps::key(src[0]) >> shift) & (BUCKETS-1)] == n)
+			continue;
+
+		// Turn counts into output positions in place.
+		//
+		unsigned long long sum = 0;
+		for (unsigned int d=0; d<BUCKETS; ++d)
+		{
+			unsigned long long c = count[d];
+			count[d] = sum;
+			sum += c;
+		}
+
+		for (unsigned long long i=0; i<n; ++i)
+		{
+			unsigned int d = (KeyOps::key(src[i]) >> shift) & (BUCKETS-1);
+			dst[count[d]++] = src[i];
+		}
+
+		EntryT* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	numadeallocate(hist);
+	return src;
+}
+
+void TupleBuffer::radixsortPacked(unsigned long long* keys, unsigned int keybits)
+{
+	const unsigned long long tuples = getNumTuples();
+	dbgassert(keybits <= 32);
+
+	unsigned long long* tmp = (unsigned long long*) numaallocate_local(
+			"RdxT", tuples * sizeof(unsigned long long), this);
+
+	unsigned long long* sorted = lsdRadixSort<PackedKeyOps>(
+			keys, tmp, tuples, 32, 32 + keybits, this);
+	gatherTuples<PackedKeyOps>(sorted);
+
+	numadeallocate(tmp);
+	numadeallocate(keys);
+}
+
+void TupleBuffer::radixsortNormalized(NormalizedKey* keys, unsigned int keybits)
+{
+	typedef PairKeyOps<NormalizedKey> Ops;
+	const unsigned long long tuples = getNumTuples();
+	dbgassert(keybits <= 64);
+
+	NormalizedKey* tmp = (NormalizedKey*) numaallocate_local(
+			"RdxT", tuples * sizeof(NormalizedKey), this);
+
+	NormalizedKey* sorted = lsdRadixSort<Ops>(
+			keys, tmp, tuples, 0, keybits, this);
+	gatherTuples<Ops>(sorted);
+
+	numadeallocate(tmp);
+	numadeallocate(keys);
+}
+
+void TupleBuffer::bitonicsortKeys(unsigned long long* keys, unsigned long long* rids)
+{
+	const unsigned long long tuples = getNumTuples();
+
+	// The SIMD kernels compare keys as signed integers.
+	//
+	for (unsigned long long i=0; i<tuples; ++i)
+	{
+		keys[i] ^= 0x8000000000000000uLL;
+	}
+
+	long long* tmpkeys = (long long*) numaallocate_local(
+			"BSrT", tuples * sizeof(long long), this);
+	unsigned long long* tmprids = NULL;
+	if (rids)
+	{
+		tmprids = (unsigned long long*) numaallocate_local(
+				"BSrT", tuples * sizeof(unsigned long long), this);
+	}
+
+	simdsort((long long*) keys, rids, tmpkeys, tmprids, tuples);
+
+	if (rids)
+	{
+		gatherTuples<RowIdOps>(rids);
+		numadeallocate(tmprids);
+		numadeallocate(rids);
+	}
+	else
+	{
+		gatherTuples<PackedKeyOps>(keys);
+	}
+
+	numadeallocate(tmpkeys);
+	numadeallocate(keys);
+}
 
 void
 TupleBuffer::bitonicsort()
 {
-	unsigned long long tuples = getNumTuples();
-
 	assert(tuplesize == 8);
-	assert(tuples > 0x1000);
-	assert(tuples != 0);
-	assert((tuples & (tuples-1)) == 0);
-
-#ifdef BITONIC_SORT
-	dobitonicsort((record_t*)data, tuples);
-#else
-	throw UnknownAlgorithmException();
-#endif
+	sort<int>(4, BitonicSort);
 }
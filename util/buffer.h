@@ -305,16 +305,54 @@ class TupleBuffer : public Buffer
 			return SubrangeIterator(this, mininclusive, maxexclusive);
 		}
 
+		/**
+		 * Algorithms for sorting a TupleBuffer.
+		 */
+		enum SortAlgorithm
+		{
+			/** std::sort on the tuples themselves. */
+			ComparisonSort,
+
+			/** 
+			 * LSD radix sort on (normalized key, index) pairs, followed by
+			 * a gather of the tuples in key order.
+			 */
+			RadixSort,
+
+			/**
+			 * SIMD bitonic merge sort on normalized keys and tuple indexes,
+			 * followed by a gather of the tuples in key order. The widest
+			 * instruction set the CPU supports is picked at runtime.
+			 */
+			BitonicSort,
+
+			/**
+			 * std::sort on (key, index) pairs, followed by a gather of the
+			 * tuples in key order. Works for any tuple size and key offset, 
+			 * and ComparisonSort falls back to it for layouts it has not 
+			 * been specialized for.
+			 */
+			IndexSort
+		};
+
 		/**
 		 * Sorts this array. Hack for getting Sort-Merge to work.
 		 */
 		template <typename KeyT>
-		void sort(unsigned int keyoffset);
+		void sort(unsigned int keyoffset, SortAlgorithm algo = ComparisonSort);
+
+		/**
+		 * Sorts this array in the order of \a less, which is called with
+		 * pointers to two tuples and returns true if the first precedes the
+		 * second. Sorts an array of tuple indexes, followed by a gather of 
+		 * the tuples in that order. For keys that span several columns.
+		 */
+		template <typename LessT>
+		void sortby(const LessT& less);
 
 		/**
-		 * SIMD bitonic sort entry point.
-		 * Assumes tuple size is 8 bytes.
-		 * Assumes key is first, that is, at offset zero.
+		 * SIMD bitonic sort entry point for 8-byte tuples with a 4-byte
+		 * integer key at offset 4. Same as sort<int>(4, BitonicSort).
 		 */
 		void bitonicsort();
 		
@@ -331,9 +369,62 @@ class TupleBuffer : public Buffer
 		 */
 		inline const unsigned long long getNumTuples();
 
+		/**
+		 * Gets the size of each tuple, which is also the distance between
+		 * consecutive tuples.
+		 */
+		inline unsigned int getTupleSize() { return tuplesize; }
+
 	protected:
 		unsigned int tuplesize;
 
+		/**
+		 * Key of a tuple, transformed so that unsigned integer order
+		 * matches the order of the original key, and the index of the tuple.
+		 */
+		struct NormalizedKey
+		{
+			unsigned long long key;
+			unsigned int index;
+		} __attribute__((__packed__));
+
+		/**
+		 * Sorts \a keys, which has one entry per tuple, on the lowest
+		 * \a keybits bits of each key, then permutes tuples in the same
+		 * order. Deallocates \a keys.
+		 */
+		void radixsortNormalized(NormalizedKey* keys, unsigned int keybits);
+
+		/**
+		 * Same as radixsortNormalized(), for keys of up to 32 bits which are 
+		 * stored in the high half of each entry of \a keys, with the tuple
+		 * index in the low half.
+		 */
+		void radixsortPacked(unsigned long long* keys, unsigned int keybits);
+
+		/**
+		 * Sorts normalized \a keys with the SIMD bitonic merge sort, then
+		 * permutes tuples in the same order. If \a rids is NULL, \a keys
+		 * are packed as for radixsortPacked(), otherwise \a rids holds the
+		 * tuple index of each key. Deallocates \a keys and \a rids.
+		 */
+		void bitonicsortKeys(unsigned long long* keys, unsigned long long* rids);
+
+		/**
+		 * Sorts through an array of (key, index) pairs, for any tuple size
+		 * and key offset.
+		 */
+		template <typename KeyT>
+		void indexsort(unsigned int keyoffset);
+
+		/**
+		 * Reorders all tuples so that the i-th tuple is the one at index
+		 * KeyOps::index(sorted[i]). Tuples are copied to a scratch area in
+		 * sequential order and then copied back.
+		 */
+		template <typename KeyOps>
+		void gatherTuples(const typename KeyOps::EntryT* sorted);
+
 };
 
 
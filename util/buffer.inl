@@ -84,7 +84,10 @@ inline const unsigned long long Buffer::getUsedSpace()
 
 inline const unsigned long long TupleBuffer::getNumTuples()
 {
-	return getUsedSpace()/tuplesize;
+	// Pages with no tuples, like Operator::EmptyPage, may have no tuple size.
+	//
+	const unsigned long long used = getUsedSpace();
+	return (used == 0) ? 0 : used/tuplesize;
 }
 
 inline void* TupleBuffer::getTupleOffset(unsigned long long pos) 
@@ -117,6 +120,8 @@ inline bool TupleBuffer::isValidTupleAddress(void* loc)
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include "numaallocate.h"
 
 template<int tuplesize, int keyoffset, typename KeyT>
 struct ElementWithKey
@@ -132,15 +137,242 @@ struct ElementWithKey
 } __attribute__((__packed__));
 
 
+/*
+ * Order-preserving key normalization for radix sorting: the returned keys
+ * compare as unsigned integers in the same order as the original keys.
+ */
+inline unsigned long long normalizeSortKey(unsigned int key)
+{
+	return key;
+}
+
+inline unsigned long long normalizeSortKey(int key)
+{
+	return static_cast<unsigned int>(key) ^ 0x80000000u;
+}
+
+inline unsigned long long normalizeSortKey(unsigned long long key)
+{
+	return key;
+}
+
+inline unsigned long long normalizeSortKey(long long key)
+{
+	return static_cast<unsigned long long>(key) ^ 0x8000000000000000uLL;
+}
+
+/*
+ * Positive doubles get their sign bit set, negative doubles get all bits
+ * flipped, so that larger magnitudes of negative numbers sort first.
+ */
+inline unsigned long long normalizeSortKey(double key)
+{
+	unsigned long long bits;
+	memcpy(&bits, &key, sizeof(bits));
+	return (bits & 0x8000000000000000uLL) ? ~bits : (bits | 0x8000000000000000uLL);
+}
+
+/*
+ * Entry of the (key, index) array that indexsort() sorts. 
+ */
 template <typename KeyT>
-void TupleBuffer::sort(unsigned int keyoffset)
+struct KeyWithIndex
 {
-#ifdef BITONIC_SORT
-	// Bitonic sort is never invoked through this function call, because it
-	// only works for 8-byte tuples. Throw here to catch early.
+	KeyT key;
+	unsigned int index;
+
+	bool operator< (const KeyWithIndex<KeyT>& el) const
+	{
+		return key < el.key;
+	}
+} __attribute__((__packed__));
+
+template <typename KeyT>
+struct KeyWithIndexOps
+{
+	typedef KeyWithIndex<KeyT> EntryT;
+	static unsigned long long index(const EntryT& e) { return e.index; }
+};
+
+/*
+ * Entry of an array of tuple indexes. 
+ */
+struct RowIdOps
+{
+	typedef unsigned long long EntryT;
+	static unsigned long long index(const EntryT& e) { return e; }
+};
+
+/*
+ * Orders tuple indexes by the tuples they point to, for sortby().
+ */
+template <typename LessT>
+class TupleIndexOrder
+{
+	public:
+		TupleIndexOrder(char* data, unsigned int tuplesize, const LessT& less)
+			: data(data), tuplesize(tuplesize), less(less)
+		{ }
+
+		inline bool operator()(unsigned long long l, unsigned long long r) const
+		{
+			return less(data + l * tuplesize, data + r * tuplesize);
+		}
+
+	private:
+		char* data;
+		unsigned int tuplesize;
+		const LessT& less;
+};
+
+template <typename KeyOps>
+void TupleBuffer::gatherTuples(const typename KeyOps::EntryT* sorted)
+{
+	// How many tuples ahead to prefetch. 
 	//
-	throw UnknownAlgorithmException();
-#endif
+	const unsigned long long PREFETCH_DISTANCE = 8;
+
+	const unsigned long long tuples = getNumTuples();
+	const char* in = (const char*) data;
+	char* out = (char*) numaallocate_local("Gthr", tuples * tuplesize, this);
+
+	for (unsigned long long i=0; i<tuples; ++i)
+	{
+		if (i + PREFETCH_DISTANCE < tuples)
+		{
+			const char* ahead = in 
+				+ KeyOps::index(sorted[i + PREFETCH_DISTANCE]) * tuplesize;
+			for (unsigned int b=0; b<tuplesize; b+=64)
+				__builtin_prefetch(ahead + b);
+		}
+
+		memcpy(out + i * tuplesize, 
+				in + KeyOps::index(sorted[i]) * tuplesize, tuplesize);
+	}
+
+	memcpy(data, out, tuples * tuplesize);
+	numadeallocate(out);
+}
+
+template <typename KeyT>
+void TupleBuffer::indexsort(unsigned int keyoffset)
+{
+	const unsigned long long tuples = getNumTuples();
+	if (tuples < 2)
+		return;
+
+	assert(tuples <= 0xFFFFFFFFuLL);
+
+	KeyWithIndex<KeyT>* keys = (KeyWithIndex<KeyT>*) numaallocate_local(
+			"IdxK", tuples * sizeof(KeyWithIndex<KeyT>), this);
+
+	const char* tup = (const char*) data;
+	for (unsigned long long i=0; i<tuples; ++i, tup += tuplesize)
+	{
+		memcpy(&keys[i].key, tup + keyoffset, sizeof(KeyT));
+		keys[i].index = i;
+	}
+
+	std::sort(keys, keys + tuples);
+
+	gatherTuples<KeyWithIndexOps<KeyT> >(keys);
+	numadeallocate(keys);
+}
+
+template <typename LessT>
+void TupleBuffer::sortby(const LessT& less)
+{
+	const unsigned long long tuples = getNumTuples();
+	if (tuples < 2)
+		return;
+
+	unsigned long long* rids = (unsigned long long*) numaallocate_local(
+			"SrtR", tuples * sizeof(unsigned long long), this);
+
+	for (unsigned long long i=0; i<tuples; ++i)
+	{
+		rids[i] = i;
+	}
+
+	std::sort(rids, rids + tuples, 
+			TupleIndexOrder<LessT>((char*) data, tuplesize, less));
+
+	gatherTuples<RowIdOps>(rids);
+	numadeallocate(rids);
+}
+
+template <typename KeyT>
+void TupleBuffer::sort(unsigned int keyoffset, SortAlgorithm algo)
+{
+	if (algo == IndexSort)
+	{
+		indexsort<KeyT>(keyoffset);
+		return;
+	}
+
+	if (algo == RadixSort || algo == BitonicSort)
+	{
+		const unsigned long long tuples = getNumTuples();
+		if (tuples < 2)
+			return;
+
+		char* tup = (char*) data;
+		assert(tuples <= 0xFFFFFFFFuLL);
+
+		// Keys of up to 4 bytes are packed with the tuple index in one word.
+		//
+		if (sizeof(KeyT) <= 4)
+		{
+			unsigned long long* keys = (unsigned long long*) 
+				numaallocate_local("RdxK", tuples * sizeof(unsigned long long), this);
+
+			for (unsigned long long i=0; i<tuples; ++i, tup += tuplesize)
+			{
+				KeyT k;
+				memcpy(&k, tup + keyoffset, sizeof(KeyT));
+				keys[i] = (normalizeSortKey(k) << 32) | i;
+			}
+
+			if (algo == RadixSort)
+				radixsortPacked(keys, sizeof(KeyT) * 8);
+			else
+				bitonicsortKeys(keys, NULL);
+			return;
+		}
+
+		if (algo == BitonicSort)
+		{
+			unsigned long long* keys = (unsigned long long*) 
+				numaallocate_local("BSrK", tuples * sizeof(unsigned long long), this);
+			unsigned long long* rids = (unsigned long long*) 
+				numaallocate_local("BSrR", tuples * sizeof(unsigned long long), this);
+
+			for (unsigned long long i=0; i<tuples; ++i, tup += tuplesize)
+			{
+				KeyT k;
+				memcpy(&k, tup + keyoffset, sizeof(KeyT));
+				keys[i] = normalizeSortKey(k);
+				rids[i] = i;
+			}
+
+			bitonicsortKeys(keys, rids);
+			return;
+		}
+
+		NormalizedKey* keys = (NormalizedKey*) numaallocate_local(
+				"RdxK", tuples * sizeof(NormalizedKey), this);
+
+		for (unsigned long long i=0; i<tuples; ++i, tup += tuplesize)
+		{
+			KeyT k;
+			memcpy(&k, tup + keyoffset, sizeof(KeyT));
+			keys[i].key = normalizeSortKey(k);
+			keys[i].index = i;
+		}
+
+		radixsortNormalized(keys, sizeof(KeyT) * 8);
+		return;
+	}
 
 	const unsigned long long tuples = getNumTuples();
 
@@ -164,7 +396,8 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
@@ -186,7 +419,8 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
@@ -201,7 +435,8 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
@@ -216,7 +451,8 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
@@ -231,7 +467,8 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
@@ -260,7 +497,8 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
@@ -282,12 +520,14 @@ void TupleBuffer::sort(unsigned int keyoffset)
 						break;
 					}
 				default:
-					assert(false);
+					indexsort<KeyT>(keyoffset);
+					break;
 			}
 			break;
 
 		default:
-			assert(false);
+			indexsort<KeyT>(keyoffset);
+			break;
 	}
 }
 
@@ -312,7 +552,7 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
@@ -330,7 +570,7 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
@@ -348,7 +588,7 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
@@ -366,7 +606,7 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
@@ -384,7 +624,7 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
@@ -412,7 +652,7 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
@@ -440,13 +680,27 @@ unsigned int TupleBuffer::findsmallest(unsigned int keyoffset, KeyT key)
 						return res - a;
 					}
 				default:
-					assert(false);
+					break;
 			}
 			break;
 
 		default:
-			assert(false);
+			break;
 	}
 
-	assert(false);
+	// No specialization for this layout, binary search on the tuples.
+	//
+	unsigned long long lo = 0;
+	unsigned long long hi = tuples;
+	while (lo < hi)
+	{
+		unsigned long long mid = lo + (hi - lo) / 2;
+		KeyT midkey;
+		memcpy(&midkey, (char*) data + mid * tuplesize + keyoffset, sizeof(KeyT));
+		if (midkey < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
 }
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "densekeytable.h"
+#include "../hash.h"
+
+#ifdef DEBUG
+#include <cstring>
+#endif
+
+void DenseKeyTable::init(CtLong min, CtLong max, unsigned int tuplesize, 
+		vector<char> partitions, void* allocsource)
+{
+	assert(min <= max);
+
+	// If partitions is empty, localy allocate a single memory region.
+	//
+	if (partitions.empty())
+		partitions.push_back(-1);
+
+	assertpowerof2(partitions.size());
+	assert(partitions.size() <= MAX_PART); // check we don't overflow array
+	log2partitions = getlogarithm(partitions.size());
+
+	this->keymin = min;
+	this->keymax = max;
+	this->tuplesize = tuplesize;
+	this->nslots = max - min + 1;
+	this->failed = false;
+
+	unsigned int noparts = 1<<log2partitions;
+
+	for (unsigned int i = 0; i<noparts; ++i)
+	{
+		size_t partsize = tuplesize * ((nslots+noparts-1)/noparts);
+		slots[i] = numaallocate_onnode("DKtS", partsize, partitions.at(i), allocsource);
+		assert(slots[i] != NULL);
+
+#ifdef DEBUG
+		memset(slots[i], 0xBC, partsize);
+#endif
+	}
+
+	// The bitmap is read on every lookup, so it is placed with the first
+	// partition of the slots.
+	//
+	size_t bitmapsize = sizeof(unsigned long) 
+		* ((nslots + BITS_PER_WORD - 1) / BITS_PER_WORD);
+	bitmap = (volatile unsigned long*) 
+		numaallocate_onnode("DKtB", bitmapsize, partitions.at(0), allocsource);
+	assert(bitmap != NULL);
+}
+
+void DenseKeyTable::clear(int thisthread, int totalthreads)
+{
+	unsigned long long thread = thisthread;
+	unsigned long long words = (nslots + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+	unsigned long long startoffset = ((thread+0uLL)*words) / totalthreads;
+	unsigned long long endoffset   = ((thread+1uLL)*words) / totalthreads;
+
+	for (unsigned long long i = startoffset; i < endoffset; ++i)
+	{
+		bitmap[i] = 0;
+	}
+
+	failed = false;
+}
+
+void DenseKeyTable::destroy()
+{
+	unsigned int noparts = 1<<log2partitions;
+
+	for (unsigned int i = 0; i<noparts; ++i)
+	{
+		numadeallocate(slots[i]);
+		slots[i] = NULL;
+	}
+
+	numadeallocate((void*)bitmap);
+	bitmap = NULL;
+}
+
+unsigned long long DenseKeyTable::statOccupied()
+{
+	unsigned long long ret = 0;
+	unsigned long long words = (nslots + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+	for (unsigned long long i = 0; i < words; ++i)
+	{
+		ret += __builtin_popcountl(bitmap[i]);
+	}
+
+	return ret;
+}
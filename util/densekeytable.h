@@ -0,0 +1,198 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYDENSEKEYTABLE__
+#define __MYDENSEKEYTABLE__
+
+#include "../schema.h"
+#include "custom_asserts.h"
+#include "static_assert.h"
+#include "numaallocate.h"
+#include "atomics.h"
+
+#include <vector>
+using std::vector;
+
+/**
+ * Direct-indexed table for unique keys drawn from a dense integer domain
+ * [min, max]. Slot (key - min) holds the single tuple with that key, and a
+ * presence bitmap tracks which slots are occupied. A lookup is therefore a
+ * bounds check, a bitmap test and a load, with no hashing, chaining or key
+ * comparison.
+ *
+ * The table does not handle duplicate keys. An insertion of a key that is
+ * out of range or already present fails and returns NULL, and the caller is
+ * expected to fall back to a regular HashTable.
+ */
+class DenseKeyTable {
+	public:
+		friend class PrettyPrinterVisitor;
+
+		DenseKeyTable() 
+			: keymin(0), keymax(-1), tuplesize(0), nslots(0), 
+			  log2partitions(0), bitmap(0), failed(false)
+		{
+			for (unsigned int i=0; i<MAX_PART; ++i)
+				slots[i] = 0;
+		}
+
+		/**
+		 * Initializes the table. Not thread-safe.
+		 * @param min Smallest key that can be stored (inclusive).
+		 * @param max Largest key that can be stored (inclusive).
+		 * @param tuplesize Size of each tuple (in bytes).
+		 * @param partitions NUMA placement of slot memory, with the same
+		 * semantics as in HashTable::init. Slots are striped across
+		 * partitions on the least significant bits of their index.
+		 * @param allocsource Debugging info passed to allocator.
+		 */
+		void init(CtLong min, CtLong max, unsigned int tuplesize, 
+				vector<char> partitions, void* allocsource);
+
+		/**
+		 * Resets the presence bitmap and the failure flag. Must be called
+		 * after \a init, by all \a totalthreads threads. Not thread-safe with
+		 * respect to concurrent inserts or lookups.
+		 */
+		void clear(int thisthread, int totalthreads);
+
+		/**
+		 * Deallocates memory, reversing \a init(). Not thread-safe.
+		 */
+		void destroy();
+
+		/**
+		 * Claims the slot for \a key atomically. 
+		 * @return Location that has \a tuplesize bytes for writing, or NULL
+		 * if \a key is out of range or has already been inserted.
+		 */
+		inline void* atomicAllocate(CtLong key)
+		{
+			unsigned long long idx = key - keymin;
+			if (idx >= nslots)
+				return 0;
+
+			volatile unsigned long* word = &bitmap[idx / BITS_PER_WORD];
+			unsigned long mask = 1uL << (idx % BITS_PER_WORD);
+			unsigned long oldval = *word;
+			unsigned long seen;
+
+			while ((oldval & mask) == 0)
+			{
+				seen = atomic_compare_and_swap(word, oldval, oldval | mask);
+				if (seen == oldval)
+					return getSlot(idx);
+				oldval = seen;
+			}
+
+			return 0;
+		}
+
+		/**
+		 * Returns the tuple stored for \a key, or NULL if none exists.
+		 */
+		inline void* lookup(CtLong key)
+		{
+			unsigned long long idx = key - keymin;
+			if (idx >= nslots)
+				return 0;
+
+			if ((bitmap[idx / BITS_PER_WORD] & (1uL << (idx % BITS_PER_WORD))) == 0)
+				return 0;
+
+			return getSlot(idx);
+		}
+
+		/**
+		 * Returns the tuple stored at slot \a idx, or NULL if the slot is
+		 * empty. Used to migrate the contents to a HashTable on fallback.
+		 */
+		inline void* slotIfPresent(unsigned long long idx)
+		{
+			dbg2assert(idx < nslots);
+			if ((bitmap[idx / BITS_PER_WORD] & (1uL << (idx % BITS_PER_WORD))) == 0)
+				return 0;
+			return getSlot(idx);
+		}
+
+		inline unsigned long long getNumberOfSlots()
+		{
+			return nslots;
+		}
+
+		/**
+		 * Marks the table as unusable, because a tuple could not be stored.
+		 * The caller is responsible for placing that tuple elsewhere.
+		 */
+		inline void markFailed()
+		{
+			failed = true;
+		}
+
+		inline bool hasFailed()
+		{
+			return failed;
+		}
+
+		/**
+		 * Returns the number of occupied slots. The caller must guarantee
+		 * that no threads are inserting while this method is called.
+		 */
+		unsigned long long statOccupied();
+
+	private:
+		static const unsigned int MAX_PART = 4;
+		static const unsigned int BITS_PER_WORD = sizeof(unsigned long) * 8;
+
+		inline void* getSlot(unsigned long long idx)
+		{
+			unsigned int part = idx & ((1 << log2partitions) - 1);
+			unsigned long long pos = idx >> log2partitions;
+
+			dbg2assert(slots[part] != 0);
+			return (char*)slots[part] + pos * tuplesize;
+		}
+
+		CtLong keymin;
+		CtLong keymax;
+		unsigned int tuplesize;
+		unsigned long long nslots;
+		unsigned int log2partitions;
+
+		void* slots[MAX_PART];
+		volatile unsigned long* bitmap;
+
+		volatile bool failed;
+};
+
+#endif
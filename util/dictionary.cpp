@@ -0,0 +1,140 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "dictionary.h"
+#include "hashkernels.h"
+#include "custom_asserts.h"
+
+using std::map;
+using std::string;
+
+/**
+ * Named dictionaries, so that scans of different tables share them.
+ */
+static Lock registrylock;
+static map<string, Dictionary*> registry;
+
+Dictionary::Dictionary(const string& name)
+	: name(name), refcount(1)
+{
+}
+
+int Dictionary::encode(const char* value, size_t len)
+{
+	const unsigned int shardid = crc32key(value, len) & (Shards - 1);
+	Shard& shard = shards[shardid];
+	const string key(value, len);
+
+	shard.lock.lock();
+	map<string, int>::iterator it = shard.codes.find(key);
+	int code;
+	if (it != shard.codes.end())
+	{
+		code = it->second;
+	}
+	else
+	{
+		code = (shard.values.size() << ShardBits) | shardid;
+		shard.codes[key] = code;
+		shard.values.push_back(key);
+	}
+	shard.lock.unlock();
+
+	return code;
+}
+
+string Dictionary::decode(int code)
+{
+	Shard& shard = shards[code & (Shards - 1)];
+	const unsigned int idx = static_cast<unsigned int>(code) >> ShardBits;
+
+	shard.lock.lock();
+	dbgassert(idx < shard.values.size());
+	string ret = shard.values[idx];
+	shard.lock.unlock();
+
+	return ret;
+}
+
+unsigned int Dictionary::size()
+{
+	unsigned int ret = 0;
+	for (unsigned int i=0; i<Shards; ++i)
+	{
+		shards[i].lock.lock();
+		ret += shards[i].values.size();
+		shards[i].lock.unlock();
+	}
+	return ret;
+}
+
+Dictionary* Dictionary::acquire(const string& name)
+{
+	if (name.empty())
+		return new Dictionary(name);
+
+	registrylock.lock();
+	Dictionary* ret;
+	map<string, Dictionary*>::iterator it = registry.find(name);
+	if (it != registry.end())
+	{
+		ret = it->second;
+		ret->refcount++;
+	}
+	else
+	{
+		ret = new Dictionary(name);
+		registry[name] = ret;
+	}
+	registrylock.unlock();
+
+	return ret;
+}
+
+void Dictionary::release(Dictionary* dictionary)
+{
+	if (dictionary->name.empty())
+	{
+		delete dictionary;
+		return;
+	}
+
+	registrylock.lock();
+	bool last = (--dictionary->refcount == 0);
+	if (last)
+		registry.erase(dictionary->name);
+	registrylock.unlock();
+
+	if (last)
+		delete dictionary;
+}
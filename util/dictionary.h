@@ -0,0 +1,108 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYDICTIONARY__
+#define __MYDICTIONARY__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../lock.h"
+
+/**
+ * Dictionary of the distinct values of "char" columns, assigning each value
+ * a 32-bit code. Codes are assigned in order of first appearance, so they
+ * preserve equality but not order.
+ *
+ * Values are spread over \a Shards shards on their CRC32 hash, each with its
+ * own lock, so that threads loading different files of a table can encode
+ * concurrently. The shard is kept in the low \a ShardBits bits of a code.
+ */
+class Dictionary
+{
+	public:
+		Dictionary(const std::string& name);
+
+		/**
+		 * Returns the code of the \a len bytes at \a value, assigning a new
+		 * code if the value is not in the dictionary. Thread-safe.
+		 */
+		int encode(const char* value, size_t len);
+
+		/**
+		 * Returns the value of \a code. Thread-safe.
+		 */
+		std::string decode(int code);
+
+		/**
+		 * Returns the number of distinct values.
+		 */
+		unsigned int size();
+
+		const std::string& getName() { return name; }
+
+		/**
+		 * Returns the dictionary called \a name, creating it if it does not
+		 * exist, so that columns of different tables that are encoded with
+		 * the same dictionary can be compared and joined on their codes.
+		 * Every dictionary that is not anonymous must be acquired and
+		 * released in pairs. An anonymous dictionary is created every time
+		 * \a name is empty.
+		 */
+		static Dictionary* acquire(const std::string& name);
+
+		/**
+		 * Releases \a dictionary, destroying it after its last release.
+		 */
+		static void release(Dictionary* dictionary);
+
+		static const unsigned int ShardBits = 4;
+		static const unsigned int Shards = 1 << ShardBits;
+
+	private:
+		struct Shard
+		{
+			char padding1[64];
+			Lock lock;
+			std::map<std::string, int> codes;
+			std::vector<std::string> values;
+			char padding2[64];
+		};
+
+		Shard shards[Shards];
+		std::string name;
+		unsigned int refcount;	///< Protected by the registry lock.
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Arithmetic kernels of the compute operator. The generic loops in
+ * exprkernels.inl are compiled once per instruction set, each in its own
+ * namespace and with its own target options, as in simdsort.cpp.
+ */
+
+#include "exprkernels.h"
+
+namespace exprkernels_sse2
+{
+#include "exprkernels.inl"
+}
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace exprkernels_avx2
+{
+#include "exprkernels.inl"
+}
+#pragma GCC pop_options
+
+static ExprKernelIsa detectIsa()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return ExprKernelAVX2;
+	return ExprKernelSSE2;
+}
+
+ExprKernelIsa exprKernelDetectIsa()
+{
+	static ExprKernelIsa isa = detectIsa();
+	return isa;
+}
+
+const char* exprKernelIsaName(ExprKernelIsa isa)
+{
+	switch (isa)
+	{
+		case ExprKernelAVX2:
+			return "avx2";
+		default:
+			return "sse2";
+	}
+}
+
+void exprarith(ExprArithOp op, const long long* a, const long long* b, 
+		long long* out, unsigned int count, ExprKernelIsa isa)
+{
+	if (isa == ExprKernelAVX2)
+		exprkernels_avx2::arithlong(op, a, b, out, count);
+	else
+		exprkernels_sse2::arithlong(op, a, b, out, count);
+}
+
+void exprarith(ExprArithOp op, const double* a, const double* b, 
+		double* out, unsigned int count, ExprKernelIsa isa)
+{
+	if (isa == ExprKernelAVX2)
+		exprkernels_avx2::arithdouble(op, a, b, out, count);
+	else
+		exprkernels_sse2::arithdouble(op, a, b, out, count);
+}
+
+void exprconvert(const long long* in, double* out, unsigned int count, 
+		ExprKernelIsa isa)
+{
+	if (isa == ExprKernelAVX2)
+		exprkernels_avx2::longtodouble(in, out, count);
+	else
+		exprkernels_sse2::longtodouble(in, out, count);
+}
+
+void exprconvert(const double* in, long long* out, unsigned int count, 
+		ExprKernelIsa isa)
+{
+	if (isa == ExprKernelAVX2)
+		exprkernels_avx2::doubletolong(in, out, count);
+	else
+		exprkernels_sse2::doubletolong(in, out, count);
+}
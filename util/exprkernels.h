@@ -0,0 +1,86 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYEXPRKERNELS__
+#define __MYEXPRKERNELS__
+
+/**
+ * Instruction sets that the expression kernels are compiled for.
+ */
+enum ExprKernelIsa
+{
+	ExprKernelSSE2,		///< Baseline of all x86-64 CPUs, 2 values per register.
+	ExprKernelAVX2		///< 4 values per register.
+};
+
+/**
+ * Returns the widest instruction set this CPU supports, as detected on the
+ * first call.
+ */
+ExprKernelIsa exprKernelDetectIsa();
+
+/**
+ * Returns a printable name for \a isa.
+ */
+const char* exprKernelIsaName(ExprKernelIsa isa);
+
+enum ExprArithOp
+{
+	ExprAdd,
+	ExprSub,
+	ExprMul,
+	ExprDiv
+};
+
+/**
+ * Computes \a out[i] = \a a[i] \a op \a b[i] for the first \a count values.
+ * Integer division truncates towards zero, and division by zero yields zero.
+ * The kernel for \a isa is used, which must be supported by this CPU.
+ */
+void exprarith(ExprArithOp op, const long long* a, const long long* b, 
+		long long* out, unsigned int count, ExprKernelIsa isa);
+
+void exprarith(ExprArithOp op, const double* a, const double* b, 
+		double* out, unsigned int count, ExprKernelIsa isa);
+
+/**
+ * Converts the first \a count values of \a in to \a out. Conversion to
+ * integers truncates towards zero.
+ */
+void exprconvert(const long long* in, double* out, unsigned int count, 
+		ExprKernelIsa isa);
+
+void exprconvert(const double* in, long long* out, unsigned int count, 
+		ExprKernelIsa isa);
+
+#endif
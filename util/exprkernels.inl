@@ -0,0 +1,99 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Generic part of the expression kernels, included once per instruction set
+ * by exprkernels.cpp. The loops work on contiguous arrays with no
+ * dependencies between iterations, so that the compiler vectorizes them for
+ * the target options of the including namespace.
+ */
+
+static void arithlong(ExprArithOp op, const long long* a, const long long* b, 
+		long long* out, unsigned int count)
+{
+	switch (op)
+	{
+		case ExprAdd:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = a[i] + b[i];
+			break;
+		case ExprSub:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = a[i] - b[i];
+			break;
+		case ExprMul:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = a[i] * b[i];
+			break;
+		case ExprDiv:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = (b[i] == 0) ? 0 : a[i] / b[i];
+			break;
+	}
+}
+
+static void arithdouble(ExprArithOp op, const double* a, const double* b, 
+		double* out, unsigned int count)
+{
+	switch (op)
+	{
+		case ExprAdd:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = a[i] + b[i];
+			break;
+		case ExprSub:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = a[i] - b[i];
+			break;
+		case ExprMul:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = a[i] * b[i];
+			break;
+		case ExprDiv:
+			for (unsigned int i=0; i<count; ++i)
+				out[i] = (b[i] == 0) ? 0 : a[i] / b[i];
+			break;
+	}
+}
+
+static void longtodouble(const long long* in, double* out, unsigned int count)
+{
+	for (unsigned int i=0; i<count; ++i)
+		out[i] = static_cast<double>(in[i]);
+}
+
+static void doubletolong(const double* in, long long* out, unsigned int count)
+{
+	for (unsigned int i=0; i<count; ++i)
+		out[i] = static_cast<long long>(in[i]);
+}
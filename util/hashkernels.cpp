@@ -0,0 +1,265 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Batch hash kernels. Kernels that need an instruction set extension are
+ * compiled with their own target options, and are selected at runtime based
+ * on what the CPU supports, as in simdsort.cpp. Every kernel returns the
+ * same hash values, so threads on different CPUs agree on buckets.
+ */
+
+#include "hashkernels.h"
+
+#include <cstring>
+#include <immintrin.h>
+
+/**
+ * CRC32-C starts from all ones, so that leading zero bytes are not lost.
+ */
+static const unsigned int CrcSeed = 0xFFFFFFFFu;
+
+/**
+ * Reflected Castagnoli polynomial, which the SSE 4.2 CRC32 instruction uses.
+ */
+static const unsigned int CrcPolynomial = 0x82F63B78u;
+
+static unsigned int crctable[256];
+
+static bool buildcrctable()
+{
+	for (unsigned int i=0; i<256; ++i)
+	{
+		unsigned int c = i;
+		for (int j=0; j<8; ++j)
+			c = (c & 1) ? (c >> 1) ^ CrcPolynomial : (c >> 1);
+		crctable[i] = c;
+	}
+	return true;
+}
+
+static unsigned int crc32scalar(const char* p, size_t size)
+{
+	static bool built = buildcrctable();
+	(void) built;
+
+	unsigned int c = CrcSeed;
+	for (size_t i=0; i<size; ++i)
+		c = crctable[(c ^ (unsigned char) p[i]) & 0xFF] ^ (c >> 8);
+	return c;
+}
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+static unsigned int crc32sse42(const char* p, size_t size)
+{
+	unsigned long long c = CrcSeed;
+	for (; size >= 8; size -= 8, p += 8)
+	{
+		unsigned long long v;
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+
+	unsigned int c32 = static_cast<unsigned int>(c);
+	if (size >= 4)
+	{
+		unsigned int v;
+		memcpy(&v, p, sizeof(v));
+		c32 = _mm_crc32_u32(c32, v);
+		size -= 4;
+		p += 4;
+	}
+	for (; size > 0; --size, ++p)
+		c32 = _mm_crc32_u8(c32, *p);
+
+	return c32;
+}
+
+static void hashcrc32sse42(const char* first, unsigned int count, 
+		unsigned int stride, size_t size, unsigned int mask, unsigned int* out)
+{
+	for (unsigned int i=0; i<count; ++i)
+		out[i] = crc32sse42(first + i * (unsigned long long) stride, size) & mask;
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+/**
+ * Low 64 bits of the product of each lane of \a a and \a b. AVX2 only
+ * multiplies 32-bit halves, so the product is put together from three.
+ */
+static inline __m256i mullo64(__m256i a, __m256i b)
+{
+	__m256i lo = _mm256_mul_epu32(a, b);
+	__m256i cross1 = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+	__m256i cross2 = _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32));
+	__m256i cross = _mm256_slli_epi64(_mm256_add_epi64(cross1, cross2), 32);
+	return _mm256_add_epi64(lo, cross);
+}
+
+static void hashmultiplyshiftavx2(const char* first, unsigned int count, 
+		unsigned int stride, unsigned int keysize, unsigned int log2buckets,
+		unsigned int* out)
+{
+	const __m256i mult = _mm256_set1_epi64x(MultiplyShiftConstant);
+	const __m128i shift = _mm_cvtsi32_si128(64 - log2buckets);
+	const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	const long long s = stride;
+
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const char* base = first + i * (unsigned long long) stride;
+		__m256i keys;
+		if (keysize == sizeof(long long))
+		{
+			keys = _mm256_i64gather_epi64((const long long*) base, 
+					_mm256_setr_epi64x(0, s, 2*s, 3*s), 1);
+		}
+		else
+		{
+			keys = _mm256_cvtepi32_epi64(_mm_i32gather_epi32((const int*) base,
+					_mm_setr_epi32(0, stride, 2*stride, 3*stride), 1));
+		}
+
+		// Shifting by 64 leaves zero, which is the right hash for one bucket.
+		//
+		__m256i h = _mm256_srl_epi64(mullo64(keys, mult), shift);
+		h = _mm256_permutevar8x32_epi32(h, pack);
+		_mm_storeu_si128((__m128i*) (out + i), _mm256_castsi256_si128(h));
+	}
+
+	for (; i < count; ++i)
+	{
+		const char* key = first + i * (unsigned long long) stride;
+		long long v = (keysize == sizeof(long long)) ? *(long long*) key : *(int*) key;
+		out[i] = multiplyshift(v, log2buckets);
+	}
+}
+#pragma GCC pop_options
+
+static HashKernelIsa detectIsa()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return HashKernelAVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return HashKernelSSE42;
+	return HashKernelScalar;
+}
+
+HashKernelIsa hashKernelDetectIsa()
+{
+	static HashKernelIsa isa = detectIsa();
+	return isa;
+}
+
+const char* hashKernelIsaName(HashKernelIsa isa)
+{
+	switch (isa)
+	{
+		case HashKernelSSE42:
+			return "sse4.2";
+		case HashKernelAVX2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+void hashmultiplyshift(const char* first, unsigned int count, 
+		unsigned int stride, unsigned int keysize, unsigned int log2buckets,
+		unsigned int* out, HashKernelIsa isa)
+{
+	if (isa == HashKernelAVX2)
+	{
+		hashmultiplyshiftavx2(first, count, stride, keysize, log2buckets, out);
+		return;
+	}
+
+	if (keysize == sizeof(long long))
+	{
+		for (unsigned int i=0; i<count; ++i)
+			out[i] = multiplyshift(
+					*(long long*) (first + i * (unsigned long long) stride), 
+					log2buckets);
+	}
+	else
+	{
+		for (unsigned int i=0; i<count; ++i)
+			out[i] = multiplyshift(
+					*(int*) (first + i * (unsigned long long) stride), 
+					log2buckets);
+	}
+}
+
+void hashmultiplyshift(const char* first, unsigned int count, 
+		unsigned int stride, unsigned int keysize, unsigned int log2buckets,
+		unsigned int* out)
+{
+	hashmultiplyshift(first, count, stride, keysize, log2buckets, out, 
+			hashKernelDetectIsa());
+}
+
+unsigned int crc32key(const void* key, size_t size, HashKernelIsa isa)
+{
+	if (isa == HashKernelScalar)
+		return crc32scalar(static_cast<const char*>(key), size);
+	return crc32sse42(static_cast<const char*>(key), size);
+}
+
+unsigned int crc32key(const void* key, size_t size)
+{
+	return crc32key(key, size, hashKernelDetectIsa());
+}
+
+void hashcrc32(const char* first, unsigned int count, unsigned int stride,
+		size_t size, unsigned int mask, unsigned int* out, HashKernelIsa isa)
+{
+	if (isa != HashKernelScalar)
+	{
+		hashcrc32sse42(first, count, stride, size, mask, out);
+		return;
+	}
+
+	for (unsigned int i=0; i<count; ++i)
+		out[i] = crc32scalar(first + i * (unsigned long long) stride, size) & mask;
+}
+
+void hashcrc32(const char* first, unsigned int count, unsigned int stride,
+		size_t size, unsigned int mask, unsigned int* out)
+{
+	hashcrc32(first, count, stride, size, mask, out, hashKernelDetectIsa());
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYHASHKERNELS__
+#define __MYHASHKERNELS__
+
+#include <cstddef>
+
+/**
+ * Instruction sets that the batch hash kernels have implementations for.
+ */
+enum HashKernelIsa
+{
+	HashKernelScalar,	///< Portable fallback.
+	HashKernelSSE42,	///< Hardware CRC32-C.
+	HashKernelAVX2		///< Hardware CRC32-C, 4 multiply-shift keys per register.
+};
+
+/**
+ * Returns the widest instruction set this CPU supports, as detected on the
+ * first call.
+ */
+HashKernelIsa hashKernelDetectIsa();
+
+/**
+ * Returns a printable name for \a isa.
+ */
+const char* hashKernelIsaName(HashKernelIsa isa);
+
+/**
+ * Odd 64-bit multiplier of the multiply-shift hash, 2^64 / golden ratio.
+ */
+const unsigned long long MultiplyShiftConstant = 0x9E3779B97F4A7C15uLL;
+
+/**
+ * Multiply-shift hash of \a key to \a log2buckets bits: the top bits of the
+ * 64-bit product of \a key with MultiplyShiftConstant.
+ */
+inline unsigned int multiplyshift(long long key, unsigned int log2buckets)
+{
+	if (log2buckets == 0)
+		return 0;
+	unsigned long long h = ((unsigned long long) key) * MultiplyShiftConstant;
+	return static_cast<unsigned int>(h >> (64 - log2buckets));
+}
+
+/**
+ * Multiply-shift hashes \a count integer keys of \a keysize bytes into \a
+ * out. The first key is at \a first, and every key is \a stride bytes after
+ * the previous one. Keys of 4 bytes are sign-extended, so an int and a long
+ * with the same value hash to the same bucket.
+ *
+ * The kernel for \a isa is used, which must be supported by this CPU.
+ * The overload without \a isa uses hashKernelDetectIsa().
+ */
+void hashmultiplyshift(const char* first, unsigned int count, 
+		unsigned int stride, unsigned int keysize, unsigned int log2buckets,
+		unsigned int* out, HashKernelIsa isa);
+
+void hashmultiplyshift(const char* first, unsigned int count, 
+		unsigned int stride, unsigned int keysize, unsigned int log2buckets,
+		unsigned int* out);
+
+/**
+ * Returns the CRC32-C checksum of the \a size bytes at \a key, consuming
+ * eight bytes at a time where the CPU has a CRC32 instruction. Keys of any
+ * width hash in a single pass, so this is the hash of choice for "char"
+ * columns and for keys that span several columns.
+ */
+unsigned int crc32key(const void* key, size_t size, HashKernelIsa isa);
+
+unsigned int crc32key(const void* key, size_t size);
+
+/**
+ * Hashes \a count keys of \a size bytes with crc32key() into \a out, keeping
+ * the bits in \a mask. Keys are laid out as in hashmultiplyshift().
+ */
+void hashcrc32(const char* first, unsigned int count, unsigned int stride,
+		size_t size, unsigned int mask, unsigned int* out, HashKernelIsa isa);
+
+void hashcrc32(const char* first, unsigned int count, unsigned int stride,
+		size_t size, unsigned int mask, unsigned int* out);
+
+#endif
@@ -216,6 +216,23 @@ void HashTable::bucketclear(int thisthread, int totalthreads)
 	}
 }
 
+void HashTable::clearbucket(unsigned int offset)
+{
+	BucketHeader* bh = getBucketHeader(offset);
+	dbgassertinitialized(bh);
+
+	BucketHeader* next = bh->nextBucket;
+	while (next != NULL) 
+	{
+		BucketHeader* tmp = next;
+		next = next->nextBucket;
+		numadeallocate(tmp);
+	}
+
+	bh->nextBucket = 0;
+	bh->used = 0;
+}
+
 void HashTable::destroy()
 {
 	unsigned int noparts = 1<<log2partitions;
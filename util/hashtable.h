@@ -83,6 +83,12 @@ class HashTable {
 		 */
 		void destroy();
 
+		/**
+		 * Removes all tuples from bucket at \a offset, and deallocates its
+		 * overflow chain. Caller must hold the bucket lock.
+		 */
+		void clearbucket(unsigned int offset);
+
 		/**
 		 * Allocates a tuple at bucket at \a offset. Call is not atomic and
 		 * might result in a new memory allocation if page is full.
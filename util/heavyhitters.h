@@ -0,0 +1,139 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYHEAVYHITTERS__
+#define __MYHEAVYHITTERS__
+
+#include <vector>
+#include <algorithm>
+using std::vector;
+
+/**
+ * Space-saving sketch [1] that finds the most frequent keys of a stream 
+ * using a fixed number of counters. Every key whose true weight is more 
+ * than the total weight divided by the number of counters is guaranteed to
+ * be tracked, and the estimated weight of a tracked key overestimates its
+ * true weight by at most the error reported for it.
+ *
+ * Counters are searched linearly, so the sketch is meant to be small and to
+ * be fed a sample of the input, not every tuple.
+ *
+ * [1]
+ * Ahmed Metwally, Divyakant Agrawal, Amr El Abbadi: Efficient Computation of
+ * Frequent and Top-k Elements in Data Streams, ICDT 2005.
+ */
+template <typename KeyT>
+class SpaceSavingSketch
+{
+	public:
+		struct Counter
+		{
+			KeyT key;
+			double weight;	///< Estimated weight of \a key.
+			double error;	///< Maximum overestimation of \a weight.
+		};
+
+		SpaceSavingSketch(unsigned int counters)
+			: capacity(counters), totalweight(0)
+		{ 
+			entries.reserve(capacity);
+		}
+
+		/**
+		 * Adds \a key to the stream with weight \a w.
+		 */
+		void add(KeyT key, double w = 1.0)
+		{
+			totalweight += w;
+
+			unsigned int minidx = 0;
+			for (unsigned int i=0; i<entries.size(); ++i)
+			{
+				if (entries[i].key == key)
+				{
+					entries[i].weight += w;
+					return;
+				}
+				if (entries[i].weight < entries[minidx].weight)
+					minidx = i;
+			}
+
+			if (entries.size() < capacity)
+			{
+				Counter c = { key, w, 0 };
+				entries.push_back(c);
+				return;
+			}
+
+			// Evict the key with the smallest weight. The new key inherits 
+			// its weight, which is the most it could have been seen before.
+			//
+			Counter& victim = entries[minidx];
+			victim.key = key;
+			victim.error = victim.weight;
+			victim.weight += w;
+		}
+
+		/**
+		 * Returns the tracked keys whose estimated weight is at least
+		 * \a threshold, in ascending key order.
+		 */
+		vector<Counter> heavyhitters(double threshold) const
+		{
+			vector<Counter> ret;
+			for (unsigned int i=0; i<entries.size(); ++i)
+			{
+				if (entries[i].weight >= threshold)
+					ret.push_back(entries[i]);
+			}
+			std::sort(ret.begin(), ret.end(), keyless);
+			return ret;
+		}
+
+		inline double total() const
+		{
+			return totalweight;
+		}
+
+	private:
+		static bool keyless(const Counter& l, const Counter& r)
+		{
+			return l.key < r.key;
+		}
+
+		unsigned int capacity;
+		double totalweight;
+		vector<Counter> entries;
+};
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "hugepages.h"
+#include "atomics.h"
+#include "../exceptions.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+using std::cout;
+using std::endl;
+
+namespace {
+
+const size_t TransparentHugePageSize = 2uLL * 1024 * 1024;
+
+HugePagePolicy Policy = HugePagesNone;
+
+volatile unsigned long long ExplicitBytes = 0;
+volatile unsigned long long AdvisedBytes = 0;
+volatile unsigned long long Fallbacks = 0;
+
+/**
+ * Returns true if madvise() succeeded.
+ */
+bool advise(void* address, size_t size)
+{
+	if (madvise(address, size, MADV_HUGEPAGE) != 0)
+		return false;
+
+	atomic_increment(&AdvisedBytes, (unsigned long long) size);
+	return true;
+}
+
+};
+
+HugePagePolicy parsehugepagepolicy(const string& name)
+{
+	if (name == "none")
+		return HugePagesNone;
+	if (name == "thp")
+		return HugePagesTransparent;
+	if (name == "2MB")
+		return HugePages2MB;
+	if (name == "1GB")
+		return HugePages1GB;
+
+	throw InvalidParameter();
+}
+
+void sethugepagepolicy(HugePagePolicy policy)
+{
+	Policy = policy;
+}
+
+HugePagePolicy gethugepagepolicy()
+{
+	return Policy;
+}
+
+void* mmapanonymous(size_t* size)
+{
+	HugePagePolicy policy = Policy;
+
+	if (policy == HugePages2MB || policy == HugePages1GB)
+	{
+		unsigned int shift = (policy == HugePages1GB) ? 30 : 21;
+		size_t hugepagesize = 1uLL << shift;
+
+		// Mappings smaller than a huge page would mostly be wasted.
+		//
+		if (*size >= hugepagesize)
+		{
+			size_t rounded = ((*size + hugepagesize - 1) / hugepagesize) 
+				* hugepagesize;
+
+			void* memory = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB 
+					| (shift << MAP_HUGE_SHIFT),
+					-1, 0);
+
+			if (memory != MAP_FAILED)
+			{
+				*size = rounded;
+				atomic_increment(&ExplicitBytes, (unsigned long long) rounded);
+				return memory;
+			}
+
+			// The pool of huge pages is exhausted, or this size is not
+			// supported. Fall back to transparent huge pages.
+			//
+			atomic_increment(&Fallbacks);
+		}
+	}
+
+	void* memory = mmap(NULL, *size, PROT_READ | PROT_WRITE, 
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (memory != MAP_FAILED)
+		advisehugepages(memory, *size);
+
+	return memory;
+}
+
+void advisehugepages(void* address, size_t size)
+{
+	if (Policy == HugePagesNone || size < TransparentHugePageSize)
+		return;
+
+	if (!advise(address, size))
+		atomic_increment(&Fallbacks);
+}
+
+HugePageStats gethugepagestats()
+{
+	HugePageStats stats;
+	stats.explicitbytes = ExplicitBytes;
+	stats.advisedbytes = AdvisedBytes;
+	stats.fallbacks = Fallbacks;
+	stats.actualbytes = 0;
+
+	// Sum all kinds of huge page mappings the kernel reports, in kB.
+	//
+	std::ifstream smaps("/proc/self/smaps_rollup");
+	string line;
+	while (std::getline(smaps, line))
+	{
+		std::istringstream ss(line);
+		string field;
+		unsigned long long kb = 0;
+		ss >> field >> kb;
+
+		if (field == "AnonHugePages:" || field == "ShmemPmdMapped:" 
+				|| field == "FilePmdMapped:" || field == "Shared_Hugetlb:" 
+				|| field == "Private_Hugetlb:")
+		{
+			stats.actualbytes += kb * 1024;
+		}
+	}
+
+	return stats;
+}
+
+void dbgPrintHugePages()
+{
+	const char* names[] = { "none", "thp", "2MB", "1GB" };
+	HugePageStats stats = gethugepagestats();
+
+	cout << "Huge Page Policy: " << names[Policy] << endl;
+	cout << "Huge Pages Mapped Explicitly (bytes): " << stats.explicitbytes << endl;
+	cout << "Huge Pages Advised (bytes): " << stats.advisedbytes << endl;
+	cout << "Huge Page Fallbacks: " << stats.fallbacks << endl;
+	cout << "Huge Pages In Use (bytes): " << stats.actualbytes << endl;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYHUGEPAGES__
+#define __MYHUGEPAGES__
+
+#include <cstddef>
+#include <string>
+using std::string;
+
+/**
+ * How memory that is mapped from the system is backed.
+ * \li HugePagesNone Regular pages.
+ * \li HugePagesTransparent Regular mappings of at least 2MB are marked with
+ * madvise(MADV_HUGEPAGE), so the kernel can back them with transparent huge
+ * pages.
+ * \li HugePages2MB, HugePages1GB Anonymous mappings of at least one huge
+ * page are made with MAP_HUGETLB from the pool of explicit huge pages of
+ * that size. If the pool is exhausted, the mapping falls back to 
+ * transparent huge pages. File and shared memory mappings cannot use
+ * MAP_HUGETLB, and are only marked with madvise().
+ */
+enum HugePagePolicy
+{
+	HugePagesNone,
+	HugePagesTransparent,
+	HugePages2MB,
+	HugePages1GB
+};
+
+/**
+ * Parses "none", "thp", "2MB" or "1GB".
+ * @throws InvalidParameter if \a name is none of the above.
+ */
+HugePagePolicy parsehugepagepolicy(const string& name);
+
+/**
+ * Sets the huge page policy of the process.
+ */
+void sethugepagepolicy(HugePagePolicy policy);
+HugePagePolicy gethugepagepolicy();
+
+/**
+ * Maps \a *size bytes of private, anonymous memory following the huge page
+ * policy. If explicit huge pages are used, \a *size is rounded up to a
+ * multiple of the huge page size. The memory must be unmapped with the 
+ * returned \a *size. Returns MAP_FAILED on failure.
+ */
+void* mmapanonymous(size_t* size);
+
+/**
+ * Marks the mapping at \a address of \a size bytes with MADV_HUGEPAGE, 
+ * unless the policy is HugePagesNone or the mapping is smaller than 2MB.
+ * Used for file and shared memory mappings, and for memory that has been
+ * mapped before the policy was set.
+ */
+void advisehugepages(void* address, size_t size);
+
+struct HugePageStats
+{
+	/** Bytes mapped with MAP_HUGETLB. */
+	unsigned long long explicitbytes;
+
+	/** Bytes successfully marked with MADV_HUGEPAGE. */
+	unsigned long long advisedbytes;
+
+	/** Mappings that asked for huge pages but got regular pages. */
+	unsigned long long fallbacks;
+
+	/** 
+	 * Bytes that the kernel actually backs with huge pages, both 
+	 * transparent and explicit, from /proc/self/smaps_rollup. Zero if
+	 * the file cannot be read.
+	 */
+	unsigned long long actualbytes;
+};
+
+HugePageStats gethugepagestats();
+
+/**
+ * Prints huge page statistics of the process.
+ */
+void dbgPrintHugePages();
+
+#endif
@@ -51,6 +51,8 @@
 
 #include "numaasserts.h"
 #include "atomics.h"
+#include "arena.h"
+#include "hugepages.h"
 #include "../lock.h"
 
 #ifdef MBIND_BUG_WORKAROUND
@@ -183,11 +185,14 @@ struct AllocHeader
 	void* calleraddress;
 	char tag[4];
 	bool mmapalloc;
+	char arenanode;		///< NUMA node of the block, if from \a arena.
 	size_t allocsize;
 
-	// Bitonic sort needs 16-byte aligned values. Hacking it to do so.
-	//
-	char padding[8];
+	/**
+	 * Arena the block was allocated from, or NULL. Also pads the header to
+	 * 32 bytes: bitonic sort needs 16-byte aligned values.
+	 */
+	QueryArena* arena;
 };
 
 void populateHeader(void* dest, const char tag[4], bool mmapalloc, size_t allocsize)
@@ -203,7 +208,9 @@ void populateHeader(void* dest, const char tag[4], bool mmapalloc, size_t allocs
 	d->tag[2] = tag[2];
 	d->tag[3] = tag[3];
 	d->mmapalloc = mmapalloc;
+	d->arenanode = -1;
 	d->allocsize = allocsize;
+	d->arena = NULL;
 }
 
 struct LookasideHeader
@@ -273,6 +280,17 @@ void* Lookaside::arena[1] = {
 };
 #endif
 
+void numaallocate_sethugepages(HugePagePolicy policy)
+{
+	sethugepagepolicy(policy);
+
+	for (unsigned int i=0; i<sizeof(Lookaside::arena)/sizeof(Lookaside::arena[0]); ++i)
+	{
+		LookasideHeader* lh = (LookasideHeader*) Lookaside::arena[i];
+		advisehugepages(lh, lh->maxsize + sizeof(LookasideHeader));
+	}
+}
+
 /**
  * Function does allocation via mmap().
  */
@@ -297,10 +315,10 @@ void* slowallocate_onnode(const char tag[4], size_t allocsize, int node, void* s
 	NumaAllocLock.lock();
 #endif
 
-	memory = mmap(NULL, allocsize, 
-			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 
-//			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, 
-			-1, 0);
+	// Follows the huge page policy. The size may be rounded up to a whole
+	// number of huge pages, and the header records the size that was mapped.
+	//
+	memory = mmapanonymous(&allocsize);
 	assert(memory != MAP_FAILED);
 
 #ifdef ENABLE_NUMA
@@ -394,6 +412,41 @@ void* fastallocate_onnode(const char tag[4], size_t allocsize, int node, void* s
 	return ((char*)newval) + sizeof(AllocHeader);
 }
 
+__thread QueryArena* ThreadArena = NULL;
+
+void numaallocate_setarena(QueryArena* arena)
+{
+	if (ThreadArena != NULL && ThreadArena != arena)
+		ThreadArena->flushThreadCache();
+
+	ThreadArena = arena;
+}
+
+QueryArena* numaallocate_getarena()
+{
+	return ThreadArena;
+}
+
+/**
+ * Function allocates from the arena of the calling thread.
+ */
+void* arenaallocate_onnode(const char tag[4], size_t allocsize, int node, void* source)
+{
+	size_t blocksize;
+	int blocknode;
+
+	allocsize += sizeof(AllocHeader);
+	void* memory = ThreadArena->allocate(allocsize, node, &blocksize, &blocknode);
+
+	populateHeader(memory, tag, false, blocksize);
+	AllocHeader* d = (AllocHeader*) memory;
+	d->arenanode = blocknode;
+	d->arena = ThreadArena;
+	updatestats(source, tag, node, blocknode, blocksize);
+
+	return ((char*)memory) + sizeof(AllocHeader);
+}
+
 /** 
  * NUMA-aware allocator main entry point.
  * If node is -1, do local allocation, else allocate on specified node.
@@ -403,9 +456,18 @@ void* numaallocate_onnode(const char tag[4], size_t allocsize, int node, void* s
 {
 	void* memory = NULL;
 
+	// Use the arena of the query, if this thread has one and the allocation
+	// fits in one of its blocks.
+	//
+	if (ThreadArena != NULL 
+			&& allocsize + sizeof(AllocHeader) <= QueryArena::MaxBlockSize)
+	{
+		memory = arenaallocate_onnode(tag, allocsize, node, source);
+	}
+
 	// If more than 16M, go to slow allocator to avoid pollution of arena.
 	//
-	if (allocsize <= 16uLL*1024*1024)
+	if (memory == NULL && allocsize <= 16uLL*1024*1024)
 	{
 		memory = fastallocate_onnode(tag, allocsize, node, source);
 	}
@@ -439,7 +501,13 @@ void numadeallocate(void* space)
 {
 	AllocHeader* d = (AllocHeader*) (((char*)space) - sizeof(AllocHeader));
 
-	if (d->mmapalloc)
+	if (d->arena != NULL)
+	{
+		// If allocated from an arena, make the block available for reuse.
+		//
+		d->arena->recycle(d, d->allocsize, d->arenanode);
+	}
+	else if (d->mmapalloc)
 	{
 		// If allocated via mmap(), deallocate.
 		//
@@ -32,6 +32,24 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "hugepages.h"
+
 void* numaallocate_local(const char tag[4], size_t allocsize, void* source);
 void* numaallocate_onnode(const char tag[4], size_t allocsize, int node, void* source);
 void numadeallocate(void* space);
+
+class QueryArena;
+
+/**
+ * Serves all later allocations of the calling thread that fit in a block of
+ * \a arena from it, or from the process-wide allocator if \a arena is NULL.
+ */
+void numaallocate_setarena(QueryArena* arena);
+QueryArena* numaallocate_getarena();
+
+/**
+ * Sets the huge page policy for all memory that is mapped from the system
+ * from now on, and marks the memory that has already been set aside for
+ * small allocations for transparent huge pages.
+ */
+void numaallocate_sethugepages(HugePagePolicy policy);
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+
+#include "runmerger.h"
+#include "numaallocate.h"
+
+void SortedRunMerger::init(const vector<SpillFile*>& files, 
+		unsigned int tuplesize, Comparator less, unsigned int buffersize, 
+		void* allocsource)
+{
+	this->tuplesize = tuplesize;
+	this->less = less;
+
+	for (unsigned int i=0; i<files.size(); ++i)
+	{
+		Run run;
+		run.file = files[i];
+		void* space = numaallocate_local("SRMp", sizeof(TupleBuffer), allocsource);
+		run.page = new (space) 
+			TupleBuffer(buffersize, tuplesize, allocsource, "SRMb");
+		run.pos = 0;
+		run.head = NULL;
+		advance(run);
+		runs.push_back(run);
+	}
+
+	copies = (char*) numaallocate_local("SRMc", 2 * tuplesize, allocsource);
+	lastcopy = 0;
+}
+
+void SortedRunMerger::advance(Run& run)
+{
+	run.head = run.page->getTupleOffset(run.pos++);
+	if (run.head != NULL)
+		return;
+
+	if (run.file->readTuples(run.page, tuplesize) == 0)
+		return;
+
+	run.pos = 0;
+	run.head = run.page->getTupleOffset(run.pos++);
+}
+
+void* SortedRunMerger::next()
+{
+	Run* best = NULL;
+	for (unsigned int i=0; i<runs.size(); ++i)
+	{
+		if (runs[i].head == NULL)
+			continue;
+		if (best == NULL || less.eval(runs[i].head, best->head))
+			best = &runs[i];
+	}
+
+	if (best == NULL)
+		return NULL;
+
+	// Copy out, as reading the next buffer of the run overwrites the tuple.
+	//
+	lastcopy ^= 1;
+	void* ret = copies + lastcopy * tuplesize;
+	memcpy(ret, best->head, tuplesize);
+	advance(*best);
+	return ret;
+}
+
+void SortedRunMerger::destroy()
+{
+	for (unsigned int i=0; i<runs.size(); ++i)
+	{
+		runs[i].file->close();
+		delete runs[i].file;
+		runs[i].page->~TupleBuffer();
+		numadeallocate(runs[i].page);
+	}
+	runs.clear();
+
+	if (copies != NULL)
+		numadeallocate(copies);
+	copies = NULL;
+}
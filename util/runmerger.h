@@ -0,0 +1,107 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYRUNMERGER__
+#define __MYRUNMERGER__
+
+#include <vector>
+using std::vector;
+
+#include "../schema.h"
+#include "buffer.h"
+#include "spillfile.h"
+
+/**
+ * Merges sorted runs of tuples that have been spilled to disk, returning
+ * their tuples one by one in sorted order. Each run is read through a
+ * buffer of its own, so memory use does not depend on the size of the runs.
+ *
+ * Runs are few, as each one holds as much input as fits in memory, so the
+ * next tuple is picked with a linear scan over the heads of all runs.
+ */
+class SortedRunMerger
+{
+	public:
+		SortedRunMerger() 
+			: tuplesize(0), copies(NULL), lastcopy(0)
+		{ }
+
+		/**
+		 * Starts merging \a files, which are rewound and hold tuples of
+		 * \a tuplesize bytes sorted by \a less. The merger becomes the
+		 * owner of the files.
+		 * @param buffersize Bytes of each read buffer.
+		 * @param allocsource Debugging info passed to allocator.
+		 */
+		void init(const vector<SpillFile*>& files, unsigned int tuplesize,
+				Comparator less, unsigned int buffersize, void* allocsource);
+
+		/**
+		 * Returns the next tuple, or NULL if all runs have been merged. The
+		 * tuple stays valid until the second call after this one, so that
+		 * callers can compare each tuple with the one before it.
+		 */
+		void* next();
+
+		/**
+		 * Closes all runs, which deletes them, and frees all buffers.
+		 */
+		void destroy();
+
+		inline unsigned int numberOfRuns()
+		{
+			return runs.size();
+		}
+
+	private:
+		struct Run {
+			SpillFile* file;
+			TupleBuffer* page;
+			unsigned long long pos;	///< Tuple of \a page that is next.
+			void* head;	///< Smallest tuple not returned, NULL if run is over.
+		};
+
+		/**
+		 * Moves the head of \a run forward, reading from disk if needed.
+		 */
+		void advance(Run& run);
+
+		vector<Run> runs;
+		Comparator less;
+		unsigned int tuplesize;
+
+		char* copies;	///< Space for the last two tuples returned.
+		unsigned int lastcopy;
+};
+
+#endif
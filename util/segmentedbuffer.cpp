@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include <cassert>
+
+#include "segmentedbuffer.h"
+#include "numaallocate.h"
+#include <new>
+
+SegmentedTupleBuffer::SegmentedTupleBuffer(unsigned long long segmentsize,
+		unsigned int tuplesize, void* allocsource, const char tag[4])
+	: tuplesize(tuplesize), usedbytes(0), allocsource(allocsource)
+{
+	this->segmentsize = (segmentsize / tuplesize) * tuplesize;
+	if (this->segmentsize == 0)
+		this->segmentsize = tuplesize;
+	memcpy(this->tag, tag, 4);
+}
+
+SegmentedTupleBuffer::~SegmentedTupleBuffer()
+{
+	clear();
+}
+
+void SegmentedTupleBuffer::addSegment()
+{
+	void* space = numaallocate_local(tag, sizeof(TupleBuffer), allocsource);
+	segments.push_back(new (space) 
+			TupleBuffer(segmentsize, tuplesize, allocsource, tag));
+}
+
+void SegmentedTupleBuffer::append(void* src, unsigned long long len)
+{
+	char* from = reinterpret_cast<char*>(src);
+	assert(len % tuplesize == 0);
+
+	while (len != 0)
+	{
+		if (segments.empty() || !segments.back()->canStoreTuple())
+			addSegment();
+
+		TupleBuffer* last = segments.back();
+		unsigned long long room = last->capacity() - last->getUsedSpace();
+		unsigned long long chunk = (len < room) ? len : room;
+		memcpy(last->allocate(chunk), from, chunk);
+
+		from += chunk;
+		len -= chunk;
+		usedbytes += chunk;
+	}
+}
+
+void SegmentedTupleBuffer::moveTo(TupleBuffer* dest)
+{
+	dest->clear();
+	for (unsigned int i=0; i<segments.size(); ++i)
+	{
+		unsigned long long used = segments[i]->getUsedSpace();
+		if (used != 0)
+		{
+			void* target = dest->allocate(used);
+			assert(target != NULL);
+			memcpy(target, segments[i]->getTupleOffset(0), used);
+		}
+
+		segments[i]->~TupleBuffer();
+		numadeallocate(segments[i]);
+	}
+	segments.clear();
+	usedbytes = 0;
+}
+
+void SegmentedTupleBuffer::clear()
+{
+	for (unsigned int i=0; i<segments.size(); ++i)
+	{
+		segments[i]->~TupleBuffer();
+		numadeallocate(segments[i]);
+	}
+	segments.clear();
+	usedbytes = 0;
+}
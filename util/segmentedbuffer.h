@@ -0,0 +1,180 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYSEGMENTEDBUFFER__
+#define __MYSEGMENTEDBUFFER__
+
+#include <vector>
+using std::vector;
+
+#include "buffer.h"
+
+/**
+ * Staging area that grows in fixed-size segments, instead of being sized
+ * up front from an estimate of its input. Each segment is a TupleBuffer
+ * allocated on the local NUMA node of the thread that adds it, so memory
+ * follows the actual input. Segments can be read one at a time, or through
+ * an Iterator that presents all of them as a single range of tuples.
+ *
+ * Not thread-safe.
+ */
+class SegmentedTupleBuffer
+{
+	public:
+		/**
+		 * Creates an empty buffer. No memory is allocated until the first
+		 * tuple is stored.
+		 * @param segmentsize Bytes of each segment, rounded down to whole
+		 * tuples.
+		 * @param tuplesize Size of tuples in bytes.
+		 * @param allocsource Debugging info passed to allocator.
+		 */
+		SegmentedTupleBuffer(unsigned long long segmentsize, 
+				unsigned int tuplesize, void* allocsource, 
+				const char tag[4] = "Sgmt");
+		~SegmentedTupleBuffer();
+
+		/**
+		 * Returns space for one tuple, adding a segment if the last one is
+		 * full.
+		 */
+		inline void* allocateTuple()
+		{
+			void* ret = segments.empty() ? NULL : segments.back()->allocateTuple();
+			if (ret == NULL)
+			{
+				addSegment();
+				ret = segments.back()->allocateTuple();
+			}
+			usedbytes += tuplesize;
+			return ret;
+		}
+
+		/**
+		 * Copies \a len bytes of whole tuples from \a src to the end of the
+		 * buffer.
+		 */
+		void append(void* src, unsigned long long len);
+
+		/**
+		 * Copies all tuples, in order, to the start of \a dest and empties 
+		 * this buffer. Each segment is freed as soon as it has been copied,
+		 * so the tuples are never held twice in full.
+		 * \pre \a dest can hold getUsedSpace() bytes.
+		 */
+		void moveTo(TupleBuffer* dest);
+
+		/**
+		 * Frees all segments.
+		 */
+		void clear();
+
+		inline unsigned long long getUsedSpace()
+		{
+			return usedbytes;
+		}
+
+		inline unsigned long long getNumTuples()
+		{
+			return usedbytes / tuplesize;
+		}
+
+		inline unsigned int getNumSegments()
+		{
+			return segments.size();
+		}
+
+		inline TupleBuffer* getSegment(unsigned int i)
+		{
+			return segments[i];
+		}
+
+		class Iterator {
+			public:
+				Iterator() : buffer(0), segment(0) { }
+
+				inline
+				void place(SegmentedTupleBuffer* b)
+				{
+					buffer = b;
+					reset();
+				}
+
+				inline
+				void* next()
+				{
+					while (segment < buffer->segments.size())
+					{
+						void* ret = it.next();
+						if (ret != NULL)
+							return ret;
+
+						if (++segment < buffer->segments.size())
+							it.place(buffer->segments[segment]);
+					}
+					return NULL;
+				}
+
+				inline
+				void reset()
+				{
+					segment = 0;
+					if (!buffer->segments.empty())
+						it.place(buffer->segments[0]);
+				}
+
+			private:
+				SegmentedTupleBuffer* buffer;
+				unsigned int segment;
+				TupleBuffer::Iterator it;
+		};
+
+		inline Iterator createIterator()
+		{
+			Iterator it;
+			it.place(this);
+			return it;
+		}
+
+	private:
+		void addSegment();
+
+		vector<TupleBuffer*> segments;
+		unsigned long long segmentsize;
+		unsigned int tuplesize;
+		unsigned long long usedbytes;
+		void* allocsource;
+		char tag[4];
+};
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * SIMD merge sort of 64-bit keys and optional row ids. The generic algorithm
+ * in simdsortkernel.inl is compiled once per instruction set, each in its own
+ * namespace and with its own target options, and the kernel is selected at
+ * runtime based on what the CPU supports.
+ */
+
+#include "simdsort.h"
+
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+#include "../exceptions.h"
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+namespace simdsort_sse42
+{
+	const int W = 2;
+	typedef __m128i Reg;
+	typedef __m128i Mask;
+
+	static inline Reg loadreg(const void* p) 
+	{ return _mm_loadu_si128((const __m128i*) p); }
+	static inline void storereg(void* p, Reg a) 
+	{ _mm_storeu_si128((__m128i*) p, a); }
+	static inline Mask gtmask(Reg a, Reg b) 
+	{ return _mm_cmpgt_epi64(a, b); }
+	static inline Reg selectreg(Reg a, Reg b, Mask m) 
+	{ return _mm_blendv_epi8(a, b, m); }
+	static inline Reg swaplanes(Reg a, int d) 
+	{ return _mm_shuffle_epi32(a, 0x4E); }
+	static inline Reg reverselanes(Reg a) 
+	{ return _mm_shuffle_epi32(a, 0x4E); }
+	static inline Mask lanemask(unsigned int bits) 
+	{ return _mm_set_epi64x(-(long long)((bits >> 1) & 1), -(long long)(bits & 1)); }
+	static inline Mask mand(Mask a, Mask b) { return _mm_and_si128(a, b); }
+	static inline Mask mor(Mask a, Mask b) { return _mm_or_si128(a, b); }
+	static inline Mask mandnot(Mask a, Mask b) { return _mm_andnot_si128(a, b); }
+
+#include "simdsortkernel.inl"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+namespace simdsort_avx2
+{
+	const int W = 4;
+	typedef __m256i Reg;
+	typedef __m256i Mask;
+
+	static inline Reg loadreg(const void* p) 
+	{ return _mm256_loadu_si256((const __m256i*) p); }
+	static inline void storereg(void* p, Reg a) 
+	{ _mm256_storeu_si256((__m256i*) p, a); }
+	static inline Mask gtmask(Reg a, Reg b) 
+	{ return _mm256_cmpgt_epi64(a, b); }
+	static inline Reg selectreg(Reg a, Reg b, Mask m) 
+	{ return _mm256_blendv_epi8(a, b, m); }
+	static inline Reg swaplanes(Reg a, int d) 
+	{
+		if (d == 1)
+			return _mm256_permute4x64_epi64(a, 0xB1);
+		return _mm256_permute4x64_epi64(a, 0x4E);
+	}
+	static inline Reg reverselanes(Reg a) 
+	{ return _mm256_permute4x64_epi64(a, 0x1B); }
+	static inline Mask lanemask(unsigned int bits) 
+	{ 
+		return _mm256_set_epi64x(
+				-(long long)((bits >> 3) & 1), -(long long)((bits >> 2) & 1),
+				-(long long)((bits >> 1) & 1), -(long long)(bits & 1)); 
+	}
+	static inline Mask mand(Mask a, Mask b) { return _mm256_and_si256(a, b); }
+	static inline Mask mor(Mask a, Mask b) { return _mm256_or_si256(a, b); }
+	static inline Mask mandnot(Mask a, Mask b) { return _mm256_andnot_si256(a, b); }
+
+#include "simdsortkernel.inl"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace simdsort_avx512
+{
+	const int W = 8;
+	typedef __m512i Reg;
+	typedef __mmask8 Mask;
+
+	static inline Reg loadreg(const void* p) 
+	{ return _mm512_loadu_si512(p); }
+	static inline void storereg(void* p, Reg a) 
+	{ _mm512_storeu_si512(p, a); }
+	static inline Mask gtmask(Reg a, Reg b) 
+	{ return _mm512_cmpgt_epi64_mask(a, b); }
+	static inline Reg selectreg(Reg a, Reg b, Mask m) 
+	{ return _mm512_mask_blend_epi64(m, a, b); }
+	// The zero-masked permute with all lanes selected is the plain permute,
+	// but does not read the undefined register GCC passes to the latter.
+	//
+	static inline Reg swaplanes(Reg a, int d) 
+	{
+		return _mm512_maskz_permutexvar_epi64((Mask) 0xFF,
+				_mm512_set_epi64(7^d, 6^d, 5^d, 4^d, 3^d, 2^d, 1^d, 0^d), a);
+	}
+	static inline Reg reverselanes(Reg a) 
+	{ 
+		return _mm512_maskz_permutexvar_epi64((Mask) 0xFF,
+				_mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7), a); 
+	}
+	static inline Mask lanemask(unsigned int bits) { return (Mask) bits; }
+	static inline Mask mand(Mask a, Mask b) { return a & b; }
+	static inline Mask mor(Mask a, Mask b) { return a | b; }
+	static inline Mask mandnot(Mask a, Mask b) { return (Mask) (~a & b); }
+
+#include "simdsortkernel.inl"
+}
+#pragma GCC pop_options
+
+/**
+ * Merges the sorted runs of \a n1 and \a n2 entries that start at \a ink and
+ * \a ink + \a n1 into \a outk, one entry at a time.
+ */
+static void scalarmerge(const long long* ink, const unsigned long long* inr,
+		unsigned long long n1, unsigned long long n2,
+		long long* outk, unsigned long long* outr)
+{
+	unsigned long long a = 0;
+	unsigned long long b = n1;
+	const unsigned long long end = n1 + n2;
+
+	for (unsigned long long o=0; o<end; ++o)
+	{
+		unsigned long long src;
+		if (b >= end || (a < n1 && ink[a] <= ink[b]))
+			src = a++;
+		else
+			src = b++;
+
+		outk[o] = ink[src];
+		if (inr)
+			outr[o] = inr[src];
+	}
+}
+
+/**
+ * Insertion sort, for the few entries that do not fill a whole register.
+ */
+static void insertionsort(long long* k, unsigned long long* r, 
+		unsigned long long n)
+{
+	for (unsigned long long i=1; i<n; ++i)
+	{
+		long long key = k[i];
+		unsigned long long rid = r ? r[i] : 0;
+		unsigned long long j = i;
+		for (; j>0 && k[j-1] > key; --j)
+		{
+			k[j] = k[j-1];
+			if (r)
+				r[j] = r[j-1];
+		}
+		k[j] = key;
+		if (r)
+			r[j] = rid;
+	}
+}
+
+/**
+ * Bottom-up merge sort without SIMD, for CPUs that lack all of the above.
+ */
+static void scalarsort(long long* k, unsigned long long* r,
+		long long* tk, unsigned long long* tr, unsigned long long n)
+{
+	const unsigned long long RUN = 16;
+	for (unsigned long long s=0; s<n; s+=RUN)
+		insertionsort(k + s, r ? r + s : 0, std::min(RUN, n - s));
+
+	bool intmp = false;
+	for (unsigned long long w=RUN; w<n; w*=2)
+	{
+		long long* sk = intmp ? tk : k;
+		unsigned long long* sr = intmp ? tr : r;
+		long long* dk = intmp ? k : tk;
+		unsigned long long* dr = intmp ? r : tr;
+
+		for (unsigned long long s=0; s<n; s+=2*w)
+		{
+			unsigned long long n1 = std::min(w, n - s);
+			unsigned long long n2 = std::min(w, n - s - n1);
+			scalarmerge(sk + s, sr ? sr + s : 0, n1, n2, 
+					dk + s, dr ? dr + s : 0);
+		}
+		intmp = !intmp;
+	}
+
+	if (intmp)
+	{
+		memcpy(k, tk, n * sizeof(long long));
+		if (r)
+			memcpy(r, tr, n * sizeof(unsigned long long));
+	}
+}
+
+static SimdSortIsa detectIsa()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return SimdAVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SimdAVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return SimdSSE42;
+	return SimdNone;
+}
+
+SimdSortIsa simdSortDetectIsa()
+{
+	static SimdSortIsa isa = detectIsa();
+	return isa;
+}
+
+const char* simdSortIsaName(SimdSortIsa isa)
+{
+	switch (isa)
+	{
+		case SimdSSE42:
+			return "sse4.2";
+		case SimdAVX2:
+			return "avx2";
+		case SimdAVX512:
+			return "avx512";
+		default:
+			return "scalar";
+	}
+}
+
+void simdsort(long long* keys, unsigned long long* rids, 
+		long long* tmpkeys, unsigned long long* tmprids, 
+		unsigned long long n, SimdSortIsa isa)
+{
+	unsigned int width;
+
+	switch (isa)
+	{
+		case SimdNone:
+			scalarsort(keys, rids, tmpkeys, tmprids, n);
+			return;
+		case SimdSSE42:
+			width = simdsort_sse42::W;
+			break;
+		case SimdAVX2:
+			width = simdsort_avx2::W;
+			break;
+		case SimdAVX512:
+			width = simdsort_avx512::W;
+			break;
+		default:
+			throw UnknownAlgorithmException();
+	}
+
+	// Sort the largest prefix that fills whole registers with the kernel.
+	//
+	const unsigned long long m = n - (n % width);
+	switch (isa)
+	{
+		case SimdSSE42:
+			simdsort_sse42::sort(keys, rids, tmpkeys, tmprids, m);
+			break;
+		case SimdAVX2:
+			simdsort_avx2::sort(keys, rids, tmpkeys, tmprids, m);
+			break;
+		case SimdAVX512:
+			simdsort_avx512::sort(keys, rids, tmpkeys, tmprids, m);
+			break;
+		default:
+			throw UnknownAlgorithmException();
+	}
+
+	if (m == n)
+		return;
+
+	// Sort the rest separately and merge it in.
+	//
+	insertionsort(keys + m, rids ? rids + m : 0, n - m);
+	scalarmerge(keys, rids, m, n - m, tmpkeys, tmprids);
+	memcpy(keys, tmpkeys, n * sizeof(long long));
+	if (rids)
+		memcpy(rids, tmprids, n * sizeof(unsigned long long));
+}
+
+void simdsort(long long* keys, unsigned long long* rids, 
+		long long* tmpkeys, unsigned long long* tmprids, 
+		unsigned long long n)
+{
+	simdsort(keys, rids, tmpkeys, tmprids, n, simdSortDetectIsa());
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYSIMDSORT__
+#define __MYSIMDSORT__
+
+/**
+ * Instruction sets that the SIMD merge sort has kernels for. 
+ */
+enum SimdSortIsa
+{
+	SimdNone,	///< Scalar fallback.
+	SimdSSE42,	///< 2 keys per register.
+	SimdAVX2,	///< 4 keys per register.
+	SimdAVX512	///< 8 keys per register.
+};
+
+/**
+ * Returns the widest instruction set this CPU supports, as detected on the
+ * first call.
+ */
+SimdSortIsa simdSortDetectIsa();
+
+/**
+ * Returns a printable name for \a isa.
+ */
+const char* simdSortIsaName(SimdSortIsa isa);
+
+/**
+ * Sorts \a n 64-bit \a keys in ascending order, comparing them as signed
+ * integers, with a bitonic sorting network within registers followed by
+ * bitonic merging of sorted runs. If \a rids is not NULL, its \a n row ids
+ * are permuted along with the keys.
+ *
+ * \a tmpkeys and, if \a rids is not NULL, \a tmprids must be scratch areas
+ * of \a n entries each. The sorted output is always left in \a keys and 
+ * \a rids.
+ *
+ * The kernel for \a isa is used, which must be supported by this CPU.
+ * The overload without \a isa uses simdSortDetectIsa().
+ */
+void simdsort(long long* keys, unsigned long long* rids, 
+		long long* tmpkeys, unsigned long long* tmprids, 
+		unsigned long long n, SimdSortIsa isa);
+
+void simdsort(long long* keys, unsigned long long* rids, 
+		long long* tmpkeys, unsigned long long* tmprids, 
+		unsigned long long n);
+
+#endif
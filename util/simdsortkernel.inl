@@ -0,0 +1,287 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Generic part of the SIMD merge sort, included once per instruction set by
+ * simdsort.cpp. The including namespace defines the number of 64-bit lanes W,
+ * the register and lane mask types Reg and Mask, and the following:
+ *
+ *   loadreg(p), storereg(p, a)	Unaligned load and store of W entries.
+ *   gtmask(a, b)			Lanes where a > b, as signed integers.
+ *   selectreg(a, b, m)		b in lanes set in m, a in all others.
+ *   swaplanes(a, d)		Lane i gets lane i^d of a.
+ *   reverselanes(a)		Lane i gets lane W-1-i of a.
+ *   lanemask(bits)			Mask with lane i set if bit i of bits is set.
+ *   mand(a, b), mor(a, b), mandnot(a, b)	(a & b), (a | b), (~a & b).
+ */
+
+/**
+ * Lanes of a register whose index has bit \a d clear.
+ */
+static inline unsigned int lowerlanes(int d)
+{
+	unsigned int bits = 0;
+	for (int i=0; i<W; ++i)
+		if ((i & d) == 0)
+			bits |= 1u << i;
+	return bits;
+}
+
+/**
+ * Compare-exchanges lanes i and i^d of \a k, and moves row ids \a r along.
+ * Lanes set in \a minlanes keep the smaller key, all other lanes keep the
+ * larger key.
+ */
+template <bool HasRids>
+static inline void exchange(Reg& k, Reg& r, int d, Mask minlanes)
+{
+	Reg ks = swaplanes(k, d);
+	Mask swap = mor(mand(minlanes, gtmask(k, ks)), 
+			mandnot(minlanes, gtmask(ks, k)));
+	k = selectreg(k, ks, swap);
+	if (HasRids)
+		r = selectreg(r, swaplanes(r, d), swap);
+}
+
+/**
+ * Sorts the W lanes of \a k with a bitonic sorting network.
+ */
+template <bool HasRids>
+static inline void sortregister(Reg& k, Reg& r)
+{
+	for (int size=2; size<=W; size*=2)
+	{
+		for (int d=size/2; d>0; d/=2)
+		{
+			// Lanes in ascending blocks keep the minimum in the lower lane,
+			// lanes in descending blocks keep it in the upper lane.
+			//
+			unsigned int bits = lowerlanes(d);
+			if (size != W)
+				bits ^= ~lowerlanes(size) & ((1u << W) - 1);
+			exchange<HasRids>(k, r, d, lanemask(bits));
+		}
+	}
+}
+
+/**
+ * Merges sorted registers \a ak and \a bk. On return, \a ak holds the W
+ * smallest and \a bk holds the W largest keys, both sorted.
+ */
+template <bool HasRids>
+static inline void mergeregisters(Reg& ak, Reg& ar, Reg& bk, Reg& br)
+{
+	bk = reverselanes(bk);
+	Mask m = gtmask(ak, bk);
+	Reg lo = selectreg(ak, bk, m);
+	Reg hi = selectreg(bk, ak, m);
+	ak = lo;
+	bk = hi;
+
+	if (HasRids)
+	{
+		br = reverselanes(br);
+		lo = selectreg(ar, br, m);
+		hi = selectreg(br, ar, m);
+		ar = lo;
+		br = hi;
+	}
+
+	for (int d=W/2; d>0; d/=2)
+	{
+		Mask low = lanemask(lowerlanes(d));
+		exchange<HasRids>(ak, ar, d, low);
+		exchange<HasRids>(bk, br, d, low);
+	}
+}
+
+/**
+ * Merges the sorted runs of \a n1 and \a n2 entries that start at \a ink
+ * and \a ink + \a n1 into \a outk. Both run lengths are multiples of W.
+ */
+template <bool HasRids>
+static void mergeruns(const long long* ink, const unsigned long long* inr,
+		unsigned long long n1, unsigned long long n2,
+		long long* outk, unsigned long long* outr)
+{
+	if (n2 == 0)
+	{
+		memcpy(outk, ink, n1 * sizeof(long long));
+		if (HasRids)
+			memcpy(outr, inr, n1 * sizeof(unsigned long long));
+		return;
+	}
+
+	unsigned long long a = 0;
+	unsigned long long aend = n1;
+	unsigned long long b = n1;
+	unsigned long long bend = n1 + n2;
+	unsigned long long o = 0;
+
+	Reg xk = loadreg(ink + a);
+	Reg yk = loadreg(ink + b);
+	Reg xr = xk;
+	Reg yr = yk;
+	if (HasRids)
+	{
+		xr = loadreg(inr + a);
+		yr = loadreg(inr + b);
+	}
+	a += W;
+	b += W;
+
+	// Keep the larger half of every merge in yk, and refill xk from the run
+	// with the smallest next key.
+	//
+	while (true)
+	{
+		mergeregisters<HasRids>(xk, xr, yk, yr);
+		storereg(outk + o, xk);
+		if (HasRids)
+			storereg(outr + o, xr);
+		o += W;
+
+		unsigned long long next;
+		if (a < aend && (b >= bend || ink[a] < ink[b]))
+		{
+			next = a;
+			a += W;
+		}
+		else if (b < bend)
+		{
+			next = b;
+			b += W;
+		}
+		else
+		{
+			break;
+		}
+
+		xk = loadreg(ink + next);
+		if (HasRids)
+			xr = loadreg(inr + next);
+	}
+
+	storereg(outk + o, yk);
+	if (HasRids)
+		storereg(outr + o, yr);
+}
+
+/**
+ * Merges adjacent runs of \a width entries in [\a begin, \a end) of \a sk
+ * into \a dk.
+ */
+template <bool HasRids>
+static void mergepass(const long long* sk, const unsigned long long* sr,
+		long long* dk, unsigned long long* dr,
+		unsigned long long begin, unsigned long long end, 
+		unsigned long long width)
+{
+	for (unsigned long long s=begin; s<end; s+=2*width)
+	{
+		unsigned long long n1 = std::min(width, end - s);
+		unsigned long long n2 = std::min(width, end - s - n1);
+		mergeruns<HasRids>(sk + s, HasRids ? sr + s : 0, n1, n2, 
+				dk + s, HasRids ? dr + s : 0);
+	}
+}
+
+/**
+ * Sorts \a n entries of \a k, where \a n is a multiple of W. Leaves the
+ * output in \a k.
+ */
+template <bool HasRids>
+static void sortentries(long long* k, unsigned long long* r,
+		long long* tk, unsigned long long* tr, unsigned long long n)
+{
+	// Runs of W entries, one per register.
+	//
+	for (unsigned long long i=0; i<n; i+=W)
+	{
+		Reg kk = loadreg(k + i);
+		Reg rr = kk;
+		if (HasRids)
+			rr = loadreg(r + i);
+		sortregister<HasRids>(kk, rr);
+		storereg(k + i, kk);
+		if (HasRids)
+			storereg(r + i, rr);
+	}
+
+	// Merge within cache-sized chunks first. Every chunk goes through the
+	// same number of passes, so all chunks end up in the same buffer.
+	//
+	const unsigned long long CHUNK = 4096;
+	bool intmp = false;
+
+	for (unsigned long long c=0; c<n; c+=CHUNK)
+	{
+		unsigned long long cend = std::min(c + CHUNK, n);
+		intmp = false;
+		for (unsigned long long w=W; w<CHUNK; w*=2)
+		{
+			if (intmp)
+				mergepass<HasRids>(tk, tr, k, r, c, cend, w);
+			else
+				mergepass<HasRids>(k, r, tk, tr, c, cend, w);
+			intmp = !intmp;
+		}
+	}
+
+	// Then merge across chunks.
+	//
+	for (unsigned long long w=CHUNK; w<n; w*=2)
+	{
+		if (intmp)
+			mergepass<HasRids>(tk, tr, k, r, 0, n, w);
+		else
+			mergepass<HasRids>(k, r, tk, tr, 0, n, w);
+		intmp = !intmp;
+	}
+
+	if (intmp)
+	{
+		memcpy(k, tk, n * sizeof(long long));
+		if (HasRids)
+			memcpy(r, tr, n * sizeof(unsigned long long));
+	}
+}
+
+static void sort(long long* k, unsigned long long* r,
+		long long* tk, unsigned long long* tr, unsigned long long n)
+{
+	if (r == 0)
+		sortentries<false>(k, r, tk, tr, n);
+	else
+		sortentries<true>(k, r, tk, tr, n);
+}
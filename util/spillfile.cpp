@@ -0,0 +1,111 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdlib>
+#include <unistd.h>
+
+#include "spillfile.h"
+
+/**
+ * Size of the stdio buffer of each spill file.
+ */
+static const size_t SpillBufferSize = 1024 * 1024;
+
+void SpillFile::create(const string& directory)
+{
+	string name = directory + "/pythia-spill-XXXXXX";
+	char* path = new char[name.size() + 1];
+	name.copy(path, name.size());
+	path[name.size()] = 0;
+
+	int fd = mkstemp(path);
+	if (fd != -1)
+	{
+		unlink(path);
+	}
+	delete[] path;
+
+	if (fd == -1)
+		throw SpillFailure();
+
+	file = fdopen(fd, "w+b");
+	if (file == NULL)
+	{
+		::close(fd);
+		throw SpillFailure();
+	}
+
+	buffer = new char[SpillBufferSize];
+	setvbuf(file, buffer, _IOFBF, SpillBufferSize);
+	bytes = 0;
+}
+
+void SpillFile::rewind()
+{
+	if (fflush(file) != 0 || fseek(file, 0, SEEK_SET) != 0)
+		throw SpillFailure();
+}
+
+size_t SpillFile::read(void* dest, size_t size)
+{
+	size_t ret = fread(dest, 1, size, file);
+	if (ret != size && ferror(file))
+		throw SpillFailure();
+	return ret;
+}
+
+unsigned long long SpillFile::readTuples(TupleBuffer* page, unsigned int tuplesize)
+{
+	page->clear();
+	unsigned long long len = (page->capacity() / tuplesize) * tuplesize;
+	void* dest = page->allocate(len);
+	unsigned long long ret = read(dest, len);
+	if (ret % tuplesize != 0)
+		throw SpillFailure();
+
+	page->clear();
+	page->allocate(ret);
+	return ret;
+}
+
+void SpillFile::close()
+{
+	if (file != NULL)
+	{
+		fclose(file);
+		file = NULL;
+	}
+	delete[] buffer;
+	buffer = NULL;
+	bytes = 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYSPILLFILE__
+#define __MYSPILLFILE__
+
+#include <cstdio>
+#include <string>
+using std::string;
+
+#include "../exceptions.h"
+#include "buffer.h"
+
+/**
+ * Anonymous temporary file that operators spill tuples to when their input
+ * does not fit in memory. The file is created in a given directory (such as
+ * /tmp or /dev/shm) and unlinked right away, so it never outlives the
+ * process. It is written sequentially, then rewound and read sequentially.
+ *
+ * Failures to create, write or read the file throw SpillFailure.
+ */
+class SpillFile
+{
+	public:
+		SpillFile() 
+			: file(NULL), buffer(NULL), bytes(0)
+		{ }
+
+		/**
+		 * Creates and opens a new file in \a directory.
+		 */
+		void create(const string& directory);
+
+		/**
+		 * Appends \a size bytes from \a data at the end of the file.
+		 */
+		inline void append(const void* data, size_t size)
+		{
+			if (fwrite(data, 1, size, file) != size)
+				throw SpillFailure();
+			bytes += size;
+		}
+
+		/**
+		 * Flushes all writes and positions the file at its start, for
+		 * reading.
+		 */
+		void rewind();
+
+		/**
+		 * Reads up to \a size bytes into \a dest.
+		 * @return Bytes read, zero if the end of the file has been reached.
+		 */
+		size_t read(void* dest, size_t size);
+
+		/**
+		 * Replaces the contents of \a page with as many whole tuples of
+		 * \a tuplesize bytes as fit from the file.
+		 * @return Bytes read, zero if the end of the file has been reached.
+		 */
+		unsigned long long readTuples(TupleBuffer* page, unsigned int tuplesize);
+
+		/**
+		 * Closes the file, which deletes it.
+		 */
+		void close();
+
+		inline bool isOpen()
+		{
+			return file != NULL;
+		}
+
+		/**
+		 * Returns the number of bytes written to the file.
+		 */
+		inline unsigned long long size()
+		{
+			return bytes;
+		}
+
+	private:
+		FILE* file;
+		char* buffer;
+		unsigned long long bytes;
+};
+
+#endif
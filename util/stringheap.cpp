@@ -0,0 +1,95 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+
+#include "stringheap.h"
+#include "numaallocate.h"
+#include "custom_asserts.h"
+
+StringHeap::StringHeap()
+	: cur(NULL), end(NULL), bytes(0)
+{
+}
+
+StringHeap::~StringHeap()
+{
+	clear();
+}
+
+char* StringHeap::allocateChunk(size_t size)
+{
+	char* chunk = static_cast<char*>(numaallocate_local("StrH", size, this));
+	chunks.push_back(chunk);
+	bytes += size;
+	return chunk;
+}
+
+const char* StringHeap::store(const char* value, size_t len)
+{
+	char* dest;
+
+	lock.lock();
+	if (len > ChunkSize)
+	{
+		// Too long to share a chunk, give it its own.
+		//
+		dest = allocateChunk(len);
+	}
+	else
+	{
+		if (static_cast<size_t>(end - cur) < len)
+		{
+			cur = allocateChunk(ChunkSize);
+			end = cur + ChunkSize;
+		}
+		dest = cur;
+		cur += len;
+	}
+	lock.unlock();
+
+	memcpy(dest, value, len);
+	return dest;
+}
+
+void StringHeap::clear()
+{
+	for (unsigned int i=0; i<chunks.size(); ++i)
+	{
+		numadeallocate(chunks[i]);
+	}
+	std::vector<char*>().swap(chunks);
+	cur = NULL;
+	end = NULL;
+	bytes = 0;
+}
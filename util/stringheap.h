@@ -0,0 +1,89 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYSTRINGHEAP__
+#define __MYSTRINGHEAP__
+
+#include <vector>
+#include <cstddef>
+
+#include "../lock.h"
+
+/**
+ * Append-only storage for the bytes of "varchar" values, kept outside of
+ * the tuples. Strings are copied into chunks of \a ChunkSize bytes, and all
+ * chunks are freed together by clear(), so a string stays valid for the
+ * lifetime of the heap. Strings longer than \a ChunkSize get a chunk of their
+ * own.
+ *
+ * The lock only protects bumping the allocation pointer; strings are copied
+ * outside of it, so that parse threads can store concurrently.
+ */
+class StringHeap
+{
+	public:
+		StringHeap();
+		~StringHeap();
+
+		/**
+		 * Copies the \a len bytes at \a value into the heap and returns
+		 * their new address. Thread-safe.
+		 */
+		const char* store(const char* value, size_t len);
+
+		/**
+		 * Frees all strings. Not thread-safe.
+		 */
+		void clear();
+
+		/**
+		 * Returns the number of bytes of all chunks.
+		 */
+		size_t allocated() { return bytes; }
+
+		static const size_t ChunkSize = 1024 * 1024;
+
+	private:
+		StringHeap(const StringHeap&);
+		StringHeap& operator=(const StringHeap&);
+
+		char* allocateChunk(size_t size);
+
+		Lock lock;
+		char* cur;
+		char* end;
+		size_t bytes;
+		std::vector<char*> chunks;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Substring search kernels. Kernels that need an instruction set extension
+ * are compiled with their own target options, and are selected at runtime
+ * based on what the CPU supports, as in hashkernels.cpp. All kernels find
+ * the same, leftmost occurrence.
+ */
+
+#include "strkernels.h"
+
+#include <cstring>
+#include <immintrin.h>
+
+static int strfindscalar(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen)
+{
+	if (needlelen == 0)
+		return 0;
+
+	for (size_t i=0; i + needlelen <= haylen; ++i)
+	{
+		if (hay[i] == needle[0] && memcmp(hay + i, needle, needlelen) == 0)
+			return i;
+	}
+	return -1;
+}
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2")
+
+/**
+ * PCMPESTRI in "equal ordered" mode returns the first position of a block
+ * of 16 bytes where the first 16 bytes of the needle start, including
+ * partial matches at the end of the block. Candidates are verified with
+ * memcmp, and the search resumes right after a false candidate.
+ */
+static int strfindsse42(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen)
+{
+	if (needlelen == 0)
+		return 0;
+	if (needlelen > haylen)
+		return -1;
+
+	const int prefixlen = needlelen < 16 ? needlelen : 16;
+	char prefix[16] = {0};
+	memcpy(prefix, needle, prefixlen);
+	const __m128i n = _mm_loadu_si128((const __m128i*) prefix);
+
+	const size_t last = haylen - needlelen;
+	size_t i = 0;
+
+	while (i <= last)
+	{
+		// Never read past the end of the haystack.
+		//
+		const size_t avail = haylen - i;
+		__m128i h;
+		if (avail >= 16)
+		{
+			h = _mm_loadu_si128((const __m128i*) (hay + i));
+		}
+		else
+		{
+			char tail[16] = {0};
+			memcpy(tail, hay + i, avail);
+			h = _mm_loadu_si128((const __m128i*) tail);
+		}
+
+		const int blocklen = avail < 16 ? avail : 16;
+		const int idx = _mm_cmpestri(n, prefixlen, h, blocklen, 
+				_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED);
+
+		if (idx == 16)
+		{
+			i += 16;
+			continue;
+		}
+
+		const size_t pos = i + idx;
+		if (pos > last)
+			return -1;
+		if (memcmp(hay + pos, needle, needlelen) == 0)
+			return pos;
+		i = pos + 1;
+	}
+
+	return -1;
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi")
+
+/**
+ * Compares the first and the last byte of the needle against 32 positions
+ * at a time, and verifies only the positions where both match.
+ */
+static int strfindavx2(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen)
+{
+	if (needlelen == 0)
+		return 0;
+	if (needlelen > haylen)
+		return -1;
+
+	const __m256i first = _mm256_set1_epi8(needle[0]);
+	const __m256i last = _mm256_set1_epi8(needle[needlelen - 1]);
+
+	size_t i = 0;
+	for (; i + needlelen - 1 + 32 <= haylen; i += 32)
+	{
+		const __m256i blockfirst = _mm256_loadu_si256((const __m256i*) (hay + i));
+		const __m256i blocklast = 
+			_mm256_loadu_si256((const __m256i*) (hay + i + needlelen - 1));
+		unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(
+					_mm256_cmpeq_epi8(first, blockfirst),
+					_mm256_cmpeq_epi8(last, blocklast)));
+
+		while (mask != 0)
+		{
+			const unsigned int bit = __builtin_ctz(mask);
+			if (needlelen <= 2 
+					|| memcmp(hay + i + bit + 1, needle + 1, needlelen - 2) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+
+	int ret = strfindscalar(hay + i, haylen - i, needle, needlelen);
+	return (ret == -1) ? -1 : i + ret;
+}
+#pragma GCC pop_options
+
+static StrKernelIsa detectIsa()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return StrKernelAVX2;
+	if (__builtin_cpu_supports("sse4.2"))
+		return StrKernelSSE42;
+	return StrKernelScalar;
+}
+
+StrKernelIsa strKernelDetectIsa()
+{
+	static StrKernelIsa isa = detectIsa();
+	return isa;
+}
+
+const char* strKernelIsaName(StrKernelIsa isa)
+{
+	switch (isa)
+	{
+		case StrKernelSSE42:
+			return "sse4.2";
+		case StrKernelAVX2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+int strfind(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen, StrKernelIsa isa)
+{
+	switch (isa)
+	{
+		case StrKernelAVX2:
+			return strfindavx2(hay, haylen, needle, needlelen);
+		case StrKernelSSE42:
+			return strfindsse42(hay, haylen, needle, needlelen);
+		default:
+			return strfindscalar(hay, haylen, needle, needlelen);
+	}
+}
+
+int strfind(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen)
+{
+	return strfind(hay, haylen, needle, needlelen, strKernelDetectIsa());
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2014, Pythia authors (see AUTHORS file).
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ * 
+ * 3. Neither the name of the copyright holder nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MYSTRKERNELS__
+#define __MYSTRKERNELS__
+
+#include <cstddef>
+
+/**
+ * Instruction sets that the string search kernels have implementations for.
+ */
+enum StrKernelIsa
+{
+	StrKernelScalar,	///< Portable fallback.
+	StrKernelSSE42,		///< PCMPESTRI, 16 positions per instruction.
+	StrKernelAVX2		///< First and last byte compares, 32 positions at a time.
+};
+
+/**
+ * Returns the widest instruction set this CPU supports, as detected on the
+ * first call.
+ */
+StrKernelIsa strKernelDetectIsa();
+
+/**
+ * Returns a printable name for \a isa.
+ */
+const char* strKernelIsaName(StrKernelIsa isa);
+
+/**
+ * Returns the position of the first occurrence of the \a needlelen bytes at
+ * \a needle within the \a haylen bytes at \a hay, or -1 if there is none. 
+ * An empty needle is found at position 0. No byte past \a hay + \a haylen 
+ * is read, so \a hay can point into the middle of a page.
+ *
+ * The kernel for \a isa is used, which must be supported by this CPU.
+ * The overload without \a isa uses strKernelDetectIsa().
+ */
+int strfind(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen, StrKernelIsa isa);
+
+int strfind(const char* hay, size_t haylen, 
+		const char* needle, size_t needlelen);
+
+#endif
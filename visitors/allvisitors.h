@@ -50,6 +50,7 @@ class SimpleVisitor : public Visitor {
 		void visit(SingleInputOp* op) { this->simplevisit(op); }
 		void visit(Filter* op) { this->simplevisit(op); }
 		void visit(SortLimit* op) { this->simplevisit(op); }
+		void visit(SortOp* op) { this->simplevisit(op); }
 		void visit(ConsumeOp* op) { this->simplevisit(op); }
 		void visit(PartitionOp* op) { this->simplevisit(op); }
 		void visit(GenericAggregate* op) { this->simplevisit(op); }
@@ -99,6 +100,7 @@ class RecursiveDestroyVisitor : public SimpleVisitor {
 		virtual void simplevisit(SingleInputOp* op);
 		virtual void simplevisit(DualInputOp* op);
 		virtual void simplevisit(ZeroInputOp* op);
+		virtual void visit(StarJoinOp* op);
 };
 
 class ThreadInitVisitor : public SimpleVisitor {
@@ -108,6 +110,7 @@ class ThreadInitVisitor : public SimpleVisitor {
 		virtual void simplevisit(DualInputOp* op);
 		virtual void simplevisit(ZeroInputOp* op);
 		virtual void visit(MergeOp* op);
+		virtual void visit(StarJoinOp* op);
 	private:
 		unsigned short threadid;
 };
@@ -119,6 +122,7 @@ class ThreadCloseVisitor : public SimpleVisitor {
 		virtual void simplevisit(DualInputOp* op);
 		virtual void simplevisit(ZeroInputOp* op);
 		virtual void visit(MergeOp* op);
+		virtual void visit(StarJoinOp* op);
 	private:
 		unsigned short threadid;
 };
@@ -129,6 +133,7 @@ class RecursiveFreeVisitor : public SimpleVisitor {
 		virtual void simplevisit(SingleInputOp* op);
 		virtual void simplevisit(DualInputOp* op);
 		virtual void simplevisit(ZeroInputOp* op);
+		virtual void visit(StarJoinOp* op);
 };
 
 class PrettyPrinterVisitor : public Visitor {
@@ -138,6 +143,7 @@ class PrettyPrinterVisitor : public Visitor {
 		void visit(SingleInputOp* op); 
 		void visit(Filter* op);
 		void visit(SortLimit* op);
+		void visit(SortOp* op);
 		void visit(GenericAggregate* op);
 		void visit(AggregateSum* op);
 		void visit(AggregateCount* op);
@@ -153,6 +159,7 @@ class PrettyPrinterVisitor : public Visitor {
 		void visit(ConsumeOp* op);
 		void visit(CallCountPrinter* op);
 		void visit(PartitionOp* op);
+		void visit(StarJoinOp* op);
 
 		void visit(DualInputOp* op); 
 		void visit(JoinOp* op); 
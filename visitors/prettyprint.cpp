@@ -142,7 +142,12 @@ void printSchema(Schema& s)
 		switch (spec.type)
 		{
 			case CT_INTEGER: 
-				cout << "int";
+				if (spec.dictionary == NULL)
+					cout << "int";
+				else if (spec.dictionary->getName().empty())
+					cout << "dictionary";
+				else
+					cout << "dictionary(" << spec.dictionary->getName() << ")";
 				break;
 			case CT_LONG: 
 				cout << "long";
@@ -159,6 +164,9 @@ void printSchema(Schema& s)
 			case CT_POINTER:
 				cout << "pointer";
 				break;
+			case CT_VARCHAR:
+				cout << "varchar";
+				break;
 			default:
 				cout << "???";
 		}
@@ -196,6 +204,7 @@ void PrettyPrinterVisitor::visit(GenericAggregate* op) {
 	printIdent();
 	cout << "UNKNOWN AGGREGATION ("
 		<< "agg-fields=" << printvecaddone(op->aggfields) 
+		<< (op->pagefold ? ", pagefold" : "")
 		<< ")" << endl; 
 
 	for (int i=0; i<MAX_THREADS; ++i)
@@ -215,7 +224,8 @@ void PrettyPrinterVisitor::visit(AggregateSum* op) {
 	printIdent();
 	cout << "AggregateSum ("
 		<< "agg-fields=" << printvecaddone(op->aggfields) << ", "
-		<< "sumonfield=" << op->sumfieldno + 1 << ")" << endl;
+		<< "sumonfield=" << op->sumfieldno + 1
+		<< (op->pagefold ? ", pagefold" : "") << ")" << endl;
 
 	for (int i=0; i<MAX_THREADS; ++i)
 	{
@@ -241,6 +251,7 @@ void PrettyPrinterVisitor::visit(AggregateCount* op) {
 	printIdent();
 	cout << "AggregateCount ("
 		<< "agg-fields=" << printvecaddone(op->aggfields) 
+		<< (op->pagefold ? ", pagefold" : "")
 		<< ")" << endl; 
 
 	for (int i=0; i<MAX_THREADS; ++i)
@@ -301,7 +312,10 @@ void printJoinProjection(const vector<JoinOp::JoinPrjT>& prj)
 			default:
 				cout << "?";
 		}
-		cout << "$" << prj[i].second + 1 << ", ";
+		if (prj[i].second == JoinOp::RowPointer)
+			cout << "$rowid, ";
+		else
+			cout << "$" << prj[i].second + 1 << ", ";
 	}
 	if (prj.size() != 0)
 		cout << "\b\b";
@@ -439,7 +453,11 @@ void PrettyPrinterVisitor::printSortMergeJoin(SortMergeJoinOp* op)
 	cout << "on B$" << op->joinattr1 + 1 << "=P$" << op->joinattr2 + 1;
 	cout << ", ";
 
-	if (op->prepartfn.buckets() > 1)
+	if (op->prepartfn.buckets() > 1 && op->prepartsampled)
+	{
+		cout << "build prepartitioned on sampled splitters, ";
+	}
+	else if (op->prepartfn.buckets() > 1)
 	{
 		cout << "build prepartitioned, ";
 	}
@@ -466,6 +484,16 @@ void PrettyPrinterVisitor::printSortMergeJoin(SortMergeJoinOp* op)
 		cout << "sort probe, ";
 	}
 
+	if (!op->buildpresorted || !op->probepresorted)
+	{
+		cout << sortAlgorithmName(op->sortalgo) << " sort, ";
+	}
+
+	if (op->usespill)
+	{
+		cout << "build spills over " 
+			<< addcommas(op->spillbudget / 1024 / 1024) << "MB per thread, ";
+	}
 
 	cout << "project=[";
 	printJoinProjection(op->projection);
@@ -497,16 +525,19 @@ void PrettyPrinterVisitor::printSortMergeJoin(SortMergeJoinOp* op)
 		for (unsigned int i=0; i<threads; ++i)
 		{
 			printIdent();
-			cout << ". Thread " << setw(2) << setfill('0') << i << ": " 
-				<< "Join key range [" 
-				<< setw(rangemaxchar) << setfill(' ') 
-					<< op->prepartfn.minimumforbucket(i) << "-" 
-				<< setw(rangemaxchar) << setfill(' ') 
-					<< op->prepartfn.minimumforbucket(i+1) - 1 
-				<< "]";
+			cout << ". Thread " << setw(2) << setfill('0') << i << ": ";
+			if (!op->prepartsampled)
+			{
+				cout << "Join key range [" 
+					<< setw(rangemaxchar) << setfill(' ') 
+						<< op->prepartfn.minimumforbucket(i) << "-" 
+					<< setw(rangemaxchar) << setfill(' ') 
+						<< op->prepartfn.minimumforbucket(i+1) - 1 
+					<< "], ";
+			}
 			if (op->sortmergejoinstate[i] != 0)
 			{
-				cout << ", setting iterators for "
+				cout << "setting iterators for "
 					<< setw(12) << fixed << setprecision(2) << setfill(' ') 
 						<< (op->sortmergejoinstate[i]->setitercycles) / 1000. / 1000.
 					<< " cycles";
@@ -540,7 +571,13 @@ void PrettyPrinterVisitor::printSortMergeJoin(SortMergeJoinOp* op)
 			<< " mil cycles to sort "
 			<< setw(15) << setfill(' ') 
 			<< addcommas(op->sortmergejoinstate[i]->buildusedbytes) 
-			<< " bytes" << endl;
+			<< " bytes";
+		if (op->sortmergejoinstate[i]->buildrunsspilled != 0)
+		{
+			cout << " in " << op->sortmergejoinstate[i]->buildrunsspilled
+				<< " runs on disk";
+		}
+		cout << endl;
 	}
 	op->buildOp->accept(this);
 
@@ -570,7 +607,31 @@ void PrettyPrinterVisitor::printSortMergeJoin(SortMergeJoinOp* op)
 
 void PrettyPrinterVisitor::printHashJoinOp(HashJoinOp* op)
 {
-	cout << "on B$" << op->joinattr1 + 1 << "=P$" << op->joinattr2 + 1;
+	switch (op->jointype)
+	{
+		case HashJoinOp::LeftSemiJoin:
+			cout << "leftsemi ";
+			break;
+		case HashJoinOp::LeftAntiJoin:
+			cout << "leftanti ";
+			break;
+		case HashJoinOp::RightSemiJoin:
+			cout << "rightsemi ";
+			break;
+		case HashJoinOp::RightAntiJoin:
+			cout << "rightanti ";
+			break;
+		default:
+			break;
+	}
+
+	cout << "on ";
+	for (unsigned int i=0; i<op->joinattrs1.size(); ++i)
+	{
+		cout << "B$" << op->joinattrs1[i] + 1 << "=P$" << op->joinattrs2[i] + 1;
+		if (i != op->joinattrs1.size() - 1)
+			cout << " and ";
+	}
 	cout << ", ";
 
 	cout << "project=[";
@@ -598,13 +659,68 @@ void PrettyPrinterVisitor::printHashJoinOp(HashJoinOp* op)
 	identation++;
 	printIdent();
 	cout << "Build (allocon="; 
-	if (op->allocpolicy.empty())
+	if (op->replicate)
+		cout << "replicated on " << op->numanodes << " nodes";
+	else if (op->allocpolicy.empty())
 		cout << "local";
 	else
 		cout << printvec(op->allocpolicy);
+	if (op->usedensekeys)
+		cout << ", densekeys=[" << op->densemin << "," << op->densemax << "]";
+	if (op->usespill)
+		cout << ", spill=" << addcommas(op->spillbudget / 1024 / 1024) << "MB"
+			<< " in " << op->spillparts << " partitions";
 	cout << ")" << endl;
 	for (unsigned int i=0; i<op->groupleader.size(); ++i)
 	{
+		if (op->usespill && op->spillgroupstate.at(i) != NULL)
+		{
+			unsigned int spilledparts = 0;
+			for (unsigned int p=0; p<op->spillparts; ++p)
+				spilledparts += op->spillgroupstate[i]->spilled[p] ? 1 : 0;
+
+			unsigned long long buildspilled = 0, probespilled = 0;
+			unsigned long long joined = 0, repartitions = 0;
+			for (unsigned int t=0; t<op->threadgroups.size(); ++t)
+			{
+				HashJoinOp::SpillThreadState* ss = op->spillthreadstate.at(t);
+				if (op->threadgroups[t] != i || ss == NULL)
+					continue;
+				buildspilled += ss->buildtuplesspilled;
+				probespilled += ss->probetuplesspilled;
+				joined += ss->partitionsjoined;
+				repartitions += ss->repartitions;
+			}
+
+			printIdent();
+			cout << ". Group " << setw(2) << setfill('0') << i << ": ";
+			cout << "Spill (";
+			cout << "partitions=" << spilledparts << "/" << op->spillparts;
+			cout << ", ";
+			cout << "buildtuples=" << addcommas(buildspilled);
+			cout << ", ";
+			cout << "probetuples=" << addcommas(probespilled);
+			cout << ", ";
+			cout << "joined=" << addcommas(joined);
+			cout << ", ";
+			cout << "repartitioned=" << addcommas(repartitions);
+			cout << ")" << endl;
+		}
+
+		if (op->usedensekeys && op->densetable.at(i).bitmap != 0)
+		{
+			DenseKeyTable& dt = op->densetable[i];
+			printIdent();
+			cout << ". Group " << setw(2) << setfill('0') << i << ": ";
+			cout << "DenseKeyTable (";
+			cout << "slots=" << addcommas(dt.getNumberOfSlots());
+			cout << ", ";
+			cout << "occupied=" << addcommas(dt.statOccupied());
+			cout << ", ";
+			cout << "fallback=" << (dt.hasFailed() ? "yes" : "no");
+			cout << ")" << endl;
+		}
+
 		if (op->hashtable.at(i).nbuckets == 0)
 			continue;
 
@@ -629,6 +745,46 @@ void PrettyPrinterVisitor::visit(HashJoinOp* op)
 	op->probeOp->accept(this);
 }
 
+void PrettyPrinterVisitor::visit(StarJoinOp* op)
+{
+	printIdent();
+	cout << "StarJoin (project=[";
+	for (unsigned int i=0; i<op->projection.size(); ++i)
+	{
+		int source = op->projection[i].first;
+		unsigned int attr = op->projection[i].second;
+		if (source < 0)
+			cout << "P$" << attr + 1;
+		else
+			cout << "D" << source << "$" 
+				<< op->dimensions[source].buildattrs[attr] + 1;
+		if (i != op->projection.size() - 1)
+			cout << ", ";
+	}
+	cout << "])" << endl;
+
+	identation++;
+	for (unsigned int i=0; i<op->dimensions.size(); ++i)
+	{
+		StarJoinOp::Dimension& dim = op->dimensions[i];
+		printIdent();
+		cout << "Dimension " << i << " (on D" << i << "$" << dim.buildjattr + 1
+			<< "=P$" << dim.probejattr + 1 << ")" << endl;
+		if (dim.hashtable.nbuckets != 0)
+		{
+			printIdent();
+			cout << ". ";
+			printHashTableStats(dim.hashtable);
+		}
+		op->dimensionOps[i]->accept(this);
+	}
+	identation--;
+
+	printIdent();
+	cout << "Fact" << endl;
+	op->nextOp->accept(this);
+}
+
 void PrettyPrinterVisitor::visit(IndexHashJoinOp* op) 
 {
 	printIdent();
@@ -931,14 +1087,31 @@ void PrettyPrinterVisitor::visit(SortLimit* op)
 	printIdent();
 	cout << "SortLimit (";
 	cout << "orderby=" << printvecaddone(op->orderby);
-    if (op->asc == 1){
-        cout<<" ascending";
-    }else{
-        cout<<" descending";
-    }
-    cout<< ", limit=" << op->limit;
+	cout << ", order=";
+	for (unsigned int i=0; i<op->asc.size(); ++i)
+	{
+		cout << (i == 0 ? "" : ",") << (op->asc[i] ? "asc" : "desc");
+	}
+	cout << ", limit=" << op->limit;
+	cout << ", threads=" << op->threads;
 	cout << ")" << endl;
-    op->nextOp->accept(this);
+	op->nextOp->accept(this);
+}
+
+void PrettyPrinterVisitor::visit(SortOp* op)
+{
+	printIdent();
+	cout << "Sort (";
+	cout << "orderby=" << printvecaddone(op->orderby);
+	cout << ", order=";
+	for (unsigned int i=0; i<op->asc.size(); ++i)
+	{
+		cout << (i == 0 ? "" : ",") << (op->asc[i] ? "asc" : "desc");
+	}
+	cout << ", threads=" << op->threads;
+	cout << ", samples=" << op->samplesperthread;
+	cout << ")" << endl;
+	op->nextOp->accept(this);
 }
 
 void PrettyPrinterVisitor::visit(TupleCountPrinter* op)
@@ -1047,15 +1220,77 @@ void PrettyPrinterVisitor::visit(ConsumeOp* op)
 void PrettyPrinterVisitor::visit(PartitionOp* op)
 {
 	PartitionOp::PartitionState* state; 
-	ExactRangeValueHasher* realfn = 
-		dynamic_cast<ExactRangeValueHasher*>(op->hashfn.fn);
-	unsigned int threads = realfn->buckets();
+	unsigned int threads = op->hashfn.buckets();
+
+	// Partition i holds [mininclusive[i], maxinclusive[i]].
+	//
+	vector<string> mininclusive;
+	vector<string> maxinclusive;
+	if (op->sampledsplitters)
+	{
+		SplitterValueHasher* realfn = 
+			dynamic_cast<SplitterValueHasher*>(op->hashfn.fn);
+		const vector<CtLong>& splitters = realfn->splitters();
+		const vector<SplitterValueHasher::SpreadKey>& spreadkeys = 
+			realfn->spreadkeys();
+		for (unsigned int i=0; i<threads; ++i)
+		{
+			bool lofinite = (i != 0 && splitters.size() >= i);
+			bool hifinite = (i != threads-1 && splitters.size() > i);
+			CtLong lo = lofinite ? splitters[i-1] : 0;
+			CtLong hi = hifinite ? splitters[i]-1 : 0;
+
+			// Heavy hitters spread over this partition widen its range.
+			//
+			for (unsigned int j=0; j<spreadkeys.size(); ++j)
+			{
+				const SplitterValueHasher::SpreadKey& sk = spreadkeys[j];
+				if (i < sk.first || i >= sk.first + sk.cumulative.size())
+					continue;
+				lo = min(lo, sk.key);
+				hi = max(hi, sk.key);
+			}
+
+			ostringstream lostr, histr;
+			if (lofinite)
+				lostr << lo;
+			else
+				lostr << "-inf";
+			if (hifinite)
+				histr << hi;
+			else
+				histr << "+inf";
+			mininclusive.push_back(lostr.str());
+			maxinclusive.push_back(histr.str());
+		}
+	}
+	else
+	{
+		ExactRangeValueHasher* realfn = 
+			dynamic_cast<ExactRangeValueHasher*>(op->hashfn.fn);
+		for (unsigned int i=0; i<threads; ++i)
+		{
+			ostringstream lo, hi;
+			lo << realfn->minimumforbucket(i);
+			hi << realfn->minimumforbucket(i+1) - 1;
+			mininclusive.push_back(lo.str());
+			maxinclusive.push_back(hi.str());
+		}
+	}
+
+	unsigned int rangemaxchar = 1;
+	for (unsigned int i=0; i<threads; ++i)
+	{
+		rangemaxchar = max<unsigned int>(rangemaxchar, mininclusive[i].size());
+		rangemaxchar = max<unsigned int>(rangemaxchar, maxinclusive[i].size());
+	}
 
 	if (op->sortoutput)
 	{
 		printIdent();
 		cout << "Sort ("
 			<< "attribute=" << op->sortattribute + 1 
+			<< ", " << sortAlgorithmName(op->sortalgo)
 			<< ")" << endl;
 
 		for (unsigned int i=0; i<threads; ++i)
@@ -1076,24 +1311,35 @@ void PrettyPrinterVisitor::visit(PartitionOp* op)
 	printIdent();
 	cout << "Partition (" 
 		<< "attribute=" << op->attribute + 1 
-		<< ", "
-		<< "range=[" << realfn->minimumforbucket(0) << ","
-			<< realfn->minimumforbucket(threads)-1 << "]"
-		<< ", "
-		<< "partitions=" << threads 
-		<< ")" << endl;
+		<< ", ";
+	if (op->sampledsplitters)
+	{
+		cout << "sampled splitters, " 
+			<< op->samplesize << " samples per thread";
+	}
+	else
+	{
+		cout << "range=[" << mininclusive[0] << "," 
+			<< maxinclusive[threads-1] << "]";
+	}
+	cout << ", "
+		<< "partitions=" << threads;
+	if (op->usespill)
+	{
+		cout << ", spill=" << addcommas(op->spillbudget / 1024 / 1024) 
+			<< "MB per thread";
+	}
+	cout << ")" << endl;
 
-	unsigned int rangemaxchar = 1 +
-		lrint(log10(realfn->minimumforbucket(threads)-1));
+	unsigned long long totalout = 0;
+	unsigned long long maxout = 0;
 	for (unsigned int i=0; i<threads; ++i)
 	{
 		printIdent();
 		cout << ". #" << setw(2) << setfill('0') << i << ": " 
 			<< "[" 
-			<< setw(rangemaxchar) << setfill(' ') 
-				<< realfn->minimumforbucket(i) << "-" 
-			<< setw(rangemaxchar) << setfill(' ') 
-				<< realfn->minimumforbucket(i+1) - 1 
+			<< setw(rangemaxchar) << setfill(' ') << mininclusive[i] << "-" 
+			<< setw(rangemaxchar) << setfill(' ') << maxinclusive[i] 
 			<< "] ";
 
 		state = op->partitionstate[threads-1];
@@ -1101,6 +1347,8 @@ void PrettyPrinterVisitor::visit(PartitionOp* op)
 		{
 			cout << setw(13) << setfill(' ') 
 					<< addcommas(state->idxstart[i]) << " tuples out, ";
+			totalout += state->idxstart[i];
+			maxout = max<unsigned long long>(maxout, state->idxstart[i]);
 		}
 
 		state = op->partitionstate[i];
@@ -1111,9 +1359,42 @@ void PrettyPrinterVisitor::visit(PartitionOp* op)
 			cout << setw(12) << fixed << setprecision(2) << setfill(' ') 
 				<< (state->bufferingcycles) / 1000. / 1000.
 				<< " mil cycles to buffer input";
+			if (state->tuplesspilled != 0)
+			{
+				cout << ", " << addcommas(state->tuplesspilled) 
+					<< " tuples spilled";
+			}
 		}
 		cout << endl;
 	}
+
+	// Imbalance is the largest partition over the average partition size.
+	//
+	if (totalout != 0)
+	{
+		printIdent();
+		cout << ". imbalance: " << fixed << setprecision(2) 
+			<< maxout / (totalout / (double) threads)
+			<< " (largest partition over average)" << endl;
+	}
+
+	if (op->splitheavyhitters && !op->heavyhitters.empty())
+	{
+		SplitterValueHasher* realfn = 
+			dynamic_cast<SplitterValueHasher*>(op->hashfn.fn);
+		for (unsigned int i=0; i<op->heavyhitters.size(); ++i)
+		{
+			CtLong key = op->heavyhitters[i].key;
+			pair<unsigned int, unsigned int> span = realfn->bucketspan(key);
+			printIdent();
+			cout << ". heavy hitter " << key << ": ~" 
+				<< addcommas((unsigned long long) op->heavyhitters[i].weight)
+				<< " tuples, spread over partitions #" 
+				<< setw(2) << setfill('0') << span.first << "-#" 
+				<< setw(2) << setfill('0') << span.second << endl;
+		}
+	}
+
 	op->nextOp->accept(this);
 }
 
@@ -52,3 +52,10 @@ void RecursiveDestroyVisitor::simplevisit(ZeroInputOp* op)
 {
 	op->destroy();
 }
+
+void RecursiveDestroyVisitor::visit(StarJoinOp* op)
+{
+	for (unsigned int i=0; i<op->dimensionOps.size(); ++i)
+		op->dimensionOps[i]->accept(this);
+	this->simplevisit(op);
+}
@@ -55,3 +55,13 @@ void RecursiveFreeVisitor::simplevisit(ZeroInputOp* op)
 {
 	delete op;
 }
+
+void RecursiveFreeVisitor::visit(StarJoinOp* op)
+{
+	for (unsigned int i=0; i<op->dimensionOps.size(); ++i)
+	{
+		op->dimensionOps[i]->accept(this);
+		op->dimensionOps[i] = NULL;
+	}
+	this->simplevisit(op);
+}
@@ -60,3 +60,10 @@ void ThreadCloseVisitor::visit(MergeOp* op)
 	//
 	op->threadClose(threadid);
 }
+
+void ThreadCloseVisitor::visit(StarJoinOp* op)
+{
+	for (unsigned int i=0; i<op->dimensionOps.size(); ++i)
+		op->dimensionOps[i]->accept(this);
+	this->simplevisit(op);
+}
@@ -60,3 +60,10 @@ void ThreadInitVisitor::visit(MergeOp* op)
 	//
 	op->threadInit(threadid);
 }
+
+void ThreadInitVisitor::visit(StarJoinOp* op)
+{
+	for (unsigned int i=0; i<op->dimensionOps.size(); ++i)
+		op->dimensionOps[i]->accept(this);
+	this->simplevisit(op);
+}
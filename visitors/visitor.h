@@ -52,6 +52,7 @@ class PerfCountPrinter;
 class CallCountPrinter;
 class ConsumeOp;
 class PartitionOp;
+class StarJoinOp;
 
 class DualInputOp;
 class JoinOp;
@@ -64,6 +65,7 @@ class IndexHashJoinOp;
 
 class ShuffleOp;
 class SortLimit;
+class SortOp;
 
 class ZeroInputOp;
 class ScanOp;
@@ -86,6 +88,7 @@ class Visitor {
 		virtual void visit(SingleInputOp* op) = 0;
 		virtual void visit(Filter* op) = 0;
 		virtual void visit(SortLimit* op) = 0;
+		virtual void visit(SortOp* op) = 0;
 		virtual void visit(GenericAggregate* op) = 0;
 		virtual void visit(AggregateSum* op) = 0;
 		virtual void visit(AggregateCount* op) = 0;
@@ -101,6 +104,7 @@ class Visitor {
 		virtual void visit(CallCountPrinter* op) = 0;
 		virtual void visit(ConsumeOp* op) = 0;
 		virtual void visit(PartitionOp* op) = 0;
+		virtual void visit(StarJoinOp* op) = 0;
 
 		virtual void visit(DualInputOp* op) = 0;
 		virtual void visit(JoinOp* op) = 0;